@@ -0,0 +1,84 @@
+/*
+ *  BenchmarkMain.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "BenchmarkSuite.h"
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+
+
+static void printUsage( const char* programName )
+{
+	std::fprintf( stderr, "Usage: %s [--scene <obj path>] [--threads N] [--seed N] [--output <json path>]\n",
+				programName );
+}
+
+
+
+
+int main (int argc, char * const argv[])
+{
+	BenchmarkSuite suite;
+	const char* scenePath = "Data/Port City/Port City.obj";
+	const char* outputPath = NULL;
+	
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( i + 1 >= argc )
+		{
+			printUsage( argv[0] );
+			return 1;
+		}
+		
+		const char* option = argv[i];
+		const char* value = argv[++i];
+		
+		if ( std::strcmp( option, "--scene" ) == 0 )
+			scenePath = value;
+		else if ( std::strcmp( option, "--threads" ) == 0 )
+			suite.setThreadCount( Size(std::strtoul( value, NULL, 10 )) );
+		else if ( std::strcmp( option, "--seed" ) == 0 )
+			suite.setRandomSeed( UInt32(std::strtoul( value, NULL, 10 )) );
+		else if ( std::strcmp( option, "--output" ) == 0 )
+			outputPath = value;
+		else
+		{
+			printUsage( argv[0] );
+			return 1;
+		}
+	}
+	
+	if ( !suite.loadScene( scenePath ) )
+		return 1;
+	
+	suite.run();
+	
+	// The progress goes to stderr, so the JSON can be read from stdout if there is no output file.
+	if ( outputPath == NULL )
+	{
+		suite.writeJSON( stdout );
+		return 0;
+	}
+	
+	std::FILE* file = std::fopen( outputPath, "w" );
+	
+	if ( file == NULL )
+	{
+		std::fprintf( stderr, "Unable to write the results file %s\n", outputPath );
+		return 1;
+	}
+	
+	suite.writeJSON( file );
+	std::fclose( file );
+	
+	return 0;
+}
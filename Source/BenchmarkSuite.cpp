@@ -0,0 +1,629 @@
+/*
+ *  BenchmarkSuite.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "BenchmarkSuite.h"
+#include "MeshPrimitiveSet.h"
+
+
+/// The number of random force and torque pairs that the thrust solvers are timed on.
+static const Size NUM_THRUST_PROBLEMS = 256;
+
+
+/// The number of random thrust vectors that the cost function is evaluated for with each force and torque.
+static const Size NUM_COST_SAMPLES = 1024;
+
+
+/// The number of times that the allocation solver is run on each force and torque.
+static const Size NUM_ALLOCATION_REPEATS = 64;
+
+
+/// The number of times that the scene's collision tree is built.
+static const Size NUM_TREE_BUILDS = 3;
+
+
+/// The number of random rays that are traced through the scene.
+static const Size NUM_RAYS = 1 << 18;
+
+
+/// The maximum distance of each random ray.
+static const Float RAY_DISTANCE = 100.0f;
+
+
+/// The number of depth images that are captured from random poses in the scene.
+static const Size NUM_SENSOR_CAPTURES = 64;
+
+
+/// The width of the captured depth images in pixels.
+static const Size SENSOR_WIDTH = 256;
+
+
+/// The height of the captured depth images in pixels.
+static const Size SENSOR_HEIGHT = 192;
+
+
+/// The number of random edges that are tested with each kind of roadmap link.
+static const Size NUM_LINKS = 1 << 16;
+
+
+/// The maximum offset along each axis of the end of a random edge from its start.
+static const Float LINK_OFFSET = 20.0f;
+
+
+/// The radius of the capsule roadmap links, which matches the radius of the roadmap's own edges.
+static const Float LINK_RADIUS = 2.0f;
+
+
+/// The sample counts that the roadmap is rebuilt with. The last is the roadmap used by the later benchmarks.
+static const Size ROADMAP_SAMPLE_COUNTS[] = { 100, 1000, 10000 };
+
+
+/// The total number of samples that are linked for each roadmap sample count, repeating the smaller roadmaps.
+static const Size ROADMAP_TOTAL_SAMPLES = 10000;
+
+
+/// The number of random path queries on the scene roadmap.
+static const Size NUM_PLANNER_QUERIES = 1024;
+
+
+/// The vehicle counts that the simulation is timed with.
+static const Size SIMULATION_VEHICLE_COUNTS[] = { 1, 4, 16, 64, 256, 1024 };
+
+
+/// The number of simulation steps that are timed for each vehicle count.
+static const Size NUM_SIMULATION_STEPS = 240;
+
+
+/// The fixed simulation time step in seconds.
+static const Float SIMULATION_TIME_STEP = 1.0f/120.0f;
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Helper Functions
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+/// Write a string to a JSON file with quotes, escaping the characters that JSON requires.
+static void writeJSONString( std::FILE* file, const char* string )
+{
+	std::fputc( '"', file );
+	
+	for ( ; *string != '\0'; string++ )
+	{
+		if ( *string == '"' || *string == '\\' )
+			std::fputc( '\\', file );
+		
+		std::fputc( *string, file );
+	}
+	
+	std::fputc( '"', file );
+}
+
+
+
+
+/// Return the total number of neighbor entries over all nodes of a roadmap.
+static Size getEdgeCount( const Roadmap& roadmap )
+{
+	const Size numNodes = roadmap.getNodeCount();
+	Size numEdges = 0;
+	
+	for ( Index i = 0; i < numNodes; i++ )
+		numEdges += roadmap.getNode( i ).neighbors.getSize();
+	
+	return numEdges;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+BenchmarkSuite:: BenchmarkSuite()
+	:	sceneBounds( -300, 300, 0, 50, -500, 300 ),
+		numThreads( 0 ),
+		randomSeed( 0 )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Setup Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool BenchmarkSuite:: loadScene( const char* newScenePath )
+{
+	scenePath = newScenePath;
+	
+	graphics::io::OBJTranscoder objTranscoder;
+	mesh = objTranscoder.decode( ResourceID( scenePath ) ).dynamicCast<GenericMeshShape>();
+	
+	if ( mesh.isNull() )
+	{
+		std::fprintf( stderr, "Unable to load the scene mesh %s\n", newScenePath );
+		return false;
+	}
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Run Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void BenchmarkSuite:: run()
+{
+	threadPool.setThreadCount( numThreads > 0 ? numThreads : threads::Thread::getCPUCount() );
+	results.clear();
+	
+	benchmarkThrustSolvers();
+	benchmarkCollisionTree();
+	
+	// The roadmap builds its own collision tree, which is the same work as the tree benchmark, so it isn't timed.
+	roadmap = Pointer<Roadmap>::construct( mesh, &threadPool );
+	
+	benchmarkRoadmapLinks();
+	benchmarkRoadmapRebuild();
+	benchmarkPlanner();
+	benchmarkSimulation();
+}
+
+
+
+
+void BenchmarkSuite:: writeJSON( std::FILE* file ) const
+{
+	std::fprintf( file, "{\n  \"scene\": " );
+	writeJSONString( file, (const char*)scenePath.getCString() );
+	std::fprintf( file, ",\n  \"threads\": %lu,\n  \"seed\": %lu,\n  \"results\": [\n",
+				(unsigned long)threadPool.getThreadCount(), (unsigned long)randomSeed );
+	
+	for ( Index i = 0; i < results.getSize(); i++ )
+	{
+		const Result& result = results[i];
+		const Double seconds = result.time.getSeconds();
+		
+		std::fprintf( file, "    { \"name\": " );
+		writeJSONString( file, result.name );
+		std::fprintf( file, ", \"parameter\": %lu, \"iterations\": %lu, \"seconds\": %.9f, \"rate\": %.6g, \"unit\": ",
+					(unsigned long)result.parameter, (unsigned long)result.numIterations, seconds,
+					seconds > 0 ? Double(result.numIterations) / seconds : 0.0 );
+		writeJSONString( file, result.unit );
+		std::fprintf( file, ", \"checksum\": %.17g }%s\n", result.checksum, i + 1 < results.getSize() ? "," : "" );
+	}
+	
+	std::fprintf( file, "  ]\n}\n" );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Benchmark Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void BenchmarkSuite:: benchmarkThrustSolvers()
+{
+	Quadcopter quadcopter;
+	quadcopter.setStandardAirframe();
+	
+	const ArrayList<Quadcopter::Motor>& motors = quadcopter.motors;
+	const Size numMotors = Quadcopter::getThrustCount( motors );
+	RandomVariable<Float> randomVariable( randomSeed );
+	
+	// Generate the force and torque problems, with enough upward force to hover.
+	ArrayList<Vector3f> forces( NUM_THRUST_PROBLEMS );
+	ArrayList<Vector3f> torques( NUM_THRUST_PROBLEMS );
+	
+	for ( Index p = 0; p < NUM_THRUST_PROBLEMS; p++ )
+	{
+		forces.add( Vector3f( randomVariable.sample( -5.0f, 5.0f ), randomVariable.sample( 5.0f, 20.0f ),
+							randomVariable.sample( -5.0f, 5.0f ) ) );
+		torques.add( Vector3f( randomVariable.sample( -1.0f, 1.0f ), 0, randomVariable.sample( -1.0f, 1.0f ) ) );
+	}
+	
+	//********************************************************************************
+	// Evaluate the cost function for random thrusts in each motor's range.
+	
+	ArrayList<Quadcopter::ThrustArray> thrustSamples( NUM_COST_SAMPLES );
+	
+	for ( Index s = 0; s < NUM_COST_SAMPLES; s++ )
+	{
+		Quadcopter::ThrustArray thrusts( Float(0) );
+		
+		for ( Index m = 0; m < numMotors; m++ )
+			thrusts[m] = randomVariable.sample( motors[m].thrustRange.min, motors[m].thrustRange.max );
+		
+		thrustSamples.add( thrusts );
+	}
+	
+	Double checksum = 0;
+	Time start = Time::getCurrent();
+	
+	for ( Index p = 0; p < NUM_THRUST_PROBLEMS; p++ )
+	{
+		for ( Index s = 0; s < NUM_COST_SAMPLES; s++ )
+			checksum += Quadcopter::getCost( motors, thrustSamples[s], forces[p], torques[p] );
+	}
+	
+	addResult( "Quadcopter::getCost", numMotors, NUM_THRUST_PROBLEMS*NUM_COST_SAMPLES,
+				Time::getCurrent() - start, "calls/s", checksum );
+				
+	//********************************************************************************
+	// Solve each problem with random-restart hill climbing.
+	
+	RandomVariable<Float> solverVariable( randomSeed );
+	checksum = 0;
+	start = Time::getCurrent();
+	
+	for ( Index p = 0; p < NUM_THRUST_PROBLEMS; p++ )
+	{
+		Quadcopter::ThrustArray thrusts( forces[p].getMagnitude() / Float(numMotors) );
+		Quadcopter::optimizeThrusts( motors, thrusts, forces[p], torques[p], solverVariable );
+		
+		for ( Index m = 0; m < numMotors; m++ )
+			checksum += thrusts[m];
+	}
+	
+	addResult( "Quadcopter::optimizeThrusts", numMotors, NUM_THRUST_PROBLEMS,
+				Time::getCurrent() - start, "solves/s", checksum );
+				
+	//********************************************************************************
+	// Solve each problem with the precomputed allocation, starting from the last solution.
+	
+	const MotorAllocator& allocator = quadcopter.motorAllocator;
+	Quadcopter::ThrustArray previousThrusts( Float(0) );
+	Quadcopter::ThrustArray thrusts( Float(0) );
+	checksum = 0;
+	start = Time::getCurrent();
+	
+	for ( Index r = 0; r < NUM_ALLOCATION_REPEATS; r++ )
+	{
+		for ( Index p = 0; p < NUM_THRUST_PROBLEMS; p++ )
+		{
+			allocator.solve( forces[p], torques[p], previousThrusts.getPointer(), thrusts.getPointer() );
+			previousThrusts = thrusts;
+			checksum += thrusts[0];
+		}
+	}
+	
+	addResult( "MotorAllocator::solve", numMotors, NUM_ALLOCATION_REPEATS*NUM_THRUST_PROBLEMS,
+				Time::getCurrent() - start, "solves/s", checksum );
+}
+
+
+
+
+void BenchmarkSuite:: benchmarkCollisionTree()
+{
+	MeshPrimitiveSet primitives( mesh );
+	Pointer<CollisionTree> tree;
+	Time buildTime;
+	
+	for ( Index i = 0; i < NUM_TREE_BUILDS; i++ )
+	{
+		tree = Pointer<CollisionTree>::construct();
+		
+		const Time start = Time::getCurrent();
+		tree->build( primitives, &threadPool );
+		buildTime += Time::getCurrent() - start;
+	}
+	
+	addResult( "CollisionTree::build", tree->getTriangleCount(), NUM_TREE_BUILDS, buildTime,
+				"builds/s", Double(tree->getNodeCount()) );
+				
+	//********************************************************************************
+	// Trace random rays from points in the scene bounds on one thread.
+	
+	RandomVariable<Float> randomVariable( randomSeed );
+	ArrayList<Vector3f> origins( NUM_RAYS );
+	ArrayList<Vector3f> directions( NUM_RAYS );
+	
+	for ( Index i = 0; i < NUM_RAYS; i++ )
+	{
+		origins.add( getRandomPoint( randomVariable ) );
+		directions.add( getRandomDirection( randomVariable ) );
+	}
+	
+	Size numHits = 0;
+	const Time start = Time::getCurrent();
+	
+	for ( Index i = 0; i < NUM_RAYS; i++ )
+	{
+		Float distance;
+		
+		if ( tree->traceRay( origins[i], directions[i], RAY_DISTANCE, distance ) )
+			numHits++;
+	}
+	
+	addResult( "CollisionTree::traceRay", tree->getTriangleCount(), NUM_RAYS,
+				Time::getCurrent() - start, "rays/s", Double(numHits) );
+				
+	//********************************************************************************
+	// Capture depth images from random level poses, tracing ray packets on the thread pool.
+	
+	RangeSensor sensor;
+	sensor.setResolution( SENSOR_WIDTH, SENSOR_HEIGHT );
+	sensor.setMaxRange( RAY_DISTANCE );
+	
+	ArrayList<Vector3f> positions( NUM_SENSOR_CAPTURES );
+	ArrayList<Matrix3f> orientations( NUM_SENSOR_CAPTURES );
+	
+	for ( Index i = 0; i < NUM_SENSOR_CAPTURES; i++ )
+	{
+		positions.add( getRandomPoint( randomVariable ) );
+		orientations.add( Matrix3f::rotationYDegrees( randomVariable.sample( Float(0), Float(360) ) ) );
+	}
+	
+	Double depthSum = 0;
+	
+	for ( Index i = 0; i < NUM_SENSOR_CAPTURES; i++ )
+	{
+		sensor.capture( positions[i], orientations[i], *tree, &threadPool );
+		
+		const Float* depths = sensor.getDepths();
+		
+		for ( Index p = 0; p < SENSOR_WIDTH*SENSOR_HEIGHT; p++ )
+			depthSum += depths[p];
+	}
+	
+	addResult( "RangeSensor::capture", SENSOR_WIDTH*SENSOR_HEIGHT, sensor.getRayCount(),
+				sensor.getCaptureDuration(), "rays/s", depthSum );
+}
+
+
+
+
+void BenchmarkSuite:: benchmarkRoadmapLinks()
+{
+	RandomVariable<Float> randomVariable( randomSeed );
+	ArrayList<Vector3f> starts( NUM_LINKS );
+	ArrayList<Vector3f> ends( NUM_LINKS );
+	
+	for ( Index i = 0; i < NUM_LINKS; i++ )
+	{
+		const Vector3f start = getRandomPoint( randomVariable );
+		const Vector3f offset( randomVariable.sample( -LINK_OFFSET, LINK_OFFSET ),
+								randomVariable.sample( -LINK_OFFSET, LINK_OFFSET ),
+								randomVariable.sample( -LINK_OFFSET, LINK_OFFSET ) );
+		
+		starts.add( start );
+		ends.add( start + offset );
+	}
+	
+	Size numVisible = 0;
+	Time start = Time::getCurrent();
+	
+	for ( Index i = 0; i < NUM_LINKS; i++ )
+	{
+		if ( roadmap->link( starts[i], ends[i] ) )
+			numVisible++;
+	}
+	
+	addResult( "Roadmap::link ray", 0, NUM_LINKS, Time::getCurrent() - start, "edges/s", Double(numVisible) );
+	
+	numVisible = 0;
+	start = Time::getCurrent();
+	
+	for ( Index i = 0; i < NUM_LINKS; i++ )
+	{
+		if ( roadmap->link( starts[i], ends[i], LINK_RADIUS ) )
+			numVisible++;
+	}
+	
+	addResult( "Roadmap::link capsule", 0, NUM_LINKS, Time::getCurrent() - start, "edges/s", Double(numVisible) );
+}
+
+
+
+
+void BenchmarkSuite:: benchmarkRoadmapRebuild()
+{
+	const Size numSampleCounts = sizeof(ROADMAP_SAMPLE_COUNTS) / sizeof(Size);
+	
+	for ( Index c = 0; c < numSampleCounts; c++ )
+	{
+		const Size numSamples = ROADMAP_SAMPLE_COUNTS[c];
+		const Size numRepeats = math::max( ROADMAP_TOTAL_SAMPLES / numSamples, Size(1) );
+		Size numEdges = 0;
+		Time time;
+		
+		// Reseed before each rebuild so that every repeat builds the same roadmap.
+		for ( Index r = 0; r < numRepeats; r++ )
+		{
+			roadmap->setRandomSeed( randomSeed );
+			
+			const Time start = Time::getCurrent();
+			roadmap->rebuild( sceneBounds, numSamples, &threadPool );
+			time += Time::getCurrent() - start;
+			
+			numEdges = getEdgeCount( *roadmap );
+		}
+		
+		addResult( "Roadmap::rebuild", numSamples, numRepeats, time, "builds/s", Double(numEdges) );
+	}
+}
+
+
+
+
+void BenchmarkSuite:: benchmarkPlanner()
+{
+	RandomVariable<Float> randomVariable( randomSeed );
+	ArrayList<Vector3f> starts( NUM_PLANNER_QUERIES );
+	ArrayList<Vector3f> goals( NUM_PLANNER_QUERIES );
+	
+	for ( Index i = 0; i < NUM_PLANNER_QUERIES; i++ )
+	{
+		starts.add( getRandomPoint( randomVariable ) );
+		goals.add( getRandomPoint( randomVariable ) );
+	}
+	
+	Global_planner planner;
+	Size numWaypoints = 0;
+	const Time start = Time::getCurrent();
+	
+	for ( Index i = 0; i < NUM_PLANNER_QUERIES; i++ )
+		numWaypoints += planner.prm( starts[i], goals[i], roadmap ).size();
+	
+	addResult( "Global_planner::prm", roadmap->getNodeCount(), NUM_PLANNER_QUERIES,
+				Time::getCurrent() - start, "queries/s", Double(numWaypoints) );
+}
+
+
+
+
+void BenchmarkSuite:: benchmarkSimulation()
+{
+	const Size numVehicleCounts = sizeof(SIMULATION_VEHICLE_COUNTS) / sizeof(Size);
+	Global_planner planner;
+	
+	for ( Index c = 0; c < numVehicleCounts; c++ )
+	{
+		const Size numVehicles = SIMULATION_VEHICLE_COUNTS[c];
+		RandomVariable<Float> randomVariable( randomSeed );
+		ArrayList< Pointer<Quadcopter> > quadcopters( numVehicles );
+		
+		Simulation simulation;
+		simulation.setThreadCount( threadPool.getThreadCount() );
+		
+		// Spawn the vehicles at random points with paths to random goals. This isn't timed.
+		for ( Index i = 0; i < numVehicles; i++ )
+		{
+			const Vector3f start = getRandomPoint( randomVariable );
+			const Vector3f goal = getRandomPoint( randomVariable );
+			
+			Pointer<Quadcopter> quadcopter = Pointer<Quadcopter>::construct();
+			quadcopter->currentState.position = start;
+			quadcopter->setStandardAirframe();
+			quadcopter->goalpoint = goal;
+			quadcopter->roadmap = roadmap;
+			quadcopter->path = planner.prm( start, goal, roadmap );
+			quadcopter->nextid = 1;
+			quadcopter->resetLookAhead();
+			quadcopter->nextWaypoint = quadcopter->path.size() > 1 ? quadcopter->path[1] : start;
+			
+			quadcopters.add( quadcopter );
+			simulation.addQuadcopter( quadcopter );
+		}
+		
+		// Seed the vehicles after they are added, since each vehicle's seed depends on its index.
+		simulation.setRandomSeed( randomSeed );
+		
+		const Time start = Time::getCurrent();
+		
+		for ( Index step = 0; step < NUM_SIMULATION_STEPS; step++ )
+			simulation.update( SIMULATION_TIME_STEP );
+		
+		const Time time = Time::getCurrent() - start;
+		Double checksum = 0;
+		
+		for ( Index i = 0; i < numVehicles; i++ )
+		{
+			const Vector3f& position = quadcopters[i]->currentState.position;
+			checksum += position.x + position.y + position.z;
+		}
+		
+		addResult( "Simulation::update", numVehicles, NUM_SIMULATION_STEPS, time, "steps/s", checksum );
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void BenchmarkSuite:: addResult( const char* name, Size parameter, Size numIterations, const Time& time,
+								const char* unit, Double checksum )
+{
+	results.add( Result( name, parameter, numIterations, time, unit, checksum ) );
+	
+	const Double seconds = time.getSeconds();
+	
+	std::fprintf( stderr, "%-28s %8lu %12.1f %s\n", name, (unsigned long)parameter,
+				seconds > 0 ? Double(numIterations) / seconds : 0.0, unit );
+}
+
+
+
+
+Vector3f BenchmarkSuite:: getRandomPoint( RandomVariable<Float>& randomVariable ) const
+{
+	return Vector3f( randomVariable.sample( sceneBounds.min.x, sceneBounds.max.x ),
+					randomVariable.sample( sceneBounds.min.y, sceneBounds.max.y ),
+					randomVariable.sample( sceneBounds.min.z, sceneBounds.max.z ) );
+}
+
+
+
+
+Vector3f BenchmarkSuite:: getRandomDirection( RandomVariable<Float>& randomVariable )
+{
+	// Reject points outside the unit sphere so that the directions are uniformly distributed.
+	while ( true )
+	{
+		const Vector3f v( randomVariable.sample( -1.0f, 1.0f ),
+						randomVariable.sample( -1.0f, 1.0f ),
+						randomVariable.sample( -1.0f, 1.0f ) );
+		const Float magnitudeSquared = v.getMagnitudeSquared();
+		
+		if ( magnitudeSquared > 0.0001f && magnitudeSquared <= 1.0f )
+			return v / math::sqrt( magnitudeSquared );
+	}
+}
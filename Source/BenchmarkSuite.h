@@ -0,0 +1,292 @@
+/*
+ *  BenchmarkSuite.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_BENCHMARK_SUITE_H
+#define INCLUDE_BENCHMARK_SUITE_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "CollisionTree.h"
+#include "RangeSensor.h"
+#include "Quadcopter.h"
+#include "Roadmap.h"
+#include "Simulation.h"
+
+
+#include <cstdio>
+
+
+
+
+/// A class that times the planning, collision, and control hot paths on a fixed workload.
+/**
+  * Every benchmark draws its inputs from random streams with a fixed seed and runs a
+  * fixed number of iterations, so the work done is the same on every run and only the
+  * times change. Each result also has a checksum of its outputs (such as the number
+  * of ray hits), which should be identical between builds that don't change behavior.
+  *
+  * The benchmarks are:
+  *
+  *		Quadcopter::getCost				Thrust cost evaluations per second.
+  *		Quadcopter::optimizeThrusts		Hill-climbing thrust solves per second.
+  *		MotorAllocator::solve			Allocation thrust solves per second.
+  *		CollisionTree::build			Builds of the scene's collision tree per second.
+  *		CollisionTree::traceRay			Rays per second through the scene.
+  *		RangeSensor::capture			Rays per second of 256x192 depth images on the thread pool.
+  *		Roadmap::link					Ray and capsule edge tests per second.
+  *		Roadmap::rebuild				Roadmap builds per second for 100, 1000, and 10000 samples.
+  *		Global_planner::prm				Path queries per second on the 10000-sample roadmap.
+  *		Simulation::update				Steps per second for 1 to 1024 vehicles.
+  */
+class BenchmarkSuite
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new benchmark suite with the default seed and one thread per CPU.
+			BenchmarkSuite();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Setup Methods
+			
+			
+			
+			
+			/// Load the OBJ mesh of the scene that the benchmarks are run in.
+			/**
+			  * The method prints a message and returns FALSE if the mesh can't be loaded.
+			  */
+			Bool loadScene( const char* newScenePath );
+			
+			
+			
+			
+			/// Set the number of worker threads for the parallel benchmarks, where 0 uses one thread per CPU.
+			RIM_INLINE void setThreadCount( Size newNumThreads )
+			{
+				numThreads = newNumThreads;
+			}
+			
+			
+			
+			
+			/// Set the seed of the random streams that the benchmark inputs are drawn from.
+			RIM_INLINE void setRandomSeed( UInt32 newSeed )
+			{
+				randomSeed = newSeed;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Run Methods
+			
+			
+			
+			
+			/// Run every benchmark in order, printing progress to the standard error stream.
+			void run();
+			
+			
+			
+			
+			/// Write the benchmark settings and results to a file as a JSON object.
+			void writeJSON( std::FILE* file ) const;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Result Class Declaration
+			
+			
+			
+			
+			/// A class that stores the timing and output checksum of one benchmark.
+			class Result
+			{
+				public:
+					
+					RIM_INLINE Result( const char* newName, Size newParameter, Size newNumIterations,
+										const Time& newTime, const char* newUnit, Double newChecksum )
+						:	name( newName ),
+							parameter( newParameter ),
+							numIterations( newNumIterations ),
+							time( newTime ),
+							unit( newUnit ),
+							checksum( newChecksum )
+					{
+					}
+					
+					
+					/// The name of the benchmark, which must be a string literal.
+					const char* name;
+					
+					/// The size of the benchmark's workload, such as the number of vehicles.
+					Size parameter;
+					
+					/// The number of timed iterations.
+					Size numIterations;
+					
+					/// The total time of all of the iterations.
+					Time time;
+					
+					/// The unit of the iteration rate, which must be a string literal.
+					const char* unit;
+					
+					/// A value computed from the outputs of the iterations that doesn't depend on their timing.
+					Double checksum;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Benchmark Methods
+			
+			
+			
+			
+			/// Time the cost function and the thrust solvers of a standard quadcopter.
+			void benchmarkThrustSolvers();
+			
+			
+			
+			
+			/// Time building the scene's collision tree, tracing random rays through it, and capturing depth images with it.
+			void benchmarkCollisionTree();
+			
+			
+			
+			
+			/// Time the ray and capsule visibility tests of random roadmap edges.
+			void benchmarkRoadmapLinks();
+			
+			
+			
+			
+			/// Time rebuilding the scene roadmap with each of the benchmark sample counts.
+			void benchmarkRoadmapRebuild();
+			
+			
+			
+			
+			/// Time path queries between random points on the scene roadmap.
+			void benchmarkPlanner();
+			
+			
+			
+			
+			/// Time simulation steps for each of the benchmark vehicle counts.
+			void benchmarkSimulation();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Add a result to the list of results and print it to the standard error stream.
+			void addResult( const char* name, Size parameter, Size numIterations, const Time& time,
+							const char* unit, Double checksum );
+			
+			
+			
+			
+			/// Return a random point in the scene bounds.
+			Vector3f getRandomPoint( RandomVariable<Float>& randomVariable ) const;
+			
+			
+			
+			
+			/// Return a random unit-length direction.
+			static Vector3f getRandomDirection( RandomVariable<Float>& randomVariable );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The path of the scene's OBJ mesh.
+			data::UTF8String scenePath;
+			
+			
+			/// The mesh of the scene.
+			Pointer<GenericMeshShape> mesh;
+			
+			
+			/// The bounds that roadmaps and random queries are sampled in.
+			AABB3f sceneBounds;
+			
+			
+			/// The number of worker threads, or 0 for one per CPU.
+			Size numThreads;
+			
+			
+			/// The seed of the random streams that the benchmark inputs are drawn from.
+			UInt32 randomSeed;
+			
+			
+			/// A pool of worker threads used to build collision trees and roadmaps.
+			threads::ThreadPool threadPool;
+			
+			
+			/// The scene roadmap, which the planning and simulation benchmarks run on.
+			Pointer<Roadmap> roadmap;
+			
+			
+			/// The results of the benchmarks that have been run, in order.
+			ArrayList<Result> results;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_BENCHMARK_SUITE_H
@@ -0,0 +1,1134 @@
+/*
+ *  CollisionTree.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "CollisionTree.h"
+#include "Profiler.h"
+
+
+PROFILER_ZONE( intersectsCapsuleZone, "CollisionTree::intersectsCapsule" );
+PROFILER_ZONE( traceRayZone, "CollisionTree::traceRay" );
+PROFILER_ZONE( traceRayPacketZone, "CollisionTree::traceRayPacket" );
+
+
+/// The child index which marks an unused child of a node.
+static const UInt32 INVALID_CHILD = 0xFFFFFFFF;
+
+
+/// The maximum number of nodes on the traversal stack. Each visited node adds at most three.
+static const Size TRAVERSAL_STACK_SIZE = 3*CollisionTree::MAX_DEPTH + 1;
+
+
+/// The smallest range of primitives whose split bins are filled in parallel.
+static const Size MIN_PARALLEL_BINNING_SIZE = 32768;
+
+
+/// The smallest number of primitives that a subtree job is given, so that the jobs aren't too small to be worth it.
+static const Size MIN_SUBTREE_TASK_SIZE = 1024;
+
+
+/// A value that identifies a collision tree file, the characters 'CTRE'.
+static const UInt32 COLLISION_TREE_FILE_MAGIC = 0x45525443;
+
+
+/// The current version of the collision tree file layout.
+static const UInt32 COLLISION_TREE_FILE_VERSION = 1;
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Helper Functions
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+/// Return the surface area of the specified bounding box, or 0 if it is empty.
+static Float getSurfaceArea( const AABB3f& bounds )
+{
+	const Vector3f size = bounds.max - bounds.min;
+	
+	if ( size.x < 0 || size.y < 0 || size.z < 0 )
+		return Float(0);
+	
+	return Float(2)*(size.x*size.y + size.y*size.z + size.z*size.x);
+}
+
+
+
+
+/// Return the inverse of a direction component, replacing zero with a tiny value so that the slab test stays finite.
+static Float32 getSafeInverse( Float32 value )
+{
+	const Float32 minValue = Float32(1e-20);
+	
+	if ( math::abs( value ) < minValue )
+		return value < 0 ? -1/minValue : 1/minValue;
+	
+	return 1/value;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+CollisionTree:: CollisionTree()
+	:	nodeData( NULL ),
+		numNodes( 0 ),
+		triangleData( NULL ),
+		numTriangles( 0 ),
+		buildThreadPool( NULL ),
+		subtreeTaskSize( 0 )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Build Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void CollisionTree:: build( const bvh::PrimitiveInterface& primitives, threads::ThreadPool* threadPool )
+{
+	clear();
+	
+	const Size numNewTriangles = primitives.getSize();
+	
+	if ( numNewTriangles == 0 || primitives.getType() != bvh::PrimitiveInterfaceType::TRIANGLES )
+		return;
+	
+	const Size numThreads = threadPool != NULL ? threadPool->getThreadCount() : 0;
+	buildThreadPool = numThreads > 1 ? threadPool : NULL;
+	buildPrimitives.setSize( numNewTriangles );
+	
+	if ( buildThreadPool != NULL )
+	{
+		// Compute the triangle bounds in parallel.
+		const Size numJobs = numThreads*4;
+		
+		for ( Index j = 0; j < numJobs; j++ )
+		{
+			buildThreadPool->addJob( bindCall( &CollisionTree::computePrimitiveRange, this, &primitives,
+												(j*numNewTriangles) / numJobs, ((j + 1)*numNewTriangles) / numJobs ) );
+		}
+		
+		buildThreadPool->finishJobs();
+		
+		// Build the top of the tree on this thread, leaving enough subtrees to keep every thread busy.
+		subtreeTaskSize = math::max( numNewTriangles / (numThreads*8), MIN_SUBTREE_TASK_SIZE );
+		nodes.add( Node() );
+		buildNode( nodes, 0, 0, numNewTriangles, 1, true );
+		
+		for ( Index t = 0; t < subtreeTasks.getSize(); t++ )
+			buildThreadPool->addJob( bindCall( &CollisionTree::buildSubtree, this, &subtreeTasks[t] ) );
+		
+		buildThreadPool->finishJobs();
+		
+		// Append the subtrees in the order that they were recorded, so the node order doesn't depend on timing.
+		for ( Index t = 0; t < subtreeTasks.getSize(); t++ )
+		{
+			const SubtreeTask& task = subtreeTasks[t];
+			const UInt32 offset = UInt32(nodes.getSize());
+			
+			nodes[task.parentNode].children[task.child] = offset;
+			
+			for ( Index n = 0; n < task.nodes.getSize(); n++ )
+			{
+				Node node = task.nodes[n];
+				
+				for ( Index c = 0; c < 4; c++ )
+				{
+					if ( node.numTriangles[c] == 0 && node.children[c] != INVALID_CHILD )
+						node.children[c] += offset;
+				}
+				
+				nodes.add( node );
+			}
+		}
+		
+		subtreeTasks.clear();
+		buildThreadPool = NULL;
+	}
+	else
+	{
+		computePrimitiveRange( &primitives, 0, numNewTriangles );
+		nodes.add( Node() );
+		buildNode( nodes, 0, 0, numNewTriangles, 1, false );
+	}
+	
+	// Store the triangles in the order of the leaves so that each leaf's triangles are contiguous.
+	triangles.setCapacity( numNewTriangles );
+	
+	for ( Index p = 0; p < numNewTriangles; p++ )
+	{
+		Triangle<Vector3f> triangle;
+		primitives.getTriangle( buildPrimitives[p].triangle, triangle.v1, triangle.v2, triangle.v3 );
+		triangles.add( triangle );
+	}
+	
+	buildPrimitives.setSize( 0 );
+	useOwnedArrays();
+}
+
+
+
+
+void CollisionTree:: clear()
+{
+	nodes.clear();
+	triangles.clear();
+	file.release();
+	useOwnedArrays();
+	buildPrimitives.setSize( 0 );
+	subtreeTasks.clear();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		File Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool CollisionTree:: save( const data::UTF8String& filePath, UInt64 meshHash ) const
+{
+	FileHeader header;
+	header.magic = COLLISION_TREE_FILE_MAGIC;
+	header.version = COLLISION_TREE_FILE_VERSION;
+	header.meshHash = meshHash;
+	header.numNodes = UInt32(numNodes);
+	header.numTriangles = UInt32(numTriangles);
+	header.nodeSize = UInt32(sizeof(Node));
+	header.triangleSize = UInt32(sizeof(Triangle<Vector3f>));
+	
+	rim::io::FileWriter writer( filePath );
+	
+	if ( !writer.open() )
+		return false;
+	
+	const Size nodesSize = sizeof(Node)*numNodes;
+	const Size trianglesSize = sizeof(Triangle<Vector3f>)*numTriangles;
+	
+	const Bool result = writer.write( (const UByte*)&header, sizeof(FileHeader) ) == sizeof(FileHeader) &&
+						writer.write( (const UByte*)nodeData, nodesSize ) == nodesSize &&
+						writer.write( (const UByte*)triangleData, trianglesSize ) == trianglesSize;
+	
+	writer.close();
+	
+	return result;
+}
+
+
+
+
+Bool CollisionTree:: load( const data::UTF8String& filePath, UInt64 meshHash )
+{
+	Pointer<MappedFile> newFile = Pointer<MappedFile>::construct();
+	
+	if ( !newFile->open( filePath ) || newFile->getSize() < sizeof(FileHeader) )
+		return false;
+	
+	const FileHeader& header = *(const FileHeader*)newFile->getData();
+	
+	if ( header.magic != COLLISION_TREE_FILE_MAGIC || header.version != COLLISION_TREE_FILE_VERSION ||
+		header.meshHash != meshHash || header.nodeSize != sizeof(Node) ||
+		header.triangleSize != sizeof(Triangle<Vector3f>) || header.numNodes == 0 )
+		return false;
+	
+	// Make sure that the file is exactly as large as its header says, so the arrays can be read in place.
+	const UInt64 expectedSize = UInt64(sizeof(FileHeader)) + UInt64(sizeof(Node))*UInt64(header.numNodes) +
+								UInt64(sizeof(Triangle<Vector3f>))*UInt64(header.numTriangles);
+	
+	if ( UInt64(newFile->getSize()) != expectedSize )
+		return false;
+	
+	const Node* newNodes = (const Node*)(newFile->getData() + sizeof(FileHeader));
+	
+	// The queries trust the child indices, so reject a file that could make them read out of bounds.
+	if ( !validateNodes( newNodes, header.numNodes, header.numTriangles ) )
+		return false;
+	
+	clear();
+	
+	file = newFile;
+	nodeData = newNodes;
+	numNodes = header.numNodes;
+	triangleData = (const Triangle<Vector3f>*)(newNodes + numNodes);
+	numTriangles = header.numTriangles;
+	
+	return true;
+}
+
+
+
+
+void CollisionTree:: useOwnedArrays()
+{
+	nodeData = nodes.getPointer();
+	numNodes = nodes.getSize();
+	triangleData = triangles.getPointer();
+	numTriangles = triangles.getSize();
+}
+
+
+
+
+Bool CollisionTree:: validateNodes( const Node* treeNodes, Size treeNodeCount, Size treeTriangleCount )
+{
+	// Every child node comes after its parent, so the depth of each node is known before its children are visited.
+	Array<UByte> depths( treeNodeCount, UByte(0) );
+	depths[0] = 1;
+	
+	for ( Index n = 0; n < treeNodeCount; n++ )
+	{
+		const Node& node = treeNodes[n];
+		
+		for ( Index c = 0; c < 4; c++ )
+		{
+			const UInt32 child = node.children[c];
+			
+			if ( child == INVALID_CHILD )
+				continue;
+			
+			if ( node.numTriangles[c] == 0 )
+			{
+				if ( child <= n || child >= treeNodeCount || depths[n] >= MAX_DEPTH )
+					return false;
+				
+				depths[child] = UByte(depths[n] + 1);
+			}
+			else if ( node.numTriangles[c] > treeTriangleCount || child > treeTriangleCount - node.numTriangles[c] )
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+
+
+
+void CollisionTree:: computePrimitiveRange( const bvh::PrimitiveInterface* primitives, Index start, Index end )
+{
+	for ( Index t = start; t < end; t++ )
+	{
+		Vector3f v1, v2, v3;
+		primitives->getTriangle( t, v1, v2, v3 );
+		
+		AABB3f bounds( v1 );
+		bounds.enlargeFor( v2 );
+		bounds.enlargeFor( v3 );
+		
+		buildPrimitives[t] = BuildPrimitive( bounds, t );
+	}
+}
+
+
+
+
+void CollisionTree:: buildNode( ArrayList<Node>& nodeList, Index nodeIndex, Index start, Index end, Size depth, Bool parallel )
+{
+	// Split the range into as many as four children by repeatedly splitting the largest child.
+	Index childStarts[4] = { start, 0, 0, 0 };
+	Index childEnds[4] = { end, 0, 0, 0 };
+	Size numChildren = 1;
+	
+	while ( numChildren < 4 )
+	{
+		Index largestChild = numChildren;
+		Size largestSize = MAX_LEAF_SIZE;
+		
+		for ( Index c = 0; c < numChildren; c++ )
+		{
+			if ( childEnds[c] - childStarts[c] > largestSize )
+			{
+				largestChild = c;
+				largestSize = childEnds[c] - childStarts[c];
+			}
+		}
+		
+		if ( largestChild == numChildren )
+			break;
+		
+		const Index split = partitionPrimitives( childStarts[largestChild], childEnds[largestChild], parallel );
+		childStarts[numChildren] = split;
+		childEnds[numChildren] = childEnds[largestChild];
+		childEnds[largestChild] = split;
+		numChildren++;
+	}
+	
+	// Fill in the node before recursing, since adding nodes may move the node list.
+	Node node;
+	Bool isTask[4] = { false, false, false, false };
+	
+	for ( Index c = 0; c < 4; c++ )
+	{
+		if ( c >= numChildren )
+		{
+			setChildBounds( node, c, AABB3f( Vector3f(), Vector3f() ) );
+			node.children[c] = INVALID_CHILD;
+			node.numTriangles[c] = 0;
+			continue;
+		}
+		
+		const Size numPrimitives = childEnds[c] - childStarts[c];
+		setChildBounds( node, c, getPrimitiveBounds( childStarts[c], childEnds[c] ) );
+		
+		if ( numPrimitives <= MAX_LEAF_SIZE || depth >= MAX_DEPTH )
+		{
+			node.children[c] = UInt32(childStarts[c]);
+			node.numTriangles[c] = UInt32(numPrimitives);
+		}
+		else if ( parallel && numPrimitives <= subtreeTaskSize )
+		{
+			// The child is filled in when the subtree's job is finished.
+			node.children[c] = INVALID_CHILD;
+			node.numTriangles[c] = 0;
+			isTask[c] = true;
+			subtreeTasks.add( SubtreeTask( nodeIndex, c, childStarts[c], childEnds[c], depth + 1 ) );
+		}
+		else
+		{
+			node.children[c] = UInt32(nodeList.getSize());
+			node.numTriangles[c] = 0;
+			nodeList.add( Node() );
+		}
+	}
+	
+	nodeList[nodeIndex] = node;
+	
+	for ( Index c = 0; c < numChildren; c++ )
+	{
+		if ( node.numTriangles[c] == 0 && !isTask[c] )
+			buildNode( nodeList, node.children[c], childStarts[c], childEnds[c], depth + 1, parallel );
+	}
+}
+
+
+
+
+void CollisionTree:: buildSubtree( SubtreeTask* task )
+{
+	task->nodes.add( Node() );
+	buildNode( task->nodes, 0, task->start, task->end, task->depth, false );
+}
+
+
+
+
+Index CollisionTree:: partitionPrimitives( Index start, Index end, Bool parallel )
+{
+	const Size numPrimitives = end - start;
+	BinningChunk range;
+	range.start = start;
+	range.end = end;
+	
+	if ( parallel && buildThreadPool != NULL && numPrimitives >= MIN_PARALLEL_BINNING_SIZE )
+	{
+		// Bin separate chunks of the range in parallel, then merge the chunks' bins.
+		// The merged bins are exactly the same as if they had been filled serially.
+		const Size numChunks = math::min( buildThreadPool->getThreadCount()*4, numPrimitives / (MIN_PARALLEL_BINNING_SIZE / 8) );
+		Array<BinningChunk> chunks( numChunks );
+		
+		for ( Index j = 0; j < numChunks; j++ )
+		{
+			chunks[j].start = start + (j*numPrimitives) / numChunks;
+			chunks[j].end = start + ((j + 1)*numPrimitives) / numChunks;
+			buildThreadPool->addJob( bindCall( &CollisionTree::computeChunkCentroidBounds, this, &chunks[j] ) );
+		}
+		
+		buildThreadPool->finishJobs();
+		range.centroidBounds = chunks[0].centroidBounds;
+		
+		for ( Index j = 1; j < numChunks; j++ )
+			range.centroidBounds.enlargeFor( chunks[j].centroidBounds );
+		
+		for ( Index j = 0; j < numChunks; j++ )
+		{
+			chunks[j].rangeCentroidBounds = range.centroidBounds;
+			buildThreadPool->addJob( bindCall( &CollisionTree::binChunk, this, &chunks[j] ) );
+		}
+		
+		buildThreadPool->finishJobs();
+		
+		for ( Index j = 0; j < numChunks; j++ )
+		{
+			for ( Index axis = 0; axis < 3; axis++ )
+			{
+				for ( Index b = 0; b < NUM_SPLIT_BINS; b++ )
+				{
+					range.bins[axis][b].bounds.enlargeFor( chunks[j].bins[axis][b].bounds );
+					range.bins[axis][b].numPrimitives += chunks[j].bins[axis][b].numPrimitives;
+				}
+			}
+		}
+	}
+	else
+	{
+		computeChunkCentroidBounds( &range );
+		range.rangeCentroidBounds = range.centroidBounds;
+		binChunk( &range );
+	}
+	
+	const AABB3f& centroidBounds = range.centroidBounds;
+	Float bestCost = math::max<Float>();
+	Index bestAxis = 0;
+	Index bestSplit = 0;
+	
+	for ( Index axis = 0; axis < 3; axis++ )
+	{
+		if ( centroidBounds.max[axis] - centroidBounds.min[axis] <= Float(0) )
+			continue;
+		
+		const SplitBin* bins = range.bins[axis];
+		
+		// Sweep from the right to find the cost of the primitives to the right of each split.
+		Float rightCosts[NUM_SPLIT_BINS];
+		SplitBin right;
+		
+		for ( Index b = NUM_SPLIT_BINS - 1; b > 0; b-- )
+		{
+			right.bounds.enlargeFor( bins[b].bounds );
+			right.numPrimitives += bins[b].numPrimitives;
+			rightCosts[b] = right.numPrimitives > 0 ? getSurfaceArea( right.bounds )*Float(right.numPrimitives) : Float(0);
+		}
+		
+		// Sweep from the left and pick the split with the lowest total cost.
+		SplitBin left;
+		
+		for ( Index b = 1; b < NUM_SPLIT_BINS; b++ )
+		{
+			left.bounds.enlargeFor( bins[b - 1].bounds );
+			left.numPrimitives += bins[b - 1].numPrimitives;
+			
+			if ( left.numPrimitives == 0 || left.numPrimitives == numPrimitives )
+				continue;
+			
+			const Float cost = getSurfaceArea( left.bounds )*Float(left.numPrimitives) + rightCosts[b];
+			
+			if ( cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+	
+	// If the centroids can't be separated, split the range in the middle.
+	if ( bestSplit == 0 )
+		return start + numPrimitives / 2;
+	
+	const Float axisMin = centroidBounds.min[bestAxis];
+	const Float binScale = Float(NUM_SPLIT_BINS) / (centroidBounds.max[bestAxis] - axisMin);
+	Index middle = start;
+	Index last = end;
+	
+	while ( middle < last )
+	{
+		const Index b = math::min( Index((buildPrimitives[middle].centroid[bestAxis] - axisMin)*binScale ), NUM_SPLIT_BINS - 1 );
+		
+		if ( b < bestSplit )
+			middle++;
+		else
+		{
+			last--;
+			const BuildPrimitive temp = buildPrimitives[middle];
+			buildPrimitives[middle] = buildPrimitives[last];
+			buildPrimitives[last] = temp;
+		}
+	}
+	
+	return middle;
+}
+
+
+
+
+void CollisionTree:: computeChunkCentroidBounds( BinningChunk* chunk ) const
+{
+	AABB3f centroidBounds( buildPrimitives[chunk->start].centroid );
+	
+	for ( Index p = chunk->start + 1; p < chunk->end; p++ )
+		centroidBounds.enlargeFor( buildPrimitives[p].centroid );
+	
+	chunk->centroidBounds = centroidBounds;
+}
+
+
+
+
+void CollisionTree:: binChunk( BinningChunk* chunk ) const
+{
+	const AABB3f& centroidBounds = chunk->rangeCentroidBounds;
+	
+	for ( Index axis = 0; axis < 3; axis++ )
+	{
+		const Float axisMin = centroidBounds.min[axis];
+		const Float extent = centroidBounds.max[axis] - axisMin;
+		
+		if ( extent <= Float(0) )
+			continue;
+		
+		const Float binScale = Float(NUM_SPLIT_BINS) / extent;
+		SplitBin* bins = chunk->bins[axis];
+		
+		for ( Index p = chunk->start; p < chunk->end; p++ )
+		{
+			const Index b = math::min( Index((buildPrimitives[p].centroid[axis] - axisMin)*binScale ), NUM_SPLIT_BINS - 1 );
+			bins[b].bounds.enlargeFor( buildPrimitives[p].bounds );
+			bins[b].numPrimitives++;
+		}
+	}
+}
+
+
+
+
+AABB3f CollisionTree:: getPrimitiveBounds( Index start, Index end ) const
+{
+	AABB3f bounds = buildPrimitives[start].bounds;
+	
+	for ( Index p = start + 1; p < end; p++ )
+		bounds.enlargeFor( buildPrimitives[p].bounds );
+	
+	return bounds;
+}
+
+
+
+
+void CollisionTree:: setChildBounds( Node& node, Index child, const AABB3f& bounds )
+{
+	for ( Index axis = 0; axis < 3; axis++ )
+	{
+		node.bounds[2*axis][child] = bounds.min[axis];
+		node.bounds[2*axis + 1][child] = bounds.max[axis];
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Query Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool CollisionTree:: intersectsCapsule( const Vector3f& start, const Vector3f& end, Float radius ) const
+{
+	PROFILER_SCOPE( intersectsCapsuleZone );
+	
+	if ( numNodes == 0 )
+		return false;
+	
+	const Vector3f direction = end - start;
+	const Float radiusSquared = radius*radius;
+	const SIMDFloat4 simdRadius( radius );
+	SIMDFloat4 origin[3];
+	SIMDFloat4 inverseDirection[3];
+	
+	for ( Index axis = 0; axis < 3; axis++ )
+	{
+		origin[axis] = SIMDFloat4( start[axis] );
+		inverseDirection[axis] = SIMDFloat4( getSafeInverse( direction[axis] ) );
+	}
+	
+	UInt32 stack[TRAVERSAL_STACK_SIZE];
+	Size stackSize = 0;
+	stack[stackSize++] = 0;
+	Float32 entryT[4];
+	
+	while ( stackSize > 0 )
+	{
+		const Node& node = nodeData[stack[--stackSize]];
+		const int hitMask = intersectChildren( node, origin, inverseDirection, simdRadius, Float32(1), entryT );
+		
+		for ( Index c = 0; c < 4; c++ )
+		{
+			if ( (hitMask & (1 << c)) == 0 || node.children[c] == INVALID_CHILD )
+				continue;
+			
+			if ( node.numTriangles[c] == 0 )
+			{
+				stack[stackSize++] = node.children[c];
+				continue;
+			}
+			
+			const Index leafEnd = node.children[c] + node.numTriangles[c];
+			
+			for ( Index t = node.children[c]; t < leafEnd; t++ )
+			{
+				if ( triangleIntersectsCapsule( triangleData[t], start, end, radiusSquared ) )
+					return true;
+			}
+		}
+	}
+	
+	return false;
+}
+
+
+
+
+Bool CollisionTree:: traceRay( const Vector3f& origin, const Vector3f& direction, Float maxDistance, Float& distance ) const
+{
+	PROFILER_SCOPE( traceRayZone );
+	
+	if ( numNodes == 0 )
+		return false;
+	
+	const SIMDFloat4 simdRadius( Float32(0) );
+	SIMDFloat4 simdOrigin[3];
+	SIMDFloat4 inverseDirection[3];
+	
+	for ( Index axis = 0; axis < 3; axis++ )
+	{
+		simdOrigin[axis] = SIMDFloat4( origin[axis] );
+		inverseDirection[axis] = SIMDFloat4( getSafeInverse( direction[axis] ) );
+	}
+	
+	UInt32 stack[TRAVERSAL_STACK_SIZE];
+	Size stackSize = 0;
+	stack[stackSize++] = 0;
+	Float32 entryT[4];
+	Float t = maxDistance;
+	
+	while ( stackSize > 0 )
+	{
+		const Node& node = nodeData[stack[--stackSize]];
+		const int hitMask = intersectChildren( node, simdOrigin, inverseDirection, simdRadius, Float32(t), entryT );
+		
+		// Visit the child nodes in order of entry so that the nearest hit is found early.
+		Index childOrder[4];
+		Size numChildNodes = 0;
+		
+		for ( Index c = 0; c < 4; c++ )
+		{
+			if ( (hitMask & (1 << c)) == 0 || node.children[c] == INVALID_CHILD )
+				continue;
+			
+			if ( node.numTriangles[c] == 0 )
+			{
+				Index i = numChildNodes++;
+				
+				for ( ; i > 0 && entryT[childOrder[i - 1]] < entryT[c]; i-- )
+					childOrder[i] = childOrder[i - 1];
+				
+				childOrder[i] = c;
+				continue;
+			}
+			
+			const Index leafEnd = node.children[c] + node.numTriangles[c];
+			
+			for ( Index i = node.children[c]; i < leafEnd; i++ )
+				traceRayTriangle( triangleData[i], origin, direction, t );
+		}
+		
+		for ( Index i = 0; i < numChildNodes; i++ )
+			stack[stackSize++] = node.children[childOrder[i]];
+	}
+	
+	if ( t < maxDistance )
+	{
+		distance = t;
+		return true;
+	}
+	
+	return false;
+}
+
+
+
+
+int CollisionTree:: traceRayPacket( const Vector3f& origin, const Vector3f directions[4], Float maxDistance, Float distances[4] ) const
+{
+	PROFILER_SCOPE( traceRayPacketZone );
+	
+	SIMDFloat4 t( maxDistance );
+	
+	if ( numNodes > 0 )
+	{
+		// Store the packet with one ray per lane, so that each operation works on all four rays.
+		SIMDFloat4 direction[3];
+		SIMDFloat4 inverseDirection[3];
+		
+		for ( Index axis = 0; axis < 3; axis++ )
+		{
+			direction[axis] = SIMDFloat4( directions[0][axis], directions[1][axis], directions[2][axis], directions[3][axis] );
+			inverseDirection[axis] = SIMDFloat4( getSafeInverse( directions[0][axis] ), getSafeInverse( directions[1][axis] ),
+												getSafeInverse( directions[2][axis] ), getSafeInverse( directions[3][axis] ) );
+		}
+		
+		UInt32 stack[TRAVERSAL_STACK_SIZE];
+		Size stackSize = 0;
+		stack[stackSize++] = 0;
+		Float32 laneEntryT[4];
+		Float32 entryT[4];
+		
+		while ( stackSize > 0 )
+		{
+			const Node& node = nodeData[stack[--stackSize]];
+			
+			// Visit the child nodes in order of their nearest entry by any ray in the packet.
+			Index childOrder[4];
+			Size numChildNodes = 0;
+			
+			for ( Index c = 0; c < 4; c++ )
+			{
+				if ( node.children[c] == INVALID_CHILD )
+					continue;
+				
+				// Clip all four rays against this child's bounds. The origin is shared, so only the direction varies.
+				SIMDFloat4 tMin( Float32(0) );
+				SIMDFloat4 tMax( t );
+				
+				for ( Index axis = 0; axis < 3; axis++ )
+				{
+					const SIMDFloat4 t1 = SIMDFloat4( node.bounds[2*axis][c] - origin[axis] )*inverseDirection[axis];
+					const SIMDFloat4 t2 = SIMDFloat4( node.bounds[2*axis + 1][c] - origin[axis] )*inverseDirection[axis];
+					
+					tMin = math::max( tMin, math::min( t1, t2 ) );
+					tMax = math::min( tMax, math::max( t1, t2 ) );
+				}
+				
+				const int rayMask = (tMin <= tMax).getMask();
+				
+				if ( rayMask == 0 )
+					continue;
+				
+				if ( node.numTriangles[c] == 0 )
+				{
+					tMin.storeUnaligned( laneEntryT );
+					entryT[c] = math::max<Float32>();
+					
+					for ( Index r = 0; r < 4; r++ )
+					{
+						if ( (rayMask & (1 << r)) != 0 )
+							entryT[c] = math::min( entryT[c], laneEntryT[r] );
+					}
+					
+					Index i = numChildNodes++;
+					
+					for ( ; i > 0 && entryT[childOrder[i - 1]] < entryT[c]; i-- )
+						childOrder[i] = childOrder[i - 1];
+					
+					childOrder[i] = c;
+					continue;
+				}
+				
+				const Index leafEnd = node.children[c] + node.numTriangles[c];
+				
+				for ( Index i = node.children[c]; i < leafEnd; i++ )
+					traceRayPacketTriangle( triangleData[i], origin, direction, t );
+			}
+			
+			for ( Index i = 0; i < numChildNodes; i++ )
+				stack[stackSize++] = node.children[childOrder[i]];
+		}
+	}
+	
+	t.storeUnaligned( distances );
+	
+	return (t < SIMDFloat4( maxDistance )).getMask();
+}
+
+
+
+
+int CollisionTree:: intersectChildren( const Node& node, const SIMDFloat4 origin[3], const SIMDFloat4 inverseDirection[3],
+										const SIMDFloat4& radius, Float32 maxT, Float32 entryT[4] )
+{
+	SIMDFloat4 tMin( Float32(0) );
+	SIMDFloat4 tMax( maxT );
+	
+	// Clip the segment against the slabs of the four children's bounds, enlarged by the radius.
+	for ( Index axis = 0; axis < 3; axis++ )
+	{
+		const SIMDFloat4 boundsMin = SIMDFloat4::loadUnaligned( node.bounds[2*axis] ) - radius;
+		const SIMDFloat4 boundsMax = SIMDFloat4::loadUnaligned( node.bounds[2*axis + 1] ) + radius;
+		const SIMDFloat4 t1 = (boundsMin - origin[axis])*inverseDirection[axis];
+		const SIMDFloat4 t2 = (boundsMax - origin[axis])*inverseDirection[axis];
+		
+		tMin = math::max( tMin, math::min( t1, t2 ) );
+		tMax = math::min( tMax, math::max( t1, t2 ) );
+	}
+	
+	tMin.storeUnaligned( entryT );
+	
+	return (tMin <= tMax).getMask();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Triangle Query Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void CollisionTree:: traceRayTriangle( const Triangle<Vector3f>& triangle, const Vector3f& origin,
+										const Vector3f& direction, Float& distance )
+{
+	const Vector3f edge1 = triangle.v2 - triangle.v1;
+	const Vector3f edge2 = triangle.v3 - triangle.v1;
+	const Vector3f p = math::cross( direction, edge2 );
+	const Float determinant = math::dot( edge1, p );
+	
+	if ( math::abs( determinant ) < math::epsilon<Float>() )
+		return;
+	
+	const Float inverseDeterminant = Float(1) / determinant;
+	const Vector3f s = origin - triangle.v1;
+	const Float u = math::dot( s, p )*inverseDeterminant;
+	
+	if ( u < Float(0) || u > Float(1) )
+		return;
+	
+	const Vector3f q = math::cross( s, edge1 );
+	const Float v = math::dot( direction, q )*inverseDeterminant;
+	
+	if ( v < Float(0) || u + v > Float(1) )
+		return;
+	
+	const Float t = math::dot( edge2, q )*inverseDeterminant;
+	
+	if ( t >= Float(0) && t < distance )
+		distance = t;
+}
+
+
+
+
+void CollisionTree:: traceRayPacketTriangle( const Triangle<Vector3f>& triangle, const Vector3f& origin,
+											const SIMDFloat4 direction[3], SIMDFloat4& distances )
+{
+	const Vector3f edge1 = triangle.v2 - triangle.v1;
+	const Vector3f edge2 = triangle.v3 - triangle.v1;
+	
+	// The terms that only depend on the origin are the same for every ray, so they are computed once.
+	const Vector3f s = origin - triangle.v1;
+	const Vector3f q = math::cross( s, edge1 );
+	const SIMDFloat4 tNumerator( math::dot( edge2, q ) );
+	
+	const SIMDFloat4 px = direction[1]*edge2.z - direction[2]*edge2.y;
+	const SIMDFloat4 py = direction[2]*edge2.x - direction[0]*edge2.z;
+	const SIMDFloat4 pz = direction[0]*edge2.y - direction[1]*edge2.x;
+	const SIMDFloat4 determinant = px*edge1.x + py*edge1.y + pz*edge1.z;
+	const SIMDFloat4 inverseDeterminant = Float32(1) / determinant;
+	
+	const SIMDFloat4 u = (px*s.x + py*s.y + pz*s.z)*inverseDeterminant;
+	const SIMDFloat4 v = (direction[0]*q.x + direction[1]*q.y + direction[2]*q.z)*inverseDeterminant;
+	const SIMDFloat4 t = tNumerator*inverseDeterminant;
+	
+	const SIMDInt4 hit = (math::abs( determinant ) >= math::epsilon<Float32>()) &
+						(u >= Float32(0)) & (u <= Float32(1)) &
+						(v >= Float32(0)) & (u + v <= Float32(1)) &
+						(t >= Float32(0)) & (t < distances);
+	
+	distances = math::select( hit, t, distances );
+}
+
+
+
+
+Bool CollisionTree:: triangleIntersectsCapsule( const Triangle<Vector3f>& triangle, const Vector3f& start,
+												const Vector3f& end, Float radiusSquared )
+{
+	const Vector3f& v1 = triangle.v1;
+	const Vector3f& v2 = triangle.v2;
+	const Vector3f& v3 = triangle.v3;
+	
+	// The closest points are either at a segment endpoint, between the segment and an
+	// edge of the triangle, or anywhere along the segment if it passes through the triangle.
+	if ( (getClosestPointOnTriangle( triangle, start ) - start).getMagnitudeSquared() <= radiusSquared ||
+		(getClosestPointOnTriangle( triangle, end ) - end).getMagnitudeSquared() <= radiusSquared ||
+		getSegmentDistanceSquared( start, end, v1, v2 ) <= radiusSquared ||
+		getSegmentDistanceSquared( start, end, v2, v3 ) <= radiusSquared ||
+		getSegmentDistanceSquared( start, end, v3, v1 ) <= radiusSquared )
+		return true;
+	
+	// Test whether the segment passes through the interior of the triangle.
+	const Vector3f edge1 = v2 - v1;
+	const Vector3f edge2 = v3 - v1;
+	const Vector3f direction = end - start;
+	const Vector3f p = math::cross( direction, edge2 );
+	const Float determinant = math::dot( edge1, p );
+	
+	if ( math::abs( determinant ) < math::epsilon<Float>() )
+		return false;
+	
+	const Float inverseDeterminant = Float(1) / determinant;
+	const Vector3f s = start - v1;
+	const Float u = math::dot( s, p )*inverseDeterminant;
+	
+	if ( u < Float(0) || u > Float(1) )
+		return false;
+	
+	const Vector3f q = math::cross( s, edge1 );
+	const Float v = math::dot( direction, q )*inverseDeterminant;
+	
+	if ( v < Float(0) || u + v > Float(1) )
+		return false;
+	
+	const Float t = math::dot( edge2, q )*inverseDeterminant;
+	
+	return t >= Float(0) && t <= Float(1);
+}
+
+
+
+
+Vector3f CollisionTree:: getClosestPointOnTriangle( const Triangle<Vector3f>& triangle, const Vector3f& query )
+{
+	const Vector3f& a = triangle.v1;
+	const Vector3f& b = triangle.v2;
+	const Vector3f& c = triangle.v3;
+	
+	// Determine which Voronoi region of the triangle the query point is in.
+	const Vector3f ab = b - a;
+	const Vector3f ac = c - a;
+	const Vector3f ap = query - a;
+	const Float d1 = math::dot( ab, ap );
+	const Float d2 = math::dot( ac, ap );
+	
+	if ( d1 <= Float(0) && d2 <= Float(0) )
+		return a;
+	
+	const Vector3f bp = query - b;
+	const Float d3 = math::dot( ab, bp );
+	const Float d4 = math::dot( ac, bp );
+	
+	if ( d3 >= Float(0) && d4 <= d3 )
+		return b;
+	
+	const Float vc = d1*d4 - d3*d2;
+	
+	if ( vc <= Float(0) && d1 >= Float(0) && d3 <= Float(0) )
+		return a + ab*(d1 / (d1 - d3));
+	
+	const Vector3f cp = query - c;
+	const Float d5 = math::dot( ab, cp );
+	const Float d6 = math::dot( ac, cp );
+	
+	if ( d6 >= Float(0) && d5 <= d6 )
+		return c;
+	
+	const Float vb = d5*d2 - d1*d6;
+	
+	if ( vb <= Float(0) && d2 >= Float(0) && d6 <= Float(0) )
+		return a + ac*(d2 / (d2 - d6));
+	
+	const Float va = d3*d6 - d5*d4;
+	
+	if ( va <= Float(0) && (d4 - d3) >= Float(0) && (d5 - d6) >= Float(0) )
+		return b + (c - b)*((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	
+	// The point projects onto the interior of the triangle.
+	const Float denominator = Float(1) / (va + vb + vc);
+	
+	return a + ab*(vb*denominator) + ac*(vc*denominator);
+}
+
+
+
+
+Float CollisionTree:: getSegmentDistanceSquared( const Vector3f& p1, const Vector3f& q1,
+												const Vector3f& p2, const Vector3f& q2 )
+{
+	const Vector3f d1 = q1 - p1;
+	const Vector3f d2 = q2 - p2;
+	const Vector3f r = p1 - p2;
+	const Float a = d1.getMagnitudeSquared();
+	const Float e = d2.getMagnitudeSquared();
+	const Float f = math::dot( d2, r );
+	const Float epsilon = math::epsilon<Float>();
+	Float s, t;
+	
+	if ( a <= epsilon && e <= epsilon )
+		return r.getMagnitudeSquared();
+	
+	if ( a <= epsilon )
+	{
+		s = Float(0);
+		t = math::clamp( f / e, Float(0), Float(1) );
+	}
+	else
+	{
+		const Float c = math::dot( d1, r );
+		
+		if ( e <= epsilon )
+		{
+			t = Float(0);
+			s = math::clamp( -c / a, Float(0), Float(1) );
+		}
+		else
+		{
+			// Find the closest points on the infinite lines, then clamp them to the segments.
+			const Float b = math::dot( d1, d2 );
+			const Float denominator = a*e - b*b;
+			
+			s = denominator != Float(0) ? math::clamp( (b*f - c*e) / denominator, Float(0), Float(1) ) : Float(0);
+			t = (b*s + f) / e;
+			
+			if ( t < Float(0) )
+			{
+				t = Float(0);
+				s = math::clamp( -c / a, Float(0), Float(1) );
+			}
+			else if ( t > Float(1) )
+			{
+				t = Float(1);
+				s = math::clamp( (b - c) / a, Float(0), Float(1) );
+			}
+		}
+	}
+	
+	return ((p1 + d1*s) - (p2 + d2*t)).getMagnitudeSquared();
+}
@@ -0,0 +1,654 @@
+/*
+ *  CollisionTree.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_COLLISION_TREE_H
+#define INCLUDE_COLLISION_TREE_H
+
+
+#include "rim/rimEngine.h"
+#include "MappedFile.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+
+
+/// A class that answers exact sphere and capsule queries against a static triangle mesh.
+/**
+  * The triangles are stored in a 4-wide bounding volume hierarchy built with the binned
+  * surface area heuristic. Each node stores the bounds of its four children in
+  * structure-of-arrays layout, so all four can be tested with a single set of SIMD
+  * operations. The queries test the swept volume of a vehicle directly, so unlike
+  * sampling it with rays they can't miss thin geometry. All query methods are const
+  * and keep their traversal state on the stack, so they are safe to call from many threads.
+  *
+  * A built tree can be saved to a file and later mapped back into memory, in which
+  * case the queries read the nodes and triangles directly from the mapped file.
+  */
+class CollisionTree
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new empty collision tree.
+			CollisionTree();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Build Methods
+			
+			
+			
+			
+			/// Rebuild this collision tree for the triangles of the specified primitive set.
+			/**
+			  * The triangles are read through the primitive set's getTriangle() method, so
+			  * a mesh can be built without first being copied into a list of triangles.
+			  * If the primitive set doesn't contain triangles, the tree is left empty.
+			  *
+			  * If a thread pool is given, the split bins of the large nodes near the root
+			  * are filled in parallel, and the smaller subtrees below them are built as
+			  * independent jobs. The tree is the same as one built without a thread pool,
+			  * apart from the order of its nodes.
+			  */
+			void build( const bvh::PrimitiveInterface& primitives, threads::ThreadPool* threadPool = NULL );
+			
+			
+			
+			
+			/// Remove all triangles from this collision tree.
+			void clear();
+			
+			
+			
+			
+			/// Return the number of triangles that are stored in this collision tree.
+			RIM_INLINE Size getTriangleCount() const
+			{
+				return numTriangles;
+			}
+			
+			
+			
+			
+			/// Return the number of nodes that are in this collision tree.
+			RIM_INLINE Size getNodeCount() const
+			{
+				return numNodes;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	File Methods
+			
+			
+			
+			
+			/// Write the tree's nodes and triangles to a binary file at the given path.
+			/**
+			  * The file stores the given mesh hash, followed by the node and triangle arrays
+			  * in native byte order. The method returns whether or not the file was successfully written.
+			  */
+			Bool save( const data::UTF8String& filePath, UInt64 meshHash ) const;
+			
+			
+			
+			
+			/// Map a tree file written by save() and use it in place of the current tree.
+			/**
+			  * The file is mapped read-only and queries read it in place, so nothing is
+			  * rebuilt or copied. The file is rejected if its mesh hash doesn't match the
+			  * given hash or if its layout is invalid. If the method returns FALSE, the
+			  * tree is left unchanged.
+			  */
+			Bool load( const data::UTF8String& filePath, UInt64 meshHash );
+			
+			
+			
+			
+			/// Return whether or not the tree is currently read from a mapped file.
+			RIM_INLINE Bool isMapped() const
+			{
+				return file.isSet();
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Query Methods
+			
+			
+			
+			
+			/// Return whether or not any triangle is within the radius of the segment from start to end.
+			/**
+			  * This tests the capsule that a sphere of the given radius sweeps out along
+			  * the segment. The traversal stops at the first overlapping triangle.
+			  */
+			Bool intersectsCapsule( const Vector3f& start, const Vector3f& end, Float radius ) const;
+			
+			
+			
+			
+			/// Return whether or not any triangle is within the radius of the specified center point.
+			RIM_INLINE Bool intersectsSphere( const Vector3f& center, Float radius ) const
+			{
+				return intersectsCapsule( center, center, radius );
+			}
+			
+			
+			
+			
+			/// Find the distance along a ray to the closest triangle that it hits within the maximum distance.
+			/**
+			  * The ray's direction must be unit length. The method returns FALSE if no triangle is hit.
+			  */
+			Bool traceRay( const Vector3f& origin, const Vector3f& direction, Float maxDistance, Float& distance ) const;
+			
+			
+			
+			
+			/// Find the distances along a packet of four rays from a shared origin to the closest triangles that they hit.
+			/**
+			  * The rays' directions must be unit length. Each distance is set to the maximum
+			  * distance if its ray doesn't hit anything. The packet is traversed together,
+			  * testing each child's bounds and each triangle against all four rays at once,
+			  * so it is fastest when the rays are close together, like neighboring pixels.
+			  * The method returns a mask with bit i set if ray i hit a triangle.
+			  */
+			int traceRayPacket( const Vector3f& origin, const Vector3f directions[4], Float maxDistance, Float distances[4] ) const;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Static Data Members
+			
+			
+			
+			
+			/// The maximum number of triangles that are stored in a leaf.
+			static const Size MAX_LEAF_SIZE = 4;
+			
+			
+			/// The maximum depth of the tree, which bounds the size of the traversal stack.
+			static const Size MAX_DEPTH = 48;
+			
+			
+			/// The number of bins that the centroids are sorted into along each axis when choosing a split.
+			static const Size NUM_SPLIT_BINS = 16;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Node Class Declaration
+			
+			
+			
+			
+			/// A class that stores the bounds of four children and where to find them.
+			/**
+			  * Each child is either another node, or a leaf range of triangles when its
+			  * triangle count is nonzero. Unused children have zero-size bounds at the origin,
+			  * which a query can still overlap, so they are marked with an invalid child
+			  * index, and the traversals skip them by checking that index.
+			  */
+			class Node
+			{
+				public:
+					
+					/// The minimum and maximum bounds of the children along each axis: min x, max x, min y, max y, min z, max z.
+					Float32 bounds[6][4];
+					
+					/// The index of each child node, or of the first triangle of each leaf child.
+					UInt32 children[4];
+					
+					/// The number of triangles in each leaf child, or 0 if the child is a node.
+					UInt32 numTriangles[4];
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Build Primitive Class Declaration
+			
+			
+			
+			
+			/// A class that stores the bounds of a triangle during tree construction.
+			class BuildPrimitive
+			{
+				public:
+					
+					RIM_INLINE BuildPrimitive()
+						:	triangle( 0 )
+					{
+					}
+					
+					
+					RIM_INLINE BuildPrimitive( const AABB3f& newBounds, Index newTriangle )
+						:	bounds( newBounds ),
+							centroid( newBounds.getCenter() ),
+							triangle( newTriangle )
+					{
+					}
+					
+					
+					/// The bounding box of the triangle.
+					AABB3f bounds;
+					
+					/// The center of the triangle's bounding box, which is used to bin it.
+					Vector3f centroid;
+					
+					/// The index of the triangle in the list that the tree was built from.
+					Index triangle;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Split Bin Class Declaration
+			
+			
+			
+			
+			/// A class that accumulates the primitives whose centroids fall into one bin of a split axis.
+			class SplitBin
+			{
+				public:
+					
+					RIM_INLINE SplitBin()
+						:	bounds( math::max<Float>(), -math::max<Float>(),
+									math::max<Float>(), -math::max<Float>(),
+									math::max<Float>(), -math::max<Float>() ),
+							numPrimitives( 0 )
+					{
+					}
+					
+					
+					/// The bounds of the primitives in this bin.
+					AABB3f bounds;
+					
+					/// The number of primitives in this bin.
+					Size numPrimitives;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private File Header Class Declaration
+			
+			
+			
+			
+			/// The header at the start of a tree file, followed by the node and triangle arrays.
+			class FileHeader
+			{
+				public:
+					
+					/// A value that identifies the file as a collision tree file.
+					UInt32 magic;
+					
+					/// The version of the file layout.
+					UInt32 version;
+					
+					/// The hash of the mesh that the tree was built for.
+					UInt64 meshHash;
+					
+					/// The number of nodes in the tree.
+					UInt32 numNodes;
+					
+					/// The number of triangles in the tree.
+					UInt32 numTriangles;
+					
+					/// The size in bytes of each node, which must match this build.
+					UInt32 nodeSize;
+					
+					/// The size in bytes of each triangle, which must match this build.
+					UInt32 triangleSize;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Subtree Task Class Declaration
+			
+			
+			
+			
+			/// A class that stores a subtree which is built by a separate job and then attached to its parent.
+			class SubtreeTask
+			{
+				public:
+					
+					RIM_INLINE SubtreeTask( Index newParentNode, Index newChild, Index newStart, Index newEnd, Size newDepth )
+						:	parentNode( newParentNode ),
+							child( newChild ),
+							start( newStart ),
+							end( newEnd ),
+							depth( newDepth )
+					{
+					}
+					
+					
+					/// The index of the node that the subtree is a child of.
+					Index parentNode;
+					
+					/// The index of the subtree's root within its parent's children.
+					Index child;
+					
+					/// The index of the first primitive in the subtree.
+					Index start;
+					
+					/// The index after the last primitive in the subtree.
+					Index end;
+					
+					/// The depth of the subtree's root in the tree.
+					Size depth;
+					
+					/// The nodes of the subtree, indexed from its root.
+					ArrayList<Node> nodes;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Binning Chunk Class Declaration
+			
+			
+			
+			
+			/// A class that stores the partial binning results for one chunk of a large range of primitives.
+			class BinningChunk
+			{
+				public:
+					
+					/// The index of the first primitive in the chunk.
+					Index start;
+					
+					/// The index after the last primitive in the chunk.
+					Index end;
+					
+					/// The bounds of the centroids of the primitives in the chunk.
+					AABB3f centroidBounds;
+					
+					/// The bounds of the centroids of the whole range, which determine the bins.
+					AABB3f rangeCentroidBounds;
+					
+					/// The bins along each axis for the primitives in the chunk.
+					SplitBin bins[3][NUM_SPLIT_BINS];
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Build Methods
+			
+			
+			
+			
+			/// Build the node at the given index of a node list for the primitives in the range [start, end).
+			/**
+			  * If the build is parallel, child subtrees that are small enough are recorded
+			  * as subtree tasks rather than being built immediately.
+			  */
+			void buildNode( ArrayList<Node>& nodeList, Index nodeIndex, Index start, Index end, Size depth, Bool parallel );
+			
+			
+			
+			
+			/// Build the nodes of a subtree task. This is run by a worker thread.
+			void buildSubtree( SubtreeTask* task );
+			
+			
+			
+			
+			/// Compute the bounds of the triangles in the range [start, end) of a primitive set. This is run by a worker thread.
+			void computePrimitiveRange( const bvh::PrimitiveInterface* primitives, Index start, Index end );
+			
+			
+			
+			
+			/// Split the primitives in the range [start, end) into two with the binned surface area heuristic.
+			/**
+			  * The primitives are reordered in place and the index of the first primitive
+			  * of the second half is returned. If the split is parallel and the range
+			  * is large, the bins are filled by the worker threads of the build's thread pool.
+			  */
+			Index partitionPrimitives( Index start, Index end, Bool parallel );
+			
+			
+			
+			
+			/// Compute the bounds of the centroids of the primitives in a chunk. This may be run by a worker thread.
+			void computeChunkCentroidBounds( BinningChunk* chunk ) const;
+			
+			
+			
+			
+			/// Sort the primitives in a chunk into the split bins along each axis. This may be run by a worker thread.
+			void binChunk( BinningChunk* chunk ) const;
+			
+			
+			
+			
+			/// Compute the bounding box of the primitives in the range [start, end).
+			AABB3f getPrimitiveBounds( Index start, Index end ) const;
+			
+			
+			
+			
+			/// Set the bounds of a child of the specified node.
+			static void setChildBounds( Node& node, Index child, const AABB3f& bounds );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Copy Operations
+			
+			
+			
+			
+			/// Declared but not defined so that a tree that maps a file can't be copied.
+			CollisionTree( const CollisionTree& other );
+			
+			
+			/// Declared but not defined so that a tree that maps a file can't be copied.
+			CollisionTree& operator = ( const CollisionTree& other );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Point the query arrays at the tree's own node and triangle lists.
+			void useOwnedArrays();
+			
+			
+			
+			
+			/// Return whether or not the nodes of a tree reference valid children and stay within the maximum depth.
+			static Bool validateNodes( const Node* treeNodes, Size treeNodeCount, Size treeTriangleCount );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Query Methods
+			
+			
+			
+			
+			/// Return a mask with bit i set if the segment intersects child i's bounds enlarged by the radius.
+			/**
+			  * The entry parameter of each child along the segment is written to the output.
+			  */
+			static int intersectChildren( const Node& node, const SIMDFloat4 origin[3], const SIMDFloat4 inverseDirection[3],
+										const SIMDFloat4& radius, Float32 maxT, Float32 entryT[4] );
+			
+			
+			
+			
+			/// Intersect a ray with a triangle, replacing the ray distance if the triangle is hit closer.
+			static void traceRayTriangle( const Triangle<Vector3f>& triangle, const Vector3f& origin,
+										const Vector3f& direction, Float& distance );
+			
+			
+			
+			
+			/// Intersect a packet of four rays from a shared origin with a triangle, replacing the distances of the rays that hit it closer.
+			static void traceRayPacketTriangle( const Triangle<Vector3f>& triangle, const Vector3f& origin,
+												const SIMDFloat4 direction[3], SIMDFloat4& distances );
+			
+			
+			
+			
+			/// Return whether or not a triangle is within the radius of the segment from start to end.
+			static Bool triangleIntersectsCapsule( const Triangle<Vector3f>& triangle, const Vector3f& start,
+													const Vector3f& end, Float radiusSquared );
+			
+			
+			
+			
+			/// Return the closest point on a triangle to the query point.
+			static Vector3f getClosestPointOnTriangle( const Triangle<Vector3f>& triangle, const Vector3f& query );
+			
+			
+			
+			
+			/// Return the squared distance between the segments [p1, q1] and [p2, q2].
+			static Float getSegmentDistanceSquared( const Vector3f& p1, const Vector3f& q1,
+													const Vector3f& p2, const Vector3f& q2 );
+													
+													
+													
+													
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// A pointer to the nodes that are queried, either in the node list or in the mapped file. The root is the first node.
+			const Node* nodeData;
+			
+			
+			/// The number of nodes that are queried.
+			Size numNodes;
+			
+			
+			/// A pointer to the triangles that are queried, either in the triangle list or in the mapped file.
+			const Triangle<Vector3f>* triangleData;
+			
+			
+			/// The number of triangles that are queried.
+			Size numTriangles;
+			
+			
+			/// The nodes of the tree when it was built rather than mapped.
+			ArrayList<Node> nodes;
+			
+			
+			/// The triangles of the tree when it was built, ordered so that each leaf's triangles are contiguous.
+			ArrayList< Triangle<Vector3f> > triangles;
+			
+			
+			/// The file that the tree is mapped from, or NULL if the tree was built.
+			Pointer<MappedFile> file;
+			
+			
+			/// The primitives that are being partitioned while the tree is built.
+			Array<BuildPrimitive> buildPrimitives;
+			
+			
+			/// The subtrees that are built by separate jobs during a parallel build.
+			ArrayList<SubtreeTask> subtreeTasks;
+			
+			
+			/// The thread pool that is used during a parallel build, or NULL.
+			threads::ThreadPool* buildThreadPool;
+			
+			
+			/// The largest number of primitives that are built as a single job during a parallel build.
+			Size subtreeTaskSize;
+			
+			
+			/// The test suite compares the nodes of trees built with and without a thread pool directly.
+			friend class TestSuite;
+
+
+};
+
+
+
+
+#endif // INCLUDE_COLLISION_TREE_H
@@ -0,0 +1,163 @@
+/*
+ *  FleetState.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "FleetState.h"
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructors
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+FleetState:: FleetState()
+	:	components( NULL ),
+		size( 0 ),
+		capacity( 0 )
+{
+}
+
+
+
+
+FleetState:: FleetState( const FleetState& other )
+	:	components( NULL ),
+		size( 0 ),
+		capacity( 0 )
+{
+	*this = other;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Destructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+FleetState:: ~FleetState()
+{
+	if ( components != NULL )
+		util::deallocateAligned( components );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Assignment Operator
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+FleetState& FleetState:: operator = ( const FleetState& other )
+{
+	if ( this != &other )
+	{
+		setSize( other.size );
+		
+		if ( capacity > 0 )
+			util::copy( components, other.components, NUM_COMPONENTS*capacity );
+	}
+	
+	return *this;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Size Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void FleetState:: setSize( Size newSize )
+{
+	if ( newSize == size && components != NULL )
+		return;
+	
+	if ( components != NULL )
+	{
+		util::deallocateAligned( components );
+		components = NULL;
+	}
+	
+	size = newSize;
+	capacity = ((newSize + GROUP_WIDTH - 1) / GROUP_WIDTH)*GROUP_WIDTH;
+	
+	if ( capacity == 0 )
+		return;
+	
+	components = util::allocateAligned<Float32>( NUM_COMPONENTS*capacity, 16 );
+	
+	// Initialize every vehicle (including the padding) to the identity state so that
+	// the padding lanes never produce NaNs when normalized.
+	const TransformState identity;
+	
+	for ( Index i = 0; i < capacity; i++ )
+		setState( i, identity );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Vehicle State Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+TransformState FleetState:: getState( Index vehicleIndex ) const
+{
+	const Vector3f v = getVector( ORIENTATION_V, vehicleIndex );
+	
+	return TransformState( getVector( POSITION, vehicleIndex ),
+						Quaternion<Float>( getComponent( ORIENTATION_W )[vehicleIndex], v.x, v.y, v.z ),
+						getVector( VELOCITY, vehicleIndex ),
+						getVector( ANGULAR_VELOCITY, vehicleIndex ) );
+}
+
+
+
+
+void FleetState:: setState( Index vehicleIndex, const TransformState& state )
+{
+	setVector( POSITION, vehicleIndex, state.position );
+	setVector( VELOCITY, vehicleIndex, state.velocity );
+	setVector( ANGULAR_VELOCITY, vehicleIndex, state.angularVelocity );
+	getComponent( ORIENTATION_W )[vehicleIndex] = state.orientation.a;
+	setVector( ORIENTATION_V, vehicleIndex, Vector3f( state.orientation.b, state.orientation.c, state.orientation.d ) );
+}
@@ -0,0 +1,440 @@
+/*
+ *  FleetState.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_FLEET_STATE_H
+#define INCLUDE_FLEET_STATE_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "TransformState.h"
+
+
+
+
+/// A class that stores the transform states of many vehicles in structure-of-arrays layout.
+/**
+  * Each scalar component of the vehicle states (e.g. position X, orientation quaternion
+  * W) is stored in its own contiguous, 16-byte aligned array. This allows
+  * the states of groups of 4 vehicles to be loaded and stored directly as SIMD vectors.
+  * The arrays are padded to a multiple of the group width with identity states, so
+  * the last group can always be processed with full SIMD width.
+  */
+class FleetState
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Type Declarations
+			
+			
+			
+			
+			/// The SIMD scalar type that is used to store one component for a group of vehicles.
+			typedef SIMDFloat4 GroupScalar;
+			
+			
+			/// The SIMD 3D vector type that is used to store one vector for a group of vehicles.
+			typedef SIMDVector3D<Float32,4> GroupVector3;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructors
+			
+			
+			
+			
+			/// Create a new empty fleet state with no vehicles.
+			FleetState();
+			
+			
+			
+			
+			/// Create a copy of another fleet state.
+			FleetState( const FleetState& other );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Destructor
+			
+			
+			
+			
+			/// Destroy a fleet state, releasing its component arrays.
+			~FleetState();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Assignment Operator
+			
+			
+			
+			
+			/// Assign the contents of another fleet state to this one.
+			FleetState& operator = ( const FleetState& other );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Size Accessor Methods
+			
+			
+			
+			
+			/// Return the number of vehicles that this fleet state stores.
+			RIM_INLINE Size getSize() const
+			{
+				return size;
+			}
+			
+			
+			
+			
+			/// Return the number of SIMD groups that are needed to store all of the vehicles.
+			RIM_INLINE Size getGroupCount() const
+			{
+				return capacity / GROUP_WIDTH;
+			}
+			
+			
+			
+			
+			/// Change the number of vehicles that this fleet state stores.
+			/**
+			  * If the size changes, the previous states are discarded and all
+			  * vehicles are reset to the identity state.
+			  */
+			void setSize( Size newSize );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Vehicle State Accessor Methods
+			
+			
+			
+			
+			/// Return the transform state of the vehicle at the specified index.
+			TransformState getState( Index vehicleIndex ) const;
+			
+			
+			
+			
+			/// Set the transform state of the vehicle at the specified index.
+			void setState( Index vehicleIndex, const TransformState& state );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Group State Accessor Methods
+			
+			
+			
+			
+			/// Return the positions of the vehicles in the specified group.
+			RIM_INLINE GroupVector3 getPositions( Index groupIndex ) const
+			{
+				return loadVector( POSITION, groupIndex );
+			}
+			
+			
+			
+			
+			/// Set the positions of the vehicles in the specified group.
+			RIM_INLINE void setPositions( Index groupIndex, const GroupVector3& positions )
+			{
+				storeVector( POSITION, groupIndex, positions );
+			}
+			
+			
+			
+			
+			/// Return the velocities of the vehicles in the specified group.
+			RIM_INLINE GroupVector3 getVelocities( Index groupIndex ) const
+			{
+				return loadVector( VELOCITY, groupIndex );
+			}
+			
+			
+			
+			
+			/// Set the velocities of the vehicles in the specified group.
+			RIM_INLINE void setVelocities( Index groupIndex, const GroupVector3& velocities )
+			{
+				storeVector( VELOCITY, groupIndex, velocities );
+			}
+			
+			
+			
+			
+			/// Return the angular velocities of the vehicles in the specified group.
+			RIM_INLINE GroupVector3 getAngularVelocities( Index groupIndex ) const
+			{
+				return loadVector( ANGULAR_VELOCITY, groupIndex );
+			}
+			
+			
+			
+			
+			/// Set the angular velocities of the vehicles in the specified group.
+			RIM_INLINE void setAngularVelocities( Index groupIndex, const GroupVector3& angularVelocities )
+			{
+				storeVector( ANGULAR_VELOCITY, groupIndex, angularVelocities );
+			}
+			
+			
+			
+			
+			/// Get the orientation quaternions of the vehicles in the specified group.
+			/**
+			  * The scalar parts of the quaternions are placed in w, and the vector parts in v.
+			  */
+			RIM_INLINE void getOrientations( Index groupIndex, GroupScalar& w, GroupVector3& v ) const
+			{
+				w = GroupScalar::load( getComponent( ORIENTATION_W ) + groupIndex*GROUP_WIDTH );
+				v = loadVector( ORIENTATION_V, groupIndex );
+			}
+			
+			
+			
+			
+			/// Set the orientation quaternions of the vehicles in the specified group.
+			RIM_INLINE void setOrientations( Index groupIndex, const GroupScalar& w, const GroupVector3& v )
+			{
+				w.store( getComponent( ORIENTATION_W ) + groupIndex*GROUP_WIDTH );
+				storeVector( ORIENTATION_V, groupIndex, v );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Group Math Helper Methods
+			
+			
+			
+			
+			/// Return the 3D vector stored in the specified lane of a group vector.
+			RIM_FORCE_INLINE static Vector3f getLane( const GroupVector3& vector, Index lane )
+			{
+				return Vector3f( vector.x[lane], vector.y[lane], vector.z[lane] );
+			}
+			
+			
+			
+			
+			/// Replace the 3D vector stored in the specified lane of a group vector.
+			RIM_FORCE_INLINE static void setLane( GroupVector3& vector, Index lane, const Vector3f& value )
+			{
+				vector.x[lane] = value.x;
+				vector.y[lane] = value.y;
+				vector.z[lane] = value.z;
+			}
+			
+			
+			
+			
+			/// Rotate each orientation quaternion in a group by the corresponding world-space rotation vector.
+			/**
+			  * This performs the same operations in the same order as TransformState::rotateOrientation(),
+			  * so each lane matches the scalar result. The trigonometric exponential map is
+			  * evaluated per lane, while the quaternion product and normalization are done
+			  * for the whole group at once.
+			  */
+			RIM_FORCE_INLINE static void rotateOrientations( const GroupScalar& w, const GroupVector3& v,
+															const GroupVector3& rotationVectors,
+															GroupScalar& resultW, GroupVector3& resultV )
+			{
+				GroupScalar pa, pb, pc, pd;
+				
+				for ( Index lane = 0; lane < GROUP_WIDTH; lane++ )
+				{
+					const Quaternion<Float> p = TransformState::getRotationQuaternion( getLane( rotationVectors, lane ) );
+					pa[lane] = p.a;
+					pb[lane] = p.b;
+					pc[lane] = p.c;
+					pd[lane] = p.d;
+				}
+				
+				// Multiply in the same order as Quaternion::operator * ().
+				const GroupScalar a = pa*w - pb*v.x - pc*v.y - pd*v.z;
+				const GroupScalar b = pa*v.x + pb*w + pc*v.z - pd*v.y;
+				const GroupScalar c = pa*v.y - pb*v.z + pc*w + pd*v.x;
+				const GroupScalar d = pa*v.z + pb*v.y - pc*v.x + pd*w;
+				
+				const GroupScalar inverseMagnitude = GroupScalar(1.0f) / math::sqrt( a*a + b*b + c*c + d*d );
+				
+				resultW = a*inverseMagnitude;
+				resultV = GroupVector3( b*inverseMagnitude, c*inverseMagnitude, d*inverseMagnitude );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Static Data Members
+			
+			
+			
+			
+			/// The number of vehicles that are processed together in a SIMD group.
+			static const Size GROUP_WIDTH = 4;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Component Enum Declaration
+			
+			
+			
+			
+			/// An enum which specifies the offset of the first component array of each vector.
+			/**
+			  * The orientation quaternion is stored as its scalar part followed by its vector part.
+			  */
+			enum VectorOffset
+			{
+				POSITION = 0,
+				VELOCITY = 3,
+				ANGULAR_VELOCITY = 6,
+				ORIENTATION_W = 9,
+				ORIENTATION_V = 10,
+				NUM_COMPONENTS = 13
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Return a pointer to the start of the specified component array.
+			RIM_FORCE_INLINE Float32* getComponent( Index component ) const
+			{
+				return components + component*capacity;
+			}
+			
+			
+			
+			
+			/// Load the vector at the specified component offset for a group of vehicles.
+			RIM_FORCE_INLINE GroupVector3 loadVector( Index offset, Index groupIndex ) const
+			{
+				const Index start = groupIndex*GROUP_WIDTH;
+				
+				return GroupVector3( GroupScalar::load( getComponent( offset ) + start ),
+									GroupScalar::load( getComponent( offset + 1 ) + start ),
+									GroupScalar::load( getComponent( offset + 2 ) + start ) );
+			}
+			
+			
+			
+			
+			/// Store the vector at the specified component offset for a group of vehicles.
+			RIM_FORCE_INLINE void storeVector( Index offset, Index groupIndex, const GroupVector3& vector )
+			{
+				const Index start = groupIndex*GROUP_WIDTH;
+				
+				vector.x.store( getComponent( offset ) + start );
+				vector.y.store( getComponent( offset + 1 ) + start );
+				vector.z.store( getComponent( offset + 2 ) + start );
+			}
+			
+			
+			
+			
+			/// Get the scalar vector at the specified component offset for a single vehicle.
+			RIM_FORCE_INLINE Vector3f getVector( Index offset, Index vehicleIndex ) const
+			{
+				return Vector3f( getComponent( offset )[vehicleIndex],
+								getComponent( offset + 1 )[vehicleIndex],
+								getComponent( offset + 2 )[vehicleIndex] );
+			}
+			
+			
+			
+			
+			/// Set the scalar vector at the specified component offset for a single vehicle.
+			RIM_FORCE_INLINE void setVector( Index offset, Index vehicleIndex, const Vector3f& vector )
+			{
+				getComponent( offset )[vehicleIndex] = vector.x;
+				getComponent( offset + 1 )[vehicleIndex] = vector.y;
+				getComponent( offset + 2 )[vehicleIndex] = vector.z;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// A pointer to the aligned storage for all of the component arrays.
+			Float32* components;
+			
+			
+			/// The number of vehicles whose state is stored.
+			Size size;
+			
+			
+			/// The padded length of each component array, a multiple of GROUP_WIDTH.
+			Size capacity;
+
+
+};
+
+
+
+
+#endif // INCLUDE_FLEET_STATE_H
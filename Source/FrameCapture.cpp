@@ -0,0 +1,276 @@
+/*
+ *  FrameCapture.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "FrameCapture.h"
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor / Destructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+FrameCapture:: FrameCapture()
+	:	capturing( false ),
+		imageFormat( images::ImageFormat::TGA ),
+		overflowPolicy( DROP_FRAMES ),
+		captureImageFormat( images::ImageFormat::TGA ),
+		captureOverflowPolicy( DROP_FRAMES ),
+		numSlots( 8 ),
+		numThreads( 0 ),
+		numFreeSlots( 0 ),
+		nextWriteNumber( 0 ),
+		nextFrameNumber( 0 ),
+		numDroppedFrames( 0 ),
+		numStalls( 0 ),
+		numFailures( 0 )
+{
+}
+
+
+
+
+FrameCapture:: ~FrameCapture()
+{
+	stop();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Capture Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool FrameCapture:: start( const fs::Path& newDirectory )
+{
+	stop();
+	
+	fs::Directory outputDirectory( newDirectory );
+	
+	if ( !outputDirectory.exists() && !outputDirectory.create() )
+		return false;
+	
+	// The workers read these while capturing, so later changes to the settings wait for the next start.
+	directory = newDirectory;
+	captureImageFormat = imageFormat;
+	captureOverflowPolicy = overflowPolicy;
+	slots = Array<Slot>( numSlots );
+	
+	freeSlots.clear();
+	encodeQueue.clear();
+	freeSlotSemaphore.reset();
+	encodeSemaphore.reset();
+	
+	for ( Index i = 0; i < numSlots; i++ )
+	{
+		freeSlots.add( i );
+		freeSlotSemaphore.up();
+	}
+	
+	numFreeSlots = numSlots;
+	nextWriteNumber = 0;
+	nextFrameNumber = 0;
+	numDroppedFrames = 0;
+	numStalls = 0;
+	numFailures = 0;
+	
+	const Size threadCount = numThreads > 0 ? numThreads : threads::Thread::getCPUCount();
+	
+	for ( Index i = 0; i < threadCount; i++ )
+	{
+		Pointer<threads::Thread> worker = Pointer<threads::Thread>::construct();
+		worker->start( FunctionCall<void ()>( bind( &FrameCapture::runWorker, this ) ) );
+		workers.add( worker );
+	}
+	
+	capturing = true;
+	
+	return true;
+}
+
+
+
+
+void FrameCapture:: stop()
+{
+	if ( !capturing )
+		return;
+	
+	// Each worker stops when it finds the queue empty, which only happens after every frame was taken.
+	for ( Index i = 0; i < workers.getSize(); i++ )
+		encodeSemaphore.up();
+	
+	for ( Index i = 0; i < workers.getSize(); i++ )
+		workers[i]->join();
+	
+	workers.clear();
+	slots.setSize( 0 );
+	capturing = false;
+}
+
+
+
+
+Bool FrameCapture:: addFrame( const images::Image& image )
+{
+	if ( !capturing || !image.isValid() )
+		return false;
+	
+	// Only this thread takes free slots, so a nonzero count means that waiting for one won't block for long.
+	if ( threads::atomic::addAndRead( numFreeSlots, Size(0) ) == 0 )
+	{
+		if ( captureOverflowPolicy == DROP_FRAMES )
+		{
+			numDroppedFrames++;
+			return false;
+		}
+		
+		numStalls++;
+	}
+	
+	freeSlotSemaphore.down();
+	threads::atomic::decrementAndRead( numFreeSlots );
+	
+	queueMutex.lock();
+	const Index slotIndex = freeSlots.getLast();
+	freeSlots.removeLast();
+	queueMutex.unlock();
+	
+	// The slot's buffer is reused between frames, so this is the only copy on the render thread.
+	Slot& slot = slots[slotIndex];
+	const data::Data& pixelData = image.getPixelData();
+	const Size numBytes = pixelData.getSize();
+	
+	if ( slot.pixels.getSize() < numBytes )
+		slot.pixels.setSize( numBytes );
+	
+	rim::util::copy( slot.pixels.getPointer(), pixelData.getPointer(), numBytes );
+	slot.numBytes = numBytes;
+	slot.pixelFormat = image.getPixelFormat();
+	slot.width = image.getWidth();
+	slot.height = image.getHeight();
+	slot.frameNumber = nextFrameNumber++;
+	
+	queueMutex.lock();
+	encodeQueue.add( slotIndex );
+	queueMutex.unlock();
+	
+	encodeSemaphore.up();
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void FrameCapture:: runWorker()
+{
+	images::io::ImageConverter imageConverter;
+	
+	while ( true )
+	{
+		encodeSemaphore.down();
+		
+		queueMutex.lock();
+		
+		if ( encodeQueue.getSize() == 0 )
+		{
+			queueMutex.unlock();
+			break;
+		}
+		
+		const Index slotIndex = encodeQueue.getFirst();
+		encodeQueue.removeAtIndex( 0 );
+		
+		queueMutex.unlock();
+		
+		// No other thread touches the slot until it is marked as encoded, so it is encoded without a lock.
+		Slot& slot = slots[slotIndex];
+		const images::Image image( data::Data( slot.pixels, slot.numBytes ), slot.pixelFormat, slot.width, slot.height );
+		
+		if ( !imageConverter.encode( captureImageFormat, image, slot.encodedData ) )
+			slot.encodedData = data::Data();
+		
+		writeMutex.lock();
+		slot.encoded = true;
+		writeReadyFrames();
+		writeMutex.unlock();
+	}
+}
+
+
+
+
+void FrameCapture:: writeReadyFrames()
+{
+	while ( true )
+	{
+		Index slotIndex = 0;
+		
+		while ( slotIndex < slots.getSize() &&
+				!(slots[slotIndex].encoded && slots[slotIndex].frameNumber == nextWriteNumber) )
+			slotIndex++;
+		
+		// Stop at the first frame that is still being encoded, so that the files are written in order.
+		if ( slotIndex == slots.getSize() )
+			break;
+		
+		Slot& slot = slots[slotIndex];
+		const Size numBytes = slot.encodedData.getSize();
+		Bool written = false;
+		
+		if ( numBytes > 0 )
+		{
+			rim::io::FileWriter writer( fs::Path( directory, UTF8String(slot.frameNumber) + "." +
+														captureImageFormat.getExtension() ) );
+			
+			written = writer.open() && writer.erase() && writer.write( slot.encodedData.getPointer(), numBytes ) == numBytes;
+			writer.close();
+		}
+		
+		if ( !written )
+			numFailures++;
+		
+		slot.encodedData = data::Data();
+		slot.encoded = false;
+		nextWriteNumber++;
+		
+		queueMutex.lock();
+		freeSlots.add( slotIndex );
+		queueMutex.unlock();
+		
+		threads::atomic::incrementAndRead( numFreeSlots );
+		freeSlotSemaphore.up();
+	}
+}
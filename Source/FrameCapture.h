@@ -0,0 +1,385 @@
+/*
+ *  FrameCapture.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_FRAME_CAPTURE_H
+#define INCLUDE_FRAME_CAPTURE_H
+
+
+#include "rim/rimEngine.h"
+#include "rim/rimImages.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+
+
+/// A class that encodes and writes captured frames to numbered image files on worker threads.
+/**
+  * The render thread copies each frame it reads back into one of a fixed number of
+  * slots and returns. Worker threads encode the slots in parallel, and the encoded
+  * frames are written in the order that they were captured, with consecutive numbers.
+  *
+  * When every slot is waiting to be encoded or written, the overflow policy decides
+  * whether the next frame is dropped or the render thread waits for a free slot.
+  */
+class FrameCapture
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Overflow Policy Enum Declaration
+			
+			
+			
+			
+			/// An enum type which specifies what happens to a frame when there is no free slot for it.
+			enum OverflowPolicy
+			{
+				/// The frame is dropped, so that capturing never slows down the render thread.
+				DROP_FRAMES,
+				
+				/// The render thread waits for a slot, so that every frame is written.
+				BLOCK
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor / Destructor
+			
+			
+			
+			
+			/// Create a new frame capture that writes TGA images and drops frames when it falls behind.
+			FrameCapture();
+			
+			
+			
+			
+			/// Destroy the frame capture, writing the frames that are left if it is capturing.
+			~FrameCapture();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Capture Methods
+			
+			
+			
+			
+			/// Start capturing frames to files named by their frame number in the specified directory.
+			/**
+			  * The directory is created if it doesn't exist. The method returns FALSE
+			  * if the directory can't be created. If the frame capture is already
+			  * capturing, the previous capture is finished first.
+			  */
+			Bool start( const fs::Path& newDirectory );
+			
+			
+			
+			
+			/// Write the frames that are left, then stop the worker threads.
+			void stop();
+			
+			
+			
+			
+			/// Add a frame to be encoded and written, returning whether or not it was accepted.
+			/**
+			  * The frame's pixels are copied, so the image can be reused as soon as this
+			  * returns. This must only be called by one thread.
+			  */
+			Bool addFrame( const images::Image& image );
+			
+			
+			
+			
+			/// Return whether or not frames are being captured.
+			RIM_INLINE Bool isCapturing() const
+			{
+				return capturing;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Settings Accessor Methods
+			
+			
+			
+			
+			/// Set the format that frames are encoded with, which takes effect at the next start().
+			RIM_INLINE void setImageFormat( images::ImageFormat newImageFormat )
+			{
+				imageFormat = newImageFormat;
+			}
+			
+			
+			
+			
+			/// Set what happens to a frame when there is no free slot for it, which takes effect at the next start().
+			RIM_INLINE void setOverflowPolicy( OverflowPolicy newOverflowPolicy )
+			{
+				overflowPolicy = newOverflowPolicy;
+			}
+			
+			
+			
+			
+			/// Set the number of frames that can wait to be encoded or written, which takes effect at the next start().
+			RIM_INLINE void setSlotCount( Size newNumSlots )
+			{
+				numSlots = math::max( newNumSlots, Size(1) );
+			}
+			
+			
+			
+			
+			/// Set the number of encoding threads, where 0 uses one thread per CPU, which takes effect at the next start().
+			RIM_INLINE void setThreadCount( Size newNumThreads )
+			{
+				numThreads = newNumThreads;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Statistics Accessor Methods
+			
+			
+			
+			
+			/// Return the number of frames that have been accepted since capturing started.
+			RIM_INLINE Size getFrameCount() const
+			{
+				return nextFrameNumber;
+			}
+			
+			
+			
+			
+			/// Return the number of frames that were dropped because there was no free slot.
+			RIM_INLINE Size getDroppedFrameCount() const
+			{
+				return numDroppedFrames;
+			}
+			
+			
+			
+			
+			/// Return the number of frames for which the render thread had to wait for a free slot.
+			RIM_INLINE Size getStallCount() const
+			{
+				return numStalls;
+			}
+			
+			
+			
+			
+			/// Return the number of frames that couldn't be encoded or written.
+			RIM_INLINE Size getFailureCount() const
+			{
+				return numFailures;
+			}
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Slot Class Declaration
+			
+			
+			
+			
+			/// A class that stores one captured frame while it is encoded and written.
+			class Slot
+			{
+				public:
+					
+					RIM_INLINE Slot()
+						:	numBytes( 0 ),
+							width( 0 ),
+							height( 0 ),
+							frameNumber( 0 ),
+							encoded( false )
+					{
+					}
+					
+					
+					/// The frame's pixels, which may be larger than the frame.
+					Array<UByte> pixels;
+					
+					/// The number of bytes of pixels in the frame.
+					Size numBytes;
+					
+					/// The format of the frame's pixels.
+					images::PixelFormat pixelFormat;
+					
+					/// The width of the frame in pixels.
+					Size width;
+					
+					/// The height of the frame in pixels.
+					Size height;
+					
+					/// The number of the frame, which is also its file name.
+					Index frameNumber;
+					
+					/// The encoded image file, which is empty if the frame couldn't be encoded.
+					data::Data encodedData;
+					
+					/// Whether or not the frame has been encoded and is waiting to be written.
+					Bool encoded;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Encode frames and write them in order until capturing stops. This is run by each worker thread.
+			void runWorker();
+			
+			
+			
+			
+			/// Write the encoded frames that are next in order and free their slots. The write mutex must be held.
+			void writeReadyFrames();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// Whether or not frames are being captured.
+			Bool capturing;
+			
+			
+			/// The directory that the image files are written to.
+			fs::Path directory;
+			
+			
+			/// The format that frames are encoded with.
+			images::ImageFormat imageFormat;
+			
+			
+			/// What happens to a frame when there is no free slot for it.
+			OverflowPolicy overflowPolicy;
+			
+			
+			/// The format that the current capture encodes frames with, copied from the setting by start().
+			images::ImageFormat captureImageFormat;
+			
+			
+			/// What happens to a frame in the current capture when there is no free slot, copied from the setting by start().
+			OverflowPolicy captureOverflowPolicy;
+			
+			
+			/// The number of frames that can wait to be encoded or written.
+			Size numSlots;
+			
+			
+			/// The number of encoding threads, or 0 for one per CPU.
+			Size numThreads;
+			
+			
+			/// The slots that frames are copied into.
+			Array<Slot> slots;
+			
+			
+			/// A mutex that protects the free slot list and the queue of frames to encode.
+			threads::Mutex queueMutex;
+			
+			
+			/// The indices of the slots that aren't in use.
+			ArrayList<Index> freeSlots;
+			
+			
+			/// The number of free slots, which the render thread reads to decide whether or not to drop a frame.
+			Size numFreeSlots;
+			
+			
+			/// A semaphore whose value is the number of free slots, which the render thread waits on.
+			threads::Semaphore freeSlotSemaphore;
+			
+			
+			/// The indices of the slots that are waiting to be encoded, in capture order.
+			ArrayList<Index> encodeQueue;
+			
+			
+			/// A semaphore whose value is the number of queued frames plus one for each worker that should stop.
+			threads::Semaphore encodeSemaphore;
+			
+			
+			/// A mutex that is held while encoded frames are written, so that they are written in order.
+			threads::Mutex writeMutex;
+			
+			
+			/// The number of the next frame to be written.
+			Index nextWriteNumber;
+			
+			
+			/// The threads that encode and write frames.
+			ArrayList< Pointer<threads::Thread> > workers;
+			
+			
+			/// The number of the next frame that is accepted.
+			Index nextFrameNumber;
+			
+			
+			/// The number of frames that were dropped because there was no free slot.
+			Size numDroppedFrames;
+			
+			
+			/// The number of frames for which the render thread had to wait for a free slot.
+			Size numStalls;
+			
+			
+			/// The number of frames that couldn't be encoded or written.
+			Size numFailures;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_FRAME_CAPTURE_H
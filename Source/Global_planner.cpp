@@ -1 +1,217 @@
 #include "Global_planner.h"
+#include "Profiler.h"
+
+
+PROFILER_ZONE( astarZone, "Global_planner::astar" );
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Global_planner:: Global_planner()
+	:	searchID( 0 )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Path Planning Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+vertices Global_planner:: prm( const Vector3f start, const Vector3f goal, Pointer<Roadmap> rmap )
+{
+	if ( rmap.isNull() || rmap->getNodeCount() == 0 )
+		return vertices();
+	
+	ArrayList<Index> nodePath;
+	
+	if ( !astar( *rmap, rmap->getClosestNode( start ), rmap->getClosestNode( goal ), nodePath ) )
+		return vertices();
+	
+	const Size pathLength = nodePath.getSize();
+	vertices path;
+	path.reserve( pathLength );
+	
+	for ( Index i = 0; i < pathLength; i++ )
+		path.push_back( rmap->getNode( nodePath[i] ).position );
+	
+	return path;
+}
+
+
+
+
+Bool Global_planner:: astar( const Roadmap& roadmap, Index startNode, Index goalNode, ArrayList<Index>& path )
+{
+	PROFILER_SCOPE( astarZone );
+	
+	// Each failed validation marks another edge invalid, so this ends after a finite number of searches.
+	while ( search( roadmap, startNode, goalNode, path ) )
+	{
+		if ( validatePath( roadmap, path ) )
+			return true;
+	}
+	
+	return false;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool Global_planner:: search( const Roadmap& roadmap, Index startNode, Index goalNode, ArrayList<Index>& path )
+{
+	path.clear();
+	
+	const Size numNodes = roadmap.getNodeCount();
+	
+	if ( startNode >= numNodes || goalNode >= numNodes )
+		return false;
+	
+	beginSearch( numNodes );
+	
+	const Vector3f& goalPosition = roadmap.getNode( goalNode ).position;
+	
+	costs[startNode] = Float(0);
+	parents[startNode] = startNode;
+	visitIDs[startNode] = searchID;
+	openSet.add( OpenNode( startNode, Float(0), roadmap.getNode( startNode ).position.getDistanceTo( goalPosition ) ) );
+	
+	while ( !openSet.isEmpty() )
+	{
+		const OpenNode current = openSet.getFirst();
+		openSet.remove();
+		
+		// Skip stale entries for nodes whose cost was already finalized from a cheaper entry.
+		if ( closedIDs[current.node] == searchID )
+			continue;
+		
+		closedIDs[current.node] = searchID;
+		
+		if ( current.node == goalNode )
+			break;
+		
+		const Roadmap::Node& node = roadmap.getNode( current.node );
+		const Size numNeighbors = node.neighbors.getSize();
+		
+		for ( Index n = 0; n < numNeighbors; n++ )
+		{
+			const Index neighborIndex = node.neighbors[n];
+			
+			if ( closedIDs[neighborIndex] == searchID || node.edgeStates[n] == Roadmap::EDGE_INVALID )
+				continue;
+			
+			const Vector3f& neighborPosition = roadmap.getNode( neighborIndex ).position;
+			const Float cost = current.cost + node.position.getDistanceTo( neighborPosition );
+			
+			if ( visitIDs[neighborIndex] == searchID && cost >= costs[neighborIndex] )
+				continue;
+			
+			costs[neighborIndex] = cost;
+			parents[neighborIndex] = current.node;
+			visitIDs[neighborIndex] = searchID;
+			openSet.add( OpenNode( neighborIndex, cost, cost + neighborPosition.getDistanceTo( goalPosition ) ) );
+		}
+	}
+	
+	openSet.clear();
+	
+	if ( closedIDs[goalNode] != searchID )
+		return false;
+	
+	// Walk the parent chain back from the goal, then reverse it in place.
+	Index nodeIndex = goalNode;
+	path.add( nodeIndex );
+	
+	while ( nodeIndex != startNode )
+	{
+		nodeIndex = parents[nodeIndex];
+		path.add( nodeIndex );
+	}
+	
+	const Size pathLength = path.getSize();
+	
+	for ( Index i = 0; i < pathLength / 2; i++ )
+	{
+		const Index temp = path[i];
+		path[i] = path[pathLength - i - 1];
+		path[pathLength - i - 1] = temp;
+	}
+	
+	return true;
+}
+
+
+
+
+Bool Global_planner:: validatePath( const Roadmap& roadmap, const ArrayList<Index>& path )
+{
+	for ( Index i = 1; i < path.getSize(); i++ )
+	{
+		const ArrayList<Index>& neighbors = roadmap.getNode( path[i - 1] ).neighbors;
+		
+		for ( Index n = 0; n < neighbors.getSize(); n++ )
+		{
+			if ( neighbors[n] == path[i] )
+			{
+				if ( !roadmap.validateEdge( path[i - 1], n ) )
+					return false;
+				
+				break;
+			}
+		}
+	}
+	
+	return true;
+}
+
+
+
+
+void Global_planner:: beginSearch( Size numNodes )
+{
+	if ( costs.getSize() < numNodes )
+	{
+		costs.setSize( numNodes, Float(0) );
+		parents.setSize( numNodes, Index(0) );
+		visitIDs.setSize( numNodes, UInt32(0) );
+		closedIDs.setSize( numNodes, UInt32(0) );
+	}
+	
+	searchID++;
+	
+	// When the search ID wraps around, the old stamps could alias the new ID, so clear them.
+	if ( searchID == 0 )
+	{
+		visitIDs.setAll( 0 );
+		closedIDs.setAll( 0 );
+		searchID = 1;
+	}
+}
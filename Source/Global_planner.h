@@ -8,13 +8,7 @@ Author: Niti Madhugiri
 
 */
 
-#include "VehicleState.h"
-#include "AngularVelocity.h"
-#include "Orientation.h"
-#include "VehicleAttitudeHelpers.h"
-
 #include <vector>
-#include <map>
 
 
 #include "rim/rimEngine.h"
@@ -26,233 +20,181 @@ using namespace rim;
 using namespace rim::math;
 
 
-/// Define a less-than comparison operator for the Vector3f.
-namespace rim { namespace math {
-inline bool operator < ( const Vector3f& a, const Vector3f& b )
-{
-	return a.x < b.x;// && a.y < b.y && a.z < b.z;
-}
-}; };
-
 
 
 typedef std::vector<Vector3f> vertices;
 
-class Global_planner
-{
-public:
-
-	//path cost to landmark
-	float cost(Vector3f landmark, Vector3f start, std::map<Vector3f,Vector3f> parent )
-	{
-		
-		if(landmark == start)
-		{
-			return 0;
-		}
-		else
-		{
-			return (landmark.getDistanceTo(parent[landmark]) + cost(parent[landmark],start,parent));
-
-		}
 
-	}
 
-	//f_score for a landmark
-	float costheur(Vector3f landmark, Vector3f start, Vector3f goal, std::map<Vector3f,Vector3f> parent)
-	{
-		return (cost(landmark, start, parent) + landmark.getDistanceTo(goal));
-	}
 
-	//path reconstruction
-	vertices reconstructpath(std::map<Vector3f,Vector3f> came,Vector3f current_node)
+/// A class that finds shortest paths through a Roadmap using A* search.
+/**
+  * The search runs directly on the roadmap's node indices. The open set is a binary
+  * heap, and the per-node costs and parents are stored in flat arrays that are kept
+  * between queries. Each query stamps the nodes that it touches with a new search ID,
+  * so the arrays never need to be cleared and no containers are copied.
+  *
+  * On a lazy roadmap, the search treats the unchecked edges as valid. Only the edges
+  * of the path that it finds are then checked, and the search is run again without
+  * any edge that turns out to be blocked, until a path of valid edges is found.
+  */
+class Global_planner
 {
-	vertices pp;
-
-	std::map<Vector3f,Vector3f>::iterator i1 = came.find(current_node);
-	
-	if (i1==came.end())
-	{ 
-		pp.push_back(current_node);
-		return pp;
-	}
-	else
-	{
-		pp = reconstructpath(came,came[current_node]);
-		pp.push_back(current_node);
-		return pp;
-	}
-
-}
-
-	//astar
-	vertices astar(Vector3f start, Vector3f goal, std::map<Vector3f,vertices> rmap, vertices samples)
-	{
-		vertices openlist, closedlist;
-		std::map<Vector3f,Vector3f> parent;
-		std::map<Vector3f,float> tent_cost, tent_f;
-
-		openlist.push_back(start);
-
-		tent_cost[start] = 0;
-		tent_f[start] = tent_cost[start] + start.getDistanceTo(goal);
+	public:
 		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new global planner with no allocated search state.
+			Global_planner();
 		
-		for(size_t a = 0; a < samples.size(); a++)
-		{
-			if(samples[a] != start)
-			{
-				tent_cost[samples[a]] = 50000000;
-				tent_f[samples[a]] = tent_cost[samples[a]] + samples[a].getDistanceTo(goal);
-			}
-		}
 		
-		while(!openlist.empty())
-		{
-			Vector3f current;
-			float mincost = 50000000;
-			size_t minid = 0;
-
-			for(size_t b = 0; b < openlist.size(); b++)
-			{
-				if(tent_f[openlist[b]] < mincost)
-				{
-					mincost = tent_f[openlist[b]];
-					current = openlist[b];
-					minid = b;
-				}
-			}
-			
-			if(current == goal)
-			{
-				float pathcost = cost(current,start,parent);
-				return (reconstructpath(parent,current));
-			}
-
-			openlist.erase(openlist.begin() + minid);
-			closedlist.push_back(current);
-			
-			for(size_t c = 0; c < rmap[current].size(); c++)
-			{
-				bool alreadychecked = false, openchecked = false;
-				for(size_t d = 0; d < closedlist.size(); d++)
-				{
-					if(rmap[current][c] == closedlist[d])
-						{
-							alreadychecked = true;
-							break;
-					    }
-				}
-				
-				if(alreadychecked)
-					continue;
-
-				for(size_t e = 0; e < openlist.size(); e++)
-				{
-					if(rmap[current][c] == openlist[e])
-						{
-							openchecked = true;
-							break;
-					    }
-				}
-
-				float tentativecost = tent_cost[current] + current.getDistanceTo(rmap[current][c]);
-				
-				if((!openchecked) || (tentativecost < tent_cost[rmap[current][c]]))
-				{
-					parent[rmap[current][c]] = current;
-					tent_cost[rmap[current][c]] = tentativecost;
-					tent_f[rmap[current][c]] = tent_cost[rmap[current][c]] + rmap[current][c].getDistanceTo(goal);
-
-					if(!openchecked)
-						openlist.push_back(rmap[current][c]);
-				}		
-
-
-			}
-
-		}
-
-		//perror("path not found!\n ");
-		return vertices();
-	}
-
-
-	vertices prm(const Vector3f start, const Vector3f goal,Pointer<Roadmap> rmap) 
-	{
-
-		std::map<Vector3f,vertices> roadmp;
-		vertices sample;
-/*
-		sample.push_back(start);
 		
-		vertices nbr1;
-
-		for ( Index i = 0; i < rmap->getNodeCount(); i++ )
-	{
-		const Vector3f& p11 = rmap->getNode(i).position;
-
-		if ( p11.getDistanceToSquared(start) < 10000.0 && rmap->link( p11, start) )
-			{
-				nbr1.push_back(rmap->getNode(i).position);
-				//rmap->getNode(i).neighbors. add( );
-				
-			}
-
-	}
-
-		roadmp[start] = nbr1;
-*/
-
-		for ( Index i = 0; i < rmap->getNodeCount(); i++ )
-	{
 		
-		sample.push_back(rmap->getNode(i).position);
-
-		const ArrayList<Index>& neighbors = rmap->getNode(i).neighbors;
-		const Size numNeighbors = neighbors.getSize();
-		vertices nbr;
-
-		for ( Index n = 0; n < numNeighbors; n++ )
-		{
-			nbr.push_back(rmap->getNode(neighbors[n]).position );
-		}
-
-		roadmp[rmap->getNode(i).position] = nbr;
-
-	}
-/*
-		sample.push_back(goal);
-
-		vertices nbr2;
-
-		for ( Index i = 0; i < rmap->getNodeCount(); i++ )
-	{
-		const Vector3f& p12 = rmap->getNode(i).position;
-
-		if ( p12.getDistanceToSquared(goal) < 10000.0 && rmap->link( p12, goal) )
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Path Planning Methods
+			
+			
+			
+			
+			/// Find the shortest path through the roadmap from the start to the goal position.
+			/**
+			  * The start and goal positions are snapped to the closest roadmap nodes.
+			  * The positions of the nodes along the path are returned, or an empty list
+			  * if there is no path.
+			  */
+			vertices prm( const Vector3f start, const Vector3f goal, Pointer<Roadmap> rmap );
+			
+			
+			
+			
+			/// Find the shortest path between two nodes of a roadmap.
+			/**
+			  * The node indices along the path, including the start and goal nodes, replace
+			  * the contents of the output list. The method returns FALSE if the goal is not
+			  * reachable from the start. The edges of the path are validated if they
+			  * haven't been checked yet.
+			  */
+			Bool astar( const Roadmap& roadmap, Index startNode, Index goalNode, ArrayList<Index>& path );
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Open Node Class Declaration
+			
+			
+			
+			
+			/// A class that stores a node in the open set along with its estimated total cost.
+			class OpenNode
 			{
-				nbr2.push_back(rmap->getNode(i).position);
-				//rmap->getNode(i).neighbors. add( );
-				
-				
-			}
-
-	}
-
-		roadmp[goal] = nbr2;
-*/
-
-		return astar(start,goal,roadmp,sample);
-
-
-	}
-
-
+				public:
+					
+					RIM_INLINE OpenNode( Index newNode, Float newCost, Float newEstimate )
+						:	node( newNode ),
+							cost( newCost ),
+							estimate( newEstimate )
+					{
+					}
+					
+					
+					/// Return whether or not this node has a higher priority than another.
+					/**
+					  * The priority queue keeps its largest element first, so the comparison
+					  * is inverted to pop the node with the smallest estimated cost first.
+					  */
+					RIM_INLINE Bool operator < ( const OpenNode& other ) const
+					{
+						return estimate > other.estimate;
+					}
+					
+					
+					/// The index of the roadmap node.
+					Index node;
+					
+					/// The cost of the path to the node when it was added to the open set.
+					Float cost;
+					
+					/// The path cost plus the heuristic distance from the node to the goal.
+					Float estimate;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Find the shortest path between two nodes, skipping the edges that are known to be invalid.
+			Bool search( const Roadmap& roadmap, Index startNode, Index goalNode, ArrayList<Index>& path );
+			
+			
+			
+			
+			/// Validate the edges along a path in order, returning FALSE at the first invalid edge.
+			static Bool validatePath( const Roadmap& roadmap, const ArrayList<Index>& path );
+			
+			
+			
+			
+			/// Make sure the search state arrays can hold the specified number of nodes and start a new search.
+			void beginSearch( Size numNodes );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The open set of the search, ordered by increasing estimated cost.
+			/**
+			  * Nodes are added again whenever a cheaper path to them is found, rather
+			  * than being updated in place. Stale entries are skipped when they are removed.
+			  */
+			PriorityQueue<OpenNode> openSet;
+			
+			
+			/// The cheapest known path cost to each node, valid if the node's visit ID matches the search ID.
+			Array<Float> costs;
+			
+			
+			/// The previous node on the cheapest known path to each node.
+			Array<Index> parents;
+			
+			
+			/// The ID of the last search that found a path to each node.
+			Array<UInt32> visitIDs;
+			
+			
+			/// The ID of the last search that finalized the cost of each node.
+			Array<UInt32> closedIDs;
+			
+			
+			/// The ID of the current search, incremented for each query.
+			UInt32 searchID;
 
-	Global_planner(){
-	};
-	
 
 };
-
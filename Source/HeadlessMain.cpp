@@ -0,0 +1,96 @@
+/*
+ *  HeadlessMain.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "HeadlessRunner.h"
+#include "Profiler.h"
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+
+
+static void printUsage( const char* programName )
+{
+	std::fprintf( stderr, "Usage: %s <scenario> [--steps N] [--vehicles N] [--threads N] [--integrator euler|rk4|fleet_rk4|dopri5] [--airframe quad|hexa|octo] [--trace <path>] [--telemetry <path>] [--sensors HZ]\n",
+				programName );
+}
+
+
+
+
+int main (int argc, char * const argv[])
+{
+	if ( argc < 2 )
+	{
+		printUsage( argv[0] );
+		return 1;
+	}
+	
+	HeadlessRunner runner;
+	const char* tracePath = NULL;
+	
+	if ( !runner.loadScenario( argv[1] ) )
+		return 1;
+	
+	// Options on the command line override the scenario's settings.
+	for ( int i = 2; i < argc; i++ )
+	{
+		if ( i + 1 >= argc )
+		{
+			printUsage( argv[0] );
+			return 1;
+		}
+		
+		const char* option = argv[i];
+		const char* value = argv[++i];
+		
+		Bool valid = true;
+		
+		if ( std::strcmp( option, "--steps" ) == 0 )
+			runner.setStepCount( Size(std::strtoul( value, NULL, 10 )) );
+		else if ( std::strcmp( option, "--vehicles" ) == 0 )
+			runner.setVehicleCount( Size(std::strtoul( value, NULL, 10 )) );
+		else if ( std::strcmp( option, "--threads" ) == 0 )
+			runner.setThreadCount( Size(std::strtoul( value, NULL, 10 )) );
+		else if ( std::strcmp( option, "--integrator" ) == 0 )
+			valid = runner.setIntegrator( value );
+		else if ( std::strcmp( option, "--airframe" ) == 0 )
+			valid = runner.setAirframe( value );
+		else if ( std::strcmp( option, "--trace" ) == 0 )
+			tracePath = value;
+		else if ( std::strcmp( option, "--telemetry" ) == 0 )
+			runner.setTelemetryPath( value );
+		else if ( std::strcmp( option, "--sensors" ) == 0 )
+			runner.setSensorRate( Float(std::strtod( value, NULL )) );
+		else
+			valid = false;
+		
+		if ( !valid )
+		{
+			printUsage( argv[0] );
+			return 1;
+		}
+	}
+	
+	if ( !runner.initialize() )
+		return 1;
+	
+	runner.run();
+	runner.printReport();
+	
+	if ( tracePath != NULL && !Profiler::writeChromeTrace( tracePath ) )
+	{
+		std::fprintf( stderr, "Unable to write the trace file %s\n", tracePath );
+		return 1;
+	}
+
+    return 0;
+}
@@ -0,0 +1,599 @@
+/*
+ *  HeadlessRunner.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "HeadlessRunner.h"
+#include "Profiler.h"
+
+
+#include <cstdio>
+#include <cstring>
+
+
+/// The maximum length of a line in a scenario file.
+static const Size MAX_SCENARIO_LINE_LENGTH = 1024;
+
+
+/// The number of times that a quadcopter's private roadmap is rebuilt before giving up on finding a path.
+static const Size MAX_PRIVATE_ROADMAP_TRIES = 10;
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Helper Functions
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+/// Return a pointer to the first character of a string that isn't whitespace.
+static const char* skipWhitespace( const char* string )
+{
+	while ( *string == ' ' || *string == '\t' )
+		string++;
+	
+	return string;
+}
+
+
+
+
+/// Remove the whitespace and line ending from the end of a string.
+static void trimLineEnd( char* string )
+{
+	Size length = std::strlen( string );
+	
+	while ( length > 0 && (string[length - 1] == '\n' || string[length - 1] == '\r' ||
+							string[length - 1] == ' ' || string[length - 1] == '\t') )
+		string[--length] = '\0';
+}
+
+
+
+
+/// Return the number of milliseconds per step of a total time.
+static Double getMillisecondsPerStep( const Time& time, Size numSteps )
+{
+	return numSteps > 0 ? 1000.0*time.getSeconds() / Double(numSteps) : 0.0;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+HeadlessRunner:: HeadlessRunner()
+	:	sceneBounds( -300, 300, 0, 50, -500, 300 ),
+		numRoadmapSamples( 10000 ),
+		timeStep( 0.5f/60.0f ),
+		numSteps( 3600 ),
+		numVehicles( 0 ),
+		numThreads( 0 ),
+		randomSeed( 0 ),
+		integrationMethod( Simulation::RK4 ),
+		numMotors( QuadLayout::getMotorCount() ),
+		numPlanned( 0 ),
+		sensorRate( 0 ),
+		sensorWidth( 64 ),
+		sensorHeight( 48 )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Scenario Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool HeadlessRunner:: loadScenario( const char* scenarioPath )
+{
+	std::FILE* file = std::fopen( scenarioPath, "r" );
+	
+	if ( file == NULL )
+	{
+		std::fprintf( stderr, "Unable to open the scenario file %s\n", scenarioPath );
+		return false;
+	}
+	
+	char line[MAX_SCENARIO_LINE_LENGTH];
+	Size lineNumber = 0;
+	Bool result = true;
+	
+	while ( std::fgets( line, MAX_SCENARIO_LINE_LENGTH, file ) != NULL )
+	{
+		lineNumber++;
+		trimLineEnd( line );
+		
+		const char* start = skipWhitespace( line );
+		
+		if ( *start == '\0' || *start == '#' )
+			continue;
+		
+		if ( !parseScenarioLine( start ) )
+		{
+			std::fprintf( stderr, "%s:%lu: Invalid scenario setting: %s\n", scenarioPath, (unsigned long)lineNumber, start );
+			result = false;
+			break;
+		}
+	}
+	
+	std::fclose( file );
+	
+	return result;
+}
+
+
+
+
+Bool HeadlessRunner:: setIntegrator( const char* integratorName )
+{
+	if ( std::strcmp( integratorName, "euler" ) == 0 )
+		integrationMethod = Simulation::SEMI_IMPLICIT_EULER;
+	else if ( std::strcmp( integratorName, "rk4" ) == 0 )
+		integrationMethod = Simulation::RK4;
+	else if ( std::strcmp( integratorName, "fleet_rk4" ) == 0 )
+		integrationMethod = Simulation::FLEET_RK4;
+	else if ( std::strcmp( integratorName, "dopri5" ) == 0 )
+		integrationMethod = Simulation::DORMAND_PRINCE;
+	else
+		return false;
+	
+	return true;
+}
+
+
+
+
+Bool HeadlessRunner:: setAirframe( const char* airframeName )
+{
+	if ( std::strcmp( airframeName, "quad" ) == 0 )
+		numMotors = QuadLayout::getMotorCount();
+	else if ( std::strcmp( airframeName, "hexa" ) == 0 )
+		numMotors = HexaLayout::getMotorCount();
+	else if ( std::strcmp( airframeName, "octo" ) == 0 )
+		numMotors = OctoLayout::getMotorCount();
+	else
+		return false;
+	
+	return true;
+}
+
+
+
+
+Bool HeadlessRunner:: parseScenarioLine( const char* line )
+{
+	char key[64];
+	int keyLength = 0;
+	
+	if ( std::sscanf( line, "%63s%n", key, &keyLength ) != 1 )
+		return false;
+	
+	const char* value = skipWhitespace( line + keyLength );
+	unsigned long integer;
+	unsigned long secondInteger;
+	float v[6];
+	
+	if ( std::strcmp( key, "scene" ) == 0 && *value != '\0' )
+		scenePath = data::UTF8String( value );
+	else if ( std::strcmp( key, "collisionCache" ) == 0 && *value != '\0' )
+		collisionCachePath = data::UTF8String( value );
+	else if ( std::strcmp( key, "roadmapCache" ) == 0 && *value != '\0' )
+		roadmapCachePath = data::UTF8String( value );
+	else if ( std::strcmp( key, "bounds" ) == 0 &&
+			std::sscanf( value, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5] ) == 6 )
+		sceneBounds = AABB3f( v[0], v[1], v[2], v[3], v[4], v[5] );
+	else if ( std::strcmp( key, "roadmapSamples" ) == 0 && std::sscanf( value, "%lu", &integer ) == 1 )
+		numRoadmapSamples = Size(integer);
+	else if ( std::strcmp( key, "timeStep" ) == 0 && std::sscanf( value, "%f", &v[0] ) == 1 && v[0] > 0 )
+		timeStep = v[0];
+	else if ( std::strcmp( key, "steps" ) == 0 && std::sscanf( value, "%lu", &integer ) == 1 )
+		numSteps = Size(integer);
+	else if ( std::strcmp( key, "threads" ) == 0 && std::sscanf( value, "%lu", &integer ) == 1 )
+		numThreads = Size(integer);
+	else if ( std::strcmp( key, "seed" ) == 0 && std::sscanf( value, "%lu", &integer ) == 1 )
+		randomSeed = UInt32(integer);
+	else if ( std::strcmp( key, "integrator" ) == 0 )
+		return setIntegrator( value );
+	else if ( std::strcmp( key, "airframe" ) == 0 )
+		return setAirframe( value );
+	else if ( std::strcmp( key, "quadcopter" ) == 0 &&
+			std::sscanf( value, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5] ) == 6 )
+		vehicles.add( ScenarioVehicle( Vector3f( v[0], v[1], v[2] ), Vector3f( v[3], v[4], v[5] ) ) );
+	else if ( std::strcmp( key, "sensors" ) == 0 && std::sscanf( value, "%f", &v[0] ) == 1 && v[0] >= 0 )
+		sensorRate = v[0];
+	else if ( std::strcmp( key, "sensorResolution" ) == 0 &&
+			std::sscanf( value, "%lu %lu", &integer, &secondInteger ) == 2 && integer > 0 && secondInteger > 0 )
+	{
+		sensorWidth = Size(integer);
+		sensorHeight = Size(secondInteger);
+	}
+	else
+		return false;
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Run Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool HeadlessRunner:: initialize()
+{
+	if ( scenePath.getLength() == 0 || vehicles.getSize() == 0 )
+	{
+		std::fprintf( stderr, "The scenario must have a scene and at least one quadcopter\n" );
+		return false;
+	}
+	
+	const Size threadCount = numThreads > 0 ? numThreads : threads::Thread::getCPUCount();
+	planningThreadPool.setThreadCount( threadCount );
+	simulation.setThreadCount( threadCount );
+	simulation.setIntegrationMethod( integrationMethod );
+	simulation.setRandomSeed( randomSeed );
+	
+	//********************************************************************************
+	// Load the scene mesh directly from its file, since there is no graphics context to convert it for.
+	
+	Time start = Time::getCurrent();
+	
+	graphics::io::OBJTranscoder objTranscoder;
+	Pointer<GenericMeshShape> mesh = objTranscoder.decode( ResourceID( scenePath ) ).dynamicCast<GenericMeshShape>();
+	
+	if ( mesh.isNull() )
+	{
+		std::fprintf( stderr, "Unable to load the scene mesh %s\n", (const char*)scenePath.getCString() );
+		return false;
+	}
+	
+	sceneLoadTime = Time::getCurrent() - start;
+	
+	//********************************************************************************
+	// Build or load the scene's collision tree and roadmap.
+	
+	start = Time::getCurrent();
+	
+	if ( collisionCachePath.getLength() > 0 )
+		roadmap = Pointer<Roadmap>::construct( mesh, collisionCachePath, &planningThreadPool );
+	else
+		roadmap = Pointer<Roadmap>::construct( mesh, &planningThreadPool );
+	
+	collisionTreeTime = Time::getCurrent() - start;
+	start = Time::getCurrent();
+	
+	// Seed the roadmap so that it is the same on every run, and so that a cached roadmap is only used for the same seed.
+	roadmap->setRandomSeed( randomSeed );
+	
+	if ( roadmapCachePath.getLength() == 0 || !roadmap->load( roadmapCachePath, sceneBounds, numRoadmapSamples ) )
+	{
+		roadmap->rebuild( sceneBounds, numRoadmapSamples, &planningThreadPool );
+		
+		if ( roadmapCachePath.getLength() > 0 )
+			roadmap->save( roadmapCachePath );
+	}
+	
+	roadmapTime = Time::getCurrent() - start;
+	
+	//********************************************************************************
+	// Spawn the quadcopters and plan their initial paths.
+	
+	const Size vehicleCount = numVehicles > 0 ? numVehicles : vehicles.getSize();
+	
+	for ( Index i = 0; i < vehicleCount; i++ )
+	{
+		Pointer<Quadcopter> quadcopter = newQuadcopter( vehicles[i % vehicles.getSize()] );
+		quadcopters.add( quadcopter );
+		simulation.addQuadcopter( quadcopter );
+	}
+	
+	start = Time::getCurrent();
+	
+	for ( Index i = 0; i < quadcopters.getSize(); i++ )
+		planningThreadPool.addJob( bindCall( &HeadlessRunner::planToGoal, this, quadcopters[i].getPointer() ) );
+	
+	planningThreadPool.finishJobs();
+	
+	// The roadmap pointers are reference counted, so private roadmaps are only created on this thread.
+	numPlanned = 0;
+	
+	for ( Index i = 0; i < quadcopters.getSize(); i++ )
+	{
+		Quadcopter& quadcopter = *quadcopters[i];
+		
+		if ( quadcopter.path.size() == 0 )
+			planOnPrivateRoadmap( quadcopter );
+		
+		quadcopter.nextid = 1;
+		quadcopter.resetLookAhead();
+		
+		if ( quadcopter.path.size() > 0 )
+		{
+			quadcopter.nextWaypoint = quadcopter.path[quadcopter.nextid];
+			numPlanned++;
+		}
+	}
+	
+	planningTime = Time::getCurrent() - start;
+	
+	//********************************************************************************
+	// Give each quadcopter a range sensor at the pose of its front and down cameras.
+	
+	sensors.clear();
+	
+	if ( sensorRate > 0 )
+	{
+		for ( Index i = 0; i < 2*quadcopters.getSize(); i++ )
+		{
+			RangeSensor sensor;
+			sensor.setResolution( sensorWidth, sensorHeight );
+			sensor.setRate( sensorRate );
+			sensors.add( sensor );
+		}
+	}
+	
+	return true;
+}
+
+
+
+
+void HeadlessRunner:: run()
+{
+	simulation.resetStageTimes();
+	simulation.resetStepStatistics();
+	
+	if ( telemetryPath.getLength() > 0 && !telemetryRecorder.start( telemetryPath ) )
+		std::fprintf( stderr, "Unable to write the telemetry log %s\n", (const char*)telemetryPath.getCString() );
+	
+	// Discard the zone times of the setup so that the profiler statistics are per step.
+	Profiler::endFrame();
+	
+	const Time start = Time::getCurrent();
+	
+	for ( Index step = 0; step < numSteps; step++ )
+	{
+		simulation.update( timeStep );
+		telemetryRecorder.record( Double(step + 1)*timeStep, simulation );
+		
+		if ( sensors.getSize() > 0 )
+			updateSensors( Double(step + 1)*timeStep );
+		
+		Profiler::endFrame();
+	}
+	
+	runTime = Time::getCurrent() - start;
+	
+	// Write the rest of the log after the timing, since it only waits for the disk.
+	telemetryRecorder.stop();
+}
+
+
+
+
+void HeadlessRunner:: printReport() const
+{
+	const Simulation::StageTimes& stageTimes = simulation.getStageTimes();
+	const Size steps = stageTimes.numSteps;
+	const Size vehicleCount = quadcopters.getSize();
+	const Double seconds = runTime.getSeconds();
+	const Time otherTime = runTime - stageTimes.lookAhead - stageTimes.fleetTransfer - stageTimes.integration;
+	
+	std::printf( "Setup:\n" );
+	std::printf( "  scene load        %10.3f s\n", sceneLoadTime.getSeconds() );
+	std::printf( "  collision tree    %10.3f s  (%lu triangles)\n", collisionTreeTime.getSeconds(),
+				(unsigned long)roadmap->getCollisionTree().getTriangleCount() );
+	std::printf( "  roadmap           %10.3f s  (%lu nodes)\n", roadmapTime.getSeconds(),
+				(unsigned long)roadmap->getNodeCount() );
+	std::printf( "  planning          %10.3f s  (%lu of %lu vehicles have a path)\n", planningTime.getSeconds(),
+				(unsigned long)numPlanned, (unsigned long)vehicleCount );
+	
+	std::printf( "Simulation:\n" );
+	std::printf( "  %lu vehicles, %lu steps of %g s, %lu threads\n", (unsigned long)vehicleCount,
+				(unsigned long)steps, timeStep, (unsigned long)simulation.getThreadCount() );
+	std::printf( "  wall time         %10.3f s\n", seconds );
+	
+	if ( seconds > 0 )
+	{
+		std::printf( "  steps/s           %10.1f\n", Double(steps) / seconds );
+		std::printf( "  vehicle-steps/s   %10.1f\n", Double(steps*vehicleCount) / seconds );
+	}
+	
+	std::printf( "Stage times (ms/step):\n" );
+	std::printf( "  look-ahead        %10.4f\n", getMillisecondsPerStep( stageTimes.lookAhead, steps ) );
+	std::printf( "  fleet transfer    %10.4f\n", getMillisecondsPerStep( stageTimes.fleetTransfer, steps ) );
+	std::printf( "  integration       %10.4f\n", getMillisecondsPerStep( stageTimes.integration, steps ) );
+	std::printf( "  other             %10.4f\n", getMillisecondsPerStep( otherTime, steps ) );
+	
+	if ( integrationMethod == Simulation::DORMAND_PRINCE )
+	{
+		const Simulation::StepStatistics stepStatistics = simulation.getStepStatistics();
+		const Size numInternalSteps = stepStatistics.numAccepted + stepStatistics.numRejected;
+		
+		std::printf( "Adaptive steps:\n" );
+		std::printf( "  accepted          %10lu\n", (unsigned long)stepStatistics.numAccepted );
+		std::printf( "  rejected          %10lu\n", (unsigned long)stepStatistics.numRejected );
+		
+		if ( steps*vehicleCount > 0 )
+			std::printf( "  per vehicle-step  %10.3f\n", Double(numInternalSteps) / Double(steps*vehicleCount) );
+		
+		if ( stepStatistics.numAccepted > 0 && stepStatistics.minStepSize < math::max<Float>() )
+			std::printf( "  smallest step     %10.6f s\n", stepStatistics.minStepSize );
+	}
+	
+	const UTF8String profilerSummary = Profiler::getSummary();
+	
+	if ( profilerSummary.getLength() > 0 )
+		std::printf( "Profiler zones (per step, last %lu steps):\n%s", (unsigned long)Profiler::HISTORY_LENGTH,
+					(const char*)profilerSummary.getCString() );
+	
+	if ( telemetryPath.getLength() > 0 )
+	{
+		std::printf( "Telemetry:\n" );
+		std::printf( "  frames            %10lu\n", (unsigned long)telemetryRecorder.getFrameCount() );
+		std::printf( "  ring stalls       %10lu\n", (unsigned long)telemetryRecorder.getStallCount() );
+		std::printf( "  dropped frames    %10lu\n", (unsigned long)telemetryRecorder.getDroppedFrameCount() );
+	}
+	
+	if ( sensors.getSize() > 0 )
+	{
+		Size numCaptures = 0;
+		Size numRays = 0;
+		Time captureDuration;
+		
+		for ( Index i = 0; i < sensors.getSize(); i++ )
+		{
+			numCaptures += sensors[i].getCaptureCount();
+			numRays += sensors[i].getRayCount();
+			captureDuration += sensors[i].getCaptureDuration();
+		}
+		
+		const Double captureSeconds = captureDuration.getSeconds();
+		
+		std::printf( "Range sensors:\n" );
+		std::printf( "  %lu sensors, %lux%lu pixels at %g Hz\n", (unsigned long)sensors.getSize(),
+					(unsigned long)sensorWidth, (unsigned long)sensorHeight, sensorRate );
+		std::printf( "  captures          %10lu\n", (unsigned long)numCaptures );
+		std::printf( "  rays              %10lu\n", (unsigned long)numRays );
+		std::printf( "  capture time      %10.3f s\n", captureSeconds );
+		
+		if ( captureSeconds > 0 )
+			std::printf( "  rays/s            %10.1f\n", Double(numRays) / captureSeconds );
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Pointer<Quadcopter> HeadlessRunner:: newQuadcopter( const ScenarioVehicle& vehicle ) const
+{
+	Pointer<Quadcopter> quadcopter = Pointer<Quadcopter>::construct();
+	quadcopter->currentState.position = vehicle.start;
+	
+	// Each layout is a separate template instantiation, so pick the one with the right motor count.
+	if ( numMotors == HexaLayout::getMotorCount() )
+		quadcopter->setStandardAirframe( HexaLayout() );
+	else if ( numMotors == OctoLayout::getMotorCount() )
+		quadcopter->setStandardAirframe( OctoLayout() );
+	else
+		quadcopter->setStandardAirframe( QuadLayout() );
+	
+	quadcopter->goalpoint = vehicle.goal;
+	
+	// Plan on the shared scene roadmap until a query needs a roadmap of its own.
+	quadcopter->roadmap = roadmap;
+	
+	if ( roadmap->getNodeCount() > 0 )
+		quadcopter->planner.reset( roadmap );
+	
+	quadcopter->nextWaypoint = vehicle.start;
+	
+	return quadcopter;
+}
+
+
+
+
+void HeadlessRunner:: planToGoal( Quadcopter* quadcopter )
+{
+	IncrementalPlanner& planner = quadcopter->planner;
+	planner.setStart( quadcopter->currentState.position );
+	planner.setGoal( quadcopter->goalpoint );
+	planner.plan( quadcopter->path );
+}
+
+
+
+
+Bool HeadlessRunner:: planOnPrivateRoadmap( Quadcopter& quadcopter )
+{
+	const Vector3f start = quadcopter.currentState.position;
+	const Vector3f& goal = quadcopter.goalpoint;
+	
+	AABB3f bounds( start );
+	bounds.enlargeFor( goal );
+	
+	const Float samplesPerM3 = 0.001f;
+	const Size numSamples = math::clamp( Size(samplesPerM3*bounds.getVolume()), Size(100), Size(1000) );
+	
+	quadcopter.roadmap = Pointer<Roadmap>::construct( *roadmap );
+	
+	// A private roadmap is only searched by its own planner, so its edges can be checked lazily.
+	quadcopter.roadmap->setLazy( true );
+	
+	for ( Index i = 0; i < MAX_PRIVATE_ROADMAP_TRIES; i++ )
+	{
+		quadcopter.roadmap->rebuild( bounds, numSamples, start, goal, &planningThreadPool );
+		quadcopter.planner.reset( quadcopter.roadmap );
+		planToGoal( &quadcopter );
+		
+		if ( quadcopter.path.size() > 0 )
+			return true;
+	}
+	
+	return false;
+}
+
+
+
+
+void HeadlessRunner:: updateSensors( Double time )
+{
+	const CollisionTree& tree = roadmap->getCollisionTree();
+	
+	for ( Index i = 0; i < quadcopters.getSize(); i++ )
+	{
+		// Use the same poses that the graphics give the front and down cameras.
+		const TransformState& state = quadcopters[i]->currentState;
+		const Matrix3f rotation = state.getRotation();
+		
+		sensors[2*i].update( time, state.position, rotation, tree, &planningThreadPool );
+		sensors[2*i + 1].update( time, state.position, rotation*Matrix3f::rotationXDegrees(90), tree, &planningThreadPool );
+	}
+}
@@ -0,0 +1,376 @@
+/*
+ *  HeadlessRunner.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_HEADLESS_RUNNER_H
+#define INCLUDE_HEADLESS_RUNNER_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "Quadcopter.h"
+#include "RangeSensor.h"
+#include "Roadmap.h"
+#include "Simulation.h"
+#include "TelemetryRecorder.h"
+
+
+
+
+/// A class that runs a simulation scenario without a window or graphics context.
+/**
+  * A scenario is a text file with one setting per line. Blank lines and lines
+  * starting with '#' are ignored. The recognized settings are:
+  *
+  *		scene <path>				The OBJ mesh of the scene (required).
+  *		collisionCache <path>		A file that caches the scene's collision tree.
+  *		roadmapCache <path>			A file that caches the scene's roadmap.
+  *		bounds <x0 x1 y0 y1 z0 z1>	The bounds that the scene roadmap is sampled in.
+  *		roadmapSamples <n>			The number of samples in the scene roadmap.
+  *		timeStep <seconds>			The fixed simulation time step.
+  *		steps <n>					The number of simulation steps to run.
+  *		threads <n>					The number of worker threads, or 0 for one per CPU.
+  *		seed <n>					The random seed of the simulation and the scene roadmap.
+  *		integrator <name>			One of "euler", "rk4" (the default), "fleet_rk4", or "dopri5".
+  *		airframe <name>				The motor layout of every vehicle, one of "quad", "hexa", or "octo".
+  *		quadcopter <start> <goal>	A quadcopter's start and goal positions, as six numbers.
+  *		sensors <hz>				The capture rate of each vehicle's front and down range sensors, which are off by default.
+  *		sensorResolution <w> <h>	The width and height of the range sensor images.
+  *
+  * Paths are relative to the working directory. If more vehicles are requested than
+  * the scenario lists, the listed quadcopters are repeated in order.
+  */
+class HeadlessRunner
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new headless runner with the default scenario settings and no quadcopters.
+			HeadlessRunner();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Scenario Methods
+			
+			
+			
+			
+			/// Read the scenario settings from the file at the specified path.
+			/**
+			  * The method prints a message and returns FALSE if the file can't be read or
+			  * if a line can't be parsed.
+			  */
+			Bool loadScenario( const char* scenarioPath );
+			
+			
+			
+			
+			/// Override the number of simulation steps in the scenario.
+			RIM_INLINE void setStepCount( Size newNumSteps )
+			{
+				numSteps = newNumSteps;
+			}
+			
+			
+			
+			
+			/// Override the number of quadcopters, repeating the scenario's quadcopters if needed.
+			RIM_INLINE void setVehicleCount( Size newNumVehicles )
+			{
+				numVehicles = newNumVehicles;
+			}
+			
+			
+			
+			
+			/// Override the number of worker threads, where 0 uses one thread per CPU.
+			RIM_INLINE void setThreadCount( Size newNumThreads )
+			{
+				numThreads = newNumThreads;
+			}
+			
+			
+			
+			
+			/// Override the integration method, returning whether or not the name was recognized.
+			Bool setIntegrator( const char* integratorName );
+			
+			
+			
+			
+			/// Override the airframe motor layout, returning whether or not the name was recognized.
+			Bool setAirframe( const char* airframeName );
+			
+			
+			
+			
+			/// Set the path of a telemetry log that every step is recorded to, or an empty string to not record.
+			RIM_INLINE void setTelemetryPath( const data::UTF8String& newTelemetryPath )
+			{
+				telemetryPath = newTelemetryPath;
+			}
+			
+			
+			
+			
+			/// Override the capture rate of each vehicle's front and down range sensors, where 0 turns them off.
+			RIM_INLINE void setSensorRate( Float newSensorRate )
+			{
+				sensorRate = math::max( newSensorRate, Float(0) );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Run Methods
+			
+			
+			
+			
+			/// Load the scene, build or load its roadmap, and spawn and plan the quadcopters.
+			/**
+			  * The method prints a message and returns FALSE if the scene can't be loaded
+			  * or the scenario has no quadcopters.
+			  */
+			Bool initialize();
+			
+			
+			
+			
+			/// Step the simulation as fast as possible for the scenario's number of steps.
+			void run();
+			
+			
+			
+			
+			/// Print the setup times, the simulation rate, the time spent in each stage of the update, the profiler zones, and the telemetry and sensor statistics.
+			void printReport() const;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Scenario Vehicle Class Declaration
+			
+			
+			
+			
+			/// A class that stores the start and goal of a quadcopter in the scenario.
+			class ScenarioVehicle
+			{
+				public:
+					
+					RIM_INLINE ScenarioVehicle( const Vector3f& newStart, const Vector3f& newGoal )
+						:	start( newStart ),
+							goal( newGoal )
+					{
+					}
+					
+					
+					/// The initial position of the quadcopter.
+					Vector3f start;
+					
+					/// The position that the quadcopter flies to.
+					Vector3f goal;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Parse one line of a scenario file, returning whether or not it was valid.
+			Bool parseScenarioLine( const char* line );
+			
+			
+			
+			
+			/// Create a quadcopter with the standard airframe for the specified scenario vehicle.
+			Pointer<Quadcopter> newQuadcopter( const ScenarioVehicle& vehicle ) const;
+			
+			
+			
+			
+			/// Plan a path for a quadcopter to its goal on the scene roadmap. This is run by a worker thread.
+			void planToGoal( Quadcopter* quadcopter );
+			
+			
+			
+			
+			/// Plan a path for a quadcopter on a roadmap of its own, returning whether or not a path was found.
+			Bool planOnPrivateRoadmap( Quadcopter& quadcopter );
+			
+			
+			
+			
+			/// Capture the range sensor images that are due at the specified simulation time.
+			void updateSensors( Double time );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The path of the scene's OBJ mesh.
+			data::UTF8String scenePath;
+			
+			
+			/// The path of the file that caches the scene's collision tree, or an empty string.
+			data::UTF8String collisionCachePath;
+			
+			
+			/// The path of the file that caches the scene's roadmap, or an empty string.
+			data::UTF8String roadmapCachePath;
+			
+			
+			/// The bounds that the scene roadmap is sampled in.
+			AABB3f sceneBounds;
+			
+			
+			/// The number of samples in the scene roadmap.
+			Size numRoadmapSamples;
+			
+			
+			/// The fixed simulation time step in seconds.
+			Float timeStep;
+			
+			
+			/// The number of simulation steps to run.
+			Size numSteps;
+			
+			
+			/// The number of quadcopters to simulate, or 0 to use the scenario's quadcopters once.
+			Size numVehicles;
+			
+			
+			/// The number of worker threads, or 0 for one per CPU.
+			Size numThreads;
+			
+			
+			/// The random seed of the simulation.
+			UInt32 randomSeed;
+			
+			
+			/// The numerical method used to integrate the vehicle states.
+			Simulation::IntegrationMethod integrationMethod;
+			
+			
+			/// The number of motors in the standard airframe of each vehicle.
+			Size numMotors;
+			
+			
+			/// The quadcopters that are listed in the scenario.
+			ArrayList<ScenarioVehicle> vehicles;
+			
+			
+			/// The simulation that is being run.
+			Simulation simulation;
+			
+			
+			/// The quadcopters in the simulation.
+			ArrayList< Pointer<Quadcopter> > quadcopters;
+			
+			
+			/// The roadmap of the scene that is shared by all quadcopters.
+			Pointer<Roadmap> roadmap;
+			
+			
+			/// A pool of worker threads used for building the roadmap and planning paths.
+			threads::ThreadPool planningThreadPool;
+			
+			
+			/// The time spent loading the scene mesh.
+			Time sceneLoadTime;
+			
+			
+			/// The time spent loading or building the collision tree.
+			Time collisionTreeTime;
+			
+			
+			/// The time spent loading or building the scene roadmap.
+			Time roadmapTime;
+			
+			
+			/// The time spent planning the initial paths of the quadcopters.
+			Time planningTime;
+			
+			
+			/// The number of quadcopters for which a path to the goal was found.
+			Size numPlanned;
+			
+			
+			/// The total wall-clock time of the simulation steps.
+			Time runTime;
+			
+			
+			/// The path of the telemetry log that every step is recorded to, or an empty string.
+			data::UTF8String telemetryPath;
+			
+			
+			/// The recorder that writes the telemetry log.
+			TelemetryRecorder telemetryRecorder;
+
+
+			/// The capture rate of the range sensors, or 0 if the vehicles have none.
+			Float sensorRate;
+			
+			
+			/// The width of the range sensor images in pixels.
+			Size sensorWidth;
+			
+			
+			/// The height of the range sensor images in pixels.
+			Size sensorHeight;
+			
+			
+			/// The front and then the down range sensor of each quadcopter, in the same order as the quadcopters.
+			ArrayList<RangeSensor> sensors;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_HEADLESS_RUNNER_H
@@ -0,0 +1,549 @@
+/*
+ *  IncrementalPlanner.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "IncrementalPlanner.h"
+#include "Profiler.h"
+
+
+PROFILER_ZONE( planZone, "IncrementalPlanner::plan" );
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+IncrementalPlanner:: IncrementalPlanner()
+	:	numNodes( 0 ),
+		keyModifier( 0 ),
+		hasStart( false ),
+		hasGoal( false )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Roadmap Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void IncrementalPlanner:: reset( const Pointer<Roadmap>& newRoadmap )
+{
+	roadmap = newRoadmap;
+	numNodes = roadmap.isNull() ? 0 : roadmap->getNodeCount();
+	
+	// Lay out one invalid flag per edge, in the same order as the roadmap's neighbor lists.
+	edgeFlagOffsets.setSize( numNodes + 1 );
+	edgeFlagOffsets[0] = 0;
+	
+	for ( Index i = 0; i < numNodes; i++ )
+		edgeFlagOffsets[i + 1] = edgeFlagOffsets[i] + roadmap->getNode( i ).neighbors.getSize();
+	
+	invalidEdgeFlags.setSize( edgeFlagOffsets[numNodes] );
+	invalidEdgeFlags.setAll( false );
+	
+	// Reset the search state for the roadmap nodes plus the virtual start and goal vertices.
+	const Size numVertices = numNodes + 2;
+	
+	startLinkCosts.setSize( numNodes );
+	startLinkCosts.setAll( math::infinity<Float>() );
+	startLinkNodes.clear();
+	goalLinkCosts.setSize( numNodes );
+	goalLinkCosts.setAll( math::infinity<Float>() );
+	goalLinkNodes.clear();
+	
+	costs.setSize( numVertices );
+	costs.setAll( math::infinity<Float>() );
+	lookaheadCosts.setSize( numVertices );
+	lookaheadCosts.setAll( math::infinity<Float>() );
+	isOpen.setSize( numVertices );
+	isOpen.setAll( false );
+	openKeys.setSize( numVertices );
+	openSet.clear();
+	
+	keyModifier = 0;
+	hasStart = false;
+	hasGoal = false;
+	
+	// The search grows out from the goal. Its key is a lower bound until the start is known.
+	const Index goalVertex = getGoalVertex();
+	lookaheadCosts[goalVertex] = 0;
+	isOpen[goalVertex] = true;
+	openKeys[goalVertex] = Key( 0, 0 );
+	openSet.add( OpenVertex( goalVertex, openKeys[goalVertex] ) );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Endpoint Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool IncrementalPlanner:: setStart( const Vector3f& newStart )
+{
+	if ( roadmap.isNull() )
+		return false;
+	
+	if ( hasStart && newStart == startPosition )
+		return startLinkNodes.getSize() > 0;
+	
+	// Moving the start changes the heuristic of every vertex. Rather than re-keying
+	// the open set, add the distance moved to all future keys so that the old keys
+	// remain lower bounds.
+	if ( hasStart )
+		keyModifier += startPosition.getDistanceTo( newStart );
+	
+	startPosition = newStart;
+	hasStart = true;
+	
+	linkEndpoint( startPosition, startLinkCosts, startLinkNodes );
+	
+	// The start is never the successor of another vertex, so only its own lookahead cost changes.
+	updateVertex( getStartVertex() );
+	
+	return startLinkNodes.getSize() > 0;
+}
+
+
+
+
+Bool IncrementalPlanner:: setGoal( const Vector3f& newGoal )
+{
+	if ( roadmap.isNull() )
+		return false;
+	
+	if ( hasGoal && newGoal == goalPosition )
+		return goalLinkNodes.getSize() > 0;
+	
+	goalPosition = newGoal;
+	hasGoal = true;
+	
+	// Update the nodes that lose their goal link and the nodes that gain one.
+	ArrayList<Index> oldLinkNodes = goalLinkNodes;
+	linkEndpoint( goalPosition, goalLinkCosts, goalLinkNodes );
+	
+	for ( Index i = 0; i < oldLinkNodes.getSize(); i++ )
+		updateVertex( oldLinkNodes[i] );
+	
+	for ( Index i = 0; i < goalLinkNodes.getSize(); i++ )
+		updateVertex( goalLinkNodes[i] );
+	
+	return goalLinkNodes.getSize() > 0;
+}
+
+
+
+
+void IncrementalPlanner:: linkEndpoint( const Vector3f& position, Array<Float>& linkCosts, ArrayList<Index>& linkNodes )
+{
+	for ( Index i = 0; i < linkNodes.getSize(); i++ )
+		linkCosts[linkNodes[i]] = math::infinity<Float>();
+	
+	linkNodes.clear();
+	
+	// Test the visibility of the nearest candidates in one batch, as in Roadmap::rebuild().
+	const Size maxCandidates = 2*MAX_ENDPOINT_LINKS;
+	ArrayList<KDTree::Neighbor> neighbors;
+	roadmap->getNodeIndex().getKNearest( position, maxCandidates, neighbors );
+	
+	ArrayList<Roadmap::Edge> edges( neighbors.getSize() );
+	
+	for ( Index c = 0; c < neighbors.getSize(); c++ )
+		edges.add( Roadmap::Edge( position, roadmap->getNode( neighbors[c].index ).position ) );
+	
+	Array<UInt32> visibleMask;
+	roadmap->linkEdges( edges, 2.0f, visibleMask );
+	
+	for ( Index c = 0; c < neighbors.getSize() && linkNodes.getSize() < MAX_ENDPOINT_LINKS; c++ )
+	{
+		if ( Roadmap::isEdgeVisible( visibleMask, c ) )
+		{
+			linkCosts[neighbors[c].index] = math::sqrt( neighbors[c].distanceSquared );
+			linkNodes.add( neighbors[c].index );
+		}
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Edge Update Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void IncrementalPlanner:: invalidateEdge( Index node1, Index node2 )
+{
+	if ( node1 >= numNodes || node2 >= numNodes )
+		return;
+	
+	if ( !invalidateEdgeFlag( node1, node2 ) )
+		return;
+	
+	// The search can follow the edge from either end.
+	invalidateEdgeFlag( node2, node1 );
+	
+	updateVertex( node1 );
+	updateVertex( node2 );
+}
+
+
+
+
+Bool IncrementalPlanner:: invalidateEdgeFlag( Index node, Index neighbor )
+{
+	const ArrayList<Index>& neighbors = roadmap->getNode( node ).neighbors;
+	
+	for ( Index n = 0; n < neighbors.getSize(); n++ )
+	{
+		if ( neighbors[n] != neighbor )
+			continue;
+		
+		Bool& flag = invalidEdgeFlags[edgeFlagOffsets[node] + n];
+		
+		if ( flag )
+			return false;
+		
+		flag = true;
+		return true;
+	}
+	
+	return false;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Path Planning Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool IncrementalPlanner:: plan( vertices& path )
+{
+	PROFILER_SCOPE( planZone );
+	
+	path.clear();
+	
+	if ( roadmap.isNull() || !hasStart )
+		return false;
+	
+	ArrayList<Index> nodePath;
+	
+	// Each path is checked before it is returned. Invalidating a blocked edge lets the
+	// next search repair the previous one, so only the edges near the path are tested.
+	while ( findPath( nodePath ) )
+	{
+		if ( validatePath( nodePath ) )
+		{
+			path.reserve( nodePath.getSize() + 2 );
+			path.push_back( startPosition );
+			
+			for ( Index i = 0; i < nodePath.getSize(); i++ )
+				path.push_back( roadmap->getNode( nodePath[i] ).position );
+			
+			path.push_back( goalPosition );
+			
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+
+
+Bool IncrementalPlanner:: findPath( ArrayList<Index>& nodePath )
+{
+	nodePath.clear();
+	computeShortestPath();
+	
+	Index vertex = getStartVertex();
+	const Index goalVertex = getGoalVertex();
+	
+	if ( costs[vertex] == math::infinity<Float>() )
+		return false;
+	
+	// Follow the cheapest successor of each vertex until the goal is reached.
+	
+	for ( Index step = 0; vertex != goalVertex && step <= numNodes; step++ )
+	{
+		Index nextVertex = goalVertex;
+		Float nextCost = math::infinity<Float>();
+		
+		if ( vertex == getStartVertex() )
+		{
+			for ( Index i = 0; i < startLinkNodes.getSize(); i++ )
+			{
+				const Index node = startLinkNodes[i];
+				const Float cost = startLinkCosts[node] + costs[node];
+				
+				if ( cost < nextCost )
+				{
+					nextCost = cost;
+					nextVertex = node;
+				}
+			}
+		}
+		else
+		{
+			const ArrayList<Index>& neighbors = roadmap->getNode( vertex ).neighbors;
+			nextCost = goalLinkCosts[vertex];
+			
+			for ( Index n = 0; n < neighbors.getSize(); n++ )
+			{
+				const Float cost = getEdgeCost( vertex, n ) + costs[neighbors[n]];
+				
+				if ( cost < nextCost )
+				{
+					nextCost = cost;
+					nextVertex = neighbors[n];
+				}
+			}
+		}
+		
+		if ( nextCost == math::infinity<Float>() )
+			break;
+		
+		vertex = nextVertex;
+		
+		if ( vertex != goalVertex )
+			nodePath.add( vertex );
+	}
+	
+	if ( vertex != goalVertex )
+	{
+		nodePath.clear();
+		return false;
+	}
+	
+	return true;
+}
+
+
+
+
+Bool IncrementalPlanner:: validatePath( const ArrayList<Index>& nodePath )
+{
+	for ( Index i = 1; i < nodePath.getSize(); i++ )
+	{
+		const Index node = nodePath[i - 1];
+		const ArrayList<Index>& neighbors = roadmap->getNode( node ).neighbors;
+		
+		for ( Index n = 0; n < neighbors.getSize(); n++ )
+		{
+			if ( neighbors[n] == nodePath[i] )
+			{
+				if ( !roadmap->validateEdge( node, n ) )
+				{
+					invalidateEdge( node, nodePath[i] );
+					return false;
+				}
+				
+				break;
+			}
+		}
+	}
+	
+	return true;
+}
+
+
+
+
+void IncrementalPlanner:: computeShortestPath()
+{
+	const Index startVertex = getStartVertex();
+	
+	while ( true )
+	{
+		discardStaleEntries();
+		
+		if ( openSet.isEmpty() )
+			break;
+		
+		const OpenVertex top = openSet.getFirst();
+		
+		if ( !(top.key < calculateKey( startVertex )) && lookaheadCosts[startVertex] == costs[startVertex] )
+			break;
+		
+		openSet.remove();
+		isOpen[top.vertex] = false;
+		
+		const Key newKey = calculateKey( top.vertex );
+		
+		if ( top.key < newKey )
+		{
+			// The key was computed for an earlier start position, so reinsert it with the current key.
+			addOpen( top.vertex );
+		}
+		else if ( costs[top.vertex] > lookaheadCosts[top.vertex] )
+		{
+			// The vertex became cheaper, so its cost is final and its predecessors may improve.
+			costs[top.vertex] = lookaheadCosts[top.vertex];
+			updatePredecessors( top.vertex );
+		}
+		else
+		{
+			// The vertex became more expensive, so invalidate it and everything that depended on it.
+			costs[top.vertex] = math::infinity<Float>();
+			updateVertex( top.vertex );
+			updatePredecessors( top.vertex );
+		}
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void IncrementalPlanner:: updateVertex( Index vertex )
+{
+	const Index goalVertex = getGoalVertex();
+	
+	if ( vertex != goalVertex )
+	{
+		Float lookaheadCost = math::infinity<Float>();
+		
+		if ( vertex == getStartVertex() )
+		{
+			for ( Index i = 0; i < startLinkNodes.getSize(); i++ )
+			{
+				const Index node = startLinkNodes[i];
+				lookaheadCost = math::min( lookaheadCost, startLinkCosts[node] + costs[node] );
+			}
+		}
+		else
+		{
+			const ArrayList<Index>& neighbors = roadmap->getNode( vertex ).neighbors;
+			lookaheadCost = goalLinkCosts[vertex] + costs[goalVertex];
+			
+			for ( Index n = 0; n < neighbors.getSize(); n++ )
+				lookaheadCost = math::min( lookaheadCost, getEdgeCost( vertex, n ) + costs[neighbors[n]] );
+		}
+		
+		lookaheadCosts[vertex] = lookaheadCost;
+	}
+	
+	// Open entries are removed lazily, by marking the vertex closed so that its entry is skipped.
+	if ( costs[vertex] != lookaheadCosts[vertex] )
+		addOpen( vertex );
+	else
+		isOpen[vertex] = false;
+}
+
+
+
+
+void IncrementalPlanner:: updatePredecessors( Index vertex )
+{
+	if ( vertex == getGoalVertex() )
+	{
+		for ( Index i = 0; i < goalLinkNodes.getSize(); i++ )
+			updateVertex( goalLinkNodes[i] );
+	}
+	else if ( vertex < numNodes )
+	{
+		const ArrayList<Index>& neighbors = roadmap->getNode( vertex ).neighbors;
+		
+		for ( Index n = 0; n < neighbors.getSize(); n++ )
+			updateVertex( neighbors[n] );
+		
+		if ( startLinkCosts[vertex] != math::infinity<Float>() )
+			updateVertex( getStartVertex() );
+	}
+}
+
+
+
+
+void IncrementalPlanner:: addOpen( Index vertex )
+{
+	const Key key = calculateKey( vertex );
+	
+	// Don't add a duplicate entry if the vertex is already open with the same key.
+	if ( isOpen[vertex] && openKeys[vertex] == key )
+		return;
+	
+	isOpen[vertex] = true;
+	openKeys[vertex] = key;
+	openSet.add( OpenVertex( vertex, key ) );
+	
+	// Rebuild the open set if stale entries start to dominate it.
+	if ( openSet.getSize() > 4*(numNodes + 2) )
+	{
+		openSet.clear();
+		
+		for ( Index v = 0; v < numNodes + 2; v++ )
+		{
+			if ( isOpen[v] )
+				openSet.add( OpenVertex( v, openKeys[v] ) );
+		}
+	}
+}
+
+
+
+
+void IncrementalPlanner:: discardStaleEntries()
+{
+	while ( !openSet.isEmpty() )
+	{
+		const OpenVertex& top = openSet.getFirst();
+		
+		if ( isOpen[top.vertex] && openKeys[top.vertex] == top.key )
+			break;
+		
+		openSet.remove();
+	}
+}
@@ -0,0 +1,487 @@
+/*
+ *  IncrementalPlanner.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_INCREMENTAL_PLANNER_H
+#define INCLUDE_INCREMENTAL_PLANNER_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "Roadmap.h"
+#include "Global_planner.h"
+
+
+
+
+/// A class that plans paths through a Roadmap and repairs them as the endpoints or edges change.
+/**
+  * The planner uses the D* Lite algorithm. The search is rooted at the goal, and the
+  * cost-to-goal of each roadmap node is kept between queries. The roadmap itself is
+  * only read, so one roadmap can be shared by the planners of many vehicles. The start and goal
+  * positions are not roadmap nodes. They are virtual vertices that are linked to
+  * their nearest visible roadmap nodes. Moving the start or goal, or invalidating
+  * a roadmap edge, only changes the costs of a few edges. The next query then repairs
+  * the previous search locally instead of searching the whole roadmap again.
+  *
+  * On a lazy roadmap, the edges of each path are validated before the path is returned,
+  * and each blocked edge is invalidated so that the next search repairs around it.
+  */
+class IncrementalPlanner
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new incremental planner that has no roadmap.
+			IncrementalPlanner();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Roadmap Accessor Methods
+			
+			
+			
+			
+			/// Return a pointer to the roadmap that this planner searches.
+			RIM_INLINE const Pointer<Roadmap>& getRoadmap() const
+			{
+				return roadmap;
+			}
+			
+			
+			
+			
+			/// Start planning on the specified roadmap, discarding all previous search state.
+			/**
+			  * This method must be called again whenever the roadmap's nodes or
+			  * connectivity are rebuilt. The start and goal must then be set again.
+			  */
+			void reset( const Pointer<Roadmap>& newRoadmap );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Endpoint Accessor Methods
+			
+			
+			
+			
+			/// Return the current start position of the planner.
+			RIM_INLINE const Vector3f& getStart() const
+			{
+				return startPosition;
+			}
+			
+			
+			
+			
+			/// Move the start position, linking it to its nearest visible roadmap nodes.
+			/**
+			  * If the start hasn't moved, the previous links are kept. The method returns
+			  * whether or not the start could be linked to any roadmap node.
+			  */
+			Bool setStart( const Vector3f& newStart );
+			
+			
+			
+			
+			/// Return the current goal position of the planner.
+			RIM_INLINE const Vector3f& getGoal() const
+			{
+				return goalPosition;
+			}
+			
+			
+			
+			
+			/// Move the goal position, linking it to its nearest visible roadmap nodes.
+			/**
+			  * If the goal hasn't moved, the previous links are kept. The method returns
+			  * whether or not the goal could be linked to any roadmap node.
+			  */
+			Bool setGoal( const Vector3f& newGoal );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Edge Update Methods
+			
+			
+			
+			
+			/// Mark the roadmap edge between two nodes as impassable.
+			/**
+			  * This is used when an obstacle is found to block an edge. The edge
+			  * stays blocked until the planner is reset.
+			  */
+			void invalidateEdge( Index node1, Index node2 );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Path Planning Methods
+			
+			
+			
+			
+			/// Update the search for the current start, goal and edge costs, and output the shortest path.
+			/**
+			  * The path starts at the start position and ends at the goal position, with
+			  * the roadmap node positions in between. The method returns FALSE and outputs
+			  * an empty path if the goal is not reachable.
+			  */
+			Bool plan( vertices& path );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Static Data Members
+			
+			
+			
+			
+			/// The maximum number of roadmap nodes that the start or goal is linked to.
+			static const Size MAX_ENDPOINT_LINKS = 10;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Key Class Declaration
+			
+			
+			
+			
+			/// A class that stores the priority of a vertex in the open set.
+			class Key
+			{
+				public:
+					
+					RIM_INLINE Key()
+						:	first( 0 ),
+							second( 0 )
+					{
+					}
+					
+					
+					RIM_INLINE Key( Float newFirst, Float newSecond )
+						:	first( newFirst ),
+							second( newSecond )
+					{
+					}
+					
+					
+					/// Return whether or not this key has a lower value than another, comparing lexicographically.
+					RIM_INLINE Bool operator < ( const Key& other ) const
+					{
+						return first < other.first || (first == other.first && second < other.second);
+					}
+					
+					
+					/// Return whether or not this key is equal to another.
+					RIM_INLINE Bool operator == ( const Key& other ) const
+					{
+						return first == other.first && second == other.second;
+					}
+					
+					
+					/// The estimated cost of a path through the vertex.
+					Float first;
+					
+					/// The cost-to-goal of the vertex, used to break ties.
+					Float second;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Open Vertex Class Declaration
+			
+			
+			
+			
+			/// A class that stores a vertex in the open set along with its key when it was added.
+			class OpenVertex
+			{
+				public:
+					
+					RIM_INLINE OpenVertex( Index newVertex, const Key& newKey )
+						:	vertex( newVertex ),
+							key( newKey )
+					{
+					}
+					
+					
+					/// Return whether or not this vertex has a higher priority than another.
+					/**
+					  * The priority queue keeps its largest element first, so the comparison
+					  * is inverted to pop the vertex with the smallest key first.
+					  */
+					RIM_INLINE Bool operator < ( const OpenVertex& other ) const
+					{
+						return other.key < key;
+					}
+					
+					
+					/// The index of the vertex.
+					Index vertex;
+					
+					/// The key of the vertex when it was added to the open set.
+					Key key;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Return the index of the virtual start vertex, which comes after the roadmap nodes.
+			RIM_INLINE Index getStartVertex() const
+			{
+				return numNodes;
+			}
+			
+			
+			
+			
+			/// Return the index of the virtual goal vertex, which comes after the start vertex.
+			RIM_INLINE Index getGoalVertex() const
+			{
+				return numNodes + 1;
+			}
+			
+			
+			
+			
+			/// Return the position of the specified vertex.
+			RIM_INLINE const Vector3f& getPosition( Index vertex ) const
+			{
+				if ( vertex < numNodes )
+					return roadmap->getNode( vertex ).position;
+				else if ( vertex == getStartVertex() )
+					return startPosition;
+				else
+					return goalPosition;
+			}
+			
+			
+			
+			
+			/// Compute the current key of the specified vertex.
+			RIM_INLINE Key calculateKey( Index vertex ) const
+			{
+				const Float cost = math::min( costs[vertex], lookaheadCosts[vertex] );
+				
+				return Key( cost + startPosition.getDistanceTo( getPosition( vertex ) ) + keyModifier, cost );
+			}
+			
+			
+			
+			
+			/// Return the cost of the edge from a roadmap node to the neighbor at the specified index, or infinity if it was invalidated.
+			RIM_INLINE Float getEdgeCost( Index node, Index neighborIndex ) const
+			{
+				if ( invalidEdgeFlags[edgeFlagOffsets[node] + neighborIndex] )
+					return math::infinity<Float>();
+				
+				const Roadmap::Node& roadmapNode = roadmap->getNode( node );
+				
+				return roadmapNode.position.getDistanceTo( roadmap->getNode( roadmapNode.neighbors[neighborIndex] ).position );
+			}
+			
+			
+			
+			
+			/// Mark the edge from a roadmap node to another node as invalid, returning whether or not the edge exists and was valid.
+			Bool invalidateEdgeFlag( Index node, Index neighbor );
+			
+			
+			
+			
+			/// Find the visible roadmap nodes near a position and store their link costs.
+			void linkEndpoint( const Vector3f& position, Array<Float>& linkCosts, ArrayList<Index>& linkNodes );
+			
+			
+			
+			
+			/// Recompute the one-step lookahead cost of a vertex and update its membership in the open set.
+			void updateVertex( Index vertex );
+			
+			
+			
+			
+			/// Update the vertices whose lookahead costs depend on the cost of the specified vertex.
+			void updatePredecessors( Index vertex );
+			
+			
+			
+			
+			/// Add a vertex to the open set with its current key.
+			void addOpen( Index vertex );
+			
+			
+			
+			
+			/// Remove the stale entries from the front of the open set.
+			void discardStaleEntries();
+			
+			
+			
+			
+			/// Expand vertices until the start vertex's cost is consistent.
+			void computeShortestPath();
+			
+			
+			
+			
+			/// Update the search and output the roadmap nodes along the cheapest path from the start to the goal.
+			/**
+			  * The method returns FALSE and outputs an empty list if the goal is not reachable.
+			  */
+			Bool findPath( ArrayList<Index>& nodePath );
+			
+			
+			
+			
+			/// Validate the roadmap edges along a path, invalidating the first edge that is blocked.
+			/**
+			  * The method returns whether or not every edge of the path is valid.
+			  */
+			Bool validatePath( const ArrayList<Index>& nodePath );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// A pointer to the roadmap that is being searched.
+			Pointer<Roadmap> roadmap;
+			
+			
+			/// The number of nodes in the roadmap when the planner was reset.
+			Size numNodes;
+			
+			
+			/// The index of the first edge flag of each roadmap node, followed by the total number of flags.
+			Array<Index> edgeFlagOffsets;
+			
+			
+			/// Whether or not each roadmap edge has been invalidated since the last reset, in the order of each node's neighbors.
+			Array<Bool> invalidEdgeFlags;
+			
+			
+			/// The cost of the link from the start to each roadmap node, or infinity if there is no link.
+			Array<Float> startLinkCosts;
+			
+			
+			/// The roadmap nodes that the start is linked to.
+			ArrayList<Index> startLinkNodes;
+			
+			
+			/// The cost of the link from each roadmap node to the goal, or infinity if there is no link.
+			Array<Float> goalLinkCosts;
+			
+			
+			/// The roadmap nodes that the goal is linked to.
+			ArrayList<Index> goalLinkNodes;
+			
+			
+			/// The current cost-to-goal of each vertex.
+			Array<Float> costs;
+			
+			
+			/// The one-step lookahead cost-to-goal of each vertex, based on the costs of its successors.
+			Array<Float> lookaheadCosts;
+			
+			
+			/// Whether or not each vertex is currently in the open set.
+			Array<Bool> isOpen;
+			
+			
+			/// The key of each open vertex. Open set entries with a different key are stale.
+			Array<Key> openKeys;
+			
+			
+			/// The open set of the search, ordered by increasing key.
+			PriorityQueue<OpenVertex> openSet;
+			
+			
+			/// The current start position.
+			Vector3f startPosition;
+			
+			
+			/// The current goal position.
+			Vector3f goalPosition;
+			
+			
+			/// The sum of the distances that the start has moved, which is added to all new keys.
+			Float keyModifier;
+			
+			
+			/// Whether or not the start position has been set since the last reset.
+			Bool hasStart;
+			
+			
+			/// Whether or not the goal position has been set since the last reset.
+			Bool hasGoal;
+
+
+};
+
+
+
+
+#endif // INCLUDE_INCREMENTAL_PLANNER_H
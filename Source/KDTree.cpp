@@ -0,0 +1,265 @@
+/*
+ *  KDTree.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "KDTree.h"
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+KDTree:: KDTree()
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Build Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void KDTree:: build( const ArrayList<Vector3f>& newPoints )
+{
+	const Size numPoints = newPoints.getSize();
+	points.clear();
+	
+	for ( Index i = 0; i < numPoints; i++ )
+		points.add( Point( newPoints[i], i ) );
+	
+	buildRecursive( 0, numPoints );
+}
+
+
+
+
+void KDTree:: clear()
+{
+	points.clear();
+}
+
+
+
+
+void KDTree:: buildRecursive( Index start, Index end )
+{
+	if ( end - start <= 1 )
+		return;
+	
+	// Split the range along the axis where it has the largest extent.
+	AABB3f bounds( points[start].position );
+	
+	for ( Index i = start + 1; i < end; i++ )
+		bounds.enlargeFor( points[i].position );
+	
+	const Vector3f extent = bounds.max - bounds.min;
+	Index axis = 0;
+	
+	if ( extent.y > extent[axis] )
+		axis = 1;
+	
+	if ( extent.z > extent[axis] )
+		axis = 2;
+	
+	const Index median = (start + end) / 2;
+	selectMedian( start, end, median, axis );
+	points[median].axis = axis;
+	
+	buildRecursive( start, median );
+	buildRecursive( median + 1, end );
+}
+
+
+
+
+void KDTree:: selectMedian( Index start, Index end, Index median, Index axis )
+{
+	// Hoare's quickselect, using the middle element as the pivot.
+	Index left = start;
+	Index right = end - 1;
+	
+	while ( left < right )
+	{
+		const Float pivot = points[(left + right) / 2].position[axis];
+		Index i = left;
+		Index j = right;
+		
+		while ( i <= j )
+		{
+			while ( points[i].position[axis] < pivot )
+				i++;
+			
+			while ( points[j].position[axis] > pivot )
+				j--;
+			
+			if ( i <= j )
+			{
+				const Point temp = points[i];
+				points[i] = points[j];
+				points[j] = temp;
+				i++;
+				
+				if ( j == 0 )
+					break;
+				
+				j--;
+			}
+		}
+		
+		if ( median <= j )
+			right = j;
+		else if ( median >= i )
+			left = i;
+		else
+			break;
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Query Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool KDTree:: getNearest( const Vector3f& query, Index& nearestIndex ) const
+{
+	if ( points.getSize() == 0 )
+		return false;
+	
+	ArrayList<Neighbor> neighbors( 1 );
+	getKNearestRecursive( 0, points.getSize(), query, 1, neighbors );
+	nearestIndex = neighbors[0].index;
+	
+	return true;
+}
+
+
+
+
+void KDTree:: getKNearest( const Vector3f& query, Size k, ArrayList<Neighbor>& neighbors ) const
+{
+	neighbors.clear();
+	
+	if ( k == 0 )
+		return;
+	
+	getKNearestRecursive( 0, points.getSize(), query, k, neighbors );
+}
+
+
+
+
+void KDTree:: getWithinRadius( const Vector3f& query, Float radius, ArrayList<Neighbor>& neighbors ) const
+{
+	neighbors.clear();
+	getWithinRadiusRecursive( 0, points.getSize(), query, radius*radius, neighbors );
+}
+
+
+
+
+void KDTree:: getKNearestRecursive( Index start, Index end, const Vector3f& query, Size k,
+									ArrayList<Neighbor>& neighbors ) const
+{
+	if ( start >= end )
+		return;
+	
+	const Index median = (start + end) / 2;
+	const Point& point = points[median];
+	
+	const Float distanceSquared = point.position.getDistanceToSquared( query );
+	
+	if ( neighbors.getSize() < k || distanceSquared < neighbors.getLast().distanceSquared )
+		insertNeighbor( neighbors, Neighbor( point.index, distanceSquared ), k );
+	
+	// Visit the side of the split that contains the query first.
+	const Float planeDistance = query[point.axis] - point.position[point.axis];
+	
+	if ( planeDistance < Float(0) )
+	{
+		getKNearestRecursive( start, median, query, k, neighbors );
+		
+		if ( neighbors.getSize() < k || planeDistance*planeDistance < neighbors.getLast().distanceSquared )
+			getKNearestRecursive( median + 1, end, query, k, neighbors );
+	}
+	else
+	{
+		getKNearestRecursive( median + 1, end, query, k, neighbors );
+		
+		if ( neighbors.getSize() < k || planeDistance*planeDistance < neighbors.getLast().distanceSquared )
+			getKNearestRecursive( start, median, query, k, neighbors );
+	}
+}
+
+
+
+
+void KDTree:: getWithinRadiusRecursive( Index start, Index end, const Vector3f& query, Float radiusSquared,
+										ArrayList<Neighbor>& neighbors ) const
+{
+	if ( start >= end )
+		return;
+	
+	const Index median = (start + end) / 2;
+	const Point& point = points[median];
+	
+	const Float distanceSquared = point.position.getDistanceToSquared( query );
+	
+	if ( distanceSquared <= radiusSquared )
+		insertNeighbor( neighbors, Neighbor( point.index, distanceSquared ), math::max<Size>() );
+	
+	const Float planeDistance = query[point.axis] - point.position[point.axis];
+	
+	if ( planeDistance < Float(0) || planeDistance*planeDistance <= radiusSquared )
+		getWithinRadiusRecursive( start, median, query, radiusSquared, neighbors );
+	
+	if ( planeDistance >= Float(0) || planeDistance*planeDistance <= radiusSquared )
+		getWithinRadiusRecursive( median + 1, end, query, radiusSquared, neighbors );
+}
+
+
+
+
+void KDTree:: insertNeighbor( ArrayList<Neighbor>& neighbors, const Neighbor& neighbor, Size maxNeighbors )
+{
+	// Find the insertion point, searching from the back since most candidates are far away.
+	Index i = neighbors.getSize();
+	
+	while ( i > 0 && neighbor < neighbors[i - 1] )
+		i--;
+	
+	if ( i >= maxNeighbors )
+		return;
+	
+	if ( neighbors.getSize() == maxNeighbors )
+		neighbors.removeLast();
+	
+	neighbors.insert( i, neighbor );
+}
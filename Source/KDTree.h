@@ -0,0 +1,249 @@
+/*
+ *  KDTree.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_KD_TREE_H
+#define INCLUDE_KD_TREE_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+
+
+/// A class that provides fast nearest-neighbor queries over a static set of 3D points.
+/**
+  * The tree is stored implicitly in a single array: the point at the middle of each
+  * index range is the splitting point for that range, and the halves of the range
+  * on either side are its children. The splitting axis is the axis of largest extent
+  * for each range, so the tree stays balanced and needs no per-node pointers.
+  */
+class KDTree
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Neighbor Class Declaration
+			
+			
+			
+			
+			/// A class that stores the result of a nearest-neighbor query.
+			class Neighbor
+			{
+				public:
+					
+					/// Create a new neighbor with the specified point index and squared distance.
+					RIM_INLINE Neighbor( Index newIndex, Float newDistanceSquared )
+						:	index( newIndex ),
+							distanceSquared( newDistanceSquared )
+					{
+					}
+					
+					
+					/// Return whether or not this neighbor is closer than another.
+					RIM_INLINE Bool operator < ( const Neighbor& other ) const
+					{
+						return distanceSquared < other.distanceSquared;
+					}
+					
+					
+					/// The index of the neighboring point in the point list that the tree was built from.
+					Index index;
+					
+					/// The squared distance from the query point to the neighboring point.
+					Float distanceSquared;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new empty k-d tree.
+			KDTree();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Build Methods
+			
+			
+			
+			
+			/// Rebuild this k-d tree for the specified list of points.
+			/**
+			  * The query results refer to points by their index in this list.
+			  */
+			void build( const ArrayList<Vector3f>& newPoints );
+			
+			
+			
+			
+			/// Remove all points from this k-d tree.
+			void clear();
+			
+			
+			
+			
+			/// Return the number of points that are stored in this k-d tree.
+			RIM_INLINE Size getPointCount() const
+			{
+				return points.getSize();
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Query Methods
+			
+			
+			
+			
+			/// Find the point that is closest to the query point.
+			/**
+			  * The method returns FALSE if the tree is empty.
+			  */
+			Bool getNearest( const Vector3f& query, Index& nearestIndex ) const;
+			
+			
+			
+			
+			/// Find the k points that are closest to the query point.
+			/**
+			  * The neighbors are written to the output list in ascending order of
+			  * distance. The previous contents of the list are replaced.
+			  */
+			void getKNearest( const Vector3f& query, Size k, ArrayList<Neighbor>& neighbors ) const;
+			
+			
+			
+			
+			/// Find all of the points that are within the specified radius of the query point.
+			/**
+			  * The neighbors are written to the output list in ascending order of
+			  * distance. The previous contents of the list are replaced.
+			  */
+			void getWithinRadius( const Vector3f& query, Float radius, ArrayList<Neighbor>& neighbors ) const;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Point Class Declaration
+			
+			
+			
+			
+			/// A class that stores a point in the tree along with the axis that it splits.
+			class Point
+			{
+				public:
+					
+					RIM_INLINE Point( const Vector3f& newPosition, Index newIndex )
+						:	position( newPosition ),
+							index( newIndex ),
+							axis( 0 )
+					{
+					}
+					
+					
+					/// The position of this point.
+					Vector3f position;
+					
+					/// The index of this point in the list that the tree was built from.
+					Index index;
+					
+					/// The axis which this point splits its subtree along.
+					Index axis;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Recursively build the subtree for the points in the range [start, end).
+			void buildRecursive( Index start, Index end );
+			
+			
+			
+			
+			/// Partially sort the range [start, end) so that the median point along the axis is at its middle.
+			void selectMedian( Index start, Index end, Index median, Index axis );
+			
+			
+			
+			
+			/// Recursively find the k nearest points in the subtree for the range [start, end).
+			void getKNearestRecursive( Index start, Index end, const Vector3f& query, Size k,
+										ArrayList<Neighbor>& neighbors ) const;
+			
+			
+			
+			
+			/// Recursively find the points within the squared radius in the subtree for the range [start, end).
+			void getWithinRadiusRecursive( Index start, Index end, const Vector3f& query, Float radiusSquared,
+											ArrayList<Neighbor>& neighbors ) const;
+			
+			
+			
+			
+			/// Insert a neighbor into a list sorted by distance, keeping at most the specified number of neighbors.
+			static void insertNeighbor( ArrayList<Neighbor>& neighbors, const Neighbor& neighbor, Size maxNeighbors );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The points in the tree, stored in implicit tree order.
+			ArrayList<Point> points;
+
+
+};
+
+
+
+
+#endif // INCLUDE_KD_TREE_H
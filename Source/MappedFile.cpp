@@ -0,0 +1,206 @@
+/*
+ *  MappedFile.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "MappedFile.h"
+
+
+#if defined(RIM_PLATFORM_WINDOWS)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+MappedFile:: MappedFile()
+	:	mappedData( NULL ),
+		size( 0 )
+#if defined(RIM_PLATFORM_WINDOWS)
+		,fileHandle( NULL ),
+		mappingHandle( NULL )
+#endif
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Destructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+MappedFile:: ~MappedFile()
+{
+	close();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		File Mapping Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+#if defined(RIM_PLATFORM_WINDOWS)
+
+
+
+
+Bool MappedFile:: open( const data::UTF8String& filePath )
+{
+	close();
+	
+	HANDLE file = CreateFileA( (const char*)filePath.getCString(), GENERIC_READ, FILE_SHARE_READ, NULL,
+								OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL );
+	
+	if ( file == INVALID_HANDLE_VALUE )
+		return false;
+	
+	LARGE_INTEGER fileSize;
+	
+	if ( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart <= 0 ||
+		UInt64(fileSize.QuadPart) > UInt64(math::max<Size>()) )
+	{
+		CloseHandle( file );
+		return false;
+	}
+	
+	HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	
+	if ( mapping == NULL )
+	{
+		CloseHandle( file );
+		return false;
+	}
+	
+	const void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	
+	if ( view == NULL )
+	{
+		CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+	
+	fileHandle = file;
+	mappingHandle = mapping;
+	mappedData = (const UByte*)view;
+	size = Size(fileSize.QuadPart);
+	
+	return true;
+}
+
+
+
+
+void MappedFile:: close()
+{
+	if ( mappedData != NULL )
+		UnmapViewOfFile( mappedData );
+	
+	if ( mappingHandle != NULL )
+		CloseHandle( (HANDLE)mappingHandle );
+	
+	if ( fileHandle != NULL )
+		CloseHandle( (HANDLE)fileHandle );
+	
+	mappedData = NULL;
+	size = 0;
+	mappingHandle = NULL;
+	fileHandle = NULL;
+}
+
+
+
+
+#else // POSIX
+
+
+
+
+Bool MappedFile:: open( const data::UTF8String& filePath )
+{
+	close();
+	
+	const int file = ::open( (const char*)filePath.getCString(), O_RDONLY );
+	
+	if ( file < 0 )
+		return false;
+	
+	struct stat fileStatus;
+	
+	if ( fstat( file, &fileStatus ) != 0 || fileStatus.st_size <= 0 ||
+		UInt64(fileStatus.st_size) > UInt64(math::max<Size>()) )
+	{
+		::close( file );
+		return false;
+	}
+	
+	void* view = mmap( NULL, Size(fileStatus.st_size), PROT_READ, MAP_PRIVATE, file, 0 );
+	
+	// The mapping keeps its own reference to the file, so the descriptor isn't needed anymore.
+	::close( file );
+	
+	if ( view == MAP_FAILED )
+		return false;
+	
+	mappedData = (const UByte*)view;
+	size = Size(fileStatus.st_size);
+	
+	return true;
+}
+
+
+
+
+void MappedFile:: close()
+{
+	if ( mappedData != NULL )
+		munmap( (void*)mappedData, size );
+	
+	mappedData = NULL;
+	size = 0;
+}
+
+
+
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ *  MappedFile.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_MAPPED_FILE_H
+#define INCLUDE_MAPPED_FILE_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+
+
+
+
+/// A class that maps the contents of a file into memory for reading.
+/**
+  * The operating system pages the file in on demand, so opening a large file
+  * is nearly free and its contents can be read in place without copying them
+  * into a separate buffer. The mapping is read-only.
+  */
+class MappedFile
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new mapped file object that doesn't have a file open.
+			MappedFile();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Destructor
+			
+			
+			
+			
+			/// Destroy a mapped file object, unmapping its file if it is open.
+			~MappedFile();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	File Mapping Methods
+			
+			
+			
+			
+			/// Map the file at the specified path into memory, closing any previously open file.
+			/**
+			  * The method returns whether or not the file was successfully mapped.
+			  * Empty files can't be mapped.
+			  */
+			Bool open( const data::UTF8String& filePath );
+			
+			
+			
+			
+			/// Unmap the current file, if there is one.
+			void close();
+			
+			
+			
+			
+			/// Return whether or not a file is currently mapped.
+			RIM_INLINE Bool isOpen() const
+			{
+				return mappedData != NULL;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Data Accessor Methods
+			
+			
+			
+			
+			/// Return a pointer to the start of the mapped file's contents, or NULL if no file is open.
+			RIM_INLINE const UByte* getData() const
+			{
+				return mappedData;
+			}
+			
+			
+			
+			
+			/// Return the size in bytes of the mapped file.
+			RIM_INLINE Size getSize() const
+			{
+				return size;
+			}
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Copy Operations
+			
+			
+			
+			
+			/// Declared but not defined so that a mapping can't be copied and unmapped twice.
+			MappedFile( const MappedFile& other );
+			
+			
+			/// Declared but not defined so that a mapping can't be copied and unmapped twice.
+			MappedFile& operator = ( const MappedFile& other );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// A pointer to the start of the mapped file's contents.
+			const UByte* mappedData;
+			
+			
+			/// The size in bytes of the mapped file.
+			Size size;
+
+
+#if defined(RIM_PLATFORM_WINDOWS)
+			/// The handle of the open file.
+			void* fileHandle;
+			
+			
+			/// The handle of the file mapping object.
+			void* mappingHandle;
+#endif
+
+
+};
+
+
+
+
+#endif // INCLUDE_MAPPED_FILE_H
@@ -0,0 +1,367 @@
+/*
+ *  MeshPrimitiveSet.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "MeshPrimitiveSet.h"
+
+
+/// The initial value of the 64-bit FNV-1a hash.
+static const UInt64 FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Helper Functions
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+/// Hash the bytes of the specified data using the 64-bit FNV-1a hash.
+static UInt64 hashBytes( const UByte* bytes, Size numBytes, UInt64 hash = FNV_OFFSET_BASIS )
+{
+	for ( Index i = 0; i < numBytes; i++ )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	
+	return hash;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+MeshPrimitiveSet:: MeshPrimitiveSet( const Pointer<GenericMeshShape>& newMesh )
+	:	mesh( newMesh ),
+		numTriangles( 0 )
+{
+	if ( mesh.isNull() )
+		return;
+	
+	for ( Index g = 0; g < mesh->getGroupCount(); g++ )
+	{
+		const Pointer<GenericMeshGroup>& meshGroup = mesh->getGroup(g);
+		const BufferRange& bufferRange = meshGroup->getBufferRange();
+		
+		if ( bufferRange.getPrimitiveType() != IndexedPrimitiveType::TRIANGLES )
+			continue;
+		
+		Pointer<GenericBuffer> positionBuffer = meshGroup->getVertexBuffers()->getBufferWithUsage( VertexUsage::POSITION );
+		
+		if ( positionBuffer.isNull() || !positionBuffer->hasData() ||
+			positionBuffer->getAttributeType() != AttributeType::get<Vector3f>() )
+			continue;
+		
+		Group group;
+		group.positions = (const Vector3f*)positionBuffer->getPointer();
+		group.numVertices = positionBuffer->getSize();
+		group.indices = NULL;
+		group.shortIndices = false;
+		group.firstVertex = 0;
+		group.firstTriangle = numTriangles;
+		
+		// The group's range selects the indices that it uses, or its vertices if it has no index buffer.
+		const Pointer<GenericBuffer>& indexBuffer = meshGroup->getIndexBuffer();
+		const Index rangeStart = bufferRange.getStartIndex();
+		Size rangeSize = bufferRange.getVertexCount();
+		
+		if ( indexBuffer.isNull() )
+		{
+			if ( rangeStart >= group.numVertices )
+				continue;
+			
+			group.firstVertex = rangeStart;
+			rangeSize = math::min( rangeSize, group.numVertices - rangeStart );
+		}
+		else
+		{
+			const AttributeType& indexType = indexBuffer->getAttributeType();
+			
+			if ( indexType == AttributeType::get<UInt16>() )
+				group.shortIndices = true;
+			else if ( indexType != AttributeType::get<UInt32>() )
+				continue;
+			
+			if ( rangeStart >= indexBuffer->getSize() )
+				continue;
+			
+			group.indices = (const UByte*)indexBuffer->getPointer() + rangeStart*indexType.getSizeInBytes();
+			rangeSize = math::min( rangeSize, indexBuffer->getSize() - rangeStart );
+		}
+		
+		group.numTriangles = rangeSize / 3;
+		
+		if ( group.numTriangles == 0 || !validateIndices( group ) )
+			continue;
+		
+		groups.add( group );
+		numTriangles += group.numTriangles;
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Attribute Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Size MeshPrimitiveSet:: getSize() const
+{
+	return numTriangles;
+}
+
+
+
+
+bvh::PrimitiveInterfaceType MeshPrimitiveSet:: getType() const
+{
+	return bvh::PrimitiveInterfaceType::TRIANGLES;
+}
+
+
+
+
+UInt64 MeshPrimitiveSet:: getContentHash() const
+{
+	UInt64 hash = FNV_OFFSET_BASIS;
+	
+	for ( Index g = 0; g < groups.getSize(); g++ )
+	{
+		const Group& group = groups[g];
+		const Size numIndices = 3*group.numTriangles;
+		
+		hash = hashBytes( (const UByte*)group.positions, sizeof(Vector3f)*group.numVertices, hash );
+		
+		if ( group.indices == NULL )
+		{
+			const UInt64 range[2] = { UInt64(group.firstVertex), UInt64(numIndices) };
+			hash = hashBytes( (const UByte*)range, sizeof(range), hash );
+		}
+		else
+		{
+			const Size indexSize = group.shortIndices ? sizeof(UInt16) : sizeof(UInt32);
+			hash = hashBytes( (const UByte*)group.indices, indexSize*numIndices, hash );
+		}
+	}
+	
+	return hash;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Bounding Volume Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+AABB3f MeshPrimitiveSet:: getAABB( Index primitiveIndex ) const
+{
+	Vector3f v0, v1, v2;
+	getTriangle( primitiveIndex, v0, v1, v2 );
+	
+	AABB3f result( v0 );
+	result.enlargeFor( v1 );
+	result.enlargeFor( v2 );
+	
+	return result;
+}
+
+
+
+
+bvh::BoundingSphere<Float> MeshPrimitiveSet:: getBoundingSphere( Index primitiveIndex ) const
+{
+	Vector3f v0, v1, v2;
+	getTriangle( primitiveIndex, v0, v1, v2 );
+	
+	return bvh::BoundingSphere<Float>( v0, v1, v2 );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Intersections Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool MeshPrimitiveSet:: intersectRay( Index primitiveIndex, const Ray3f& ray, Float& distance ) const
+{
+	Vector3f v0, v1, v2;
+	
+	if ( !getTriangle( primitiveIndex, v0, v1, v2 ) )
+		return false;
+	
+	const Vector3f edge1 = v1 - v0;
+	const Vector3f edge2 = v2 - v0;
+	const Vector3f p = math::cross( ray.direction, edge2 );
+	const Float determinant = math::dot( edge1, p );
+	
+	if ( math::abs( determinant ) < math::epsilon<Float>() )
+		return false;
+	
+	const Float inverseDeterminant = Float(1) / determinant;
+	const Vector3f s = ray.origin - v0;
+	const Float u = math::dot( s, p )*inverseDeterminant;
+	
+	if ( u < Float(0) || u > Float(1) )
+		return false;
+	
+	const Vector3f q = math::cross( s, edge1 );
+	const Float v = math::dot( ray.direction, q )*inverseDeterminant;
+	
+	if ( v < Float(0) || u + v > Float(1) )
+		return false;
+	
+	const Float t = math::dot( edge2, q )*inverseDeterminant;
+	
+	if ( t < Float(0) )
+		return false;
+	
+	distance = t;
+	
+	return true;
+}
+
+
+
+
+Bool MeshPrimitiveSet:: intersectRay( const Index* primitiveIndices, Size numPrimitives,
+									const Ray3f& ray, Float& distance, Index& closestPrimitive ) const
+{
+	Bool hit = false;
+	
+	for ( Index i = 0; i < numPrimitives; i++ )
+	{
+		Float t;
+		
+		if ( intersectRay( primitiveIndices[i], ray, t ) && (!hit || t < distance) )
+		{
+			distance = t;
+			closestPrimitive = primitiveIndices[i];
+			hit = true;
+		}
+	}
+	
+	return hit;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Concrete-Type Primitive Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool MeshPrimitiveSet:: getTriangle( Index index, Vector3f& v0, Vector3f& v1, Vector3f& v2 ) const
+{
+	if ( index >= numTriangles )
+		return false;
+	
+	const Group& group = getGroup( index );
+	const Index corner = 3*(index - group.firstTriangle);
+	
+	v0 = group.positions[getVertexIndex( group, corner )];
+	v1 = group.positions[getVertexIndex( group, corner + 1 )];
+	v2 = group.positions[getVertexIndex( group, corner + 2 )];
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+const MeshPrimitiveSet::Group& MeshPrimitiveSet:: getGroup( Index primitiveIndex ) const
+{
+	// Find the last group whose first triangle is not after the primitive.
+	Index low = 0;
+	Index high = groups.getSize() - 1;
+	
+	while ( low < high )
+	{
+		const Index middle = (low + high + 1) / 2;
+		
+		if ( groups[middle].firstTriangle <= primitiveIndex )
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	
+	return groups[low];
+}
+
+
+
+
+Bool MeshPrimitiveSet:: validateIndices( const Group& group )
+{
+	const Size numIndices = 3*group.numTriangles;
+	
+	for ( Index i = 0; i < numIndices; i++ )
+	{
+		if ( getVertexIndex( group, i ) >= group.numVertices )
+			return false;
+	}
+	
+	return true;
+}
@@ -0,0 +1,238 @@
+/*
+ *  MeshPrimitiveSet.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_MESH_PRIMITIVE_SET_H
+#define INCLUDE_MESH_PRIMITIVE_SET_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+using namespace rim::graphics;
+
+
+
+
+/// A primitive interface to the triangles of a generic mesh that reads the mesh's buffers in place.
+/**
+  * Each triangle group of the mesh is referenced by its position and index buffers,
+  * which may use either 16-bit or 32-bit indices. Nothing is copied, so a BVH can be
+  * built over a large mesh without a second copy of its geometry. The mesh is kept
+  * alive by this object and must not be modified while it is in use.
+  */
+class MeshPrimitiveSet : public bvh::PrimitiveInterface
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new primitive set for the triangle groups of the specified mesh.
+			/**
+			  * Groups that don't contain triangles, don't have 3-component float positions,
+			  * or reference vertices outside of their position buffer are skipped.
+			  */
+			MeshPrimitiveSet( const Pointer<GenericMeshShape>& newMesh );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Attribute Accessor Methods
+			
+			
+			
+			
+			/// Return the number of triangles in this primitive set.
+			virtual Size getSize() const;
+			
+			
+			
+			
+			/// Return that this primitive set contains triangles.
+			virtual bvh::PrimitiveInterfaceType getType() const;
+			
+			
+			
+			
+			/// Return a hash of the positions and indices of every triangle group in the mesh.
+			/**
+			  * The hash is computed from the raw buffer contents, so it can be used to detect
+			  * whether data that was cached for a mesh is stale.
+			  */
+			UInt64 getContentHash() const;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Bounding Volume Accessor Methods
+			
+			
+			
+			
+			/// Return an axis-aligned bounding box for the triangle with the specified index.
+			virtual AABB3f getAABB( Index primitiveIndex ) const;
+			
+			
+			
+			
+			/// Return a bounding sphere for the triangle with the specified index.
+			virtual bvh::BoundingSphere<Float> getBoundingSphere( Index primitiveIndex ) const;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Intersections Methods
+			
+			
+			
+			
+			/// Return whether or not the triangle with the specified index is intersected by a ray.
+			virtual Bool intersectRay( Index primitiveIndex, const Ray3f& ray, Float& distance ) const;
+			
+			
+			
+			
+			/// Return whether or not any of the triangles with the specified indices is intersected by a ray.
+			virtual Bool intersectRay( const Index* primitiveIndices, Size numPrimitives,
+										const Ray3f& ray, Float& distance, Index& closestPrimitive ) const;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Concrete-Type Primitive Accessor Methods
+			
+			
+			
+			
+			/// Get the vertices of the triangle at the specified index in this primitive set.
+			virtual Bool getTriangle( Index index, Vector3f& v0, Vector3f& v1, Vector3f& v2 ) const;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Group Class Declaration
+			
+			
+			
+			
+			/// A class that references the buffers of one triangle group of the mesh.
+			class Group
+			{
+				public:
+					
+					/// A pointer to the tightly packed vertex positions of the group.
+					const Vector3f* positions;
+					
+					/// The number of vertex positions in the group's position buffer.
+					Size numVertices;
+					
+					/// A pointer to the group's first index, or NULL if the group isn't indexed.
+					const void* indices;
+					
+					/// Whether or not the group's indices are 16-bit rather than 32-bit.
+					Bool shortIndices;
+					
+					/// The first vertex of the group if it isn't indexed.
+					Index firstVertex;
+					
+					/// The index in the primitive set of the group's first triangle.
+					Index firstTriangle;
+					
+					/// The number of triangles in the group.
+					Size numTriangles;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Return the vertex index of a corner of a triangle within its group.
+			RIM_INLINE static Index getVertexIndex( const Group& group, Index corner )
+			{
+				if ( group.indices == NULL )
+					return group.firstVertex + corner;
+				else if ( group.shortIndices )
+					return ((const UInt16*)group.indices)[corner];
+				else
+					return ((const UInt32*)group.indices)[corner];
+			}
+			
+			
+			
+			
+			/// Return the group that contains the triangle with the specified index.
+			const Group& getGroup( Index primitiveIndex ) const;
+			
+			
+			
+			
+			/// Return whether or not all of the vertex indices of a group are within its position buffer.
+			static Bool validateIndices( const Group& group );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The mesh whose buffers are referenced, which keeps them alive.
+			Pointer<GenericMeshShape> mesh;
+			
+			
+			/// The triangle groups of the mesh, in order of their first triangle.
+			ArrayList<Group> groups;
+			
+			
+			/// The total number of triangles in all of the groups.
+			Size numTriangles;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_MESH_PRIMITIVE_SET_H
@@ -0,0 +1,446 @@
+/*
+ *  MotorAllocator.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "MotorAllocator.h"
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+MotorAllocator:: MotorAllocator( Float newDeltaWeight, Float newForceWeight, Float newTorqueWeight )
+	:	numMotors( 0 ),
+		deltaWeight( newDeltaWeight ),
+		forceWeight( newForceWeight ),
+		torqueWeight( newTorqueWeight )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Motor Layout Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void MotorAllocator:: setMotor( Index motorIndex, const Vector3f& comOffset, const Vector3f& thrustDirection,
+								const AABB1f& thrustRange )
+{
+	// The columns of the allocation matrix are the force and torque produced by a unit thrust.
+	forceColumns[motorIndex] = thrustDirection;
+	torqueColumns[motorIndex] = math::cross( comOffset, thrustDirection );
+	thrustRanges[motorIndex] = thrustRange;
+}
+
+
+
+
+Bool MotorAllocator:: computeAllocation()
+{
+	const Size n = numMotors;
+	
+	if ( n == 0 )
+		return false;
+		
+	//****************************************************************************
+	// Compute the quadratic cost matrix H = Wd*I + Wf*Af'*Af + Wt*At'*At.
+	
+	// The matrices are computed in double precision since the allocation matrix is
+	// usually rank-deficient and the regularized system is poorly conditioned.
+	Double trace = 0;
+	
+	for ( Index i = 0; i < n; i++ )
+	{
+		for ( Index j = 0; j < n; j++ )
+		{
+			hessian[i*MAX_MOTORS + j] = forceWeight*Double(math::dot( forceColumns[i], forceColumns[j] )) +
+										torqueWeight*Double(math::dot( torqueColumns[i], torqueColumns[j] ));
+		}
+		
+		hessian[i*MAX_MOTORS + i] += deltaWeight;
+		trace += hessian[i*MAX_MOTORS + i];
+	}
+	
+	if ( trace <= Double(0) )
+	{
+		numMotors = 0;
+		return false;
+	}
+	
+	// The allocation matrix is usually rank-deficient (e.g. a quadcopter can't produce
+	// a sideways force), so add a tiny ridge term. This makes the inverse well-defined
+	// and picks the minimum-norm thrusts, just like the true pseudo-inverse.
+	const Double ridge = Double(1e-6)*trace / Double(n);
+	
+	for ( Index i = 0; i < n; i++ )
+		hessian[i*MAX_MOTORS + i] += ridge;
+		
+	//****************************************************************************
+	// Invert the cost matrix one column at a time.
+	
+	Double a[MAX_MOTORS*MAX_MOTORS];
+	Double column[MAX_MOTORS];
+	
+	for ( Index j = 0; j < n; j++ )
+	{
+		for ( Index i = 0; i < n*MAX_MOTORS; i++ )
+			a[i] = hessian[i];
+		
+		for ( Index i = 0; i < n; i++ )
+			column[i] = i == j ? Double(1) : Double(0);
+		
+		if ( !solveLinearSystem( a, MAX_MOTORS, column, n ) )
+		{
+			numMotors = 0;
+			return false;
+		}
+		
+		for ( Index i = 0; i < n; i++ )
+			inverseHessian[i*MAX_MOTORS + j] = column[i];
+	}
+	
+	//****************************************************************************
+	// Compute the rows of the weighted pseudo-inverse: H^-1*Wf*Af' and H^-1*Wt*At'.
+	
+	for ( Index i = 0; i < n; i++ )
+	{
+		Vector3d forceGain;
+		Vector3d torqueGain;
+		
+		for ( Index j = 0; j < n; j++ )
+		{
+			const Double h = inverseHessian[i*MAX_MOTORS + j];
+			forceGain += h*Vector3d( forceColumns[j] );
+			torqueGain += h*Vector3d( torqueColumns[j] );
+		}
+		
+		forceGains[i] = Vector3f( forceGain*Double(forceWeight) );
+		torqueGains[i] = Vector3f( torqueGain*Double(torqueWeight) );
+	}
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Solve Method
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool MotorAllocator:: solve( const Vector3f& localForce, const Vector3f& localTorque,
+							const Float* previousThrusts, Float* thrusts ) const
+{
+	const Size n = numMotors;
+	Bool saturated = false;
+	
+	//****************************************************************************
+	// Compute the unconstrained optimum using the precomputed pseudo-inverse.
+	
+	for ( Index i = 0; i < n; i++ )
+	{
+		Float thrust = math::dot( forceGains[i], localForce ) + math::dot( torqueGains[i], localTorque );
+		
+		if ( deltaWeight != Float(0) )
+		{
+			for ( Index j = 0; j < n; j++ )
+				thrust += Float(deltaWeight*inverseHessian[i*MAX_MOTORS + j]*previousThrusts[j]);
+		}
+		
+		// Clamp the thrust so that the QP solver starts from a feasible point.
+		if ( thrust < thrustRanges[i].min )
+		{
+			thrust = thrustRanges[i].min;
+			saturated = true;
+		}
+		else if ( thrust > thrustRanges[i].max )
+		{
+			thrust = thrustRanges[i].max;
+			saturated = true;
+		}
+		
+		thrusts[i] = thrust;
+	}
+	
+	if ( !saturated )
+		return false;
+		
+	//****************************************************************************
+	// At least one motor saturated, find the true constrained optimum.
+	
+	Double linearTerm[MAX_MOTORS];
+	
+	for ( Index i = 0; i < n; i++ )
+	{
+		linearTerm[i] = Double(forceWeight*math::dot( forceColumns[i], localForce )) +
+						Double(torqueWeight*math::dot( torqueColumns[i], localTorque )) +
+						Double(deltaWeight*previousThrusts[i]);
+	}
+	
+	solveBoxConstrained( linearTerm, thrusts );
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Box-Constrained QP Method
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void MotorAllocator:: solveBoxConstrained( const Double* linearTerm, Float* thrustsOut ) const
+{
+	// Minimize 0.5*t'*H*t - b'*t subject to min <= t <= max with a primal active-set method.
+	// Each motor is either free (0) or fixed at its lower (-1) or upper (1) bound.
+	const Size n = numMotors;
+	const Size maxIterations = 4*MAX_MOTORS;
+	Int bounds[MAX_MOTORS];
+	Index freeIndices[MAX_MOTORS];
+	Double a[MAX_MOTORS*MAX_MOTORS];
+	Double x[MAX_MOTORS];
+	Double thrusts[MAX_MOTORS];
+	
+	for ( Index i = 0; i < n; i++ )
+	{
+		thrusts[i] = thrustsOut[i];
+		
+		if ( thrusts[i] <= thrustRanges[i].min )
+			bounds[i] = -1;
+		else if ( thrusts[i] >= thrustRanges[i].max )
+			bounds[i] = 1;
+		else
+			bounds[i] = 0;
+	}
+	
+	for ( Index iteration = 0; iteration < maxIterations; iteration++ )
+	{
+		//****************************************************************************
+		// Solve the equality-constrained subproblem for the free motors.
+		
+		Size numFree = 0;
+		
+		for ( Index i = 0; i < n; i++ )
+		{
+			if ( bounds[i] == 0 )
+				freeIndices[numFree++] = i;
+		}
+		
+		for ( Index f = 0; f < numFree; f++ )
+		{
+			const Index i = freeIndices[f];
+			Double rhs = linearTerm[i];
+			
+			for ( Index j = 0; j < n; j++ )
+			{
+				if ( bounds[j] != 0 )
+					rhs -= hessian[i*MAX_MOTORS + j]*thrusts[j];
+			}
+			
+			for ( Index g = 0; g < numFree; g++ )
+				a[f*MAX_MOTORS + g] = hessian[i*MAX_MOTORS + freeIndices[g]];
+			
+			x[f] = rhs;
+		}
+		
+		if ( numFree > 0 && !solveLinearSystem( a, MAX_MOTORS, x, numFree ) )
+			break;
+			
+		//****************************************************************************
+		// Step towards the subproblem solution, stopping at the first bound that is hit.
+		
+		Double alpha = 1;
+		Index blocking = n;
+		Int blockingBound = 0;
+		
+		for ( Index f = 0; f < numFree; f++ )
+		{
+			const Index i = freeIndices[f];
+			const Double delta = x[f] - thrusts[i];
+			
+			if ( x[f] < thrustRanges[i].min && delta < Double(0) )
+			{
+				const Double stepSize = (thrustRanges[i].min - thrusts[i]) / delta;
+				
+				if ( stepSize < alpha )
+				{
+					alpha = stepSize;
+					blocking = i;
+					blockingBound = -1;
+				}
+			}
+			else if ( x[f] > thrustRanges[i].max && delta > Double(0) )
+			{
+				const Double stepSize = (thrustRanges[i].max - thrusts[i]) / delta;
+				
+				if ( stepSize < alpha )
+				{
+					alpha = stepSize;
+					blocking = i;
+					blockingBound = 1;
+				}
+			}
+		}
+		
+		for ( Index f = 0; f < numFree; f++ )
+		{
+			const Index i = freeIndices[f];
+			thrusts[i] += alpha*(x[f] - thrusts[i]);
+		}
+		
+		if ( blocking < n )
+		{
+			// Add the blocking motor to the active set.
+			bounds[blocking] = blockingBound;
+			thrusts[blocking] = blockingBound < 0 ? thrustRanges[blocking].min : thrustRanges[blocking].max;
+			continue;
+		}
+		
+		//****************************************************************************
+		// The subproblem solution is feasible. Release the bound motor whose
+		// Lagrange multiplier has the wrong sign, or stop if all are optimal.
+		
+		Double worstMultiplier = 0;
+		Index worstIndex = n;
+		
+		for ( Index i = 0; i < n; i++ )
+		{
+			if ( bounds[i] == 0 )
+				continue;
+			
+			Double gradient = -linearTerm[i];
+			
+			for ( Index j = 0; j < n; j++ )
+				gradient += hessian[i*MAX_MOTORS + j]*thrusts[j];
+			
+			// The gradient should point into the box at a lower bound and out of it at an upper bound.
+			const Double multiplier = bounds[i] < 0 ? gradient : -gradient;
+			
+			if ( multiplier < worstMultiplier )
+			{
+				worstMultiplier = multiplier;
+				worstIndex = i;
+			}
+		}
+		
+		if ( worstIndex == n )
+			break;
+		
+		bounds[worstIndex] = 0;
+	}
+	
+	for ( Index i = 0; i < n; i++ )
+		thrustsOut[i] = math::clamp( Float(thrusts[i]), thrustRanges[i].min, thrustRanges[i].max );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Linear System Solve Method
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool MotorAllocator:: solveLinearSystem( Double* a, Size stride, Double* b, Size n )
+{
+	// Forward elimination with partial pivoting.
+	for ( Index k = 0; k < n; k++ )
+	{
+		Index pivot = k;
+		Double pivotMagnitude = math::abs( a[k*stride + k] );
+		
+		for ( Index i = k + 1; i < n; i++ )
+		{
+			const Double magnitude = math::abs( a[i*stride + k] );
+			
+			if ( magnitude > pivotMagnitude )
+			{
+				pivot = i;
+				pivotMagnitude = magnitude;
+			}
+		}
+		
+		if ( pivotMagnitude < math::epsilon<Double>() )
+			return false;
+		
+		if ( pivot != k )
+		{
+			for ( Index j = k; j < n; j++ )
+			{
+				const Double temp = a[k*stride + j];
+				a[k*stride + j] = a[pivot*stride + j];
+				a[pivot*stride + j] = temp;
+			}
+			
+			const Double temp = b[k];
+			b[k] = b[pivot];
+			b[pivot] = temp;
+		}
+		
+		for ( Index i = k + 1; i < n; i++ )
+		{
+			const Double factor = a[i*stride + k] / a[k*stride + k];
+			
+			for ( Index j = k; j < n; j++ )
+				a[i*stride + j] -= factor*a[k*stride + j];
+			
+			b[i] -= factor*b[k];
+		}
+	}
+	
+	// Back substitution.
+	for ( Index k = n; k > 0; k-- )
+	{
+		const Index i = k - 1;
+		Double sum = b[i];
+		
+		for ( Index j = i + 1; j < n; j++ )
+			sum -= a[i*stride + j]*b[j];
+		
+		b[i] = sum / a[i*stride + i];
+	}
+	
+	return true;
+}
+
+
+
@@ -0,0 +1,232 @@
+/*
+ *  MotorAllocator.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_MOTOR_ALLOCATOR_H
+#define INCLUDE_MOTOR_ALLOCATOR_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+
+
+/// A class that solves for the motor thrusts which best produce a preferred body-space force and torque.
+/**
+  * The allocator minimizes the same weighted quadratic cost as the quadcopter's
+  * hill-climbing optimizer:
+  *
+  *		deltaWeight*|t - t0|^2 + forceWeight*|F(t) - F|^2 + torqueWeight*|T(t) - T|^2
+  *
+  * Since the net force and torque are linear in the motor thrusts, the unconstrained
+  * minimum is given by a weighted pseudo-inverse of the motor allocation matrix.
+  * That matrix only depends on the motor layout and is precomputed once in setMotors().
+  * If the unconstrained solution violates the thrust range of any motor, a small
+  * box-constrained active-set QP solver is used to find the constrained optimum.
+  */
+class MotorAllocator
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new motor allocator with no motors and the specified cost function weights.
+			MotorAllocator( Float newDeltaWeight = 0, Float newForceWeight = 1, Float newTorqueWeight = 0 );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Motor Layout Methods
+			
+			
+			
+			
+			/// Precompute the allocation matrix for the specified list of motors.
+			/**
+			  * The motor type must have public comOffset, thrustDirection, and thrustRange members.
+			  * If there are more than MAX_MOTORS motors, the allocator is invalidated and
+			  * the method returns FALSE.
+			  */
+			template < typename MotorType >
+			Bool setMotors( const ArrayList<MotorType>& motors )
+			{
+				const Size newNumMotors = motors.getSize();
+				
+				if ( newNumMotors > MAX_MOTORS )
+				{
+					numMotors = 0;
+					return false;
+				}
+				
+				for ( Index m = 0; m < newNumMotors; m++ )
+				{
+					const MotorType& motor = motors[m];
+					setMotor( m, motor.comOffset, motor.thrustDirection, motor.thrustRange );
+				}
+				
+				numMotors = newNumMotors;
+				
+				return computeAllocation();
+			}
+			
+			
+			
+			
+			/// Return the number of motors in the layout that this allocator was computed for.
+			RIM_INLINE Size getMotorCount() const
+			{
+				return numMotors;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Solve Method
+			
+			
+			
+			
+			/// Compute the motor thrusts that best achieve the specified body-space force and torque.
+			/**
+			  * The previous thrust of each motor is used for the delta cost term, and the
+			  * final thrusts are written to the output array. Both arrays must have space for
+			  * at least getMotorCount() values. The method returns whether or not the
+			  * thrust range constraints were active in the final solution.
+			  */
+			Bool solve( const Vector3f& localForce, const Vector3f& localTorque,
+						const Float* previousThrusts, Float* thrusts ) const;
+						
+						
+						
+						
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Static Data Members
+			
+			
+			
+			
+			/// The maximum number of motors that an allocator can solve for.
+			static const Size MAX_MOTORS = 8;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Store the layout information for the motor at the specified index.
+			void setMotor( Index motorIndex, const Vector3f& comOffset, const Vector3f& thrustDirection,
+							const AABB1f& thrustRange );
+			
+			
+			
+			
+			/// Precompute the quadratic cost matrix, its inverse, and the weighted pseudo-inverse.
+			Bool computeAllocation();
+			
+			
+			
+			
+			/// Find the minimum of the quadratic cost within the thrust range box, starting at the given feasible thrusts.
+			void solveBoxConstrained( const Double* linearTerm, Float* thrusts ) const;
+			
+			
+			
+			
+			/// Solve the dense linear system A*x = b in place using Gaussian elimination with partial pivoting.
+			/**
+			  * The matrix is stored in row-major order with the given row stride.
+			  * The method returns FALSE if the matrix is singular.
+			  */
+			static Bool solveLinearSystem( Double* a, Size stride, Double* b, Size n );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The unit thrust direction in body space for each motor (the force allocation matrix columns).
+			Vector3f forceColumns[MAX_MOTORS];
+			
+			
+			/// The torque produced in body space by a unit thrust of each motor (the torque allocation matrix columns).
+			Vector3f torqueColumns[MAX_MOTORS];
+			
+			
+			/// The valid range of thrust for each motor.
+			AABB1f thrustRanges[MAX_MOTORS];
+			
+			
+			/// The row-major quadratic cost matrix H = Wd*I + Wf*Af'*Af + Wt*At'*At.
+			Double hessian[MAX_MOTORS*MAX_MOTORS];
+			
+			
+			/// The row-major inverse of the quadratic cost matrix.
+			Double inverseHessian[MAX_MOTORS*MAX_MOTORS];
+			
+			
+			/// The rows of the weighted pseudo-inverse that map the preferred force to each motor's thrust.
+			Vector3f forceGains[MAX_MOTORS];
+			
+			
+			/// The rows of the weighted pseudo-inverse that map the preferred torque to each motor's thrust.
+			Vector3f torqueGains[MAX_MOTORS];
+			
+			
+			/// The number of motors in the current layout.
+			Size numMotors;
+			
+			
+			/// The weight of the change-in-thrust term of the cost function.
+			Float deltaWeight;
+			
+			
+			/// The weight of the net force error term of the cost function.
+			Float forceWeight;
+			
+			
+			/// The weight of the net torque error term of the cost function.
+			Float torqueWeight;
+
+
+};
+
+
+
+
+#endif // INCLUDE_MOTOR_ALLOCATOR_H
@@ -0,0 +1,128 @@
+/*
+ *  MotorLayout.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_MOTOR_LAYOUT_H
+#define INCLUDE_MOTOR_LAYOUT_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "MotorAllocator.h"
+
+
+
+
+/// A class that describes a multirotor airframe with a number of motors that is fixed at compile time.
+/**
+  * The motors are evenly spaced around the body's vertical (Y) axis in the horizontal
+  * plane, and all thrust upwards. The first motor is placed half a spacing away from
+  * the forward (-Z) axis, so that the layout is symmetric about that axis. For 4 motors,
+  * this is the X layout of the standard quadcopter airframe.
+  *
+  * Since the number of motors is a template parameter, vectors that hold one value
+  * per motor can be StaticArray objects without any heap allocation.
+  */
+template < Size numMotors >
+class MotorLayout
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Motor Accessor Methods
+			
+			
+			
+			
+			/// Return the number of motors in this layout.
+			RIM_INLINE static Size getMotorCount()
+			{
+				return numMotors;
+			}
+			
+			
+			
+			
+			/// Return the center-of-mass offset in body space of the motor at the specified index for the given arm length.
+			RIM_INLINE static Vector3f getMotorOffset( Index motorIndex, Float armLength )
+			{
+				const Float angle = math::pi<Float>()*(Float(1) + (Float(2*motorIndex) + Float(1)) / Float(numMotors));
+				
+				return armLength*Vector3f( math::cos( angle ), 0, math::sin( angle ) );
+			}
+			
+			
+			
+			
+			/// Return the unit-length thrust direction in body space of the motor at the specified index.
+			RIM_INLINE static Vector3f getThrustDirection( Index /*motorIndex*/ )
+			{
+				return Vector3f( 0, 1, 0 );
+			}
+			
+			
+			
+			
+			/// Return the body-space inertia tensor of the motors if each has the specified mass and arm length.
+			/**
+			  * The motors are treated as point masses. For 3 or more evenly-spaced motors,
+			  * half of the inertia around the vertical axis is around each horizontal axis.
+			  */
+			RIM_INLINE static Matrix3f getMotorInertia( Float motorMass, Float armLength )
+			{
+				const Float verticalInertia = Float(numMotors)*motorMass*armLength*armLength;
+				
+				return Matrix3f( Float(0.5)*verticalInertia, 0, 0,
+								0, verticalInertia, 0,
+								0, 0, Float(0.5)*verticalInertia );
+			}
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Compile-Time Layout Checks
+			
+			
+			
+			
+			/// A type that fails to compile if the layout can't be solved by a motor allocator.
+			typedef char MotorCountCheck[numMotors >= 3 && numMotors <= MotorAllocator::MAX_MOTORS ? 1 : -1];
+
+
+
+};
+
+
+
+
+/// The layout of a quadcopter with 4 motors in an X configuration.
+typedef MotorLayout<4> QuadLayout;
+
+
+/// The layout of a hexacopter with 6 motors.
+typedef MotorLayout<6> HexaLayout;
+
+
+/// The layout of an octocopter with 8 motors.
+typedef MotorLayout<8> OctoLayout;
+
+
+
+
+#endif // INCLUDE_MOTOR_LAYOUT_H
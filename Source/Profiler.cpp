@@ -0,0 +1,482 @@
+/*
+ *  Profiler.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "Profiler.h"
+
+
+#include <cstdio>
+
+
+#if defined(_MSC_VER)
+	#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+	#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Thread Buffer Class
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+/// A class that stores the zone occurrences of one thread.
+/**
+  * Only the owning thread writes to a buffer, and it holds the buffer's mutex while
+  * it does, so that other threads can read a consistent buffer under the same mutex.
+  * The totals are monotonic so that endFrame() can read the per-frame deltas without
+  * resetting them.
+  */
+class ProfilerThreadBuffer
+{
+	public:
+		
+		/// A class that stores one occurrence of a zone.
+		class Event
+		{
+			public:
+				
+				/// The start time of the occurrence in nanoseconds.
+				Int64 start;
+				
+				/// The duration of the occurrence in nanoseconds.
+				Int64 duration;
+				
+				/// The index of the zone.
+				Index zoneIndex;
+		
+		};
+		
+		
+		RIM_INLINE ProfilerThreadBuffer( Index newThreadIndex )
+			:	threadIndex( newThreadIndex ),
+				numEvents( 0 )
+		{
+			for ( Index i = 0; i < Profiler::MAX_ZONES; i++ )
+			{
+				totalTimes[i] = 0;
+				totalCalls[i] = 0;
+				lastTimes[i] = 0;
+				lastCalls[i] = 0;
+			}
+		}
+		
+		
+		/// The index of the thread in the order that it first entered a zone.
+		Index threadIndex;
+		
+		/// A mutex that is held while the events and totals are written or read.
+		threads::Mutex mutex;
+		
+		/// The total number of events that have been recorded, including those that were overwritten.
+		UInt64 numEvents;
+		
+		/// A ring buffer of the most recent occurrences.
+		Event events[Profiler::EVENT_CAPACITY];
+		
+		/// The total time in nanoseconds spent in each zone.
+		Int64 totalTimes[Profiler::MAX_ZONES];
+		
+		/// The total number of times each zone was entered.
+		UInt64 totalCalls[Profiler::MAX_ZONES];
+		
+		/// The total time of each zone when the last frame ended.
+		Int64 lastTimes[Profiler::MAX_ZONES];
+		
+		/// The total calls of each zone when the last frame ended.
+		UInt64 lastCalls[Profiler::MAX_ZONES];
+
+};
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Static Profiler State
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+/// The maximum number of threads that can record zones.
+static const Size MAX_THREADS = 64;
+
+
+/// The zones that have been registered, which are only added during static initialization.
+static const ProfilerZone* zones[Profiler::MAX_ZONES];
+
+
+/// The number of zones that have been registered.
+static Size numZones = 0;
+
+
+/// The buffer of the current thread, or NULL if the thread hasn't entered a zone yet.
+static PROFILER_THREAD_LOCAL ProfilerThreadBuffer* currentBuffer = NULL;
+
+
+/// Whether or not the current thread entered a zone when every thread buffer was taken.
+static PROFILER_THREAD_LOCAL Bool currentThreadDropped = false;
+
+
+/// The buffers of all threads that have entered a zone.
+static ProfilerThreadBuffer* threadBuffers[MAX_THREADS];
+
+
+/// The number of thread buffers.
+static Size numThreadBuffers = 0;
+
+
+/// The number of threads whose zones weren't recorded because every thread buffer was taken.
+static Size numDroppedThreads = 0;
+
+
+/// A mutex that protects the list of thread buffers.
+static threads::Mutex threadBufferMutex;
+
+
+/// The time spent in each zone for each recent frame, in nanoseconds.
+static Int64 frameTimes[Profiler::MAX_ZONES][Profiler::HISTORY_LENGTH];
+
+
+/// The number of calls of each zone for each recent frame.
+static UInt64 frameCalls[Profiler::MAX_ZONES][Profiler::HISTORY_LENGTH];
+
+
+/// The index in the history of the next frame.
+static Index nextFrameIndex = 0;
+
+
+/// The number of valid frames in the history.
+static Size numHistoryFrames = 0;
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Profiler Zone Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+ProfilerZone:: ProfilerZone( const char* newName )
+	:	name( newName )
+{
+	index = Profiler::addZone( this );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Frame Statistics Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void Profiler:: endFrame()
+{
+	threadBufferMutex.lock();
+	const Size numBuffers = numThreadBuffers;
+	threadBufferMutex.unlock();
+	
+	Int64 times[MAX_ZONES];
+	UInt64 calls[MAX_ZONES];
+	
+	for ( Index z = 0; z < numZones; z++ )
+	{
+		times[z] = 0;
+		calls[z] = 0;
+	}
+	
+	for ( Index t = 0; t < numBuffers; t++ )
+	{
+		ProfilerThreadBuffer& buffer = *threadBuffers[t];
+		Int64 totalTimes[MAX_ZONES];
+		UInt64 totalCalls[MAX_ZONES];
+		
+		// Copy the totals under the buffer's lock, so that a thread that is recording can't tear them.
+		buffer.mutex.lock();
+		
+		for ( Index z = 0; z < numZones; z++ )
+		{
+			totalTimes[z] = buffer.totalTimes[z];
+			totalCalls[z] = buffer.totalCalls[z];
+		}
+		
+		buffer.mutex.unlock();
+		
+		// The last totals are only used here, and endFrame() is only called from one thread.
+		for ( Index z = 0; z < numZones; z++ )
+		{
+			times[z] += totalTimes[z] - buffer.lastTimes[z];
+			calls[z] += totalCalls[z] - buffer.lastCalls[z];
+			buffer.lastTimes[z] = totalTimes[z];
+			buffer.lastCalls[z] = totalCalls[z];
+		}
+	}
+	
+	for ( Index z = 0; z < numZones; z++ )
+	{
+		frameTimes[z][nextFrameIndex] = times[z];
+		frameCalls[z][nextFrameIndex] = calls[z];
+	}
+	
+	nextFrameIndex = (nextFrameIndex + 1) % HISTORY_LENGTH;
+	numHistoryFrames = math::min( numHistoryFrames + 1, HISTORY_LENGTH );
+}
+
+
+
+
+Size Profiler:: getZoneCount()
+{
+	return numZones;
+}
+
+
+
+
+const ProfilerZone& Profiler:: getZone( Index zoneIndex )
+{
+	return *zones[zoneIndex];
+}
+
+
+
+
+Profiler::ZoneStatistics Profiler:: getZoneStatistics( Index zoneIndex )
+{
+	ZoneStatistics statistics;
+	
+	if ( numHistoryFrames == 0 )
+		return statistics;
+	
+	Int64 totalTime = 0;
+	Int64 maxTime = 0;
+	UInt64 totalCalls = 0;
+	
+	for ( Index i = 0; i < numHistoryFrames; i++ )
+	{
+		totalTime += frameTimes[zoneIndex][i];
+		maxTime = math::max( maxTime, frameTimes[zoneIndex][i] );
+		totalCalls += frameCalls[zoneIndex][i];
+	}
+	
+	statistics.averageTime = Time(totalTime).getSeconds() / Double(numHistoryFrames);
+	statistics.maxTime = Time(maxTime).getSeconds();
+	statistics.averageCalls = Double(totalCalls) / Double(numHistoryFrames);
+	
+	return statistics;
+}
+
+
+
+
+Size Profiler:: getDroppedThreadCount()
+{
+	threadBufferMutex.lock();
+	const Size droppedThreads = numDroppedThreads;
+	threadBufferMutex.unlock();
+	
+	return droppedThreads;
+}
+
+
+
+
+UTF8String Profiler:: getSummary()
+{
+	data::UTF8StringBuffer summary;
+	
+	for ( Index z = 0; z < numZones; z++ )
+	{
+		const ZoneStatistics statistics = getZoneStatistics( z );
+		
+		if ( statistics.averageCalls == 0 )
+			continue;
+		
+		summary << zones[z]->getName() << ": " << UTF8String(statistics.averageTime*1000.0,3) << " ms avg, "
+				<< UTF8String(statistics.maxTime*1000.0,3) << " ms max, "
+				<< UTF8String(statistics.averageCalls,1) << " calls\n";
+	}
+	
+	const Size droppedThreads = getDroppedThreadCount();
+	
+	if ( droppedThreads > 0 )
+	{
+		summary << UTF8String(droppedThreads) << " threads weren't profiled because the limit of "
+				<< UTF8String(MAX_THREADS) << " was reached\n";
+	}
+	
+	return summary.toString();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Trace Output Method
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool Profiler:: writeChromeTrace( const UTF8String& filePath )
+{
+	std::FILE* file = std::fopen( (const char*)filePath.getCString(), "w" );
+	
+	if ( file == NULL )
+		return false;
+	
+	threadBufferMutex.lock();
+	const Size numBuffers = numThreadBuffers;
+	threadBufferMutex.unlock();
+	
+	std::fprintf( file, "{\"traceEvents\":[\n" );
+	
+	ArrayList<ProfilerThreadBuffer::Event> events;
+	Bool first = true;
+	
+	for ( Index t = 0; t < numBuffers; t++ )
+	{
+		ProfilerThreadBuffer& buffer = *threadBuffers[t];
+		
+		// Copy the events in order under the buffer's lock, and write them after releasing it.
+		buffer.mutex.lock();
+		
+		const UInt64 numEvents = buffer.numEvents;
+		const UInt64 firstEvent = numEvents > EVENT_CAPACITY ? numEvents - EVENT_CAPACITY : 0;
+		events.clear();
+		
+		for ( UInt64 e = firstEvent; e < numEvents; e++ )
+			events.add( buffer.events[e % EVENT_CAPACITY] );
+		
+		buffer.mutex.unlock();
+		
+		for ( Index e = 0; e < events.getSize(); e++ )
+		{
+			const ProfilerThreadBuffer::Event& event = events[e];
+			
+			// Chrome traces are in microseconds.
+			std::fprintf( file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+						first ? "" : ",\n", zones[event.zoneIndex]->getName(), (unsigned long)buffer.threadIndex,
+						Double(event.start)*1.0e-3, Double(event.duration)*1.0e-3 );
+			
+			first = false;
+		}
+	}
+	
+	std::fprintf( file, "\n]}\n" );
+	
+	return std::fclose( file ) == 0;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void Profiler:: record( Index zoneIndex, const Time& startTime, const Time& endTime )
+{
+	if ( zoneIndex >= MAX_ZONES )
+		return;
+	
+	ProfilerThreadBuffer* buffer = currentBuffer;
+	
+	// Create the buffer the first time this thread enters a zone.
+	if ( buffer == NULL )
+	{
+		if ( currentThreadDropped )
+			return;
+		
+		threadBufferMutex.lock();
+		
+		if ( numThreadBuffers < MAX_THREADS )
+		{
+			buffer = util::construct<ProfilerThreadBuffer>( numThreadBuffers );
+			threadBuffers[numThreadBuffers] = buffer;
+			numThreadBuffers++;
+		}
+		else
+			numDroppedThreads++;
+		
+		threadBufferMutex.unlock();
+		
+		// Count each thread without a buffer once, and don't try to take a buffer for it again.
+		if ( buffer == NULL )
+		{
+			currentThreadDropped = true;
+			return;
+		}
+		
+		currentBuffer = buffer;
+	}
+	
+	const Int64 duration = (endTime - startTime).getNanoseconds();
+	
+	// The lock is only contended while endFrame() or writeChromeTrace() reads this buffer.
+	buffer->mutex.lock();
+	
+	ProfilerThreadBuffer::Event& event = buffer->events[buffer->numEvents % EVENT_CAPACITY];
+	event.start = startTime.getNanoseconds();
+	event.duration = duration;
+	event.zoneIndex = zoneIndex;
+	
+	buffer->numEvents++;
+	buffer->totalTimes[zoneIndex] += duration;
+	buffer->totalCalls[zoneIndex]++;
+	
+	buffer->mutex.unlock();
+}
+
+
+
+
+Index Profiler:: addZone( const ProfilerZone* zone )
+{
+	if ( numZones >= MAX_ZONES )
+		return MAX_ZONES;
+	
+	zones[numZones] = zone;
+	
+	return numZones++;
+}
@@ -0,0 +1,338 @@
+/*
+ *  Profiler.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_PROFILER_H
+#define INCLUDE_PROFILER_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+
+
+/// Define QUADCOPTER_PROFILER as 0 to compile all of the profiler zones out of the program.
+#ifndef QUADCOPTER_PROFILER
+	#define QUADCOPTER_PROFILER 1
+#endif
+
+
+#define PROFILER_CONCAT_HELPER( a, b ) a##b
+#define PROFILER_CONCAT( a, b ) PROFILER_CONCAT_HELPER( a, b )
+
+
+#if QUADCOPTER_PROFILER
+	/// Declare a named profiler zone. This must be used at file scope so that the zone is registered before any threads start.
+	#define PROFILER_ZONE( variable, name ) static ProfilerZone variable( name )
+	
+	/// Time the rest of the enclosing block as one occurrence of the specified zone.
+	#define PROFILER_SCOPE( variable ) ProfilerScope PROFILER_CONCAT( profilerScope, __LINE__ )( variable )
+#else
+	#define PROFILER_ZONE( variable, name )
+	#define PROFILER_SCOPE( variable )
+#endif
+
+
+
+
+/// A class that identifies a named region of code that is timed by the profiler.
+/**
+  * Zones should be declared with the PROFILER_ZONE macro at file scope. Each zone is
+  * given an index when it is constructed, which is used to accumulate its times in
+  * per-thread storage without any locking.
+  */
+class ProfilerZone
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create and register a new zone with the specified name, which must be a string literal.
+			ProfilerZone( const char* newName );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Accessor Methods
+			
+			
+			
+			
+			/// Return the name of this zone.
+			RIM_INLINE const char* getName() const
+			{
+				return name;
+			}
+			
+			
+			
+			
+			/// Return the index of this zone in the profiler, or MAX_ZONES if there were too many zones.
+			RIM_INLINE Index getIndex() const
+			{
+				return index;
+			}
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The name of this zone.
+			const char* name;
+			
+			
+			/// The index of this zone in the profiler.
+			Index index;
+
+
+
+};
+
+
+
+
+/// A class that times the scope that it is declared in as one occurrence of a profiler zone.
+class ProfilerScope
+{
+	public:
+		
+		/// Start timing an occurrence of the specified zone.
+		RIM_FORCE_INLINE ProfilerScope( const ProfilerZone& newZone )
+			:	zone( newZone ),
+				startTime( Time::getCurrent() )
+		{
+		}
+		
+		
+		/// Stop timing the zone and record the occurrence in the current thread's buffer.
+		~ProfilerScope();
+	
+	
+	
+	private:
+		
+		/// The zone that is being timed.
+		const ProfilerZone& zone;
+		
+		/// The time when the scope was entered.
+		Time startTime;
+
+
+
+};
+
+
+
+
+/// A class that collects the times of the profiler zones from every thread.
+/**
+  * Each thread that enters a zone gets its own buffer, which is only written by that
+  * thread. The buffer keeps a running total of the time and calls of each zone, and
+  * a ring buffer of the most recent occurrences. endFrame() turns the totals into
+  * rolling per-frame statistics, and writeChromeTrace() writes the occurrences as a
+  * trace that can be viewed in chrome://tracing.
+  *
+  * Buffers are kept for the rest of the program and their number is limited, so zones
+  * should be entered by long-lived threads rather than threads that are started over
+  * and over. Threads beyond the limit aren't profiled, and the summary says how many.
+  *
+  * Each buffer has its own lock, which its thread only contends for while endFrame()
+  * or writeChromeTrace() is reading that buffer. A zone that ends after its buffer
+  * was read is counted in the next frame. The trace holds each thread's most recent
+  * events when that thread's buffer was copied, so it can be written while zones run.
+  */
+class Profiler
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Zone Statistics Class Declaration
+			
+			
+			
+			
+			/// A class that stores the rolling statistics of a zone over the recent frames.
+			class ZoneStatistics
+			{
+				public:
+					
+					RIM_INLINE ZoneStatistics()
+						:	averageTime( 0 ),
+							maxTime( 0 ),
+							averageCalls( 0 )
+					{
+					}
+					
+					
+					/// The average time in seconds spent in the zone per frame, summed over all threads.
+					Double averageTime;
+					
+					/// The maximum time in seconds spent in the zone in any one of the recent frames.
+					Double maxTime;
+					
+					/// The average number of times per frame that the zone was entered.
+					Double averageCalls;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Frame Statistics Methods
+			
+			
+			
+			
+			/// Collect the zone times since the last call into the rolling per-frame statistics.
+			/**
+			  * This should be called once per frame from a single thread.
+			  */
+			static void endFrame();
+			
+			
+			
+			
+			/// Return the number of zones that are registered.
+			static Size getZoneCount();
+			
+			
+			
+			
+			/// Return the zone at the specified index.
+			static const ProfilerZone& getZone( Index zoneIndex );
+			
+			
+			
+			
+			/// Return the rolling statistics of the zone at the specified index.
+			static ZoneStatistics getZoneStatistics( Index zoneIndex );
+			
+			
+			
+			
+			/// Return the number of threads whose zones weren't recorded because the limit on thread buffers was reached.
+			static Size getDroppedThreadCount();
+			
+			
+			
+			
+			/// Return a text table of the rolling statistics of the zones that have been entered, one zone per line.
+			/**
+			  * If any threads weren't profiled because of the thread limit, a last line says how many.
+			  */
+			static UTF8String getSummary();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Trace Output Method
+			
+			
+			
+			
+			/// Write the recent occurrences of every zone on every thread to a Chrome trace JSON file.
+			/**
+			  * The method returns whether or not the file was successfully written.
+			  */
+			static Bool writeChromeTrace( const UTF8String& filePath );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Static Data Members
+			
+			
+			
+			
+			/// The maximum number of zones that can be registered.
+			static const Size MAX_ZONES = 64;
+			
+			
+			/// The number of recent occurrences that are kept for each thread.
+			static const Size EVENT_CAPACITY = 1 << 16;
+			
+			
+			/// The number of frames that the rolling statistics are computed over.
+			static const Size HISTORY_LENGTH = 60;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Record an occurrence of a zone on the current thread.
+			static void record( Index zoneIndex, const Time& startTime, const Time& endTime );
+			
+			
+			
+			
+			/// Register a zone, returning its index.
+			static Index addZone( const ProfilerZone* zone );
+			
+			
+			
+			
+			friend class ProfilerZone;
+			friend class ProfilerScope;
+
+
+
+};
+
+
+
+
+RIM_FORCE_INLINE ProfilerScope:: ~ProfilerScope()
+{
+	Profiler::record( zone.getIndex(), startTime, Time::getCurrent() );
+}
+
+
+
+
+#endif // INCLUDE_PROFILER_H
@@ -9,6 +9,11 @@
  */
 
 #include "Quadcopter.h"
+#include "Profiler.h"
+
+
+PROFILER_ZONE( optimizeThrustsZone, "Quadcopter::optimizeThrusts" );
+
 
 
 const float Quadcopter:: MAX_SPEED = 10.0f;
@@ -27,6 +32,16 @@ const Vector3f Quadcopter:: VEHICLE_DELTA_THRUST = Vector3f(20, 20, 25);
 const float Quadcopter:: VEHICLE_CLOSE_RANGE = 5;
 const float Quadcopter:: VEHICLE_CLOSE_RANGE_SCALE_FACTOR = 0.2f;
 
+const float Quadcopter:: LOOK_AHEAD_CELL_SIZE = 1.0f;
+
+const float Quadcopter:: THRUST_DELTA_WEIGHT = 0.0f;
+const float Quadcopter:: THRUST_FORCE_WEIGHT = 1.0f;
+const float Quadcopter:: THRUST_TORQUE_WEIGHT = 0.0f;
+const float Quadcopter:: STANDARD_ARM_LENGTH = 0.5f;
+const float Quadcopter:: STANDARD_MASS = 1.0f;
+const float Quadcopter:: STANDARD_HUB_MASS = 0.6f;
+const float Quadcopter:: STANDARD_HUB_RADIUS = 0.05f;
+
 
 
 
@@ -43,13 +58,19 @@ const float Quadcopter:: VEHICLE_CLOSE_RANGE_SCALE_FACTOR = 0.2f;
 
 Quadcopter:: Quadcopter()
 	:	currentState(),
+		thrustSolver( ALLOCATION ),
+		motorAllocator( THRUST_DELTA_WEIGHT, THRUST_FORCE_WEIGHT, THRUST_TORQUE_WEIGHT ),
 		mass( 1 ),
 		inertia( 1, 0, 0,
 				0, 1, 0,
 				0, 0, 1 ),
 		planningTimestep( 0.016f / 2 ),
+		planningRate( 10 ),
+		lookAheadTimer( 0 ),
 		frontCamera( Pointer<PerspectiveCamera>::construct() ),
-		downCamera( Pointer<PerspectiveCamera>::construct() )
+		downCamera( Pointer<PerspectiveCamera>::construct() ),
+		randomVariable( 0 ),
+		visibilityCache( LOOK_AHEAD_CACHE_SIZE )
 {
 }
 
@@ -67,10 +88,10 @@ Quadcopter:: Quadcopter()
 
 
 
-void Quadcopter:: updateGraphics()
+void Quadcopter:: updateGraphics( const TransformState& state )
 {
-	const Vector3f& position = currentState.position;
-	const Matrix3f& rotation = currentState.rotation;
+	const Vector3f& position = state.position;
+	const Matrix3f rotation = state.getRotation();
 
 	
 	if ( graphics.isSet() )
@@ -93,6 +114,61 @@ void Quadcopter:: updateGraphics()
 }
 
 
+
+
+void Quadcopter:: addTracerPoint( const Vector3f& point )
+{
+	if ( tracer.getSize() >= 2*MAX_TRACER_POINTS )
+	{
+		// Move the newest half to the front and drop the rest.
+		rim::util::copy( tracer.getPointer(), tracer.getPointer() + MAX_TRACER_POINTS, MAX_TRACER_POINTS );
+		tracer.removeLast( tracer.getSize() - MAX_TRACER_POINTS );
+	}
+	
+	tracer.add( point );
+}
+
+
+//##########################################################################################
+//##########################################################################################
+//############		
+//############		Motor Layout Update Method
+//############		
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool Quadcopter:: updateMotorLayout()
+{
+	return motorAllocator.setMotors( motors );
+}
+
+
+
+
+void Quadcopter:: setStandardAirframe()
+{
+	setStandardAirframe( QuadLayout() );
+}
+
+
+
+
+Matrix3f Quadcopter:: getStandardHubInertia()
+{
+	// The inertia of a solid sphere.
+	const Float sphereInertia = (2.0f/5.0f)*STANDARD_HUB_MASS*STANDARD_HUB_RADIUS*STANDARD_HUB_RADIUS;
+	
+	return Matrix3f( sphereInertia, 0, 0,
+					0, sphereInertia, 0,
+					0, 0, sphereInertia );
+}
+
+
+
+
 //############
 // Path to the goal
 //###############
@@ -108,7 +184,7 @@ vertices Quadcopter::getpath(const TransformState& state, const Vector3f& goalPo
 //##########################################################################################
 //##########################################################################################
 //############		
-//############		Acceleration Computation Method
+//############		Path Look-Ahead Methods
 //############		
 //##########################################################################################
 //##########################################################################################
@@ -116,33 +192,137 @@ vertices Quadcopter::getpath(const TransformState& state, const Vector3f& goalPo
 
 
 
-void Quadcopter:: computeAcceleration( const TransformState& newState, Float timeStep,
-										Vector3f& linearAcceleration, Vector3f& angularAcceleration ) const
+void Quadcopter:: updateLookAhead( Float dt )
 {
+	if ( nextWaypoint == goalpoint || path.size() == 0 )
+		return;
 	
-	if((float)((nextWaypoint - goalpoint).getMagnitude()) != 0)
+	if ( nextWaypoint.getDistanceTo( currentState.position ) < (VEHICLE_CLOSE_RANGE/1.5) )
 	{
-		if ((float)((nextWaypoint-newState.position).getMagnitude()) < (VEHICLE_CLOSE_RANGE/1.5))
+		nextid = nextid + 1;
+		
+		if ( nextid < path.size() )
+			nextWaypoint = path[nextid];
+	}
+	
+	lookAheadTimer -= dt;
+	
+	if ( lookAheadTimer > 0 || roadmap.isNull() )
+		return;
+	
+	// Don't let the timer fall behind if the timestep is larger than the planning period.
+	lookAheadTimer = math::max( lookAheadTimer + Float(1) / planningRate, Float(0) );
+	
+	shortcutPath();
+}
+
+
+
+
+void Quadcopter:: shortcutPath()
+{
+	const Index firstWaypoint = nextid;
+	const Size numWaypoints = path.size();
+	
+	if ( firstWaypoint >= numWaypoints )
+		return;
+	
+	const Vector3f& position = currentState.position;
+	const Vector3i cell( (int)math::floor( position.x / LOOK_AHEAD_CELL_SIZE ),
+						(int)math::floor( position.y / LOOK_AHEAD_CELL_SIZE ),
+						(int)math::floor( position.z / LOOK_AHEAD_CELL_SIZE ) );
+	
+	// Use the cached results for this position cell, and test the visibility of
+	// the other waypoints in one batch.
+	shortcutEdges.clear();
+	shortcutWaypoints.clear();
+	Index furthestVisible = numWaypoints;
+	
+	for ( Index i = firstWaypoint; i < numWaypoints; i++ )
+	{
+		const VisibilityCacheEntry& entry = visibilityCache[getVisibilityCacheIndex( i, cell )];
+		
+		if ( entry.matches( i, path[i], cell ) )
 		{
-			nextid = nextid + 1;
-			
-			if ( nextid < path.size() )
-				nextWaypoint = path[nextid];
-			
+			if ( entry.visible )
+				furthestVisible = i;
 		}
+		else
+		{
+			shortcutEdges.add( Roadmap::Edge( position, path[i] ) );
+			shortcutWaypoints.add( i );
+		}
+	}
+	
+	if ( shortcutEdges.getSize() > 0 )
+	{
+		roadmap->linkEdges( shortcutEdges, 2.0f, shortcutVisibleMask );
 		
-		for ( Index i = nextid; i < path.size(); i++ )
+		for ( Index e = 0; e < shortcutEdges.getSize(); e++ )
 		{
-			if ( roadmap->link( newState.position, path[i], 2.0f ) &&
-				roadmap->link( path[i], newState.position, 2.0f ) )
-			{
-				nextWaypoint = path[i];
-				nextid = i;
-			}
+			const Index i = shortcutWaypoints[e];
+			VisibilityCacheEntry& entry = visibilityCache[getVisibilityCacheIndex( i, cell )];
+			entry.waypointIndex = i;
+			entry.waypoint = path[i];
+			entry.cell = cell;
+			entry.visible = Roadmap::isEdgeVisible( shortcutVisibleMask, e );
+			
+			if ( entry.visible && (furthestVisible == numWaypoints || i > furthestVisible) )
+				furthestVisible = i;
 		}
 	}
 	
+	// Skip ahead to the furthest visible waypoint.
+	if ( furthestVisible < numWaypoints )
+	{
+		nextWaypoint = path[furthestVisible];
+		nextid = furthestVisible;
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############		
+//############		Acceleration Computation Method
+//############		
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void Quadcopter:: computeAcceleration( const TransformState& newState, Float timeStep,
+										Vector3f& linearAcceleration, Vector3f& angularAcceleration ) const
+{
+	ThrustArray thrusts( Float(0) );
+	computeAcceleration( newState, timeStep, linearAcceleration, angularAcceleration, thrusts );
+}
+
+
+
+
+void Quadcopter:: computeStepAcceleration( const TransformState& newState, Float timeStep,
+											Vector3f& linearAcceleration, Vector3f& angularAcceleration )
+{
+	ThrustArray thrusts( Float(0) );
+	computeAcceleration( newState, timeStep, linearAcceleration, angularAcceleration, thrusts );
 	
+	const Size numMotors = getThrustCount( motors );
+	
+	for ( Index m = 0; m < numMotors; m++ )
+		motors[m].thrust = thrusts[m];
+}
+
+
+
+
+void Quadcopter:: computeAcceleration( const TransformState& newState, Float timeStep,
+										Vector3f& linearAcceleration, Vector3f& angularAcceleration,
+										ThrustArray& thrusts ) const
+{
 	//****************************************************************************
 	// Determine the preferred thrust vector based on the next waypoint.
 	
@@ -162,18 +342,19 @@ void Quadcopter:: computeAcceleration( const TransformState& newState, Float tim
 	//****************************************************************************
 	// Solve for the thrust (scalar value) at each motor given the current state.
 	
-	Array<Float> thrusts( motors.getSize(), 0 );
 	Vector3f localPreferredForce = mass*newState.rotateVectorToBody( preferredThrust );
 	Vector3f localPreferredTorque = inertia*newState.rotateVectorToBody( preferredAngularAcceleration );
 	
-	solveForMotorThrusts( newState, motors, localPreferredForce, localPreferredTorque, thrusts );
+	solveForMotorThrusts( newState, localPreferredForce, localPreferredTorque, thrusts );
 	
 	//****************************************************************************
 	// Apply the force and torque due to each motor.
 	
 	Vector3f force, torque;
 	
-	for ( Index m = 0; m < motors.getSize(); m++ )
+	const Size numMotors = getThrustCount( motors );
+	
+	for ( Index m = 0; m < numMotors; m++ )
 	{
 		const Motor& motor = motors[m];
 		const Float motorThrust = thrusts[m];
@@ -186,7 +367,8 @@ void Quadcopter:: computeAcceleration( const TransformState& newState, Float tim
 	}
 	
 	// Compute the inverse world-space inertia tensor (similarity transform).
-	Matrix3f worldInverseInertia = newState.rotation * inertia.invert() * newState.rotation.transpose();
+	const Matrix3f rotation = newState.getRotation();
+	Matrix3f worldInverseInertia = rotation * inertia.invert() * rotation.transpose();
 	
 	/// Apply the motor acceleration.
 	//linearAcceleration += mass > math::epsilon<Float>() ? force / mass : Vector3f();
@@ -304,7 +486,7 @@ Vector3f Quadcopter:: computePreferredAngularAcceleration( const TransformState&
 	prefRot = preferredRotation;
 	
 	// Compute the rotational difference between the new rotation and the target rotation.
-	Quaternion<Float> qNew( state.rotation );
+	const Quaternion<Float>& qNew = state.orientation;
 	Quaternion<Float> qPref( preferredRotation );
 	Quaternion<Float> deltaQ = qPref*qNew.invert();
 	
@@ -402,7 +584,7 @@ Matrix3f Quadcopter:: computePreferredRotation( const TransformState& newState,
 		if ( math::abs(math::dot( up, look )) < math::cos( MAX_ANGLE_ERROR ) )
 			horizontal = rotationFromUpLook( up, look );
 		else
-			horizontal = rotationFromUpLook( up, -newState.rotation.z );
+			horizontal = rotationFromUpLook( up, -newState.rotateVectorToWorld( Vector3f( 0, 0, 1 ) ) );
 		
 		// Apply the quaternion to the horizontal frame to get the target rotation.
 		return q.toMatrix().transpose()*horizontal;
@@ -415,7 +597,7 @@ Matrix3f Quadcopter:: computePreferredRotation( const TransformState& newState,
 		if ( math::abs(math::dot( up, look )) < math::cos( MAX_ANGLE_ERROR ) )
 			return rotationFromUpLook( up, look );
 		else
-			return rotationFromUpLook( up, -newState.rotation.z );
+			return rotationFromUpLook( up, -newState.rotateVectorToWorld( Vector3f( 0, 0, 1 ) ) );
 	}
 }
 
@@ -433,18 +615,35 @@ Matrix3f Quadcopter:: computePreferredRotation( const TransformState& newState,
 
 
 
-void Quadcopter:: solveForMotorThrusts( const TransformState& state, const ArrayList<Motor>& motors,
-										const Vector3f& localPreferredForce, const Vector3f& localPreferredTorque,
-										Array<Float>& thrusts )
+void Quadcopter:: solveForMotorThrusts( const TransformState& state, const Vector3f& localPreferredForce,
+										const Vector3f& localPreferredTorque, ThrustArray& thrusts ) const
 {
 	Vector3f localForce = localPreferredForce;
 	Vector3f localTorque = localPreferredTorque;
 	localTorque.y = 0;
 	
+	// Use the precomputed allocation if it is up to date with the motor layout.
+	if ( thrustSolver == ALLOCATION && motorAllocator.getMotorCount() == motors.getSize() )
+	{
+		ThrustArray previousThrusts;
+		
+		for ( Index m = 0; m < motors.getSize(); m++ )
+			previousThrusts[m] = motors[m].thrust;
+		
+		motorAllocator.solve( localForce, localTorque, previousThrusts, thrusts.getPointer() );
+		
+		return;
+	}
+	
 	// Pick a decent initial guess.
-	thrusts.setAll( localForce.getMagnitude() / thrusts.getSize() );
+	const Size numMotors = getThrustCount( motors );
+	
+	const Float initialThrust = localForce.getMagnitude() / numMotors;
+	
+	for ( Index m = 0; m < numMotors; m++ )
+		thrusts[m] = initialThrust;
 	
-	optimizeThrusts( motors, thrusts, localForce, localTorque );
+	optimizeThrusts( motors, thrusts, localForce, localTorque, randomVariable );
 }
 
 
@@ -461,23 +660,26 @@ void Quadcopter:: solveForMotorThrusts( const TransformState& state, const Array
 
 
 
-void Quadcopter:: optimizeThrusts( const ArrayList<Motor>& motors, Array<Float>& thrusts,
-									const Vector3f& localForce, const Vector3f& localTorque )
+void Quadcopter:: optimizeThrusts( const ArrayList<Motor>& motors, ThrustArray& thrusts,
+									const Vector3f& localForce, const Vector3f& localTorque,
+									RandomVariable<Float>& randomVariable )
 {
+	PROFILER_SCOPE( optimizeThrustsZone );
+	
 	const Size numTrys = 100;
-	const Size numMotors = motors.getSize();
-	Array<Float> currentThrusts = thrusts;
+	const Size numMotors = getThrustCount( motors );
+	ThrustArray currentThrusts = thrusts;
 	Float currentCost = getCost( motors, currentThrusts, localForce, localTorque );
 	
 	for ( Index i = 0; i < numTrys; i++ )
 	{
 		// Pick a random starting thrust value.
-		Array<Float> tempThrusts = currentThrusts;
+		ThrustArray tempThrusts = currentThrusts;
 		
 		for ( Index m = 0; m < numMotors; m++ )
 		{
 			const Motor& motor = motors[m];
-			tempThrusts[m] = math::random( motor.thrustRange.min, motor.thrustRange.max );
+			tempThrusts[m] = randomVariable.sample( motor.thrustRange.min, motor.thrustRange.max );
 		}
 		
 		Float cost = hillClimbThrusts( motors, tempThrusts, localForce, localTorque );
@@ -506,7 +708,7 @@ void Quadcopter:: optimizeThrusts( const ArrayList<Motor>& motors, Array<Float>&
 
 
 
-Float Quadcopter:: hillClimbThrusts( const ArrayList<Motor>& motors, Array<Float>& thrusts,
+Float Quadcopter:: hillClimbThrusts( const ArrayList<Motor>& motors, ThrustArray& thrusts,
 									const Vector3f& localForce, const Vector3f& localTorque )
 {
 	const Float stepSize = 0.1f; // Newtons.
@@ -516,9 +718,9 @@ Float Quadcopter:: hillClimbThrusts( const ArrayList<Motor>& motors, Array<Float
 	const Size numCandidates = 5;
 	const Float candidates[numCandidates] = { -acceleration, -1.0f / acceleration, 0, 1.0f / acceleration, acceleration };
 	
-	const Size numMotors = motors.getSize();
-	Array<Float> currentThrusts = thrusts;
-	Array<Float> currentStepSize( numMotors, stepSize );
+	const Size numMotors = getThrustCount( motors );
+	ThrustArray currentThrusts = thrusts;
+	ThrustArray currentStepSize( stepSize );
 	Float currentCost = getCost( motors, currentThrusts, localForce, localTorque );
 	
 	for ( Index iteration = 0; iteration < maxIterations; iteration++ )
@@ -583,12 +785,9 @@ Float Quadcopter:: hillClimbThrusts( const ArrayList<Motor>& motors, Array<Float
 
 
 
-void Quadcopter:: constrainThrusts( const ArrayList<Motor>& motors, Array<Float>& thrusts )
+void Quadcopter:: constrainThrusts( const ArrayList<Motor>& motors, ThrustArray& thrusts )
 {
-	const Size numMotors = motors.getSize();
-	
-	if ( thrusts.getSize() < motors.getSize() )
-		thrusts.setSize( motors.getSize() );
+	const Size numMotors = getThrustCount( motors );
 	
 	for ( Index m = 0; m < numMotors; m++ )
 	{
@@ -615,15 +814,15 @@ void Quadcopter:: constrainThrusts( const ArrayList<Motor>& motors, Array<Float>
 
 
 
-Float Quadcopter:: getCost( const ArrayList<Motor>& motors, const Array<Float>& thrusts,
+Float Quadcopter:: getCost( const ArrayList<Motor>& motors, const ThrustArray& thrusts,
 							const Vector3f& localForce, const Vector3f& localTorque )
 {
 	// Weight constants for each of the terms in the cost function.
-	const Float deltaWeight = 0;
-	const Float linearWeight = 1.0f;
-	const Float angleWeight = 0.0f;
+	const Float deltaWeight = THRUST_DELTA_WEIGHT;
+	const Float linearWeight = THRUST_FORCE_WEIGHT;
+	const Float angleWeight = THRUST_TORQUE_WEIGHT;
 	
-	const Size numMotors = motors.getSize();
+	const Size numMotors = getThrustCount( motors );
 	
 	//****************************************************************************
 	// Compute the cost due to change in thrust.
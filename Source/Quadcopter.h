@@ -16,8 +16,11 @@
 //#include "rim/rimGraphicsGUI.h"
 
 #include "TransformState.h"
+#include "MotorAllocator.h"
+#include "MotorLayout.h"
 
 #include "Global_planner.h"
+#include "IncrementalPlanner.h"
 #include "Roadmap.h"
 
 using namespace rim;
@@ -51,8 +54,18 @@ class Quadcopter
 			
 			
 			
-			/// Update the graphical representation + camera with the new simulated position.
-			void updateGraphics();
+			/// Update the graphical representation + camera with the specified state, such as an interpolated render state.
+			void updateGraphics( const TransformState& state );
+			
+			
+			
+			
+			/// Add a point to the end of this quadcopter's tracer, discarding the oldest points once it is full.
+			/**
+			  * The tracer keeps at least the last MAX_TRACER_POINTS points. The oldest half
+			  * is discarded all at once, so that adding a point only moves memory occasionally.
+			  */
+			void addTracerPoint( const Vector3f& point );
 			
 			
 			
@@ -68,6 +81,133 @@ class Quadcopter
 			
 			
 			
+			/// Compute the accelerations like computeAcceleration(), and store the solved thrusts as the motors' current thrusts.
+			/**
+			  * The simulation calls this once per update, for the stage that is evaluated at the
+			  * current state, so that the motors hold the thrusts that they produce during the
+			  * update. The next update's thrust solve then starts from those thrusts.
+			  */
+			void computeStepAcceleration( const TransformState& state, Float timeStep, Vector3f& linearAcceleration, Vector3f& angularAcceleration );
+			
+			
+			
+			
+			/// Advance this quadcopter's target waypoint along its path for the specified timestep.
+			/**
+			  * The simulation calls this once per step, before integrating the vehicle, so that
+			  * the integrator stages don't do any ray tracing. The target advances whenever the
+			  * quadcopter comes close to it. At the planning rate, the remaining waypoints are
+			  * also tested for visibility and the target skips ahead to the furthest visible one.
+			  */
+			void updateLookAhead( Float dt );
+			
+			
+			
+			
+			/// Make the next look-ahead update test waypoint visibility, such as after the path changes.
+			RIM_INLINE void resetLookAhead()
+			{
+				lookAheadTimer = 0;
+			}
+			
+			
+			
+			
+			/// Return the number of times per second that the path look-ahead tests waypoint visibility.
+			RIM_INLINE Float getPlanningRate() const
+			{
+				return planningRate;
+			}
+			
+			
+			
+			
+			/// Set the number of times per second that the path look-ahead tests waypoint visibility.
+			/**
+			  * The rate is clamped to be at least a small positive value.
+			  */
+			RIM_INLINE void setPlanningRate( Float newPlanningRate )
+			{
+				planningRate = math::max( newPlanningRate, Float(0.01) );
+			}
+			
+			
+			
+			
+			/// Recompute the cached motor allocation matrix after the motors of this quadcopter have changed.
+			/**
+			  * This method should be called whenever a motor is added or removed, or when a motor's
+			  * offset, direction, or thrust range changes. The method returns whether or not the
+			  * allocation could be computed for the current motor layout.
+			  */
+			Bool updateMotorLayout();
+			
+			
+			
+			
+			/// Replace the motors, mass, and inertia of this quadcopter with those of the standard 1 kg airframe.
+			/**
+			  * The airframe has four upward-facing motors on 0.5 m arms in an X layout,
+			  * with most of its mass in a small sphere at the center.
+			  */
+			void setStandardAirframe();
+			
+			
+			
+			
+			/// Replace the motors, mass, and inertia of this vehicle with those of a standard 1 kg airframe with the given layout.
+			/**
+			  * The airframe has the layout's motors on 0.5 m arms, with most of its mass in a
+			  * small sphere at the center and the rest divided evenly between the motors.
+			  */
+			template < Size numMotors >
+			void setStandardAirframe( const MotorLayout<numMotors>& layout )
+			{
+				motors.clear();
+				
+				for ( Index m = 0; m < numMotors; m++ )
+					motors.add( Motor( layout.getMotorOffset( m, STANDARD_ARM_LENGTH ), layout.getThrustDirection( m ) ) );
+				
+				updateMotorLayout();
+				
+				const Float motorMass = (STANDARD_MASS - STANDARD_HUB_MASS) / Float(numMotors);
+				
+				mass = STANDARD_MASS;
+				inertia = getStandardHubInertia() + layout.getMotorInertia( motorMass, STANDARD_ARM_LENGTH );
+			}
+			
+			
+			
+			
+			/// Reset the random stream that is used by this quadcopter's thrust optimizer to the specified seed.
+			RIM_INLINE void setRandomSeed( UInt32 newSeed )
+			{
+				randomVariable.setSeed( newSeed );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Thrust Solver Enum Declaration
+			
+			
+			
+			
+			/// An enum type which specifies the algorithm used to determine the motor thrusts.
+			enum ThrustSolver
+			{
+				/// Use random-restart hill climbing to minimize the thrust cost function.
+				HILL_CLIMBING,
+				
+				/// Use the precomputed motor allocation pseudo-inverse, with a QP fallback when thrusts saturate.
+				ALLOCATION
+			};
+			
+			
+			
 			
 		//********************************************************************************
 		//********************************************************************************
@@ -153,6 +293,15 @@ class Quadcopter
 			static const float VEHICLE_CLOSE_RANGE;
 			static const float VEHICLE_CLOSE_RANGE_SCALE_FACTOR;
 			
+			/// The size in meters of the position cells that waypoint visibility results are cached for.
+			static const float LOOK_AHEAD_CELL_SIZE;
+			
+			/// The number of entries in the waypoint visibility cache.
+			static const Size LOOK_AHEAD_CACHE_SIZE = 256;
+			
+			/// The number of recent points that the tracer keeps.
+			static const Size MAX_TRACER_POINTS = 2048;
+			
 			
 			
 			
@@ -168,18 +317,31 @@ class Quadcopter
 			
 			
 			/// A list of the motors that are part of the quadcopter.
+			/**
+			  * Only the first MotorAllocator::MAX_MOTORS motors produce thrust, since the
+			  * thrust solvers use fixed-size storage so that they never allocate memory.
+			  */
 			ArrayList<Motor> motors;
 			
+			/// The algorithm that is used to compute the thrust of each motor.
+			ThrustSolver thrustSolver;
+			
+			/// An object which stores the precomputed allocation matrix for the current motor layout.
+			MotorAllocator motorAllocator;
+			
 			Pointer<Roadmap> roadmap;
 			
+			/// A planner which keeps its search state between queries on the current roadmap.
+			IncrementalPlanner planner;
+			
 			vertices path;
-			mutable int nextid;
+			int nextid;
 			
 			/// The previous thrust vector in the world coordinate frame.
 			Vector3f lastThrust;
 			
 			/// The current target waypoint for the quadcopter in world space.
-			mutable Vector3f nextWaypoint;
+			Vector3f nextWaypoint;
 
 			/// The goal position for the quadcopter in world space.
 			Vector3f goalpoint;
@@ -199,6 +361,12 @@ class Quadcopter
 			/// The time step used to determine the next acceleration.
 			Float planningTimestep;
 			
+			/// The number of times per second that the path look-ahead tests waypoint visibility.
+			Float planningRate;
+			
+			/// The time remaining until the path look-ahead next tests waypoint visibility.
+			Float lookAheadTimer;
+			
 			
 			/// A camera that looks in the forward direction.
 			Pointer<PerspectiveCamera> frontCamera;
@@ -209,23 +377,109 @@ class Quadcopter
 			/// The graphical representation of the quadcopter.
 			Pointer<GraphicsObject> graphics;
 			
-			/// A history of the previous points along this quadcopter's path.
+			/// A history of the recent points along this quadcopter's path, at most twice MAX_TRACER_POINTS long.
 			ArrayList<Vector3f> tracer;
 			
 			
 	private:
 		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Type Declarations
+			
+			
+			
+			
+			/// The type of a fixed-size vector that stores one thrust value for each motor.
+			typedef StaticArray<Float,MotorAllocator::MAX_MOTORS> ThrustArray;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Visibility Cache Entry Class Declaration
+			
+			
+			
+			
+			/// A class that stores whether a waypoint was visible from a cell of positions.
+			class VisibilityCacheEntry
+			{
+				public:
+					
+					RIM_INLINE VisibilityCacheEntry()
+						:	waypointIndex( math::max<Index>() ),
+							visible( false )
+					{
+					}
+					
+					
+					/// Return whether or not this entry stores the result for a waypoint seen from a position cell.
+					RIM_INLINE Bool matches( Index newWaypointIndex, const Vector3f& newWaypoint, const Vector3i& newCell ) const
+					{
+						return waypointIndex == newWaypointIndex && cell == newCell && waypoint == newWaypoint;
+					}
+					
+					
+					/// The index of the waypoint in the path.
+					Index waypointIndex;
+					
+					/// The position of the waypoint, so that entries from a previous path aren't reused.
+					Vector3f waypoint;
+					
+					/// The position cell that the visibility was tested from.
+					Vector3i cell;
+					
+					/// Whether or not the waypoint was visible from the cell.
+					Bool visible;
+			
+			};
+			
+			
+			
+			
 		//********************************************************************************
 		//********************************************************************************
 		//********************************************************************************
 		//******	Private Functions
 			
+			
+			
+			
+			/// Test the visibility of the remaining waypoints and skip ahead to the furthest visible one.
+			void shortcutPath();
+			
+			
+			
+			
+			/// Return the index of the visibility cache entry for a waypoint seen from a position cell.
+			RIM_INLINE static Index getVisibilityCacheIndex( Index waypointIndex, const Vector3i& cell )
+			{
+				const UInt32 hash = UInt32(waypointIndex)*73856093u ^ UInt32(cell.x)*19349663u ^
+									UInt32(cell.y)*83492791u ^ UInt32(cell.z)*2654435761u;
+				
+				return hash % LOOK_AHEAD_CACHE_SIZE;
+			}
+			
+			
+			
+			
 			/// Compute the path based on goal position and transform state
 			vertices getpath(const TransformState& state, const Vector3f& goalPosition, Pointer<Roadmap> rmap) const;
 
 			
 			
 			
+			/// Compute the accelerations for the specified state, and write the solved motor thrusts to the last parameter.
+			void computeAcceleration( const TransformState& state, Float timeStep, Vector3f& linearAcceleration,
+									Vector3f& angularAcceleration, ThrustArray& thrusts ) const;
+			
+			
+			
+			
 			/// Compute the ideal thrust vector based on the given goal position, transform stsate, and external acceleration.
 			Vector3f computePreferredThrust( const TransformState& state, const Vector3f& goalPosition,
 											const Vector3f& externalAcceleration ) const;
@@ -247,17 +501,22 @@ class Quadcopter
 			
 			
 			
-			static void solveForMotorThrusts( const TransformState& state, const ArrayList<Motor>& motors,
-												const Vector3f& preferredForce, const Vector3f& preferredTorque,
-												Array<Float>& thrusts );
+			/// Compute the thrust for each motor that best achieves the preferred body-space force and torque.
+			void solveForMotorThrusts( const TransformState& state, const Vector3f& preferredForce,
+										const Vector3f& preferredTorque, ThrustArray& thrusts ) const;
 			
 			
 			
 			
 			
 			/// Optimize for the best set of motor thrusts for the specified preferred force and torque.
-			static void optimizeThrusts( const ArrayList<Motor>& motors, Array<Float>& thrusts,
-										const Vector3f& localForce, const Vector3f& localTorque );
+			/**
+			  * The random restarts are drawn from the specified random variable so that
+			  * the result is reproducible and independent of other vehicles.
+			  */
+			static void optimizeThrusts( const ArrayList<Motor>& motors, ThrustArray& thrusts,
+										const Vector3f& localForce, const Vector3f& localTorque,
+										RandomVariable<Float>& randomVariable );
 			
 			
 			
@@ -265,24 +524,37 @@ class Quadcopter
 			/**
 			  * The final best cost is returned.
 			  */
-			static Float hillClimbThrusts( const ArrayList<Motor>& motors, Array<Float>& thrusts,
+			static Float hillClimbThrusts( const ArrayList<Motor>& motors, ThrustArray& thrusts,
 										const Vector3f& localForce, const Vector3f& localTorque );
 			
 			
 			
 			/// Constrain the thrust values for the motors to be within the valid range for the motors.
-			static void constrainThrusts( const ArrayList<Motor>& motors, Array<Float>& thrusts );
+			static void constrainThrusts( const ArrayList<Motor>& motors, ThrustArray& thrusts );
 			
 			
 			
 			
 			/// Compute the cost for a new set of thrust values for the given quadcopter state and preferred accelerations.
-			static Float getCost( const ArrayList<Motor>& motors, const Array<Float>& thrusts,
+			static Float getCost( const ArrayList<Motor>& motors, const ThrustArray& thrusts,
 									const Vector3f& localForce, const Vector3f& localTorque );
 			
 			
 			
 			
+			/// Return the number of motors that the thrust solvers compute thrusts for.
+			RIM_FORCE_INLINE static Size getThrustCount( const ArrayList<Motor>& motors )
+			{
+				return math::min( motors.getSize(), MotorAllocator::MAX_MOTORS );
+			}
+			
+			
+			
+			/// Return the inertia tensor of the central sphere of the standard airframe.
+			static Matrix3f getStandardHubInertia();
+			
+			
+			
 			/// Compute and return an orthonormal rotation matrix from the given up and look vectors.
 			static Matrix3f rotationFromUpLook( const Vector3f& up, const Vector3f& look )
 			{
@@ -305,6 +577,68 @@ class Quadcopter
 			
 			
 			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Static Data Members
+			
+			
+			
+			
+			/// The weight of the change-in-thrust term of the thrust cost function.
+			static const float THRUST_DELTA_WEIGHT;
+			
+			/// The weight of the net force error term of the thrust cost function.
+			static const float THRUST_FORCE_WEIGHT;
+			
+			/// The weight of the net torque error term of the thrust cost function.
+			static const float THRUST_TORQUE_WEIGHT;
+			
+			/// The distance in meters from the center of the standard airframe to each motor.
+			static const float STANDARD_ARM_LENGTH;
+			
+			/// The total mass in kg of the standard airframe.
+			static const float STANDARD_MASS;
+			
+			/// The mass in kg of the central sphere of the standard airframe.
+			static const float STANDARD_HUB_MASS;
+			
+			/// The radius in meters of the central sphere of the standard airframe.
+			static const float STANDARD_HUB_RADIUS;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// This quadcopter's own random stream, used for the random restarts of the thrust optimizer.
+			mutable RandomVariable<Float> randomVariable;
+			
+			/// A direct-mapped cache of waypoint visibility results, indexed by waypoint and position cell.
+			Array<VisibilityCacheEntry> visibilityCache;
+			
+			/// The uncached waypoint edges tested by the last shortcut, kept so that their storage is reused.
+			ArrayList<Roadmap::Edge> shortcutEdges;
+			
+			/// The index of the waypoint at the end of each of the shortcut edges.
+			ArrayList<Index> shortcutWaypoints;
+			
+			/// The visibility of each of the shortcut edges, one bit per edge.
+			Array<UInt32> shortcutVisibleMask;
+			
+			
+			/// The benchmark suite times the private thrust solvers directly.
+			friend class BenchmarkSuite;
+
+
+
 };
 
 
@@ -9,6 +9,20 @@
  */
 
 #include "QuadcopterDemo.h"
+#include "Profiler.h"
+
+
+/// The bounds of the Port City scene, which contain every roadmap that is built for it.
+static const AABB3f sceneBounds( -300, 300, 0, 50, -500, 300 );
+
+/// The number of samples in the precomputed roadmap that covers the whole scene.
+static const Size numDenseRoadmapSamples = 10000;
+
+/// The random seed of the precomputed roadmap. It matches the Port City scenario so that both use the same cached file.
+static const UInt32 denseRoadmapSeed = 0;
+
+/// The profiler zone that times the forward rendering of the scene.
+PROFILER_ZONE( renderZone, "ForwardRenderer::render" );
 
 
 
@@ -30,9 +44,14 @@ QuadcopterDemo:: QuadcopterDemo()
 		cameraPitch( 40.0f ),
 		cameraYaw( 0 ),
 		cameraDistance( 50.0f ),
-		timeStep( 0.5/60.0f ),
 		currentView( 0 ),
-		recording( false )
+		showProfiler( false ),
+		clock( &simulation, 0.5f/60.0f ),
+		replaying( false ),
+		replayTime( 0 ),
+		replaySpeed( 1 ),
+		sensorsEnabled( false ),
+		numFrameSteps( 0 )
 {
 }
 
@@ -112,12 +131,15 @@ Bool QuadcopterDemo:: initialize( const Pointer<GraphicsContext>& context )
 		scene->addLight( light );
 	}
 	
+	planningThreadPool.setThreadCount( threads::Thread::getCPUCount() );
+	
 	// Load a mesh for the scene.
 	{
 		Resource<GraphicsShape> mesh = getResourceManager()->getResource<GraphicsShape>( 
 											ResourceID( rootPath + "Data/Port City/Port City.obj" ) );
 		Pointer<GenericMeshShape> genericMesh = mesh.getData().dynamicCast<GenericMeshShape>();
-		roadmap = Pointer<Roadmap>::construct( genericMesh );
+		roadmap = Pointer<Roadmap>::construct( genericMesh, rootPath + "Data/Port City/Port City.collision",
+												&planningThreadPool );
 
 		Pointer<MeshShape> shape = getGraphicsConverter()->convertGenericMesh( genericMesh );
 		Pointer<GraphicsObject> object = Pointer<GraphicsObject>::construct( shape );
@@ -145,6 +167,20 @@ Bool QuadcopterDemo:: initialize( const Pointer<GraphicsContext>& context )
 		quadcopterMesh->setScale( 2.0f );
 	}
 	
+	//********************************************************************************
+	// Initialize the simulation.
+	
+	simulation.setThreadCount( threads::Thread::getCPUCount() );
+	
+	// Load the precomputed roadmap for the scene, or build and cache it if the file is missing or stale.
+	roadmap->setRandomSeed( denseRoadmapSeed );
+	
+	if ( !roadmap->load( rootPath + "Data/Port City/Port City.roadmap", sceneBounds, numDenseRoadmapSamples ) )
+	{
+		roadmap->rebuild( sceneBounds, numDenseRoadmapSamples, &planningThreadPool );
+		roadmap->save( rootPath + "Data/Port City/Port City.roadmap" );
+	}
+	
 	//********************************************************************************
 	
 	goal = Vector3f( 0, 20, 0 );
@@ -171,6 +207,13 @@ Bool QuadcopterDemo:: initialize( const Pointer<GraphicsContext>& context )
 
 void QuadcopterDemo:: deinitialize()
 {
+	// Stop stepping the simulation so that the telemetry log can be finished.
+	clock.setMaxSpeed( false );
+	clock.setRecorder( NULL );
+	telemetryRecorder.stop();
+	
+	frameCapture.stop();
+	
 	sceneRenderer.release();
 	immediateRenderer.release();
 }
@@ -199,19 +242,40 @@ void QuadcopterDemo:: update( const Time& dt )
 	
 	Timer timer;
 	
-	// Update the simulation using a fixed time step.
-	simulation.update( timeStep );
+	// Take as many fixed steps as fit in the real time that elapsed since the last frame.
+	// The simulation is paused while a telemetry log is replayed.
+	numFrameSteps = replaying ? 0 : clock.advance( dt );
 	
 	simulationTime = timer.getElapsedTime();
 	
 	//********************************************************************************
 	// Update the graphics.
 	
-	// Update all of the quadcopter graphical representations with their new positions.
-	for ( Index i = 0; i < quadcopters.getSize(); i++ )
+	clock.lock();
+	
+	if ( replaying )
+	{
+		// Play the log at the replay speed, looping back to the start at the end.
+		replayTime += Double(dt)*replaySpeed;
+		
+		if ( replayTime > telemetryReplay.getEndTime() )
+			replayTime = telemetryReplay.getStartTime();
+		
+		telemetryReplay.seek( replayTime );
+		
+		const Size numReplayed = math::min( quadcopters.getSize(), telemetryReplay.getVehicleCount() );
+		
+		for ( Index i = 0; i < numReplayed; i++ )
+			quadcopters[i]->updateGraphics( telemetryReplay.getState( i ) );
+	}
+	else
 	{
-		quadcopters[i]->tracer.add( quadcopters[i]->currentState.position );
-		quadcopters[i]->updateGraphics();
+		// Update all of the quadcopter graphical representations with their interpolated states.
+		for ( Index i = 0; i < quadcopters.getSize(); i++ )
+		{
+			quadcopters[i]->addTracerPoint( quadcopters[i]->currentState.position );
+			quadcopters[i]->updateGraphics( clock.getRenderState( i ) );
+		}
 	}
 	
 	// Update the camera's orientation and position.
@@ -224,11 +288,31 @@ void QuadcopterDemo:: update( const Time& dt )
 	{
 		Quadcopter& quadcopter = *quadcopters[currentView - 1];
 		camera->setOrientation( Matrix3f::rotationYDegrees( cameraYaw )*Matrix3f::rotationXDegrees( cameraPitch ) );
-		camera->setPosition( quadcopter.currentState.position - camera->getViewDirection()*5.0f );
+		camera->setPosition( quadcopter.graphics->getPosition() - camera->getViewDirection()*5.0f );
 	}
 	
+	const Double sensorTime = replaying ? replayTime : clock.getSimulatedTime();
+	
+	clock.unlock();
+	
+	// Trace depth images from the cameras of the viewed quadcopter, or the first one when no quadcopter is viewed.
+	// The cameras and the scene tree are only changed on this thread, so the simulation doesn't need to be locked.
+	if ( sensorsEnabled && quadcopters.getSize() > 0 )
+	{
+		const Index sensorVehicle = currentView > 0 && currentView - 1 < quadcopters.getSize() ? currentView - 1 : 0;
+		const Quadcopter& quadcopter = *quadcopters[sensorVehicle];
+		const CollisionTree& tree = roadmap->getCollisionTree();
+		
+		frontSensor.update( sensorTime, quadcopter.frontCamera->getPosition(), quadcopter.frontCamera->getOrientation(),
+							tree, &planningThreadPool );
+		downSensor.update( sensorTime, quadcopter.downCamera->getPosition(), quadcopter.downCamera->getOrientation(),
+							tree, &planningThreadPool );
+	}
 	
 	scene->update( dt );
+	
+	// Roll the zone times of this frame into the profiler statistics.
+	Profiler::endFrame();
 }
 
 
@@ -320,8 +404,95 @@ void QuadcopterDemo:: keyEvent( const KeyboardEvent& event )
 		if ( event.getKey() == Key::Q )
 			currentView = (currentView + 1) % (quadcopters.getSize()+1);
 		
+		// Start or finish capturing the rendered frames to numbered images.
 		if ( event.getKey() == Key::R )
-			recording = !recording;
+		{
+			if ( frameCapture.isCapturing() )
+				frameCapture.stop();
+			else
+				frameCapture.start( Path( Directory::getExecutable(), Path("frames") ) );
+		}
+		
+		if ( event.getKey() == Key::M )
+			clock.setMaxSpeed( !clock.getMaxSpeed() );
+		
+		// Start or stop tracing depth images from the viewed quadcopter's cameras.
+		if ( event.getKey() == Key::V )
+		{
+			sensorsEnabled = !sensorsEnabled;
+			frontSensor.resetStatistics();
+			downSensor.resetStatistics();
+		}
+		
+		if ( event.getKey() == Key::P )
+			showProfiler = !showProfiler;
+		
+		// Write the recent profiler zones as a Chrome trace while the simulation is paused.
+		if ( event.getKey() == Key::T )
+		{
+			clock.lock();
+			Profiler::writeChromeTrace( Path( Directory::getExecutable(), Path("trace.json") ) );
+			clock.unlock();
+		}
+		
+		// Start or finish recording the vehicle states to a telemetry log after every step.
+		if ( event.getKey() == Key::L && !replaying )
+		{
+			clock.lock();
+			
+			if ( telemetryRecorder.isRecording() )
+			{
+				clock.setRecorder( NULL );
+				telemetryRecorder.stop();
+			}
+			else if ( telemetryRecorder.start( Path( Directory::getExecutable(), Path("telemetry.qtlm") ) ) )
+				clock.setRecorder( &telemetryRecorder );
+			
+			clock.unlock();
+		}
+		
+		// Start or stop replaying the telemetry log in place of the simulation.
+		if ( event.getKey() == Key::K )
+		{
+			if ( replaying )
+			{
+				replaying = false;
+				telemetryReplay.close();
+			}
+			else
+			{
+				clock.setMaxSpeed( false );
+				clock.lock();
+				
+				// Finish the log so that its last chunk is written before it is read.
+				if ( telemetryRecorder.isRecording() )
+				{
+					clock.setRecorder( NULL );
+					telemetryRecorder.stop();
+				}
+				
+				replaying = telemetryReplay.open( Path( Directory::getExecutable(), Path("telemetry.qtlm") ) );
+				replayTime = telemetryReplay.getStartTime();
+				replaySpeed = 1;
+				
+				clock.unlock();
+			}
+		}
+		
+		// Halve or double the replay speed, or the simulation time step when not replaying.
+		if ( event.getKey() == Key::OPEN_BRACKET || event.getKey() == Key::CLOSE_BRACKET )
+		{
+			const Float scale = event.getKey() == Key::OPEN_BRACKET ? 0.5f : 2.0f;
+			
+			if ( replaying )
+				replaySpeed *= scale;
+			else
+			{
+				clock.lock();
+				clock.setTimeStep( clock.getTimeStep()*scale );
+				clock.unlock();
+			}
+		}
 	}
 }
 
@@ -377,27 +548,45 @@ void QuadcopterDemo:: mouseButtonEvent( const MouseButtonEvent& event )
 	if ( goal.y < targetY )
 		goal.y = targetY;
 	
-	const AABB3f sceneBounds( -300, 300, 0, 50, -500, 300 );
 	const Size numSceneSamples = 1000;
 	const Size minNumSamples = 100;
 	const Size maxNumSamples = 1000;
 	const Size maxInitialTrys = 10;
 	const Size maxExpandedTrys = 3;
 	
-	// Set the goal for each quadcopter.
+	// Keep the max-speed thread from stepping the quadcopters while their paths change.
+	clock.lock();
+	
+	// Answer all of the path queries against the shared scene roadmap in parallel.
+	// The roadmap pointers are reference counted, so they are only reassigned on this thread.
 	for ( Index i = 0; i < quadcopters.getSize(); i++ )
 	{
-		const Vector3f& start = quadcopters[i]->currentState.position;
 		quadcopters[i]->goalpoint = goal;
 		
+		if ( quadcopters[i]->planner.getRoadmap() != roadmap )
+		{
+			quadcopters[i]->roadmap = roadmap;
+			quadcopters[i]->planner.reset( roadmap );
+		}
+		
+		planningThreadPool.addJob( bindCall( &QuadcopterDemo::replanToGoal, this, quadcopters[i].getPointer() ) );
+	}
+	
+	planningThreadPool.finishJobs();
+	
+	// Build a separate roadmap for each quadcopter whose path couldn't be found on the shared roadmap.
+	for ( Index i = 0; i < quadcopters.getSize(); i++ )
+	{
+		const Vector3f& start = quadcopters[i]->currentState.position;
+		
 		AABB3f startGoalBounds( start );
 		startGoalBounds.enlargeFor( goal );
 		const Float samplesPerM3 = 0.001;
 		const Size roadmapSamples = math::clamp( Size(samplesPerM3*startGoalBounds.getVolume()),
 												minNumSamples, maxNumSamples );
-		Bool foundPath = false;
+		Bool foundPath = quadcopters[i]->path.size() > 0;
 		
-		for ( Index j = 0; j < maxInitialTrys; j++ )
+		for ( Index j = 0; j < maxInitialTrys && !foundPath; j++ )
 		{
 			if ( foundPath = generateRoadmap( *quadcopters[i], startGoalBounds, start, goal, roadmapSamples ) )
 				break;
@@ -413,12 +602,15 @@ void QuadcopterDemo:: mouseButtonEvent( const MouseButtonEvent& event )
 		}
 		
 		quadcopters[i]->nextid = 1;
+		quadcopters[i]->resetLookAhead();
 		
 		if ( quadcopters[i]->path.size() > 0 )
 			quadcopters[i]->nextWaypoint = quadcopters[i]->path[quadcopters[i]->nextid];
 		
 		quadcopters[i]->tracer.clear();
 	}
+	
+	clock.unlock();
 }
 
 
@@ -427,12 +619,39 @@ void QuadcopterDemo:: mouseButtonEvent( const MouseButtonEvent& event )
 Bool QuadcopterDemo:: generateRoadmap( Quadcopter& quadcopter, const AABB3f& bounds,
 									const Vector3f& start, const Vector3f& goal, Size numSamples )
 {
-	quadcopter.roadmap->rebuild( bounds, numSamples, start, goal );
+	// Never rebuild the shared scene roadmap, since other quadcopters are planning on it.
+	if ( quadcopter.roadmap == roadmap )
+	{
+		quadcopter.roadmap = Pointer<Roadmap>::construct( *roadmap );
+		
+		// A private roadmap is only searched by its own planner, so its edges can be checked lazily.
+		quadcopter.roadmap->setLazy( true );
+	}
 	
-	Global_planner gplan = Global_planner();
-	quadcopter.path = gplan.prm( start, goal, quadcopter.roadmap );
+	quadcopter.roadmap->rebuild( bounds, numSamples, start, goal, &planningThreadPool );
+	quadcopter.planner.reset( quadcopter.roadmap );
+	
+	return replan( quadcopter, start, goal );
+}
+
+
+
+
+void QuadcopterDemo:: replanToGoal( Quadcopter* quadcopter )
+{
+	replan( *quadcopter, quadcopter->currentState.position, quadcopter->goalpoint );
+}
+
+
+
+
+Bool QuadcopterDemo:: replan( Quadcopter& quadcopter, const Vector3f& start, const Vector3f& goal )
+{
+	IncrementalPlanner& planner = quadcopter.planner;
+	planner.setStart( start );
+	planner.setGoal( goal );
 	
-	return quadcopter.path.size() > 0;
+	return planner.plan( quadcopter.path );
 }
 
 
@@ -479,7 +698,10 @@ void QuadcopterDemo:: mouseMotionEvent( const MouseMotionEvent& event )
 
 void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 {
-	sceneRenderer->render();
+	{
+		PROFILER_SCOPE( renderZone );
+		sceneRenderer->render();
+	}
 	
 	immediateRenderer->synchronizeContext();
 	immediateRenderer->setTransform( camera->getInverseTransformMatrix() );
@@ -490,6 +712,8 @@ void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 	
 	immediateRenderer->getRenderMode().setFlag( RenderFlags::BLENDING, true );
 	
+	clock.lock();
+	
 	// Draw the goal location.
 	immediateRenderer->setPointSize( 10 );
 	immediateRenderer->begin( IndexedPrimitiveType::POINTS );
@@ -514,12 +738,14 @@ void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 	for ( Index i = 0; i < quadcopters.getSize(); i++ )
 	{
 		const Quadcopter& quadcopter = *quadcopters[i];
+		const TransformState renderState = replaying && i < telemetryReplay.getVehicleCount() ?
+											telemetryReplay.getState( i ) : clock.getRenderState( i );
 		
 		for ( Index m = 0; m < quadcopter.motors.getSize(); m++ )
 		{
 			const Quadcopter::Motor& motor = quadcopter.motors[m];
-			Vector3f motorPoint = quadcopter.currentState.transformToWorld( motor.comOffset );
-			Vector3f motorVector = quadcopter.currentState.rotateVectorToWorld( motor.thrustDirection );
+			Vector3f motorPoint = renderState.transformToWorld( motor.comOffset );
+			Vector3f motorVector = renderState.rotateVectorToWorld( motor.thrustDirection );
 			
 			immediateRenderer->vertex( motorPoint );
 			immediateRenderer->vertex( motorPoint - motorVector );
@@ -531,9 +757,18 @@ void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 	
 	immediateRenderer->getRenderMode().setFlag( RenderFlags::DEPTH_WRITE, false );
 	
+	// Draw each distinct roadmap once, since most quadcopters share the scene roadmap.
+	ArrayList<const Roadmap*> drawnRoadmaps;
+	
 	for ( Index q = 0; q < quadcopters.getSize(); q++ )
 	{
-		drawRoadmap( *quadcopters[q]->roadmap );
+		const Roadmap* quadcopterRoadmap = quadcopters[q]->roadmap;
+		
+		if ( !drawnRoadmaps.contains( quadcopterRoadmap ) )
+		{
+			drawRoadmap( *quadcopterRoadmap );
+			drawnRoadmaps.add( quadcopterRoadmap );
+		}
 	}
 	
 	
@@ -546,12 +781,16 @@ void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 	
 	for (Index q = 0; q < quadcopters.getSize(); q++)
 	{
-		if  ( quadcopters[q]->path.size() == 0 )
+		// Draw the replayed paths while a telemetry log is replayed.
+		const vertices& path = replaying && q < telemetryReplay.getVehicleCount() ?
+								telemetryReplay.getPath( q ) : quadcopters[q]->path;
+		
+		if  ( path.size() == 0 )
 			continue;
 		
-		for ( Index i = 0; i < quadcopters[q]->path.size(); i++ )
+		for ( Index i = 0; i < path.size(); i++ )
 		{
-			immediateRenderer->vertex( quadcopters[q]->path[i]);
+			immediateRenderer->vertex( path[i]);
 		}
 		
 		immediateRenderer->render();
@@ -562,11 +801,11 @@ void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 		immediateRenderer->color( 1.0f, 0.0f, 0.0f, 1.0f );
 		immediateRenderer->begin( IndexedPrimitiveType::LINES );
 		
-		for ( Index i = 0; i < (quadcopters[q]->path.size()-1); i++ )
+		for ( Index i = 0; i < (path.size()-1); i++ )
 		{
 			
-				immediateRenderer->vertex( quadcopters[q]->path[i] );
-				immediateRenderer->vertex( quadcopters[q]->path[i+1] );
+				immediateRenderer->vertex( path[i] );
+				immediateRenderer->vertex( path[i+1] );
 			
 		}
 		
@@ -589,29 +828,34 @@ void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 	immediateRenderer->getRenderMode().setFlag( RenderFlags::DEPTH_TEST, true );
 	immediateRenderer->getRenderMode().setFlag( RenderFlags::DEPTH_WRITE, true );
 	
+	const Float timeStep = clock.getTimeStep();
+	const Double simulatedTime = clock.getSimulatedTime();
+	
+	UTF8String telemetryString;
+	
+	if ( replaying )
+	{
+		telemetryString = UTF8String("Replay: ") + UTF8String(telemetryReplay.getTime(),1) + " / " +
+							UTF8String(telemetryReplay.getEndTime(),1) + " s at " + UTF8String(replaySpeed,2) + "x\n";
+	}
+	else if ( telemetryRecorder.isRecording() )
+	{
+		telemetryString = UTF8String("Telemetry: ") + UTF8String(telemetryRecorder.getFrameCount()) + " frames, " +
+							UTF8String(telemetryRecorder.getStallCount()) + " stalls\n";
+	}
+	
+	clock.unlock();
 	
 	
 	
-	// Save the graphics frame to an image file.
-	if ( recording )
+	
+	// Hand the graphics frame to the capture workers, which encode and write it.
+	if ( frameCapture.isCapturing() )
 	{
 		context->flush();
 		
-		Image screen;
-		
-		if ( context->readColorBuffer( PixelFormat::RGB, screen ) )
-		{
-			Path imagePath( Directory::getExecutable(), Path("frames/" + UTF8String(frameNumber) + ".tga") );
-			FileWriter writer( imagePath );
-			
-			if ( writer.open() )
-			{
-				images::io::ImageConverter imageConverter;
-				imageConverter.encode( images::ImageFormat::TGA, screen, writer );
-				writer.close();
-			}
-			frameNumber++;
-		}
+		if ( context->readColorBuffer( PixelFormat::RGB, captureImage ) )
+			frameCapture.addFrame( captureImage );
 	}
 	
 	//****************************************************************************
@@ -619,8 +863,35 @@ void QuadcopterDemo:: draw( const Pointer<GraphicsContext>& context )
 	
 	Vector2f textPosition( 20, context->getFramebufferSize().y - fontStyle.getFontSize() - 20 );
 	
+	UTF8String captureString;
+	
+	if ( frameCapture.isCapturing() )
+	{
+		captureString = UTF8String("Capture: ") + UTF8String(frameCapture.getFrameCount()) + " frames, " +
+							UTF8String(frameCapture.getDroppedFrameCount()) + " dropped\n";
+	}
+	
+	UTF8String sensorString;
+	
+	if ( sensorsEnabled )
+	{
+		const Size numRays = frontSensor.getRayCount() + downSensor.getRayCount();
+		const Double sensorSeconds = (frontSensor.getCaptureDuration() + downSensor.getCaptureDuration()).getSeconds();
+		const Double raysPerSecond = sensorSeconds > 0 ? Double(numRays) / sensorSeconds : 0.0;
+		
+		sensorString = UTF8String("Sensors: ") + UTF8String(raysPerSecond*1.0e-6,2) + " Mrays/s, front " +
+						UTF8String(frontSensor.getDepth( frontSensor.getWidth()/2, frontSensor.getHeight()/2 ),1) + " m, down " +
+						UTF8String(downSensor.getDepth( downSensor.getWidth()/2, downSensor.getHeight()/2 ),1) + " m\n";
+	}
+	
+	UTF8String stepsString = clock.getMaxSpeed() ? UTF8String("Max Speed") : UTF8String(numFrameSteps) + " per frame";
+	
 	fontDrawer->drawString( UTF8String("Time Step: ") + UTF8String(timeStep*1000,2) + " ms\n" +
-							UTF8String("Simulation Time: ") + UTF8String(simulationTime*1000,3) + " ms\n"
+							UTF8String("Steps: ") + stepsString + "\n" +
+							UTF8String("Simulation Time: ") + UTF8String(simulationTime*1000,3) + " ms\n" +
+							UTF8String("Simulated: ") + UTF8String(simulatedTime,1) + " s\n" +
+							telemetryString + captureString + sensorString +
+							(showProfiler ? Profiler::getSummary() : UTF8String())
 							, fontStyle, textPosition );
 }
 
@@ -653,6 +924,10 @@ void QuadcopterDemo:: drawRoadmap( const Roadmap& roadmap )
 		
 		for ( Index n = 0; n < numNeighbors; n++ )
 		{
+			// Skip the edges of a lazy roadmap that were found to be blocked.
+			if ( roadmap.getNode(i).edgeStates[n] == Roadmap::EDGE_INVALID )
+				continue;
+			
 			immediateRenderer->vertex( roadmap.getNode(i).position );
 			immediateRenderer->vertex( roadmap.getNode(neighbors[n]).position );
 		}
@@ -715,28 +990,18 @@ Pointer<Quadcopter> QuadcopterDemo:: newQuadcopter( const Vector3f& position ) c
 	quadcopter->downCamera->setNearPlaneDistance( 1.0f );
 	quadcopter->downCamera->setFarPlaneDistance( 1000 );
 	
-	Float l = 0.5f; // distance to motors from center,
+	// Configure the motors, mass, and inertia of the quadcopter.
+	quadcopter->setStandardAirframe();
 	
-	// Configure the motors of the quadcopter.
-	quadcopter->motors.add( Quadcopter::Motor( l*Vector3f( -1, 0, -1 ).normalize(), Vector3f( 0, 1, 0 ) ) );
-	quadcopter->motors.add( Quadcopter::Motor( l*Vector3f( 1, 0, -1 ).normalize(), Vector3f( 0, 1, 0 ) ) );
-	quadcopter->motors.add( Quadcopter::Motor( l*Vector3f( 1, 0, 1 ).normalize(), Vector3f( 0, 1, 0 ) ) );
-	quadcopter->motors.add( Quadcopter::Motor( l*Vector3f( -1, 0, 1 ).normalize(), Vector3f( 0, 1, 0 ) ) );
+	// Set the goal position.
+	quadcopter->goalpoint = goal;
 	
-	Float mass = 1.0f;
-	Float M = 0.6f; // mass of center
-	Float R = 0.05f; // center sphere radius
-	Float m = (mass - M) / quadcopter->motors.getSize();
+	// Plan on the shared scene roadmap until a query needs a roadmap of its own.
+	quadcopter->roadmap = roadmap;
 	
-	// The mass of the quadcopter.
-	quadcopter->mass = mass;
-	quadcopter->inertia = Matrix3f( (2.0f/5.0f)*M*R*R + 2.0f*m*l*l, 0, 0,
-									0, (2.0f/5.0f)*M*R*R + 4.0f*m*l*l, 0,
-									0, 0, (2.0f/5.0f)*M*R*R + 2.0f*m*l*l );
+	if ( roadmap->getNodeCount() > 0 )
+		quadcopter->planner.reset( roadmap );
 	
-	// Set the goal position.
-	quadcopter->goalpoint = goal;
-	quadcopter->roadmap = Pointer<Roadmap>::construct( *roadmap );
 	quadcopter->nextWaypoint = position;
 	
 	return quadcopter;
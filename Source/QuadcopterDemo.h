@@ -25,8 +25,13 @@ using namespace rim::engine;
 
 #include "Quadcopter.h"
 #include "Simulation.h"
+#include "SimulationClock.h"
+#include "TelemetryRecorder.h"
+#include "TelemetryReplay.h"
 #include "Roadmap.h"
 #include "Global_planner.h"
+#include "FrameCapture.h"
+#include "RangeSensor.h"
 
 
 class QuadcopterDemo : public SimpleDemo
@@ -128,6 +133,17 @@ class QuadcopterDemo : public SimpleDemo
 									const Vector3f& start, const Vector3f& goal, Size numSamples );
 			
 			
+			/// Update the quadcopter's path from its current position to its goal on its current roadmap.
+			/**
+			  * This only reads the roadmap, so it can run for many quadcopters sharing a roadmap in parallel.
+			  */
+			void replanToGoal( Quadcopter* quadcopter );
+			
+			
+			/// Update the quadcopter's path for a new start and goal by repairing the search on its current roadmap.
+			Bool replan( Quadcopter& quadcopter, const Vector3f& start, const Vector3f& goal );
+			
+			
 			
 			
 			/// Draw the specified roadmap to the current viewport.
@@ -198,8 +214,15 @@ class QuadcopterDemo : public SimpleDemo
 			
 			
 			
-			Index frameNumber;
-			Bool recording;
+			/// The image that each frame is read back into while frames are being captured.
+			Image captureImage;
+			
+			/// An object which encodes and writes the captured frames on worker threads.
+			FrameCapture frameCapture;
+			
+			
+			/// Whether or not the rolling profiler statistics are drawn over the scene.
+			Bool showProfiler;
 			
 			
 			
@@ -216,6 +239,46 @@ class QuadcopterDemo : public SimpleDemo
 			Simulation simulation;
 			
 			
+			/// A clock which advances the simulation with fixed steps to follow real time.
+			SimulationClock clock;
+			
+			
+			/// A pool of worker threads that are used to test roadmap edge visibility in parallel.
+			threads::ThreadPool planningThreadPool;
+			
+			
+			/// A recorder that writes the vehicle states to a telemetry log after every step.
+			TelemetryRecorder telemetryRecorder;
+			
+			
+			/// A reader that plays a telemetry log back in place of the simulation.
+			TelemetryReplay telemetryReplay;
+			
+			
+			/// Whether or not the telemetry log is being replayed.
+			Bool replaying;
+			
+			
+			/// The simulation time in the telemetry log that is being replayed.
+			Double replayTime;
+			
+			
+			/// The number of seconds of the telemetry log that are replayed per second of real time.
+			Double replaySpeed;
+			
+			
+			/// A range sensor at the pose of the viewed quadcopter's front camera.
+			RangeSensor frontSensor;
+			
+			
+			/// A range sensor at the pose of the viewed quadcopter's down camera.
+			RangeSensor downSensor;
+			
+			
+			/// Whether or not the range sensors are capturing.
+			Bool sensorsEnabled;
+			
+			
 			
 			
 		//********************************************************************************
@@ -229,10 +292,11 @@ class QuadcopterDemo : public SimpleDemo
 			Time simulationTime;
 			
 			
-			Path rootPath;
+			/// The number of simulation steps that were taken during the last frame.
+			Size numFrameSteps;
 			
 			
-			Float timeStep;
+			Path rootPath;
 			
 			
 };
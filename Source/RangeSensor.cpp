@@ -0,0 +1,259 @@
+/*
+ *  RangeSensor.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "RangeSensor.h"
+#include "Profiler.h"
+
+
+PROFILER_ZONE( rangeSensorCaptureZone, "RangeSensor::capture" );
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+RangeSensor:: RangeSensor()
+	:	width( 64 ),
+		height( 48 ),
+		horizontalFieldOfView( 90 ),
+		maxRange( 100 ),
+		rate( 10 ),
+		hasCaptured( false ),
+		captureTime( 0 ),
+		captureOrientation( Matrix3f::IDENTITY ),
+		captureTree( NULL ),
+		numCaptures( 0 ),
+		numRays( 0 )
+{
+	updatePixelDirections();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Capture Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool RangeSensor:: update( Double time, const Vector3f& position, const Matrix3f& orientation,
+							const CollisionTree& tree, threads::ThreadPool* threadPool )
+{
+	// A time before the last capture, such as when a replay loops, starts the schedule over.
+	if ( hasCaptured && rate > 0 && time >= captureTime )
+	{
+		const Double period = Double(1) / rate;
+		
+		if ( time < captureTime + period )
+			return false;
+		
+		// Keep the captures on the rate's schedule, skipping any periods that were missed entirely.
+		captureTime += period*math::floor( (time - captureTime) / period );
+	}
+	else
+		captureTime = time;
+	
+	hasCaptured = true;
+	capture( position, orientation, tree, threadPool );
+	
+	return true;
+}
+
+
+
+
+void RangeSensor:: capture( const Vector3f& position, const Matrix3f& orientation,
+							const CollisionTree& tree, threads::ThreadPool* threadPool )
+{
+	PROFILER_SCOPE( rangeSensorCaptureZone );
+	
+	const Time start = Time::getCurrent();
+	
+	capturePosition = position;
+	captureOrientation = orientation;
+	captureTree = &tree;
+	
+	// Each packet is a 2x2 block of pixels, so the jobs are given whole pairs of rows.
+	const Size numRowPairs = (height + 1) / 2;
+	const Size numThreads = threadPool != NULL ? threadPool->getThreadCount() : 1;
+	
+	if ( numThreads > 1 && numRowPairs > 1 )
+	{
+		// Split the rows into contiguous ranges, a few per thread to balance the load.
+		const Size numJobs = math::min( numRowPairs, numThreads*4 );
+		
+		for ( Index j = 0; j < numJobs; j++ )
+		{
+			const Index jobStart = (j*numRowPairs) / numJobs;
+			const Index jobEnd = ((j + 1)*numRowPairs) / numJobs;
+			
+			threadPool->addJob( bindCall( &RangeSensor::traceRowPairs, this, jobStart, jobEnd ) );
+		}
+		
+		threadPool->finishJobs();
+	}
+	else
+		traceRowPairs( 0, numRowPairs );
+	
+	captureTree = NULL;
+	numCaptures++;
+	numRays += width*height;
+	captureDuration += Time::getCurrent() - start;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Settings Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void RangeSensor:: setResolution( Size newWidth, Size newHeight )
+{
+	width = math::max( newWidth, Size(1) );
+	height = math::max( newHeight, Size(1) );
+	
+	updatePixelDirections();
+}
+
+
+
+
+void RangeSensor:: setHorizontalFieldOfView( Float newHorizontalFieldOfView )
+{
+	horizontalFieldOfView = math::clamp( newHorizontalFieldOfView, Float(1), Float(179) );
+	
+	updatePixelDirections();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Statistics Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void RangeSensor:: resetStatistics()
+{
+	numCaptures = 0;
+	numRays = 0;
+	captureDuration = Time();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void RangeSensor:: updatePixelDirections()
+{
+	const Size numPixels = width*height;
+	const Float horizontalSlope = math::tan( Float(0.5)*math::degreesToRadians( horizontalFieldOfView ) );
+	const Float verticalSlope = horizontalSlope*Float(height) / Float(width);
+	
+	pixelDirections.setSize( numPixels );
+	depthScales.setSize( numPixels );
+	ranges.setSize( numPixels );
+	depths.setSize( numPixels );
+	
+	for ( Index y = 0; y < height; y++ )
+	{
+		// Row 0 is at the top of the image, so the rows go down the Y axis.
+		const Float offsetY = (Float(1) - Float(2*y + 1) / Float(height))*verticalSlope;
+		
+		for ( Index x = 0; x < width; x++ )
+		{
+			const Float offsetX = (Float(2*x + 1) / Float(width) - Float(1))*horizontalSlope;
+			const Vector3f direction( offsetX, offsetY, Float(-1) );
+			const Float length = direction.getMagnitude();
+			const Index pixel = y*width + x;
+			
+			// The direction's view component is 1 before normalizing, so its inverse length is the cosine to the view direction.
+			pixelDirections[pixel] = direction / length;
+			depthScales[pixel] = Float(1) / length;
+			ranges[pixel] = maxRange;
+			depths[pixel] = maxRange*depthScales[pixel];
+		}
+	}
+}
+
+
+
+
+void RangeSensor:: traceRowPairs( Index start, Index end )
+{
+	Index pixels[4];
+	Vector3f directions[4];
+	Float distances[4];
+	
+	for ( Index pair = start; pair < end; pair++ )
+	{
+		// An odd last row or column repeats its pixels, which are then traced twice and written twice.
+		const Index y0 = 2*pair;
+		const Index y1 = math::min( y0 + 1, height - 1 );
+		
+		for ( Index x0 = 0; x0 < width; x0 += 2 )
+		{
+			const Index x1 = math::min( x0 + 1, width - 1 );
+			
+			pixels[0] = y0*width + x0;
+			pixels[1] = y0*width + x1;
+			pixels[2] = y1*width + x0;
+			pixels[3] = y1*width + x1;
+			
+			for ( Index i = 0; i < 4; i++ )
+				directions[i] = captureOrientation*pixelDirections[pixels[i]];
+			
+			captureTree->traceRayPacket( capturePosition, directions, maxRange, distances );
+			
+			for ( Index i = 0; i < 4; i++ )
+			{
+				ranges[pixels[i]] = distances[i];
+				depths[pixels[i]] = distances[i]*depthScales[pixels[i]];
+			}
+		}
+	}
+}
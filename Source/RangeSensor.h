@@ -0,0 +1,377 @@
+/*
+ *  RangeSensor.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_RANGE_SENSOR_H
+#define INCLUDE_RANGE_SENSOR_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "CollisionTree.h"
+
+
+
+
+/// A class that simulates a depth camera by tracing rays through a collision tree.
+/**
+  * The sensor uses the same conventions as a perspective camera: it looks down the
+  * negative Z axis of its orientation, with X to the right and Y up, and its horizontal
+  * field of view is given in degrees. The vertical field of view follows from the
+  * resolution, so that the pixels are square. A sensor can be placed at the pose of a
+  * vehicle's front or down camera to see what that camera sees.
+  *
+  * Each capture traces one ray per pixel. Each 2x2 block of pixels is traced as one ray
+  * packet, and the rows are split into contiguous ranges that are traced by the jobs
+  * of a thread pool. Two images are produced: the range, which is the distance along
+  * each pixel's ray, and the depth, which is the distance along the view direction.
+  * Pixels whose rays don't hit anything within the maximum range are set to it.
+  */
+class RangeSensor
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new range sensor with a 64x48 image, a 90 degree field of view, a 100 meter range, and a 10 Hz rate.
+			RangeSensor();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Capture Methods
+			
+			
+			
+			
+			/// Capture an image at the specified pose if a capture is due at the specified time.
+			/**
+			  * The first call always captures, and afterwards a capture is due once per
+			  * period of the rate, or whenever the time goes back before the last capture.
+			  * The method returns whether or not an image was captured. If a thread pool
+			  * is given, its jobs must not be waited on by any other thread during the capture.
+			  */
+			Bool update( Double time, const Vector3f& position, const Matrix3f& orientation,
+						const CollisionTree& tree, threads::ThreadPool* threadPool = NULL );
+			
+			
+			
+			
+			/// Capture an image at the specified pose now, whether or not one is due.
+			void capture( const Vector3f& position, const Matrix3f& orientation,
+						const CollisionTree& tree, threads::ThreadPool* threadPool = NULL );
+						
+						
+						
+						
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Image Accessor Methods
+			
+			
+			
+			
+			/// Return the width of the images in pixels.
+			RIM_INLINE Size getWidth() const
+			{
+				return width;
+			}
+			
+			
+			
+			
+			/// Return the height of the images in pixels.
+			RIM_INLINE Size getHeight() const
+			{
+				return height;
+			}
+			
+			
+			
+			
+			/// Return the distance along the ray of the pixel at the specified column and row, where row 0 is the top.
+			RIM_INLINE Float getRange( Index x, Index y ) const
+			{
+				return ranges[y*width + x];
+			}
+			
+			
+			
+			
+			/// Return the distance along the view direction of the pixel at the specified column and row, where row 0 is the top.
+			RIM_INLINE Float getDepth( Index x, Index y ) const
+			{
+				return depths[y*width + x];
+			}
+			
+			
+			
+			
+			/// Return a pointer to the range image, stored in rows from the top.
+			RIM_INLINE const Float* getRanges() const
+			{
+				return ranges.getPointer();
+			}
+			
+			
+			
+			
+			/// Return a pointer to the depth image, stored in rows from the top.
+			RIM_INLINE const Float* getDepths() const
+			{
+				return depths.getPointer();
+			}
+			
+			
+			
+			
+			/// Return the time on the rate's schedule that the last image was captured for by update().
+			RIM_INLINE Double getCaptureTime() const
+			{
+				return captureTime;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Settings Accessor Methods
+			
+			
+			
+			
+			/// Set the width and height of the images in pixels, which must both be at least 1.
+			void setResolution( Size newWidth, Size newHeight );
+			
+			
+			
+			
+			/// Return the horizontal field of view in degrees.
+			RIM_INLINE Float getHorizontalFieldOfView() const
+			{
+				return horizontalFieldOfView;
+			}
+			
+			
+			
+			
+			/// Set the horizontal field of view in degrees, which is clamped between 1 and 179.
+			void setHorizontalFieldOfView( Float newHorizontalFieldOfView );
+			
+			
+			
+			
+			/// Return the maximum distance that the rays are traced to.
+			RIM_INLINE Float getMaxRange() const
+			{
+				return maxRange;
+			}
+			
+			
+			
+			
+			/// Set the maximum distance that the rays are traced to.
+			RIM_INLINE void setMaxRange( Float newMaxRange )
+			{
+				maxRange = math::max( newMaxRange, Float(0) );
+			}
+			
+			
+			
+			
+			/// Return the number of images captured per second by update().
+			RIM_INLINE Float getRate() const
+			{
+				return rate;
+			}
+			
+			
+			
+			
+			/// Set the number of images captured per second by update(), where 0 captures at every update.
+			RIM_INLINE void setRate( Float newRate )
+			{
+				rate = math::max( newRate, Float(0) );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Statistics Accessor Methods
+			
+			
+			
+			
+			/// Return the number of images that have been captured since the statistics were reset.
+			RIM_INLINE Size getCaptureCount() const
+			{
+				return numCaptures;
+			}
+			
+			
+			
+			
+			/// Return the number of rays that have been traced since the statistics were reset.
+			RIM_INLINE Size getRayCount() const
+			{
+				return numRays;
+			}
+			
+			
+			
+			
+			/// Return the wall-clock time spent capturing images since the statistics were reset.
+			RIM_INLINE const Time& getCaptureDuration() const
+			{
+				return captureDuration;
+			}
+			
+			
+			
+			
+			/// Return the number of rays traced per second of capture time, or 0 if nothing was captured.
+			RIM_INLINE Double getRaysPerSecond() const
+			{
+				const Double seconds = captureDuration.getSeconds();
+				
+				return seconds > 0 ? Double(numRays) / seconds : Double(0);
+			}
+			
+			
+			
+			
+			/// Reset the capture count, ray count, and capture time to 0.
+			void resetStatistics();
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Compute the direction and depth scale of every pixel in the sensor's frame.
+			void updatePixelDirections();
+			
+			
+			
+			
+			/// Trace the pixels in the specified range of row pairs for the current capture. This is run by each job.
+			void traceRowPairs( Index start, Index end );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The width of the images in pixels.
+			Size width;
+			
+			
+			/// The height of the images in pixels.
+			Size height;
+			
+			
+			/// The horizontal field of view in degrees.
+			Float horizontalFieldOfView;
+			
+			
+			/// The maximum distance that the rays are traced to.
+			Float maxRange;
+			
+			
+			/// The number of images captured per second by update(), or 0 to capture at every update.
+			Float rate;
+			
+			
+			/// The unit direction of each pixel's ray in the sensor's frame.
+			Array<Vector3f> pixelDirections;
+			
+			
+			/// The cosine of the angle between each pixel's ray and the view direction, which converts range to depth.
+			Array<Float> depthScales;
+			
+			
+			/// The distance along each pixel's ray to the closest hit.
+			Array<Float> ranges;
+			
+			
+			/// The distance along the view direction to each pixel's closest hit.
+			Array<Float> depths;
+			
+			
+			/// Whether or not an image has been captured by update().
+			Bool hasCaptured;
+			
+			
+			/// The time on the rate's schedule that the last image was captured for by update().
+			Double captureTime;
+			
+			
+			/// The position of the capture in progress.
+			Vector3f capturePosition;
+			
+			
+			/// The orientation of the capture in progress.
+			Matrix3f captureOrientation;
+			
+			
+			/// The tree that the capture in progress traces rays through.
+			const CollisionTree* captureTree;
+			
+			
+			/// The number of images that have been captured since the statistics were reset.
+			Size numCaptures;
+			
+			
+			/// The number of rays that have been traced since the statistics were reset.
+			Size numRays;
+			
+			
+			/// The wall-clock time spent capturing images since the statistics were reset.
+			Time captureDuration;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_RANGE_SENSOR_H
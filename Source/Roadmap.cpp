@@ -8,412 +8,506 @@
  */
 
 #include "Roadmap.h"
+#include "MappedFile.h"
+#include "MeshPrimitiveSet.h"
+#include "Profiler.h"
 
 
-class Foo
+/// The radius of the sphere that must be able to move along a roadmap edge for the edge to be valid.
+static const Float EDGE_RADIUS = 2.0f;
+
+
+PROFILER_ZONE( linkZone, "Roadmap::link" );
+
+
+
+Roadmap:: Roadmap( const Pointer<GenericMeshShape>& mesh, threads::ThreadPool* threadPool )
+	:	collisionTree( Pointer<CollisionTree>::construct() ),
+		lazy( false ),
+		numBuildSamples( 0 ),
+		buildSeed( 0 )
 {
-	public:
-		
-		inline Foo( const Pointer<GenericBufferList>& b, Index i )
-			:	bufferList( b ),
-				indexOffset(i)
-		{
-		}
-		
-		inline Bool operator == ( const Foo& other ) const
-		{
-			return bufferList == other.bufferList;
-		}
-		
-		Pointer<GenericBufferList> bufferList;
-		Index indexOffset;
-};
+	MeshPrimitiveSet primitives( mesh );
+	sceneHash = primitives.getContentHash();
+	collisionTree->build( primitives, threadPool );
+}
 
 
 
 
-ArrayList<Triangle<Vector3f> > convertGenericMeshToMesh( const GenericMeshShape& genericMesh )
+Roadmap:: Roadmap( const Pointer<GenericMeshShape>& mesh, const data::UTF8String& collisionTreePath,
+					threads::ThreadPool* threadPool )
+	:	collisionTree( Pointer<CollisionTree>::construct() ),
+		lazy( false ),
+		numBuildSamples( 0 ),
+		buildSeed( 0 )
 {
-	ArrayList<Vector3f> vertices;
-	ArrayList< Triangle<Index> > triangles;
-	Index vertexOffset = 0;
-	
-	ArrayList<Foo> pastBuffers;
+	MeshPrimitiveSet primitives( mesh );
+	sceneHash = primitives.getContentHash();
 	
-	for ( Index g = 0; g < genericMesh.getGroupCount(); g++ )
+	// Only build the tree if there is no valid cached tree for this scene.
+	if ( !collisionTree->load( collisionTreePath, sceneHash ) )
 	{
-		const Pointer<GenericMeshGroup>& group = genericMesh.getGroup(g);
-		const BufferRange& bufferRange = group->getBufferRange();
-		
-		if ( bufferRange.getPrimitiveType() != IndexedPrimitiveType::TRIANGLES )
-			continue;
-		
-		//***********************************************************************
-		
-		const Pointer<GenericBufferList>& vertexBuffers = group->getVertexBuffers();
-		Index pastBufferIndex;
-		Index currentVertexOffset = 0;
-		
-		if ( !pastBuffers.getIndex( Foo( vertexBuffers, 0 ), pastBufferIndex ) )
-		{
-			Pointer<GenericBuffer> positionBuffer = vertexBuffers->getBufferWithUsage( VertexUsage::POSITION );
-			
-			if ( positionBuffer.isNull() )
-				continue;
-			
-			for ( Index i = 0; i < positionBuffer->getSize(); i++ )
-				vertices.add( positionBuffer->get<Vector3f>(i) );
-			
-			currentVertexOffset = vertexOffset;
-			pastBuffers.add( Foo( vertexBuffers, vertexOffset ) );
-			vertexOffset += positionBuffer->getSize();
-		}
-		else
-		{
-			currentVertexOffset = pastBuffers[pastBufferIndex].indexOffset;
-		}
-		
-		//***********************************************************************
-		
-		const Pointer<GenericBuffer>& indexBuffer = group->getIndexBuffer();
-		
-		if ( indexBuffer.isNull() )
-			continue;
-		
-		if ( indexBuffer->getAttributeType() == AttributeType::get<UInt32>() )
-		{
-			for ( Index i = 0; i < indexBuffer->getSize(); i += 3 )
-			{
-				Index v0 = currentVertexOffset + indexBuffer->get<UInt32>(i);
-				Index v1 = currentVertexOffset + indexBuffer->get<UInt32>(i + 1);
-				Index v2 = currentVertexOffset + indexBuffer->get<UInt32>(i + 2);
-				triangles.add( Triangle<Index>( v0, v1, v2 ) );
-			}
-		}
+		collisionTree->build( primitives, threadPool );
+		collisionTree->save( collisionTreePath, sceneHash );
 	}
+}
+
+
+
+
+Bool Roadmap:: link( const Vector3f& start, const Vector3f& end ) const
+{
+	PROFILER_SCOPE( linkZone );
 	
-	//***********************************************************************
-	
-	ArrayList<Triangle<Vector3f> > outputTriangles;
+	Float distance;
+	const Vector3f direction = (end - start).normalize( distance );
+	Float hitDistance;
 	
-	for ( Index t = 0; t < triangles.getSize(); t++ )
-	{
-		outputTriangles.add( Triangle<Vector3f>( vertices[triangles[t].v1], vertices[triangles[t].v2], vertices[triangles[t].v3] ) );
-	}
+	return !collisionTree->traceRay( start, direction, distance, hitDistance );
+}
+
+
+
+
+Bool Roadmap:: link( const Vector3f& start, const Vector3f& end, Float radius ) const
+{
+	PROFILER_SCOPE( linkZone );
 	
-	return outputTriangles;
+	return !collisionTree->intersectsCapsule( start, end, radius );
 }
 
 
 
 
-class Roadmap:: TriangleSet : public bvh::PrimitiveInterface
+Bool Roadmap:: validateEdge( Index nodeIndex, Index neighborIndex ) const
 {
-	public:
-		
-		TriangleSet( const Pointer<GenericMeshShape>& mesh )
-			:	triangles( convertGenericMeshToMesh( *mesh ) )
-		{
-		}
-		
-		
-		virtual Size getSize() const
-		{
-			return triangles.getSize();
-		}
-		
-		virtual PrimitiveInterfaceType getType() const
-		{
-			return PrimitiveInterfaceType::TRIANGLES;
-		}
-		
-		
-		
-		virtual AABB3f getAABB( Index primitiveIndex ) const
-		{
-			const Triangle<Vector3f>& t = triangles[primitiveIndex];
-			AABB3f result( t.v1 );
-			result.enlargeFor( t.v2 );
-			result.enlargeFor( t.v3 );
-			
-			return result;
-		}
-		
-		
-		virtual bvh::BoundingSphere<Float> getBoundingSphere( Index primitiveIndex ) const
-		{
-			const Triangle<Vector3f>& t = triangles[primitiveIndex];
-			return bvh::BoundingSphere<Float>( t.v1, t.v2, t.v3 );
-		}
-		
-		
-		virtual Bool intersectRay( Index primitiveIndex, const Ray3f& ray, Float& distance ) const
-		{
-			return true;
-		}
-		
+	const Node& node = nodes[nodeIndex];
+	UByte& state = node.edgeStates[neighborIndex];
+	
+	if ( state == EDGE_UNCHECKED )
+	{
+		const Index otherIndex = node.neighbors[neighborIndex];
+		const Node& other = nodes[otherIndex];
 		
+		state = link( node.position, other.position, EDGE_RADIUS ) ? EDGE_VALID : EDGE_INVALID;
 		
-		virtual Bool intersectRay( const Index* primitiveIndices, Size numPrimitives,
-									const Ray3f& ray, Float& distance, Index& closestPrimitive ) const
+		// Store the result on the reverse edge too, so that it isn't tested again from the other node.
+		for ( Index n = 0; n < other.neighbors.getSize(); n++ )
 		{
-			return true;
+			if ( other.neighbors[n] == nodeIndex )
+				other.edgeStates[n] = state;
 		}
+	}
+	
+	return state == EDGE_VALID;
+}
+
+
+
+
+void Roadmap:: linkEdges( const ArrayList<Edge>& edges, Float radius, Array<UInt32>& visibleMask,
+						threads::ThreadPool* threadPool ) const
+{
+	const Size numEdges = edges.getSize();
+	const Size numWords = (numEdges + 31) / 32;
+	
+	// Only grow the mask, so that a caller's mask is reused from one call to the next.
+	if ( visibleMask.getSize() < numWords )
+		visibleMask.setSize( numWords );
+	
+	visibleMask.setAll( UInt32(0) );
+	
+	EdgeBatch batch;
+	batch.edges = &edges;
+	batch.radius = radius;
+	batch.visibleMask = &visibleMask;
+	
+	const Size numThreads = threadPool != NULL ? threadPool->getThreadCount() : 0;
+	
+	if ( numThreads > 1 && numWords > 1 )
+	{
+		// Split the edges on mask word boundaries so that no two jobs write the same word.
+		const Size numJobs = math::min( numWords, numThreads*4 );
 		
-		
-		
-		virtual Bool getTriangle( Index primitiveIndex, Vector3f& v0, Vector3f& v1, Vector3f& v2 ) const
+		for ( Index j = 0; j < numJobs; j++ )
 		{
-			if ( primitiveIndex < triangles.getSize() )
-			{
-				const Triangle<Vector3f>& t = triangles[primitiveIndex];
-				
-				v0 = t.v1;
-				v1 = t.v2;
-				v2 = t.v3;
-				
-				return true;
-			}
+			const Index start = ((j*numWords) / numJobs)*32;
+			const Index end = math::min( (((j + 1)*numWords) / numJobs)*32, numEdges );
 			
-			return false;
+			threadPool->addJob( bindCall( &Roadmap::linkEdgeRange, this, (const EdgeBatch*)&batch, start, end ) );
 		}
 		
-		
-	private:
-		
-		ArrayList< Triangle<Vector3f> > triangles;
-		
-};
+		threadPool->finishJobs();
+	}
+	else
+		linkEdgeRange( &batch, 0, numEdges );
+}
+
+
 
 
+void Roadmap:: linkEdgeRange( const EdgeBatch* batch, Index start, Index end ) const
+{
+	const ArrayList<Edge>& edges = *batch->edges;
+	Array<UInt32>& visibleMask = *batch->visibleMask;
+	
+	for ( Index i = start; i < end; i++ )
+	{
+		if ( !collisionTree->intersectsCapsule( edges[i].start, edges[i].end, batch->radius ) )
+			visibleMask[i >> 5] |= UInt32(1) << (i & 31);
+	}
+}
+
 
 
 
-Roadmap:: Roadmap( const Pointer<GenericMeshShape>& mesh )
+void Roadmap:: rebuild( const AABB3f& bounds, Size numSamples, const Vector3f& start, const Vector3f& goal,
+						threads::ThreadPool* threadPool )
 {
-	bvh = Pointer<AABBTree4>::construct( Pointer<TriangleSet>::construct( mesh ) );
-	bvh->rebuild();
+	nodes.clear();
+	nodes.add( Node( start ) );
+	nodes.add( Node( goal ) );
+	addRandomNodes( bounds, numSamples );
+	linkNodes( threadPool );
 }
 
 
 
 
-Bool Roadmap:: link( const Vector3f& start, const Vector3f& end ) const
+void Roadmap:: rebuild( const AABB3f& bounds, Size numSamples, threads::ThreadPool* threadPool )
 {
-	Float distance;
-	Ray3f ray( start, (end - start).normalize( distance ) );
-	
-	return !bvh->traceRay( ray, distance, stack.getRoot() );
+	nodes.clear();
+	addRandomNodes( bounds, numSamples );
+	linkNodes( threadPool );
 }
 
 
 
 
-static Float getSphereHalfAngleSize( Float observerDistance, Float sphereRadius )
+void Roadmap:: addRandomNodes( const AABB3f& bounds, Size numSamples )
 {
-	const Float hypotenuseSquared = math::square(observerDistance) - math::square(sphereRadius);
-	const Float sphereHalfAngle = hypotenuseSquared > 0 ? math::acos( math::sqrt( hypotenuseSquared ) / observerDistance ) : Float(0);
+	buildBounds = bounds;
+	numBuildSamples = numSamples;
+	buildSeed = randomVariable.getSeed();
 	
-	return sphereHalfAngle;
+	for ( Index i = 0; i < numSamples; i++ )
+	{
+		Vector3f p( randomVariable.sample( bounds.min.x, bounds.max.x ),
+					randomVariable.sample( bounds.min.y, bounds.max.y ),
+					randomVariable.sample( bounds.min.z, bounds.max.z ) );
+		
+		nodes.add( Node( p ) );
+	}
 }
 
 
 
 
-static Vector3f getRandomDirectionInZCone( math::RandomVariable<Float>& variable, Real halfAngle )
+void Roadmap:: buildNodeIndex()
 {
-	Real u1 = variable.sample( math::cos(halfAngle), Real(1) );
-	Real u2 = variable.sample( Real(0), Real(1) );
-	Real r = math::sqrt( Real(1) - u1*u1 );
-	Real theta = Real(2)*math::pi<Real>()*u2;
+	ArrayList<Vector3f> positions( nodes.getSize() );
+	
+	for ( Index i = 0; i < nodes.getSize(); i++ )
+		positions.add( nodes[i].position );
 	
-	return Vector3f( r*math::cos( theta ), r*math::sin( theta ), u1 );
+	nodeIndex.build( positions );
 }
 
 
 
-static Bool rayIntersectsSphere( const Ray3f& ray, const bvh::BoundingSphere<Float>& sphere, Real& distanceAlongRay )
+
+void Roadmap:: addEdge( Index node1, Index node2, EdgeState state )
 {
-	Vector3 d = sphere.position - ray.origin;
-	Real dSquared = d.getMagnitudeSquared();
-	Real rSquared = sphere.radius*sphere.radius;
-	
-	if ( dSquared < rSquared )
-	{
-		// The ray starts inside the sphere and therefore we have an intersection.
-		distanceAlongRay = Real(0);
-		
-		return true;
-	}
-	else
-	{
-		// Find the closest point on the ray to the sphere's center.
-		Real t1 = math::dot( d, ray.direction );
-		
-		if ( t1 < math::epsilon<Real>() )
-		{
-			// The ray points away from the sphere so there is no intersection.
-			return false;
-		}
-		
-		// Find the distance from the closest point to the sphere's surface.
-		Real t2Squared = rSquared - dSquared + t1*t1;
-		
-		if ( t2Squared < math::epsilon<Real>() )
-			return false;
-		
-		// Compute the distance along the ray of the intersection.
-		distanceAlongRay = t1 - math::sqrt(t2Squared);
-		
-		return true;
-	}
+	nodes[node1].neighbors.add( node2 );
+	nodes[node1].edgeStates.add( UByte(state) );
+	nodes[node2].neighbors.add( node1 );
+	nodes[node2].edgeStates.add( UByte(state) );
 }
 
 
 
 
-Bool Roadmap:: link( const Vector3f& start, const Vector3f& end, Float radius, Size numSamples ) const
+void Roadmap:: linkNodes( threads::ThreadPool* threadPool )
 {
-	Vector3f detectorDirection = start - end;
-	Float detectorDistance = detectorDirection.getMagnitude();
-	detectorDirection /= detectorDistance;
+	// Index the node positions so that the candidate neighbors can be found quickly.
+	buildNodeIndex();
 	
-	// Compute the angular size of the detector.
-	const Float detectorHalfAngle = getSphereHalfAngleSize( detectorDistance, radius );
+	const Size numNodes = nodes.getSize();
+	const Size maxNeighbors = MAX_NEIGHBORS;
+	const Size maxCandidates = 2*maxNeighbors;
 	
-	// Compute the rotation matrix for the direction samples.
-	Matrix3f detectorRotation = Matrix3::planeBasis( detectorDirection );
+	//****************************************************************************
+	// Find the nearest candidates for each node, in order of increasing distance.
+	// The candidate lists include the node itself, so ask for one extra.
 	
-	// Take samples to determine the detector's visibility.
-	Size numVisible = 0;
+	ArrayList<KDTree::Neighbor> neighbors;
+	ArrayList<Index> candidates( numNodes*maxCandidates );
+	ArrayList<Index> candidateCounts( numNodes );
 	
-	for ( Index i = 0; i < numSamples; i++ )
+	for ( Index i = 0; i < numNodes; i++ )
 	{
-		// Generate a ray that samples the detectors's visibility.
-		Ray3f validationRay( end, 
-							detectorRotation*getRandomDirectionInZCone( randomVariable, detectorHalfAngle ) );
+		nodeIndex.getKNearest( nodes[i].position, maxCandidates + 1, neighbors );
+		Size numCandidates = 0;
 		
-		// Determine the distance along the ray where the sphere is intersected.
-		Float rayDistance;
+		for ( Index c = 0; c < neighbors.getSize() && numCandidates < maxCandidates; c++ )
+		{
+			if ( neighbors[c].index != i )
+			{
+				candidates.add( neighbors[c].index );
+				numCandidates++;
+			}
+		}
 		
-		if ( !rayIntersectsSphere( validationRay, bvh::BoundingSphere<Float>( start, radius ), rayDistance ) )
-			continue;
+		// Pad the candidate list so that each node's candidates start at i*maxCandidates.
+		for ( Index c = numCandidates; c < maxCandidates; c++ )
+			candidates.add( i );
 		
-		// Trace a ray to see if that point is visible.
-		if ( !bvh->traceRay( validationRay, rayDistance, stack.getRoot() ) )
-			numVisible++;
+		candidateCounts.add( numCandidates );
 	}
 	
-	return numVisible == numSamples;
-}
-
-
-
-
-void Roadmap:: rebuild( const AABB3f& bounds, Size numSamples, const Vector3f& start, const Vector3f& goal )
-{
-	nodes.clear();
-	nodes.add( Node( start ) );
-	nodes.add( Node( goal ) );
+	//****************************************************************************
+	// In lazy mode, link each node to all of its candidates without testing them.
+	// The extra candidates stand in for the ones that the eager test would reject.
 	
-	for ( Index i = 0; i < numSamples; i++ )
+	if ( lazy )
 	{
-		Vector3f p( math::random( bounds.min.x, bounds.max.x ),
-					math::random( bounds.min.y, bounds.max.y ),
-					math::random( bounds.min.z, bounds.max.z ) );
+		for ( Index i = 0; i < numNodes; i++ )
+		{
+			for ( Index c = 0; c < candidateCounts[i]; c++ )
+			{
+				const Index j = candidates[i*maxCandidates + c];
+				
+				if ( !nodes[i].neighbors.contains( j ) )
+					addEdge( i, j, EDGE_UNCHECKED );
+			}
+		}
 		
-		nodes.add( Node( p ) );
+		return;
 	}
 	
-	const Float distanceThreshold = 100.0;
-	const Float distanceThreshold2 = distanceThreshold*distanceThreshold;
-	const Size maxNeighbors = 10;
-	ArrayList< Tuple<Index,Float> > neighbors;
+	//****************************************************************************
+	// Test the visibility of each unique candidate pair in one batch.
 	
-	for ( Index i = 0; i < nodes.getSize(); i++ )
+	ArrayList<Edge> edges;
+	ArrayList<Index> edgeIndices( numNodes*maxCandidates );
+	
+	for ( Index i = 0; i < numNodes; i++ )
 	{
-		const Vector3f& p1 = nodes[i].position;
-		Float maxNeighborDist = 0;
-		
-		for ( Index j = i + 1; j < nodes.getSize(); j++ )
+		for ( Index c = 0; c < maxCandidates; c++ )
 		{
-			const Vector3f& p2 = nodes[j].position;
-			Float distSquared = p1.getDistanceToSquared(p2);
+			const Index j = candidates[i*maxCandidates + c];
+			Index edgeIndex = math::max<Index>();
 			
-			if ( neighbors.getSize() < maxNeighbors || distSquared < maxNeighborDist )
+			if ( c < candidateCounts[i] )
 			{
-				if ( link( p1, p2, 2.0f ) && link( p2, p1, 2.0f ) )
-				//if ( link( p1, p2 ) )
+				// Reuse the edge if the pair was already added from the other node.
+				if ( j < i )
 				{
-					if ( neighbors.getSize() < maxNeighbors )
-					{
-						neighbors.add( Tuple<Index,Float>( j, distSquared ) );
-						maxNeighborDist = math::max( distSquared, maxNeighborDist );
-					}
-					else
+					for ( Index d = 0; d < candidateCounts[j]; d++ )
 					{
-						Index maxIndex = 0;
-						Float maxDist = 0;
-						
-						for ( Index k = 0; k < neighbors.getSize(); k++ )
+						if ( candidates[j*maxCandidates + d] == i )
 						{
-							if ( neighbors[k].value2 > maxDist )
-							{
-								maxDist = neighbors[k].value2;
-								maxIndex = k;
-							}
+							edgeIndex = edgeIndices[j*maxCandidates + d];
+							break;
 						}
-						
-						neighbors[maxIndex] = Tuple<Index,Float>( j, distSquared );
-						maxNeighborDist = math::max( distSquared, maxDist );
 					}
 				}
+				
+				if ( edgeIndex == math::max<Index>() )
+				{
+					edgeIndex = edges.getSize();
+					edges.add( Edge( nodes[i].position, nodes[j].position ) );
+				}
 			}
+			
+			edgeIndices.add( edgeIndex );
 		}
-		
-		for ( Index j = 0; j < neighbors.getSize(); j++ )
+	}
+	
+	Array<UInt32> visibleMask;
+	linkEdges( edges, EDGE_RADIUS, visibleMask, threadPool );
+	
+	//****************************************************************************
+	// Link each node to its nearest visible candidates.
+	
+	for ( Index i = 0; i < numNodes; i++ )
+	{
+		for ( Index c = 0; c < candidateCounts[i] && nodes[i].neighbors.getSize() < maxNeighbors; c++ )
 		{
-			nodes[i].neighbors.add( neighbors[j].value1 );
-			nodes[neighbors[j].value1].neighbors.add( i );
+			const Index j = candidates[i*maxCandidates + c];
+			
+			if ( isEdgeVisible( visibleMask, edgeIndices[i*maxCandidates + c] ) && !nodes[i].neighbors.contains( j ) )
+				addEdge( i, j, EDGE_VALID );
 		}
-		
-		neighbors.clear();
 	}
 }
 
 
 
 
-Bool Roadmap:: traceRay( const Vector3f& start, const Vector3f& direction, Float maxDistance, Float& t )
+/// The value stored at the start of every roadmap file, the characters 'RMAP' in little-endian order.
+static const UInt32 ROADMAP_FILE_MAGIC = 0x50414D52;
+
+
+/// The current version of the roadmap file layout.
+static const UInt32 ROADMAP_FILE_VERSION = 3;
+
+
+
+
+Bool Roadmap:: save( const data::UTF8String& filePath ) const
 {
-	Ray3f ray( start, direction.normalize() );
-	Index primitive;
+	const Size numNodes = nodes.getSize();
+	
+	// Flatten the node positions and neighbor lists into the arrays that are stored in the file.
+	Array<Float32> positions( 3*numNodes );
+	Array<UInt32> offsets( numNodes + 1 );
+	ArrayList<UInt32> neighbors;
+	
+	for ( Index i = 0; i < numNodes; i++ )
+	{
+		const Node& node = nodes[i];
+		positions[3*i] = node.position.x;
+		positions[3*i + 1] = node.position.y;
+		positions[3*i + 2] = node.position.z;
+		offsets[i] = UInt32(neighbors.getSize());
+		
+		for ( Index n = 0; n < node.neighbors.getSize(); n++ )
+		{
+			if ( validateEdge( i, n ) )
+				neighbors.add( UInt32(node.neighbors[n]) );
+		}
+	}
+	
+	offsets[numNodes] = UInt32(neighbors.getSize());
+	
+	FileHeader header;
+	header.magic = ROADMAP_FILE_MAGIC;
+	header.version = ROADMAP_FILE_VERSION;
+	header.sceneHash = sceneHash;
+	header.numNodes = UInt32(numNodes);
+	header.numNeighbors = UInt32(neighbors.getSize());
+	header.bounds[0] = buildBounds.min.x;
+	header.bounds[1] = buildBounds.min.y;
+	header.bounds[2] = buildBounds.min.z;
+	header.bounds[3] = buildBounds.max.x;
+	header.bounds[4] = buildBounds.max.y;
+	header.bounds[5] = buildBounds.max.z;
+	header.numSamples = UInt32(numBuildSamples);
+	header.maxNeighbors = UInt32(MAX_NEIGHBORS);
+	header.seed = buildSeed;
+	header.reserved = 0;
+	
+	rim::io::FileWriter writer( filePath );
+	
+	if ( !writer.open() )
+		return false;
+	
+	const Size positionsSize = sizeof(Float32)*positions.getSize();
+	const Size offsetsSize = sizeof(UInt32)*offsets.getSize();
+	const Size neighborsSize = sizeof(UInt32)*neighbors.getSize();
 	
-	return bvh->traceRay( ray, maxDistance, stack.getRoot(), t, primitive );
+	const Bool result = writer.write( (const UByte*)&header, sizeof(FileHeader) ) == sizeof(FileHeader) &&
+						writer.write( (const UByte*)positions.getPointer(), positionsSize ) == positionsSize &&
+						writer.write( (const UByte*)offsets.getPointer(), offsetsSize ) == offsetsSize &&
+						writer.write( (const UByte*)neighbors.getPointer(), neighborsSize ) == neighborsSize;
+	
+	writer.close();
+	
+	return result;
 }
 
 
 
 
-Index Roadmap:: getClosestNode( const Vector3f& position ) const
+Bool Roadmap:: load( const data::UTF8String& filePath, const AABB3f& bounds, Size numSamples )
 {
-	const Size numNodes = nodes.getSize();
-	Float minDistance = math::max<Float>();
-	Index minIndex = 0;
+	MappedFile file;
+	
+	if ( !file.open( filePath ) || file.getSize() < sizeof(FileHeader) )
+		return false;
+	
+	const FileHeader& header = *(const FileHeader*)file.getData();
+	const UInt32 seed = randomVariable.getSeed();
+	
+	if ( header.magic != ROADMAP_FILE_MAGIC || header.version != ROADMAP_FILE_VERSION ||
+		header.sceneHash != sceneHash )
+		return false;
+	
+	// Reject a roadmap that was built with different settings, since rebuilding would give a different one.
+	if ( header.bounds[0] != bounds.min.x || header.bounds[1] != bounds.min.y || header.bounds[2] != bounds.min.z ||
+		header.bounds[3] != bounds.max.x || header.bounds[4] != bounds.max.y || header.bounds[5] != bounds.max.z ||
+		header.numSamples != numSamples || header.maxNeighbors != MAX_NEIGHBORS || header.seed != seed )
+		return false;
+	
+	const Size numNodes = header.numNodes;
+	const Size numNeighbors = header.numNeighbors;
+	
+	// Make sure that the file is exactly as large as its header says, so the arrays can be read in place.
+	const UInt64 expectedSize = UInt64(sizeof(FileHeader)) + UInt64(sizeof(Float32))*3*UInt64(numNodes) +
+								UInt64(sizeof(UInt32))*(UInt64(numNodes) + 1) + UInt64(sizeof(UInt32))*UInt64(numNeighbors);
+	
+	if ( UInt64(file.getSize()) != expectedSize )
+		return false;
+	
+	const Float32* positions = (const Float32*)(file.getData() + sizeof(FileHeader));
+	const UInt32* offsets = (const UInt32*)(positions + 3*numNodes);
+	const UInt32* neighbors = offsets + numNodes + 1;
+	
+	// Validate the neighbor lists before replacing the current nodes.
+	if ( offsets[0] != 0 || offsets[numNodes] != numNeighbors )
+		return false;
+	
+	for ( Index i = 0; i < numNodes; i++ )
+	{
+		if ( offsets[i + 1] < offsets[i] )
+			return false;
+	}
+	
+	for ( Index n = 0; n < numNeighbors; n++ )
+	{
+		if ( neighbors[n] >= numNodes )
+			return false;
+	}
+	
+	nodes.clear();
 	
 	for ( Index i = 0; i < numNodes; i++ )
 	{
-		Float distance = nodes[i].position.getDistanceTo( position );
+		nodes.add( Node( Vector3f( positions[3*i], positions[3*i + 1], positions[3*i + 2] ) ) );
 		
-		if ( distance < minDistance )
+		for ( Index n = offsets[i]; n < offsets[i + 1]; n++ )
 		{
-			minDistance = distance;
-			minIndex = i;
+			nodes[i].neighbors.add( neighbors[n] );
+			nodes[i].edgeStates.add( UByte(EDGE_VALID) );
 		}
 	}
 	
-	return minIndex;
+	buildNodeIndex();
+	
+	buildBounds = bounds;
+	numBuildSamples = numSamples;
+	buildSeed = seed;
+	
+	return true;
 }
 
 
 
+
+Bool Roadmap:: traceRay( const Vector3f& start, const Vector3f& direction, Float maxDistance, Float& t ) const
+{
+	return collisionTree->traceRay( start, direction.normalize(), maxDistance, t );
+}
+
+
+
+
+Index Roadmap:: getClosestNode( const Vector3f& position ) const
+{
+	Index closestIndex = 0;
+	nodeIndex.getNearest( position, closestIndex );
+	
+	return closestIndex;
+}
@@ -12,6 +12,8 @@
 
 
 #include "rim/rimEngine.h"
+#include "KDTree.h"
+#include "CollisionTree.h"
 using namespace rim;
 using namespace rim::bvh;
 using namespace rim::graphics;
@@ -22,6 +24,21 @@ class Roadmap
 {
 	public:
 		
+		/// An enum type which specifies whether or not the collision check of a roadmap edge has been done.
+		enum EdgeState
+		{
+			/// The edge hasn't been checked for collisions yet.
+			EDGE_UNCHECKED = 0,
+			
+			/// The edge was checked and a vehicle can fly along it.
+			EDGE_VALID = 1,
+			
+			/// The edge was checked and it is blocked by the scene.
+			EDGE_INVALID = 2
+		};
+		
+		
+		
 		/// A node in a roadmap.
 		class Node
 		{
@@ -39,6 +56,9 @@ class Roadmap
 				/// A list of the node indices of the neighbors to this node.
 				ArrayList<Index> neighbors;
 				
+				/// The EdgeState of the edge to each neighbor, memoized when the edge is checked.
+				mutable ArrayList<UByte> edgeStates;
+				
 				/// In the A* algorithm, this value stores the index of the previous node in the path so it can be reconstructed.
 				Index previous;
 				
@@ -47,7 +67,43 @@ class Roadmap
 		
 		
 		
-		Roadmap( const Pointer<GenericMeshShape>& mesh );
+		/// A candidate edge whose visibility should be tested.
+		class Edge
+		{
+			public:
+				
+				inline Edge( const Vector3f& newStart, const Vector3f& newEnd )
+					:	start( newStart ),
+						end( newEnd )
+				{
+				}
+				
+				/// The first endpoint of the edge.
+				Vector3f start;
+				
+				/// The second endpoint of the edge.
+				Vector3f end;
+		
+		
+		};
+		
+		
+		
+		/// Create a new empty roadmap for the specified scene mesh.
+		/**
+		  * If a thread pool is given, the scene's collision tree is built in parallel.
+		  */
+		Roadmap( const Pointer<GenericMeshShape>& mesh, threads::ThreadPool* threadPool = NULL );
+		
+		
+		/// Create a new empty roadmap for the specified scene mesh, caching its collision tree in a file.
+		/**
+		  * If the file holds a tree for the same mesh, the tree is mapped from the file
+		  * instead of being built. Otherwise, the tree is built and written to the file.
+		  * Copies of a roadmap share the same collision tree.
+		  */
+		Roadmap( const Pointer<GenericMeshShape>& mesh, const data::UTF8String& collisionTreePath,
+				threads::ThreadPool* threadPool = NULL );
 		
 		
 		
@@ -56,24 +112,152 @@ class Roadmap
 		Bool link( const Vector3f& start, const Vector3f& end ) const;
 		
 		
-		/// Return whether or not the specified start and end positions are visible to each other.
-		Bool link( const Vector3f& start, const Vector3f& end, Float radius, Size numSamples = 50 ) const;
+		/// Return whether or not a vehicle with the specified radius can fly from the start to the end position.
+		/**
+		  * This is an exact test of the capsule that the vehicle sweeps out against the scene.
+		  */
+		Bool link( const Vector3f& start, const Vector3f& end, Float radius ) const;
+		
+		
+		/// Test the visibility of a list of edges, writing the result for edge i to bit (i % 32) of word (i / 32).
+		/**
+		  * An edge is visible if a sphere of the given radius can move along it without
+		  * touching the scene, as in link(). If a thread pool is given, the edges are
+		  * spread across its worker threads. The mask is only resized if it is too small
+		  * for the edges, and it is cleared first, so a caller can keep it between calls
+		  * to avoid allocating. This method is safe to call from multiple threads.
+		  */
+		void linkEdges( const ArrayList<Edge>& edges, Float radius, Array<UInt32>& visibleMask,
+						threads::ThreadPool* threadPool = NULL ) const;
+		
+		
+		/// Return whether or not the edge with the given index is marked visible in an edge visibility mask.
+		static inline Bool isEdgeVisible( const Array<UInt32>& visibleMask, Index edgeIndex )
+		{
+			return (visibleMask[edgeIndex >> 5] & (UInt32(1) << (edgeIndex & 31))) != 0;
+		}
+		
+		
+		
+		/// Return whether or not the edge from a node to the neighbor at the given index in its neighbor list is valid.
+		/**
+		  * If the edge hasn't been checked yet, it is tested with link() and the result is
+		  * stored on the edge in both directions, so each edge is only ever tested once.
+		  * Since the result is written to the roadmap, a lazy roadmap must not be
+		  * searched from more than one thread at a time.
+		  */
+		Bool validateEdge( Index nodeIndex, Index neighborIndex ) const;
+		
+		
+		
+		/// Find the distance along a ray to the closest point where it hits the scene.
+		Bool traceRay( const Vector3f& start, const Vector3f& direction, Float maxDistance, Float& t ) const;
+		
+		
+		
+		/// Return whether or not rebuild() defers the collision checks of the edges until a search needs them.
+		inline Bool isLazy() const
+		{
+			return lazy;
+		}
+		
+		
+		/// Set whether or not rebuild() defers the collision checks of the edges until a search needs them.
+		/**
+		  * In lazy mode, each node is linked to its nearest candidates without testing the
+		  * edges. The planners then only test the edges of the paths that they find with
+		  * validateEdge(), and search again around any edge that is blocked. This makes
+		  * building the roadmap cheap, and a query only pays for the edges near its path.
+		  */
+		inline void setLazy( Bool newLazy )
+		{
+			lazy = newLazy;
+		}
+		
+		
+		/// Reset the random stream that rebuild() samples the node positions from to the specified seed.
+		/**
+		  * Roadmaps are seeded from the clock by default, so this is needed to rebuild
+		  * the same roadmap on every run.
+		  */
+		inline void setRandomSeed( UInt32 newSeed )
+		{
+			randomVariable.setSeed( newSeed );
+		}
+		
+		
+		
+		/// Rebuild the roadmap with random samples in the given bounds, plus the start and goal nodes.
+		/**
+		  * If a thread pool is given, the visibility of the candidate edges is tested in parallel.
+		  */
+		void rebuild( const AABB3f& bounds, Size numSamples, const Vector3f& start, const Vector3f& goal,
+						threads::ThreadPool* threadPool = NULL );
+		
 		
+		/// Rebuild the roadmap with only random samples in the given bounds.
+		/**
+		  * This is used to precompute a dense roadmap for a whole scene that can be saved and
+		  * reused by later queries, which only need to connect their start and goal to it.
+		  */
+		void rebuild( const AABB3f& bounds, Size numSamples, threads::ThreadPool* threadPool = NULL );
 		
 		
-		Bool traceRay( const Vector3f& start, const Vector3f& direction, Float maxDistance, Float& t );
 		
 		
+		/// Write the roadmap's nodes and connectivity to a binary file at the given path.
+		/**
+		  * The file stores the scene hash and the settings of the last rebuild, followed by the
+		  * node positions and the neighbor lists as flat arrays in native byte order, so that
+		  * it can be memory-mapped when it is loaded. Any edges that haven't been checked are
+		  * checked first, and only the valid edges are written. The method returns whether
+		  * or not the file was successfully written.
+		  */
+		Bool save( const data::UTF8String& filePath ) const;
 		
-		void rebuild( const AABB3f& bounds, Size numSamples, const Vector3f& start, const Vector3f& goal );
 		
+		/// Replace the roadmap's nodes and connectivity with those stored in a file written by save().
+		/**
+		  * The file is memory-mapped and validated. It is rejected unless it was built for
+		  * this roadmap's scene with the given bounds and sample count, the current neighbor
+		  * count, and the roadmap's current random seed, so a stale cache is never used. The
+		  * seed should therefore be set with setRandomSeed() first. The arrays are copied
+		  * into the nodes, which own their neighbor lists. If the method returns FALSE,
+		  * the roadmap is left unchanged.
+		  */
+		Bool load( const data::UTF8String& filePath, const AABB3f& bounds, Size numSamples );
 		
 		
+		/// Return a reference to the tree that is used to test the scene for collisions with a vehicle.
+		inline const CollisionTree& getCollisionTree() const
+		{
+			return *collisionTree;
+		}
+		
+		
+		/// Return a hash of the scene geometry that this roadmap was built for.
+		inline UInt64 getSceneHash() const
+		{
+			return sceneHash;
+		}
+		
 		
-		/// Return the index of the node in the roadmap that is closest (and visible to) the specified point.
+		
+		
+		/// Return the index of the node in the roadmap that is closest to the specified point.
+		/**
+		  * The query is answered using the roadmap's spatial index in logarithmic time.
+		  */
 		Index getClosestNode( const Vector3f& position ) const;
 		
 		
+		/// Return a reference to the spatial index of the node positions in this roadmap.
+		inline const KDTree& getNodeIndex() const
+		{
+			return nodeIndex;
+		}
+		
+		
 		
 		
 		/// Return the number of nodes that are in this roadmap.
@@ -93,20 +277,107 @@ class Roadmap
 		
 	private:
 		
-		/// An object used as the interface to the BVH.
-		class TriangleSet;
+		/// A class that stores the shared parameters for a batch of edge visibility tests.
+		class EdgeBatch
+		{
+			public:
+				
+				const ArrayList<Edge>* edges;
+				Float radius;
+				Array<UInt32>* visibleMask;
+		
+		};
+		
+		
+		/// Test the visibility of the edges in the range [start, end) of a batch.
+		void linkEdgeRange( const EdgeBatch* batch, Index start, Index end ) const;
+		
+		
+		/// The header at the start of a roadmap file, followed by the position, offset and neighbor arrays.
+		class FileHeader
+		{
+			public:
+				
+				/// A value that identifies the file as a roadmap file.
+				UInt32 magic;
+				
+				/// The version of the file layout.
+				UInt32 version;
+				
+				/// The hash of the scene geometry that the roadmap was built for.
+				UInt64 sceneHash;
+				
+				/// The number of nodes in the roadmap.
+				UInt32 numNodes;
+				
+				/// The total length of all of the neighbor lists.
+				UInt32 numNeighbors;
+				
+				/// The minimum and maximum corners of the bounds that the nodes were sampled in.
+				Float32 bounds[6];
+				
+				/// The number of random samples that the roadmap was built with.
+				UInt32 numSamples;
+				
+				/// The maximum number of neighbors that each node was linked to.
+				UInt32 maxNeighbors;
+				
+				/// The seed of the random stream before the nodes were sampled.
+				UInt32 seed;
+				
+				/// Unused space that pads the header to a multiple of 8 bytes.
+				UInt32 reserved;
+		
+		};
+		
+		
+		/// The maximum number of neighbors that each node is linked to.
+		static const Size MAX_NEIGHBORS = 10;
+		
+		
+		/// Add the specified number of nodes at random positions within the bounds, remembering them as the build settings.
+		void addRandomNodes( const AABB3f& bounds, Size numSamples );
+		
+		
+		/// Build the spatial index for the current nodes and link each node to its nearest visible neighbors.
+		void linkNodes( threads::ThreadPool* threadPool );
+		
+		
+		/// Rebuild the spatial index of the node positions.
+		void buildNodeIndex();
+		
+		
+		/// Add an edge with the specified state between two nodes, in both of their neighbor lists.
+		void addEdge( Index node1, Index node2, EdgeState state );
 		
 		
 		ArrayList<Node> nodes;
 		
-			
-		/// A pointer to a BVH used for ray tracing in the scene.
-		Pointer<BVH> bvh;
+		/// A spatial index of the node positions, used for nearest-neighbor queries.
+		KDTree nodeIndex;
 		
-		TraversalStack stack;
 		
-		mutable RandomVariable<Float> randomVariable;
+		/// A tree of the scene's triangles used for ray and visibility tests, shared by copies of the roadmap.
+		Pointer<CollisionTree> collisionTree;
 		
+		/// A hash of the scene's triangles, used to detect stale roadmap and collision tree files.
+		UInt64 sceneHash;
+		
+		/// Whether or not rebuild() defers the collision checks of the edges until a search needs them.
+		Bool lazy;
+		
+		/// The bounds that the nodes of the last rebuild were sampled in.
+		AABB3f buildBounds;
+		
+		/// The number of random samples of the last rebuild.
+		Size numBuildSamples;
+		
+		/// The seed of the random stream before the nodes of the last rebuild were sampled.
+		UInt32 buildSeed;
+		
+		/// The random stream that the positions of new nodes are sampled from.
+		RandomVariable<Float> randomVariable;
+
 };
 
 
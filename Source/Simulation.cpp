@@ -8,6 +8,43 @@
  */
 
 #include "Simulation.h"
+#include "Profiler.h"
+
+
+PROFILER_ZONE( simulationUpdateZone, "Simulation::update" );
+
+
+/// The Dormand-Prince stage coefficients. Each row holds the weights of the previous stages' derivatives.
+/**
+  * The last row is also the weights of the fifth-order solution, so the derivative
+  * of the last stage is the first derivative of the next step.
+  */
+static const Float DP_A[7][6] =
+{
+	{ 0, 0, 0, 0, 0, 0 },
+	{ 1.0f/5.0f, 0, 0, 0, 0, 0 },
+	{ 3.0f/40.0f, 9.0f/40.0f, 0, 0, 0, 0 },
+	{ 44.0f/45.0f, -56.0f/15.0f, 32.0f/9.0f, 0, 0, 0 },
+	{ 19372.0f/6561.0f, -25360.0f/2187.0f, 64448.0f/6561.0f, -212.0f/729.0f, 0, 0 },
+	{ 9017.0f/3168.0f, -355.0f/33.0f, 46732.0f/5247.0f, 49.0f/176.0f, -5103.0f/18656.0f, 0 },
+	{ 35.0f/384.0f, 0, 500.0f/1113.0f, 125.0f/192.0f, -2187.0f/6784.0f, 11.0f/84.0f }
+};
+
+/// The fractions of a step at which the Dormand-Prince stages are evaluated.
+static const Float DP_C[7] = { 0, 1.0f/5.0f, 3.0f/10.0f, 4.0f/5.0f, 8.0f/9.0f, 1, 1 };
+
+/// The differences between the weights of the fifth-order and embedded fourth-order solutions.
+static const Float DP_E[7] = { 71.0f/57600.0f, 0, -71.0f/16695.0f, 71.0f/1920.0f,
+								-17253.0f/339200.0f, 22.0f/525.0f, -1.0f/40.0f };
+
+/// The safety factor that step sizes chosen from the error estimate are multiplied by.
+static const Float STEP_SAFETY = 0.9f;
+
+/// The smallest factor that a step size can shrink by after one step.
+static const Float MIN_STEP_SCALE = 0.2f;
+
+/// The largest factor that a step size can grow by after one step.
+static const Float MAX_STEP_SCALE = 5.0f;
 
 
 //##########################################################################################
@@ -22,7 +59,12 @@
 
 Simulation:: Simulation()
 	:	gravity( 0, -9.81f, 0 ),
-		drag( 1 )
+		drag( 1 ),
+		integrationMethod( RK4 ),
+		randomSeed( 0 ),
+		relativeTolerance( 1e-4f ),
+		absoluteTolerance( 1e-4f ),
+		minStepSize( 1e-5f )
 {
 }
 
@@ -41,8 +83,102 @@ Simulation:: Simulation()
 
 void Simulation:: update( Float dt )
 {
-	integrateRK4( dt );
-	//integrateSemiImplicitEuler( dt );
+	PROFILER_SCOPE( simulationUpdateZone );
+	
+	const Size numQuadcopters = quadcopters.getSize();
+	Size numItems = numQuadcopters;
+	Time stageStart = Time::getCurrent();
+	
+	// Advance each vehicle's waypoints and path shortcuts outside of the integrator stages.
+	runRangeJobs( &Simulation::updateLookAheadRange, dt, numQuadcopters );
+	
+	Time stageEnd = Time::getCurrent();
+	stageTimes.lookAhead += stageEnd - stageStart;
+	
+	if ( integrationMethod == FLEET_RK4 )
+	{
+		// Gather the vehicle states into the structure-of-arrays layout.
+		fleetState.setSize( numQuadcopters );
+		
+		for ( Index i = 0; i < numQuadcopters; i++ )
+			fleetState.setState( i, quadcopters[i]->currentState );
+		
+		numItems = fleetState.getGroupCount();
+		
+		stageStart = stageEnd;
+		stageEnd = Time::getCurrent();
+		stageTimes.fleetTransfer += stageEnd - stageStart;
+	}
+	
+	runRangeJobs( &Simulation::integrateRange, dt, numItems );
+	
+	stageStart = stageEnd;
+	stageEnd = Time::getCurrent();
+	stageTimes.integration += stageEnd - stageStart;
+	
+	if ( integrationMethod == FLEET_RK4 )
+	{
+		// Scatter the new states back to the vehicles.
+		for ( Index i = 0; i < numQuadcopters; i++ )
+			quadcopters[i]->currentState = fleetState.getState( i );
+		
+		stageTimes.fleetTransfer += Time::getCurrent() - stageEnd;
+	}
+	
+	stageTimes.numSteps++;
+}
+
+
+
+
+void Simulation:: integrateRange( Float dt, Index start, Index end )
+{
+	for ( Index i = start; i < end; i++ )
+	{
+		switch ( integrationMethod )
+		{
+			case SEMI_IMPLICIT_EULER:	integrateSemiImplicitEuler( *quadcopters[i], dt );	break;
+			case RK4:					integrateRK4( *quadcopters[i], dt );				break;
+			case FLEET_RK4:				integrateFleetGroupRK4( i, dt );					break;
+			case DORMAND_PRINCE:		integrateDormandPrince( i, dt );					break;
+		}
+	}
+}
+
+
+
+
+void Simulation:: updateLookAheadRange( Float dt, Index start, Index end )
+{
+	for ( Index i = start; i < end; i++ )
+		quadcopters[i]->updateLookAhead( dt );
+}
+
+
+
+
+void Simulation:: runRangeJobs( void (Simulation::*rangeMethod)( Float, Index, Index ), Float dt, Size numItems )
+{
+	const Size numThreads = threadPool.getThreadCount();
+	
+	if ( numThreads > 1 && numItems > 1 )
+	{
+		// Split the items into contiguous ranges, a few per thread to balance the load.
+		// The partition doesn't affect the result since each vehicle is updated independently.
+		const Size numJobs = math::min( numItems, numThreads*4 );
+		
+		for ( Index j = 0; j < numJobs; j++ )
+		{
+			const Index start = (j*numItems) / numJobs;
+			const Index end = ((j + 1)*numItems) / numJobs;
+			
+			threadPool.addJob( bindCall( rangeMethod, this, dt, start, end ) );
+		}
+		
+		threadPool.finishJobs();
+	}
+	else
+		(this->*rangeMethod)( dt, 0, numItems );
 }
 
 
@@ -51,7 +187,7 @@ void Simulation:: update( Float dt )
 //##########################################################################################
 //##########################################################################################
 //############		
-//############		Semi-Implicite Euler Integration Method
+//############		Random Seed Accessor Methods
 //############		
 //##########################################################################################
 //##########################################################################################
@@ -59,37 +195,92 @@ void Simulation:: update( Float dt )
 
 
 
-void Simulation:: integrateSemiImplicitEuler( Float dt )
+void Simulation:: setRandomSeed( UInt32 newRandomSeed )
 {
-	// Update the simulation state of each quadcopter.
+	randomSeed = newRandomSeed;
+	
 	const Size numQuadcopters = quadcopters.getSize();
 	
 	for ( Index i = 0; i < numQuadcopters; i++ )
+		quadcopters[i]->setRandomSeed( getVehicleSeed( i ) );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############		
+//############		Adaptive Step Statistics Accessor Methods
+//############		
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Simulation::StepStatistics Simulation:: getStepStatistics() const
+{
+	StepStatistics total;
+	
+	for ( Index i = 0; i < adaptiveSteps.getSize(); i++ )
 	{
-		Quadcopter& quadcopter = *quadcopters[i];
-		TransformState& state = quadcopter.currentState;
-		
-		const Vector3f& position = state.position;
-		const Vector3f& velocity = state.velocity;
-		const Matrix3f& rotation = state.rotation;
-		const Vector3f& angularVelocity = state.angularVelocity;
-		
-		//****************************************************************
-		
-		// Compute the linear and angular acceleration.
-		Vector3f acceleration;
-		Vector3f angularAcceleration;
-		computeAcceleration( quadcopter, dt, position, velocity, rotation, angularVelocity,
-							acceleration, angularAcceleration );
-		
-		// Integrate acceleration to velocity.
-		state.velocity += acceleration*dt;
-		state.angularVelocity += angularAcceleration*dt;
-		
-		// Integrate velocity to position.
-		state.position += state.velocity*dt;
-		state.rotation = (state.rotation + Matrix3f::skewSymmetric( state.angularVelocity )*state.rotation*dt).orthonormalize();
+		const StepStatistics& statistics = adaptiveSteps[i].statistics;
+		total.numAccepted += statistics.numAccepted;
+		total.numRejected += statistics.numRejected;
+		total.minStepSize = math::min( total.minStepSize, statistics.minStepSize );
 	}
+	
+	return total;
+}
+
+
+
+
+void Simulation:: resetStepStatistics()
+{
+	for ( Index i = 0; i < adaptiveSteps.getSize(); i++ )
+		adaptiveSteps[i].statistics = StepStatistics();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############		
+//############		Semi-Implicite Euler Integration Method
+//############		
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void Simulation:: integrateSemiImplicitEuler( Quadcopter& quadcopter, Float dt )
+{
+	TransformState& state = quadcopter.currentState;
+	
+	const Vector3f& position = state.position;
+	const Vector3f& velocity = state.velocity;
+	const Quaternion<Float>& orientation = state.orientation;
+	const Vector3f& angularVelocity = state.angularVelocity;
+	
+	//****************************************************************
+	
+	// Compute the linear and angular acceleration.
+	Vector3f acceleration;
+	Vector3f angularAcceleration;
+	computeAcceleration( quadcopter, dt, position, velocity, orientation, angularVelocity,
+						acceleration, angularAcceleration, true );
+	
+	// Integrate acceleration to velocity.
+	state.velocity += acceleration*dt;
+	state.angularVelocity += angularAcceleration*dt;
+	
+	// Integrate velocity to position.
+	state.position += state.velocity*dt;
+	state.orientation = TransformState::rotateOrientation( state.orientation, state.angularVelocity*dt );
 }
 
 
@@ -106,7 +297,7 @@ void Simulation:: integrateSemiImplicitEuler( Float dt )
 
 
 
-void Simulation:: integrateRK4( Float dt )
+void Simulation:: integrateRK4( Quadcopter& quadcopter, Float dt )
 {
 	// Compute various constant factors of the timestep.
 	const Float dt2 = (dt / Float(2));
@@ -117,70 +308,312 @@ void Simulation:: integrateRK4( Float dt )
 	Vector3f ddP1, ddP2, ddP3, ddP4;
 	Vector3f ddR1, ddR2, ddR3, ddR4;
 	
-	// Update the simulation state of each quadcopter.
-	const Size numQuadcopters = quadcopters.getSize();
+	TransformState& state = quadcopter.currentState;
 	
-	for ( Index i = 0; i < numQuadcopters; i++ )
+	const Vector3f& position = state.position;
+	const Vector3f& velocity = state.velocity;
+	const Quaternion<Float>& orientation = state.orientation;
+	const Vector3f& angularVelocity = state.angularVelocity;
+	
+	//****************************************************************
+	// Integrate using RK4.
+	// Each stage's orientation is found by rotating the initial orientation through
+	// the exponential map of the stage's angular velocity times its time offset.
+	
+	// xk1 = v_n;
+	// vk1 = a( x_n, v_n );
+	Vector3f p1 = position;
+	Quaternion<Float> r1 = orientation;
+	Vector3f dP1 = velocity;
+	Vector3f dR1 = angularVelocity;
+	computeAcceleration( quadcopter, 0, p1, dP1, r1, dR1, ddP1, ddR1, true );
+	
+	// xk2 = v_n + 0.5*h*vk1;
+	// vk2 = a( x_n + 0.5*h*xk1, xk2 );
+	Vector3f p2 = position + dP1*dt2;
+	Quaternion<Float> r2 = TransformState::rotateOrientation( orientation, dR1*dt2 );
+	Vector3f dP2 = velocity + ddP1*dt2;
+	Vector3f dR2 = angularVelocity + ddR1*dt2;
+	computeAcceleration( quadcopter, dt2, p2, dP2, r2, dR2, ddP2, ddR2 );
+	
+	// xk3 = v_n + 0.5*h*vk2;
+	// vk3 = a( x_n + 0.5*h*xk2, xk3 );
+	Vector3f p3 = position + dP2*dt2;
+	Quaternion<Float> r3 = TransformState::rotateOrientation( orientation, dR2*dt2 );
+	Vector3f dP3 = velocity + ddP2*dt2;
+	Vector3f dR3 = angularVelocity + ddR2*dt2;
+	computeAcceleration( quadcopter, dt2, p3, dP3, r3, dR3, ddP3, ddR3 );
+	
+	// xk4 = v_n + h*vk3;
+	// vk4 = a( x_n + h*xk3, xk4 );
+	Vector3f p4 = position + dP3*dt;
+	Quaternion<Float> r4 = TransformState::rotateOrientation( orientation, dR3*dt );
+	Vector3f dP4 = velocity + ddP3*dt;
+	Vector3f dR4 = angularVelocity + ddR3*dt;
+	computeAcceleration( quadcopter, dt, p4, dP4, r4, dR4, ddP4, ddR4 );
+	
+	//****************************************************************
+	
+	// Accumulate the final weighted position and velocity.
+	state.position = position + dP1*dt6 + dP2*dt3 + dP3*dt3 + dP4*dt6;
+	state.orientation = TransformState::rotateOrientation( orientation, dR1*dt6 + dR2*dt3 + dR3*dt3 + dR4*dt6 );
+	state.velocity = velocity + ddP1*dt6 + ddP2*dt3 + ddP3*dt3 + ddP4*dt6;
+	state.angularVelocity = angularVelocity + ddR1*dt6 + ddR2*dt3 + ddR3*dt3 + ddR4*dt6;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############		
+//############		Fleet RK4 Integration Methods
+//############		
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void Simulation:: integrateFleetGroupRK4( Index groupIndex, Float dt )
+{
+	typedef FleetState::GroupScalar GroupScalar;
+	typedef FleetState::GroupVector3 GroupVector3;
+	
+	// Compute various constant factors of the timestep.
+	const GroupScalar h( dt );
+	const GroupScalar h2( dt / Float(2) );
+	const GroupScalar h3( dt / Float(3) );
+	const GroupScalar h6( dt / Float(6) );
+	
+	const GroupVector3 position = fleetState.getPositions( groupIndex );
+	const GroupVector3 velocity = fleetState.getVelocities( groupIndex );
+	const GroupVector3 angularVelocity = fleetState.getAngularVelocities( groupIndex );
+	GroupScalar orientationW;
+	GroupVector3 orientationV;
+	fleetState.getOrientations( groupIndex, orientationW, orientationV );
+	
+	// The accelerations of the padding lanes are never computed, so start them at zero.
+	const GroupVector3 zero( GroupScalar(0.0f), GroupScalar(0.0f), GroupScalar(0.0f) );
+	GroupVector3 ddP1 = zero, ddP2 = zero, ddP3 = zero, ddP4 = zero;
+	GroupVector3 ddR1 = zero, ddR2 = zero, ddR3 = zero, ddR4 = zero;
+	GroupScalar rW;
+	GroupVector3 rV;
+	
+	//****************************************************************
+	// Integrate using RK4, mirroring the operation order of integrateRK4().
+	
+	const GroupVector3& dP1 = velocity;
+	const GroupVector3& dR1 = angularVelocity;
+	computeGroupAcceleration( groupIndex, 0, position, dP1, orientationW, orientationV, dR1, ddP1, ddR1, true );
+	
+	const GroupVector3 p2 = position + dP1*h2;
+	FleetState::rotateOrientations( orientationW, orientationV, dR1*h2, rW, rV );
+	const GroupVector3 dP2 = velocity + ddP1*h2;
+	const GroupVector3 dR2 = angularVelocity + ddR1*h2;
+	computeGroupAcceleration( groupIndex, dt / Float(2), p2, dP2, rW, rV, dR2, ddP2, ddR2 );
+	
+	const GroupVector3 p3 = position + dP2*h2;
+	FleetState::rotateOrientations( orientationW, orientationV, dR2*h2, rW, rV );
+	const GroupVector3 dP3 = velocity + ddP2*h2;
+	const GroupVector3 dR3 = angularVelocity + ddR2*h2;
+	computeGroupAcceleration( groupIndex, dt / Float(2), p3, dP3, rW, rV, dR3, ddP3, ddR3 );
+	
+	const GroupVector3 p4 = position + dP3*h;
+	FleetState::rotateOrientations( orientationW, orientationV, dR3*h, rW, rV );
+	const GroupVector3 dP4 = velocity + ddP3*h;
+	const GroupVector3 dR4 = angularVelocity + ddR3*h;
+	computeGroupAcceleration( groupIndex, dt, p4, dP4, rW, rV, dR4, ddP4, ddR4 );
+	
+	//****************************************************************
+	
+	// Accumulate the final weighted position and velocity.
+	fleetState.setPositions( groupIndex, position + dP1*h6 + dP2*h3 + dP3*h3 + dP4*h6 );
+	fleetState.setVelocities( groupIndex, velocity + ddP1*h6 + ddP2*h3 + ddP3*h3 + ddP4*h6 );
+	fleetState.setAngularVelocities( groupIndex, angularVelocity + ddR1*h6 + ddR2*h3 + ddR3*h3 + ddR4*h6 );
+	
+	FleetState::rotateOrientations( orientationW, orientationV, dR1*h6 + dR2*h3 + dR3*h3 + dR4*h6, rW, rV );
+	fleetState.setOrientations( groupIndex, rW, rV );
+}
+
+
+
+
+void Simulation:: computeGroupAcceleration( Index groupIndex, Float timeStep,
+											const FleetState::GroupVector3& positions,
+											const FleetState::GroupVector3& velocities,
+											const FleetState::GroupScalar& orientationW,
+											const FleetState::GroupVector3& orientationV,
+											const FleetState::GroupVector3& angularVelocities,
+											FleetState::GroupVector3& linearAccelerations,
+											FleetState::GroupVector3& angularAccelerations,
+											Bool isStepStart )
+{
+	const Index start = groupIndex*FleetState::GROUP_WIDTH;
+	const Size numLanes = math::min( FleetState::GROUP_WIDTH, quadcopters.getSize() - start );
+	
+	for ( Index lane = 0; lane < numLanes; lane++ )
 	{
-		Quadcopter& quadcopter = *quadcopters[i];
-		TransformState& state = quadcopter.currentState;
-		
-		const Vector3f& position = state.position;
-		const Vector3f& velocity = state.velocity;
-		const Matrix3f& rotation = state.rotation;
-		const Vector3f& angularVelocity = state.angularVelocity;
-		
-		//****************************************************************
-		// Integrate using RK4.
-		
-		// xk1 = v_n;
-		// vk1 = a( x_n, v_n );
-		Vector3f p1 = position;
-		Matrix3f r1 = rotation;
-		Vector3f dP1 = velocity;
-		Vector3f dR1 = angularVelocity;
-		computeAcceleration( quadcopter, 0, p1, dP1, r1, dR1, ddP1, ddR1 );
-		
-		// xk2 = v_n + 0.5*h*vk1;
-		// vk2 = a( x_n + 0.5*h*xk1, xk2 );
-		Vector3f p2 = position + dP1*dt2;
-		Matrix3f r2 = (rotation + Matrix3f::skewSymmetric( dR1 )*rotation*dt).orthonormalize();
-		Vector3f dP2 = velocity + ddP1*dt2;
-		Vector3f dR2 = angularVelocity + ddR1*dt2;
-		computeAcceleration( quadcopter, dt2, p2, dP2, r2, dR2, ddP2, ddR2 );
-		
-		// xk3 = v_n + 0.5*h*vk2;
-		// vk3 = a( x_n + 0.5*h*xk2, xk3 );
-		Vector3f p3 = position + dP2*dt2;
-		Matrix3f r3 = (rotation + Matrix3f::skewSymmetric( dR2 )*rotation*dt).orthonormalize();
-		Vector3f dP3 = velocity + ddP2*dt2;
-		Vector3f dR3 = angularVelocity + ddR2*dt2;
-		computeAcceleration( quadcopter, dt2, p3, dP3, r3, dR3, ddP3, ddR3 );
-		
-		// xk4 = v_n + h*vk3;
-		// vk4 = a( x_n + h*xk3, xk4 );
-		Vector3f p4 = position + dP3*dt;
-		Matrix3f r4 = (rotation + Matrix3f::skewSymmetric( dR3 )*rotation*dt).orthonormalize();
-		Vector3f dP4 = velocity + ddP3*dt;
-		Vector3f dR4 = angularVelocity + ddR3*dt;
-		computeAcceleration( quadcopter, dt, p4, dP4, r4, dR4, ddP4, ddR4 );
-		
-		//****************************************************************
-		
-		// Accumulate the final weighted position and velocity.
-		state.position = position + dP1*dt6 + dP2*dt3 + dP3*dt3 + dP4*dt6;
-		state.rotation = (rotation + Matrix3f::skewSymmetric( dR1 )*rotation*dt6 + 
-									Matrix3f::skewSymmetric( dR2 )*rotation*dt3 + 
-									Matrix3f::skewSymmetric( dR3 )*rotation*dt3 + 
-									Matrix3f::skewSymmetric( dR4 )*rotation*dt6).orthonormalize();
-		state.velocity = velocity + ddP1*dt6 + ddP2*dt3 + ddP3*dt3 + ddP4*dt6;
-		state.angularVelocity = angularVelocity + ddR1*dt6 + ddR2*dt3 + ddR3*dt3 + ddR4*dt6;
+		const Vector3f v = FleetState::getLane( orientationV, lane );
+		const Quaternion<Float> orientation( orientationW[lane], v.x, v.y, v.z );
+		
+		Vector3f linearAcceleration;
+		Vector3f angularAcceleration;
+		computeAcceleration( *quadcopters[start + lane], timeStep,
+							FleetState::getLane( positions, lane ), FleetState::getLane( velocities, lane ),
+							orientation, FleetState::getLane( angularVelocities, lane ),
+							linearAcceleration, angularAcceleration, isStepStart );
+		
+		FleetState::setLane( linearAccelerations, lane, linearAcceleration );
+		FleetState::setLane( angularAccelerations, lane, angularAcceleration );
 	}
 }
 
 
 
 
+//##########################################################################################
+//##########################################################################################
+//############		
+//############		Dormand-Prince Integration Method
+//############		
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+TransformState Simulation:: getStageState( const TransformState& state, const StateDerivative* k,
+										const Float* weights, Size numStages, Float h )
+{
+	Vector3f dP, dV, dR, dW;
+	
+	for ( Index j = 0; j < numStages; j++ )
+	{
+		dP += k[j].position*weights[j];
+		dV += k[j].velocity*weights[j];
+		dR += k[j].orientation*weights[j];
+		dW += k[j].angularVelocity*weights[j];
+	}
+	
+	return TransformState( state.position + dP*h,
+						TransformState::rotateOrientation( state.orientation, dR*h ),
+						state.velocity + dV*h,
+						state.angularVelocity + dW*h );
+}
+
+
+
+
+/// Return the ratio of an error vector's magnitude to the tolerance for a quantity with the given magnitude.
+RIM_FORCE_INLINE static Float getScaledError( const Vector3f& error, Float magnitude,
+											Float relativeTolerance, Float absoluteTolerance )
+{
+	return error.getMagnitude() / (absoluteTolerance + relativeTolerance*magnitude);
+}
+
+
+
+
+void Simulation:: integrateDormandPrince( Index quadcopterIndex, Float dt )
+{
+	Quadcopter& quadcopter = *quadcopters[quadcopterIndex];
+	AdaptiveStepState& adaptiveStep = adaptiveSteps[quadcopterIndex];
+	TransformState& state = quadcopter.currentState;
+	
+	// Start with the step size from the previous update, or try the whole update as one step.
+	Float h = adaptiveStep.stepSize > Float(0) ? adaptiveStep.stepSize : dt;
+	Float t = 0;
+	
+	StateDerivative k[7];
+	computeDerivative( quadcopter, 0, state, k[0], true );
+	
+	while ( t < dt )
+	{
+		h = math::clamp( h, math::min( minStepSize, dt ), dt );
+		
+		// Stretch or shrink the step to land exactly on the end of the update.
+		const Bool isLastStep = t + h*Float(1.01) >= dt;
+		const Float stepSize = isLastStep ? dt - t : h;
+		
+		for ( Index s = 1; s < 7; s++ )
+		{
+			computeDerivative( quadcopter, t + DP_C[s]*stepSize,
+								getStageState( state, k, DP_A[s], s, stepSize ), k[s] );
+		}
+		
+		// The last stage state is the fifth-order solution.
+		const TransformState newState = getStageState( state, k, DP_A[6], 6, stepSize );
+		
+		// Estimate the error as the difference from the embedded fourth-order solution.
+		Vector3f eP, eV, eR, eW;
+		
+		for ( Index s = 0; s < 7; s++ )
+		{
+			eP += k[s].position*DP_E[s];
+			eV += k[s].velocity*DP_E[s];
+			eR += k[s].orientation*DP_E[s];
+			eW += k[s].angularVelocity*DP_E[s];
+		}
+		
+		const Float error = math::max( math::max( getScaledError( eP*stepSize,
+											math::max( state.position.getMagnitude(), newState.position.getMagnitude() ),
+											relativeTolerance, absoluteTolerance ),
+										getScaledError( eV*stepSize,
+											math::max( state.velocity.getMagnitude(), newState.velocity.getMagnitude() ),
+											relativeTolerance, absoluteTolerance ) ),
+								math::max( getScaledError( eR*stepSize, Float(1), relativeTolerance, absoluteTolerance ),
+										getScaledError( eW*stepSize,
+											math::max( state.angularVelocity.getMagnitude(), newState.angularVelocity.getMagnitude() ),
+											relativeTolerance, absoluteTolerance ) ) );
+		
+		// Choose the next step size from the error of this one (the error is fifth order in the step size).
+		const Float scale = error > Float(0) ? STEP_SAFETY*math::pow( error, Float(-0.2) ) : MAX_STEP_SCALE;
+		
+		if ( error <= Float(1) || stepSize <= minStepSize )
+		{
+			state = newState;
+			t = isLastStep ? dt : t + stepSize;
+			
+			// The last stage was evaluated at the new state, so it is the next step's first stage.
+			k[0] = k[6];
+			
+			adaptiveStep.statistics.numAccepted++;
+			
+			if ( !isLastStep )
+				adaptiveStep.statistics.minStepSize = math::min( adaptiveStep.statistics.minStepSize, stepSize );
+			
+			// Don't let a short final step shrink the size that the next update starts with.
+			if ( !isLastStep || stepSize >= h )
+				h = stepSize*math::clamp( scale, MIN_STEP_SCALE, MAX_STEP_SCALE );
+		}
+		else
+		{
+			adaptiveStep.statistics.numRejected++;
+			h = stepSize*math::clamp( scale, MIN_STEP_SCALE, Float(1) );
+		}
+	}
+	
+	adaptiveStep.stepSize = h;
+}
+
+
+
+
+void Simulation:: computeDerivative( Quadcopter& quadcopter, Float timeStep,
+									const TransformState& state, StateDerivative& derivative,
+									Bool isStepStart )
+{
+	derivative.position = state.velocity;
+	derivative.orientation = state.angularVelocity;
+	
+	computeAcceleration( quadcopter, timeStep, state.position, state.velocity, state.orientation, state.angularVelocity,
+						derivative.velocity, derivative.angularVelocity, isStepStart );
+}
+
+
+
+
 //##########################################################################################
 //##########################################################################################
 //############		
@@ -193,10 +626,11 @@ void Simulation:: integrateRK4( Float dt )
 
 
 
-void Simulation:: computeAcceleration( const Quadcopter& quadcopter, Float timeStep,
+void Simulation:: computeAcceleration( Quadcopter& quadcopter, Float timeStep,
 									const Vector3f& position, const Vector3f& velocity,
-									const Matrix3f& rotation, const Vector3f& angularVelocity,
-									Vector3f& linearAcceleration, Vector3f& angularAcceleration )
+									const Quaternion<Float>& orientation, const Vector3f& angularVelocity,
+									Vector3f& linearAcceleration, Vector3f& angularAcceleration,
+									Bool isStepStart )
 {
 	// Compute the gravitational acceleration.
 	linearAcceleration = gravity;
@@ -205,8 +639,12 @@ void Simulation:: computeAcceleration( const Quadcopter& quadcopter, Float timeS
 	linearAcceleration -= drag*velocity;
 	
 	// Compute the quadcopter acceleration based on the environmental forces.
-	quadcopter.computeAcceleration( TransformState( position, rotation, velocity, angularVelocity ),
-									timeStep, linearAcceleration, angularAcceleration );
+	const TransformState state( position, orientation, velocity, angularVelocity );
+	
+	if ( isStepStart )
+		quadcopter.computeStepAcceleration( state, timeStep, linearAcceleration, angularAcceleration );
+	else
+		quadcopter.computeAcceleration( state, timeStep, linearAcceleration, angularAcceleration );
 }
 
 
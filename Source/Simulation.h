@@ -19,6 +19,7 @@ using namespace rim::math;
 
 
 #include "Quadcopter.h"
+#include "FleetState.h"
 
 
 
@@ -55,6 +56,72 @@ class Simulation
 			
 			
 			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Integration Method Enum Declaration
+			
+			
+			
+			
+			/// An enum type which specifies the numerical method used to integrate the vehicle states.
+			enum IntegrationMethod
+			{
+				/// First-order semi-implicit Euler integration, one vehicle at a time.
+				SEMI_IMPLICIT_EULER,
+				
+				/// Fourth-order Runge-Kutta integration, one vehicle at a time. This is the default method.
+				RK4,
+				
+				/// Fourth-order Runge-Kutta integration on structure-of-arrays state for groups of 4 vehicles.
+				/**
+				  * The state updates of each RK4 stage are evaluated with SIMD arithmetic, while the
+				  * vehicle accelerations are still computed per vehicle. The SIMD operations are done
+				  * in the same order as the scalar RK4 path, so in IEEE (SSE) builds the results are
+				  * identical to RK4. If the compiler contracts the scalar path into fused multiply-adds,
+				  * the results agree to within a relative error of 1e-5 per step. The states are copied
+				  * into the arrays before each update and back to the vehicles after it.
+				  */
+				FLEET_RK4,
+				
+				/// Adaptive fifth-order Dormand-Prince (RK45) integration, one vehicle at a time.
+				/**
+				  * Each update is covered by as many internal steps as each vehicle's error
+				  * estimate requires, so quiet vehicles take one large step while maneuvering
+				  * vehicles subdivide it. Each vehicle's step size is kept between updates.
+				  */
+				DORMAND_PRINCE
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Integration Method Accessor Methods
+			
+			
+			
+			
+			/// Return the numerical method used to integrate the vehicle states.
+			RIM_INLINE IntegrationMethod getIntegrationMethod() const
+			{
+				return integrationMethod;
+			}
+			
+			
+			
+			
+			/// Set the numerical method used to integrate the vehicle states.
+			RIM_INLINE void setIntegrationMethod( IntegrationMethod newMethod )
+			{
+				integrationMethod = newMethod;
+			}
+			
+			
+			
+			
 		//********************************************************************************
 		//********************************************************************************
 		//********************************************************************************
@@ -85,12 +152,18 @@ class Simulation
 			
 			
 			/// Add a new quadcopter to this simulation.
+			/**
+			  * The quadcopter's random stream is reseeded from the simulation's random seed
+			  * and the quadcopter's index, so that the simulation is reproducible.
+			  */
 			RIM_INLINE Bool addQuadcopter( Quadcopter* quadcopter )
 			{
 				if ( quadcopter == NULL )
 					return false;
 				
+				quadcopter->setRandomSeed( getVehicleSeed( quadcopters.getSize() ) );
 				quadcopters.add( quadcopter );
+				adaptiveSteps.add( AdaptiveStepState() );
 				
 				return true;
 			}
@@ -101,7 +174,12 @@ class Simulation
 			/// Remove the quadcopter at the specified index in this simulation.
 			RIM_INLINE Bool removeQuadcopter( Index quadcopterIndex )
 			{
-				return quadcopters.removeAtIndex( quadcopterIndex );
+				if ( !quadcopters.removeAtIndex( quadcopterIndex ) )
+					return false;
+				
+				adaptiveSteps.removeAtIndex( quadcopterIndex );
+				
+				return true;
 			}
 			
 			
@@ -111,13 +189,299 @@ class Simulation
 			RIM_INLINE void clearQuadcopters()
 			{
 				quadcopters.clear();
+				adaptiveSteps.clear();
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Threading Accessor Methods
+			
+			
+			
+			
+			/// Return the number of worker threads that are used to update the simulation.
+			/**
+			  * A value of 0 or 1 indicates that the simulation is updated serially on the
+			  * calling thread.
+			  */
+			RIM_INLINE Size getThreadCount() const
+			{
+				return threadPool.getThreadCount();
+			}
+			
+			
+			
+			
+			/// Set the number of worker threads that are used to update the simulation.
+			/**
+			  * Each vehicle's update only depends on its own state and random stream,
+			  * so the result is bit-identical for any number of threads.
+			  */
+			RIM_INLINE void setThreadCount( Size newNumThreads )
+			{
+				threadPool.setThreadCount( newNumThreads );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Random Seed Accessor Methods
+			
+			
+			
+			
+			/// Return the random seed from which each vehicle's random stream is derived.
+			RIM_INLINE UInt32 getRandomSeed() const
+			{
+				return randomSeed;
+			}
+			
+			
+			
+			
+			/// Set the random seed from which each vehicle's random stream is derived.
+			/**
+			  * This reseeds the random streams of all quadcopters that are currently
+			  * in the simulation.
+			  */
+			void setRandomSeed( UInt32 newRandomSeed );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Adaptive Step Accessor Methods
+			
+			
+			
+			
+			/// Return the relative error tolerance of each internal step of the DORMAND_PRINCE method.
+			RIM_INLINE Float getRelativeTolerance() const
+			{
+				return relativeTolerance;
+			}
+			
+			
+			
+			
+			/// Return the absolute error tolerance of each internal step of the DORMAND_PRINCE method.
+			RIM_INLINE Float getAbsoluteTolerance() const
+			{
+				return absoluteTolerance;
+			}
+			
+			
+			
+			
+			/// Set the relative and absolute error tolerances of each internal step of the DORMAND_PRINCE method.
+			/**
+			  * A step is accepted if the error estimate of each of a vehicle's position, velocity,
+			  * rotation, and angular velocity is less than the absolute tolerance plus the
+			  * relative tolerance times the magnitude of that quantity.
+			  */
+			RIM_INLINE void setTolerance( Float newRelativeTolerance, Float newAbsoluteTolerance )
+			{
+				relativeTolerance = math::max( newRelativeTolerance, Float(0) );
+				absoluteTolerance = math::max( newAbsoluteTolerance, math::epsilon<Float>() );
+			}
+			
+			
+			
+			
+			/// Return the smallest internal step size in seconds that the DORMAND_PRINCE method takes.
+			RIM_INLINE Float getMinStepSize() const
+			{
+				return minStepSize;
+			}
+			
+			
+			
+			
+			/// Set the smallest internal step size in seconds that the DORMAND_PRINCE method takes.
+			/**
+			  * A step of this size is accepted even if its error is too large, so that
+			  * an update always finishes.
+			  */
+			RIM_INLINE void setMinStepSize( Float newMinStepSize )
+			{
+				minStepSize = math::max( newMinStepSize, math::epsilon<Float>() );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Adaptive Step Statistics Class Declaration
+			
+			
+			
+			
+			/// A class that stores the number of internal steps taken by the DORMAND_PRINCE method.
+			class StepStatistics
+			{
+				public:
+					
+					RIM_INLINE StepStatistics()
+						:	numAccepted( 0 ),
+							numRejected( 0 ),
+							minStepSize( math::max<Float>() )
+					{
+					}
+					
+					
+					/// The number of steps whose error was within the tolerance.
+					Size numAccepted;
+					
+					/// The number of steps that were retried with a smaller size because their error was too large.
+					Size numRejected;
+					
+					/// The smallest accepted step size in seconds, excluding the final step of each update.
+					Float minStepSize;
+			
+			};
+			
+			
+			
+			
+			/// Return the internal step statistics of all vehicles since the statistics were last reset.
+			StepStatistics getStepStatistics() const;
+			
+			
+			
+			
+			/// Reset the internal step statistics of all vehicles.
+			void resetStepStatistics();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Stage Timing Class Declaration
+			
+			
+			
+			
+			/// A class that stores the total time spent in each stage of the simulation update.
+			class StageTimes
+			{
+				public:
+					
+					RIM_INLINE StageTimes()
+						:	numSteps( 0 )
+					{
+					}
+					
+					
+					/// The time spent updating the path look-ahead of the vehicles.
+					Time lookAhead;
+					
+					/// The time spent copying vehicle states to and from the fleet state.
+					Time fleetTransfer;
+					
+					/// The time spent integrating the vehicle states.
+					Time integration;
+					
+					/// The number of updates that the times were accumulated over.
+					Size numSteps;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Stage Timing Accessor Methods
+			
+			
+			
+			
+			/// Return the time spent in each stage of the updates since the times were last reset.
+			RIM_INLINE const StageTimes& getStageTimes() const
+			{
+				return stageTimes;
 			}
 			
 			
 			
 			
+			/// Reset the accumulated stage times to zero.
+			RIM_INLINE void resetStageTimes()
+			{
+				stageTimes = StageTimes();
+			}
+	
+	
+	
+	
 	private:
 		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Adaptive Step Class Declarations
+			
+			
+			
+			
+			/// A class that stores the adaptive integration state of one vehicle.
+			class AdaptiveStepState
+			{
+				public:
+					
+					RIM_INLINE AdaptiveStepState()
+						:	stepSize( 0 )
+					{
+					}
+					
+					
+					/// The size of the next internal step in seconds, or 0 if the vehicle hasn't been integrated yet.
+					Float stepSize;
+					
+					/// The internal step statistics of the vehicle.
+					StepStatistics statistics;
+			
+			};
+			
+			
+			
+			
+			/// A class that stores the time derivative of a vehicle's state.
+			class StateDerivative
+			{
+				public:
+					
+					/// The rate of change of position, i.e. the linear velocity.
+					Vector3f position;
+					
+					/// The rate of change of linear velocity, i.e. the linear acceleration.
+					Vector3f velocity;
+					
+					/// The angular velocity that the orientation changes with.
+					Vector3f orientation;
+					
+					/// The rate of change of angular velocity, i.e. the angular acceleration.
+					Vector3f angularVelocity;
+			
+			};
+			
+			
+			
+			
 		//********************************************************************************
 		//********************************************************************************
 		//********************************************************************************
@@ -126,14 +490,81 @@ class Simulation
 			
 			
 			
-			/// Update the simulation using the Semi-Implicit Euler integration method for the given timestep.
-			void integrateSemiImplicitEuler( Float dt );
+			/// Integrate the vehicles (or fleet groups) in the range [start, end) for the given timestep.
+			/**
+			  * This method is run by each worker thread for a disjoint range of the simulation.
+			  * The range indexes vehicles, or fleet groups when using the FLEET_RK4 method.
+			  */
+			void integrateRange( Float dt, Index start, Index end );
+			
+			
+			
+			
+			/// Update the path look-ahead of the vehicles in the range [start, end) for the given timestep.
+			/**
+			  * This runs once per step before integration, so that the integrator stages
+			  * only follow each vehicle's current waypoint and never test visibility.
+			  */
+			void updateLookAheadRange( Float dt, Index start, Index end );
+			
+			
+			
+			
+			/// Run the specified range method over the items [0, numItems), split across the thread pool.
+			void runRangeJobs( void (Simulation::*rangeMethod)( Float, Index, Index ), Float dt, Size numItems );
+			
+			
+			
+			
+			/// Update the given quadcopter using the Semi-Implicit Euler integration method for the given timestep.
+			void integrateSemiImplicitEuler( Quadcopter& quadcopter, Float dt );
+			
+			
+			
+			
+			/// Update the given quadcopter using the RK4 integration method for the given timestep.
+			void integrateRK4( Quadcopter& quadcopter, Float dt );
+			
+			
+			
+			
+			/// Advance the vehicles in the specified fleet group by one RK4 step.
+			void integrateFleetGroupRK4( Index groupIndex, Float dt );
+			
+			
+			
+			
+			/// Advance the vehicle at the specified index by the given timestep with adaptive Dormand-Prince steps.
+			void integrateDormandPrince( Index quadcopterIndex, Float dt );
+			
 			
 			
 			
+			/// Compute the time derivative of a vehicle's state, storing the motor thrusts if the state starts a step.
+			void computeDerivative( Quadcopter& quadcopter, Float timeStep,
+									const TransformState& state, StateDerivative& derivative,
+									Bool isStepStart = false );
 			
-			/// Update the simulation using the RK4 integration method for the given timestep.
-			void integrateRK4( Float dt );
+			
+			
+			
+			/// Return the state at a stage of a step, which is offset from the start by the weighted stage derivatives.
+			static TransformState getStageState( const TransformState& state, const StateDerivative* k,
+												const Float* weights, Size numStages, Float h );
+			
+			
+			
+			
+			/// Compute the COM accelerations for the valid vehicles in a fleet group with the specified group state.
+			void computeGroupAcceleration( Index groupIndex, Float timeStep,
+											const FleetState::GroupVector3& positions,
+											const FleetState::GroupVector3& velocities,
+											const FleetState::GroupScalar& orientationW,
+											const FleetState::GroupVector3& orientationV,
+											const FleetState::GroupVector3& angularVelocities,
+											FleetState::GroupVector3& linearAccelerations,
+											FleetState::GroupVector3& angularAccelerations,
+											Bool isStepStart = false );
 			
 			
 			
@@ -141,12 +572,24 @@ class Simulation
 			/// Compute the COM acceleration for the given quadcopter with the specified position and velocity parameters.
 			/**
 			  * The resulting linear and angular acceleration of the quadcopter's center of mass
-			  * is returned in the output reference parameters.
+			  * is returned in the output reference parameters. If the state is the one that a
+			  * step starts from, the solved thrusts are stored as the motors' current thrusts.
 			  */
-			void computeAcceleration( const Quadcopter& quadcopter, Float timeStep,
+			void computeAcceleration( Quadcopter& quadcopter, Float timeStep,
 									const Vector3f& position, const Vector3f& velocity,
-									const Matrix3f& rotation, const Vector3f& angularVelocity,
-									Vector3f& linearAcceleration, Vector3f& angularAcceleration );
+									const Quaternion<Float>& orientation, const Vector3f& angularVelocity,
+									Vector3f& linearAcceleration, Vector3f& angularAcceleration,
+									Bool isStepStart = false );
+			
+			
+			
+			
+			/// Return the random seed for the vehicle at the specified index.
+			RIM_INLINE UInt32 getVehicleSeed( Index vehicleIndex ) const
+			{
+				// Scramble the index so that neighboring vehicles get uncorrelated streams.
+				return randomSeed ^ (UInt32(vehicleIndex + 1)*UInt32(2654435761u));
+			}
 			
 			
 			
@@ -170,6 +613,42 @@ class Simulation
 			Float drag;
 			
 			
+			/// The numerical method that is used to integrate the vehicle states.
+			IntegrationMethod integrationMethod;
+			
+			
+			/// The structure-of-arrays copy of the vehicle states used by the fleet integrator.
+			FleetState fleetState;
+			
+			
+			/// The seed from which the random stream of each vehicle is derived.
+			UInt32 randomSeed;
+			
+			
+			/// A pool of worker threads that are used to update disjoint ranges of vehicles.
+			threads::ThreadPool threadPool;
+			
+			
+			/// The total time spent in each stage of the updates since the times were last reset.
+			StageTimes stageTimes;
+			
+			
+			/// The adaptive integration state of each vehicle, in the same order as the vehicles.
+			ArrayList<AdaptiveStepState> adaptiveSteps;
+			
+			
+			/// The relative error tolerance of each internal step of the DORMAND_PRINCE method.
+			Float relativeTolerance;
+			
+			
+			/// The absolute error tolerance of each internal step of the DORMAND_PRINCE method.
+			Float absoluteTolerance;
+			
+			
+			/// The smallest internal step size in seconds that the DORMAND_PRINCE method takes.
+			Float minStepSize;
+
+
 };
 
 
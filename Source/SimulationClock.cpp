@@ -0,0 +1,279 @@
+/*
+ *  SimulationClock.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "SimulationClock.h"
+
+
+/// The smallest fixed time step in seconds that the clock allows.
+static const Float MIN_TIME_STEP = 0.0001f;
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor / Destructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+SimulationClock:: SimulationClock( Simulation* newSimulation, Float newTimeStep )
+	:	simulation( newSimulation ),
+		timeStep( math::max( newTimeStep, MIN_TIME_STEP ) ),
+		maxStepsPerFrame( 8 ),
+		accumulator( 0 ),
+		interpolation( 1 ),
+		simulatedTime( 0 ),
+		droppedTime( 0 ),
+		recorder( NULL ),
+		maxSpeed( false ),
+		maxSpeedThreadStarted( false ),
+		stopMaxSpeedThread( false )
+{
+}
+
+
+
+
+SimulationClock:: ~SimulationClock()
+{
+	if ( !maxSpeedThreadStarted )
+		return;
+	
+	mutex.lock();
+	maxSpeed = false;
+	stopMaxSpeedThread = true;
+	mutex.unlock();
+	
+	maxSpeedSemaphore.up();
+	maxSpeedThread.join();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Update Method
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Size SimulationClock:: advance( const Time& frameTime )
+{
+	if ( maxSpeed )
+		return 0;
+	
+	accumulator += math::max( frameTime.getSeconds(), Double(0) );
+	
+	Size numSteps = Size(accumulator / timeStep);
+	
+	if ( numSteps > maxStepsPerFrame )
+	{
+		// Drop the time that can't be simulated this frame rather than falling further behind.
+		const Double keptTime = (maxStepsPerFrame + (accumulator / timeStep - numSteps))*timeStep;
+		droppedTime += accumulator - keptTime;
+		accumulator = keptTime;
+		numSteps = maxStepsPerFrame;
+	}
+	
+	for ( Index i = 0; i < numSteps; i++ )
+	{
+		// Only the states before the last step are needed for interpolation.
+		if ( i + 1 == numSteps )
+			savePreviousStates();
+		
+		simulation->update( timeStep );
+		accumulator -= timeStep;
+		simulatedTime += timeStep;
+		
+		if ( recorder != NULL )
+			recorder->record( simulatedTime, *simulation );
+	}
+	
+	interpolation = math::clamp( Float(accumulator / timeStep), Float(0), Float(1) );
+	
+	return numSteps;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Render State Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+TransformState SimulationClock:: getRenderState( Index quadcopterIndex ) const
+{
+	const TransformState& current = simulation->getQuadcopter( quadcopterIndex )->currentState;
+	
+	if ( maxSpeed || quadcopterIndex >= previousStates.getSize() )
+		return current;
+	
+	const TransformState& previous = previousStates[quadcopterIndex];
+	const Float a = interpolation;
+	
+	// Interpolate the orientation along the shorter arc, since q and -q are the same rotation.
+	const Quaternion<Float> target = math::dot( previous.orientation, current.orientation ) < Float(0) ?
+									current.orientation*Float(-1) : current.orientation;
+	
+	return TransformState( previous.position + (current.position - previous.position)*a,
+						(previous.orientation + (target - previous.orientation)*a).normalize(),
+						previous.velocity + (current.velocity - previous.velocity)*a,
+						previous.angularVelocity + (current.angularVelocity - previous.angularVelocity)*a );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Time Step Accessor Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void SimulationClock:: setTimeStep( Float newTimeStep )
+{
+	newTimeStep = math::max( newTimeStep, MIN_TIME_STEP );
+	
+	// Keep the same fraction of a step accumulated so that the interpolation doesn't jump.
+	accumulator *= newTimeStep / timeStep;
+	timeStep = newTimeStep;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Max-Speed Mode Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void SimulationClock:: setMaxSpeed( Bool newMaxSpeed )
+{
+	if ( newMaxSpeed == maxSpeed )
+		return;
+	
+	if ( newMaxSpeed )
+	{
+		mutex.lock();
+		maxSpeed = true;
+		mutex.unlock();
+		
+		// Reuse one thread for every toggle, so that per-thread state such as the profiler buffers isn't recreated.
+		if ( !maxSpeedThreadStarted )
+		{
+			// bindCall() returns the wrong type for methods without parameters, so the call is built directly.
+			maxSpeedThread.start( FunctionCall<void ()>( bind( &SimulationClock::runMaxSpeed, this ) ) );
+			maxSpeedThreadStarted = true;
+		}
+		
+		maxSpeedSemaphore.up();
+	}
+	else
+	{
+		// The thread only steps while holding the lock, so no step can start after this.
+		mutex.lock();
+		maxSpeed = false;
+		mutex.unlock();
+		
+		// Resume from the current state without a backlog of real time to catch up on.
+		accumulator = 0;
+		interpolation = 1;
+	}
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void SimulationClock:: savePreviousStates()
+{
+	const Size numQuadcopters = simulation->getQuadcopterCount();
+	
+	previousStates.clear();
+	
+	for ( Index i = 0; i < numQuadcopters; i++ )
+		previousStates.add( simulation->getQuadcopter(i)->currentState );
+}
+
+
+
+
+void SimulationClock:: runMaxSpeed()
+{
+	while ( true )
+	{
+		// Wait until max-speed mode is enabled or the clock is destroyed.
+		maxSpeedSemaphore.down();
+		
+		while ( true )
+		{
+			mutex.lock();
+			
+			if ( stopMaxSpeedThread )
+			{
+				mutex.unlock();
+				return;
+			}
+			
+			if ( !maxSpeed )
+			{
+				mutex.unlock();
+				break;
+			}
+			
+			simulation->update( timeStep );
+			simulatedTime += timeStep;
+			
+			if ( recorder != NULL )
+				recorder->record( simulatedTime, *simulation );
+			
+			mutex.unlock();
+			
+			// Give a waiting render thread a chance to acquire the lock between steps.
+			threads::Thread::yield();
+		}
+	}
+}
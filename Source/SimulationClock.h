@@ -0,0 +1,356 @@
+/*
+ *  SimulationClock.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_SIMULATION_CLOCK_H
+#define INCLUDE_SIMULATION_CLOCK_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "Simulation.h"
+#include "TelemetryRecorder.h"
+
+
+
+
+/// A class that advances a simulation with fixed time steps to keep up with real time.
+/**
+  * The real time that elapses between frames is accumulated, and the simulation is
+  * updated by as many fixed steps as fit in the accumulated time, up to a limit per
+  * frame. The leftover time is used to interpolate the vehicle states for rendering,
+  * so that motion is smooth when the frame rate isn't a multiple of the step rate.
+  *
+  * In max-speed mode, the simulation is instead stepped as fast as possible on a
+  * separate thread. The clock's lock must then be held by any other thread while it
+  * reads or modifies the quadcopters in the simulation.
+  */
+class SimulationClock
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor / Destructor
+			
+			
+			
+			
+			/// Create a new clock for the specified simulation with the given fixed time step in seconds.
+			SimulationClock( Simulation* newSimulation, Float newTimeStep );
+			
+			
+			
+			
+			/// Destroy the clock, stopping the max-speed thread if it was started.
+			~SimulationClock();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Update Method
+			
+			
+			
+			
+			/// Advance the simulation by the real time that elapsed during the last frame.
+			/**
+			  * The method returns the number of fixed steps that were taken. If more steps
+			  * are needed than the per-frame limit allows, the rest of the time is dropped
+			  * and the simulation falls behind real time. In max-speed mode, the method
+			  * takes no steps and returns 0.
+			  */
+			Size advance( const Time& frameTime );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Render State Accessor Methods
+			
+			
+			
+			
+			/// Return the fraction of a time step that the accumulated time is past the last step, from 0 to 1.
+			RIM_INLINE Float getInterpolation() const
+			{
+				return interpolation;
+			}
+			
+			
+			
+			
+			/// Return the state of the quadcopter at the specified index interpolated to the current frame time.
+			/**
+			  * The state is interpolated between the states before and after the last step.
+			  * In max-speed mode, or for a quadcopter added since the last step, the current
+			  * state is returned.
+			  */
+			TransformState getRenderState( Index quadcopterIndex ) const;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Time Step Accessor Methods
+			
+			
+			
+			
+			/// Return the fixed time step of the simulation in seconds.
+			RIM_INLINE Float getTimeStep() const
+			{
+				return timeStep;
+			}
+			
+			
+			
+			
+			/// Set the fixed time step of the simulation in seconds.
+			/**
+			  * Larger steps trade accuracy for speed. The step is clamped to be at least a
+			  * small positive value. In max-speed mode, the clock's lock must be held.
+			  */
+			void setTimeStep( Float newTimeStep );
+			
+			
+			
+			
+			/// Return the maximum number of steps that are taken per frame.
+			RIM_INLINE Size getMaxStepsPerFrame() const
+			{
+				return maxStepsPerFrame;
+			}
+			
+			
+			
+			
+			/// Set the maximum number of steps that are taken per frame.
+			/**
+			  * The limit is clamped to be at least 1.
+			  */
+			RIM_INLINE void setMaxStepsPerFrame( Size newMaxStepsPerFrame )
+			{
+				maxStepsPerFrame = math::max( newMaxStepsPerFrame, Size(1) );
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Statistics Accessor Methods
+			
+			
+			
+			
+			/// Return the total time in seconds that has been simulated.
+			RIM_INLINE Double getSimulatedTime() const
+			{
+				return simulatedTime;
+			}
+			
+			
+			
+			
+			/// Return the total real time in seconds that was dropped because of the per-frame step limit.
+			RIM_INLINE Double getDroppedTime() const
+			{
+				return droppedTime;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Telemetry Methods
+			
+			
+			
+			
+			/// Return the recorder that a frame is added to after every step, or NULL if there is none.
+			RIM_INLINE TelemetryRecorder* getRecorder() const
+			{
+				return recorder;
+			}
+			
+			
+			
+			
+			/// Set the recorder that a frame is added to after every step, or NULL to stop adding frames.
+			/**
+			  * In max-speed mode, the clock's lock must be held.
+			  */
+			RIM_INLINE void setRecorder( TelemetryRecorder* newRecorder )
+			{
+				recorder = newRecorder;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Max-Speed Mode Methods
+			
+			
+			
+			
+			/// Return whether or not the simulation is being stepped as fast as possible on a separate thread.
+			RIM_INLINE Bool getMaxSpeed() const
+			{
+				return maxSpeed;
+			}
+			
+			
+			
+			
+			/// Set whether or not the simulation is stepped as fast as possible on a separate thread.
+			/**
+			  * The caller must not hold the clock's lock. When max-speed mode is disabled,
+			  * the method waits for the current step to finish and the clock resumes
+			  * following real time from the next frame. The max-speed thread is started
+			  * the first time the mode is enabled and then waits while it is disabled, so
+			  * toggling the mode doesn't create a new thread each time.
+			  */
+			void setMaxSpeed( Bool newMaxSpeed );
+			
+			
+			
+			
+			/// Acquire the lock that prevents the max-speed thread from stepping the simulation.
+			RIM_INLINE void lock()
+			{
+				mutex.lock();
+			}
+			
+			
+			
+			
+			/// Release the lock that prevents the max-speed thread from stepping the simulation.
+			RIM_INLINE void unlock()
+			{
+				mutex.unlock();
+			}
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Copy the current quadcopter states so that they can be interpolated after the next step.
+			void savePreviousStates();
+			
+			
+			
+			
+			/// Step the simulation repeatedly until max-speed mode is disabled. This is run by the max-speed thread.
+			void runMaxSpeed();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The simulation that is advanced by this clock.
+			Simulation* simulation;
+			
+			
+			/// The fixed time step of the simulation in seconds.
+			Float timeStep;
+			
+			
+			/// The maximum number of steps that are taken per frame.
+			Size maxStepsPerFrame;
+			
+			
+			/// The real time in seconds that has elapsed but not yet been simulated.
+			Double accumulator;
+			
+			
+			/// The fraction of a time step that the accumulated time is past the last step.
+			Float interpolation;
+			
+			
+			/// The total time in seconds that has been simulated.
+			Double simulatedTime;
+			
+			
+			/// The total real time in seconds that was dropped because of the per-frame step limit.
+			Double droppedTime;
+			
+			
+			/// The quadcopter states before the last step, in simulation order.
+			ArrayList<TransformState> previousStates;
+			
+			
+			/// The recorder that a frame is added to after every step, or NULL if there is none.
+			TelemetryRecorder* recorder;
+			
+			
+			/// Whether or not the simulation is being stepped as fast as possible on a separate thread.
+			Bool maxSpeed;
+			
+			
+			/// A mutex that is held by the max-speed thread while it steps the simulation.
+			threads::Mutex mutex;
+			
+			
+			/// The thread that steps the simulation in max-speed mode, which lives until the clock is destroyed.
+			threads::Thread maxSpeedThread;
+			
+			
+			/// Whether or not the max-speed thread has been started.
+			Bool maxSpeedThreadStarted;
+			
+			
+			/// Whether or not the max-speed thread should exit, which is only set by the destructor.
+			Bool stopMaxSpeedThread;
+			
+			
+			/// A semaphore that the max-speed thread waits on while max-speed mode is disabled.
+			threads::Semaphore maxSpeedSemaphore;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_SIMULATION_CLOCK_H
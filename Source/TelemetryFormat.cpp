@@ -0,0 +1,167 @@
+/*
+ *  TelemetryFormat.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "TelemetryFormat.h"
+
+
+/// The number of 32-bit words in a vehicle record.
+static const Size VEHICLE_RECORD_WORDS = sizeof(TelemetryFormat::VehicleRecord) / sizeof(UInt32);
+
+
+/// Control bytes below this value start a run of literal bytes, and the rest start a run of zero bytes.
+static const UByte ZERO_RUN_FLAG = 0x80;
+
+
+/// The maximum length of a run of either kind.
+static const Size MAX_RUN_LENGTH = 128;
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Vehicle Record Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void TelemetryFormat::VehicleRecord:: set( const Quadcopter& quadcopter )
+{
+	const TransformState& state = quadcopter.currentState;
+	
+	for ( Index i = 0; i < 3; i++ )
+	{
+		position[i] = state.position[i];
+		velocity[i] = state.velocity[i];
+		angularVelocity[i] = state.angularVelocity[i];
+		nextWaypoint[i] = quadcopter.nextWaypoint[i];
+	}
+	
+	orientation[0] = state.orientation.a;
+	orientation[1] = state.orientation.b;
+	orientation[2] = state.orientation.c;
+	orientation[3] = state.orientation.d;
+	
+	numThrusts = UInt32(math::min( quadcopter.motors.getSize(), MotorAllocator::MAX_MOTORS ));
+	
+	for ( Index m = 0; m < MotorAllocator::MAX_MOTORS; m++ )
+		thrusts[m] = m < numThrusts ? quadcopter.motors[m].thrust : Float32(0);
+}
+
+
+
+
+TransformState TelemetryFormat::VehicleRecord:: getState() const
+{
+	return TransformState( Vector3f( position[0], position[1], position[2] ),
+							Quaternion<Float>( orientation[0], orientation[1], orientation[2], orientation[3] ),
+							Vector3f( velocity[0], velocity[1], velocity[2] ),
+							Vector3f( angularVelocity[0], angularVelocity[1], angularVelocity[2] ) );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Chunk Encoding Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void TelemetryFormat:: xorRecord( VehicleRecord& record, const VehicleRecord& previous )
+{
+	UInt32* words = (UInt32*)&record;
+	const UInt32* previousWords = (const UInt32*)&previous;
+	
+	for ( Index i = 0; i < VEHICLE_RECORD_WORDS; i++ )
+		words[i] ^= previousWords[i];
+}
+
+
+
+
+void TelemetryFormat:: compress( const UByte* data, Size size, ArrayList<UByte>& output )
+{
+	Index i = 0;
+	
+	while ( i < size )
+	{
+		// Measure the run of zero bytes at the current position.
+		Size zeroRun = 0;
+		
+		while ( i + zeroRun < size && zeroRun < MAX_RUN_LENGTH && data[i + zeroRun] == 0 )
+			zeroRun++;
+		
+		// A single zero costs as much as a literal byte, so only longer runs are encoded.
+		if ( zeroRun >= 2 )
+		{
+			output.add( UByte(ZERO_RUN_FLAG + zeroRun - 1) );
+			i += zeroRun;
+			continue;
+		}
+		
+		// Copy literal bytes until the next run of zeros.
+		const Index literalStart = i;
+		
+		while ( i < size && i - literalStart < MAX_RUN_LENGTH &&
+				!(data[i] == 0 && i + 1 < size && data[i + 1] == 0) )
+			i++;
+		
+		output.add( UByte(i - literalStart - 1) );
+		
+		for ( Index j = literalStart; j < i; j++ )
+			output.add( data[j] );
+	}
+}
+
+
+
+
+Bool TelemetryFormat:: decompress( const UByte* data, Size size, UByte* output, Size outputSize )
+{
+	Index input = 0;
+	Index outputIndex = 0;
+	
+	while ( input < size )
+	{
+		const UByte control = data[input++];
+		
+		if ( control < ZERO_RUN_FLAG )
+		{
+			const Size runLength = Size(control) + 1;
+			
+			if ( input + runLength > size || outputIndex + runLength > outputSize )
+				return false;
+			
+			rim::util::copy( output + outputIndex, data + input, runLength );
+			input += runLength;
+			outputIndex += runLength;
+		}
+		else
+		{
+			const Size runLength = Size(control - ZERO_RUN_FLAG) + 1;
+			
+			if ( outputIndex + runLength > outputSize )
+				return false;
+			
+			rim::util::zero( output + outputIndex, runLength );
+			outputIndex += runLength;
+		}
+	}
+	
+	return outputIndex == outputSize;
+}
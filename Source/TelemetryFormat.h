@@ -0,0 +1,244 @@
+/*
+ *  TelemetryFormat.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_TELEMETRY_FORMAT_H
+#define INCLUDE_TELEMETRY_FORMAT_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "Quadcopter.h"
+
+
+
+
+/// A class that describes the binary layout of a telemetry log and compresses its chunks.
+/**
+  * A log is a FileHeader followed by any number of chunks. Each chunk is a ChunkHeader
+  * followed by the chunk's compressed frames, and can be decoded without reading any
+  * other chunk, so a reader can seek to a chunk by its time range. Since chunks are only
+  * ever appended, a log that was cut short still has every chunk before the last one.
+  *
+  * A frame is a FrameHeader, followed by a path record for each vehicle whose path
+  * changed, followed by a VehicleRecord for each vehicle. The first frame of each chunk
+  * has a path record for every vehicle that has a path.
+  *
+  * Within a chunk, each vehicle record is stored as the XOR of its words with the
+  * same vehicle's record in the previous frame. Most of those bits are zero for a
+  * smoothly moving vehicle, and the runs of zero bytes are then run-length encoded.
+  *
+  * All values are stored in native byte order, like the other cache files.
+  */
+class TelemetryFormat
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	File Header Class Declaration
+			
+			
+			
+			
+			/// The header at the start of a telemetry log.
+			class FileHeader
+			{
+				public:
+					
+					/// The magic number that identifies a telemetry log.
+					UInt32 magic;
+					
+					/// The version of the log format.
+					UInt32 version;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Chunk Header Class Declaration
+			
+			
+			
+			
+			/// The header at the start of each chunk of frames.
+			class ChunkHeader
+			{
+				public:
+					
+					/// The magic number that marks the start of a chunk.
+					UInt32 magic;
+					
+					/// The size in bytes of the chunk's frames after decompression.
+					UInt32 rawSize;
+					
+					/// The size in bytes of the compressed frames that follow the header.
+					UInt32 compressedSize;
+					
+					/// The number of frames in the chunk.
+					UInt32 numFrames;
+					
+					/// The simulation time of the first frame in the chunk.
+					Float64 startTime;
+					
+					/// The simulation time of the last frame in the chunk.
+					Float64 endTime;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Frame Record Class Declarations
+			
+			
+			
+			
+			/// The header at the start of each frame.
+			class FrameHeader
+			{
+				public:
+					
+					/// The simulation time of the frame.
+					Float64 time;
+					
+					/// The number of vehicle records in the frame.
+					UInt32 numVehicles;
+					
+					/// The number of path records in the frame.
+					UInt32 numPaths;
+			
+			};
+			
+			
+			
+			
+			/// The header of a path record, which is followed by the waypoints as 3 floats each.
+			class PathHeader
+			{
+				public:
+					
+					/// The index of the vehicle whose path this is.
+					UInt32 vehicleIndex;
+					
+					/// The number of waypoints in the path.
+					UInt32 numWaypoints;
+			
+			};
+			
+			
+			
+			
+			/// The state of one vehicle in a frame, stored entirely as 32-bit words.
+			class VehicleRecord
+			{
+				public:
+					
+					/// Store the current state, next waypoint, and motor thrusts of a quadcopter.
+					void set( const Quadcopter& quadcopter );
+					
+					
+					/// Return the transform state that is stored in this record.
+					TransformState getState() const;
+					
+					
+					/// Return the next waypoint that is stored in this record.
+					RIM_INLINE Vector3f getNextWaypoint() const
+					{
+						return Vector3f( nextWaypoint[0], nextWaypoint[1], nextWaypoint[2] );
+					}
+					
+					
+					Float32 position[3];
+					Float32 velocity[3];
+					Float32 angularVelocity[3];
+					
+					/// The orientation quaternion's components, in the order a, b, c, d.
+					Float32 orientation[4];
+					
+					Float32 nextWaypoint[3];
+					
+					/// The thrust of each motor, where only the first numThrusts are valid.
+					Float32 thrusts[MotorAllocator::MAX_MOTORS];
+					
+					/// The number of valid motor thrusts.
+					UInt32 numThrusts;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Chunk Encoding Methods
+			
+			
+			
+			
+			/// XOR the words of a vehicle record with those of the same vehicle's previous record.
+			/**
+			  * This is its own inverse, so it both encodes and decodes the delta.
+			  */
+			static void xorRecord( VehicleRecord& record, const VehicleRecord& previous );
+			
+			
+			
+			
+			/// Run-length encode the runs of zero bytes in the data, appending the result to the output.
+			static void compress( const UByte* data, Size size, ArrayList<UByte>& output );
+			
+			
+			
+			
+			/// Decode compressed data into an output buffer, returning whether or not it had exactly the expected size.
+			static Bool decompress( const UByte* data, Size size, UByte* output, Size outputSize );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Static Data Members
+			
+			
+			
+			
+			/// The magic number that identifies a telemetry log, 'QTLM'.
+			static const UInt32 FILE_MAGIC = 0x4D4C5451;
+			
+			
+			/// The version of the log format.
+			static const UInt32 FILE_VERSION = 1;
+			
+			
+			/// The magic number that marks the start of a chunk, 'CHNK'.
+			static const UInt32 CHUNK_MAGIC = 0x4B4E4843;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_TELEMETRY_FORMAT_H
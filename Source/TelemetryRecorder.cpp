@@ -0,0 +1,379 @@
+/*
+ *  TelemetryRecorder.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "TelemetryRecorder.h"
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor / Destructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+TelemetryRecorder:: TelemetryRecorder()
+	:	recording( false ),
+		numFrames( 0 ),
+		numStalls( 0 ),
+		numDroppedFrames( 0 ),
+		writeIndex( 0 ),
+		readIndex( 0 ),
+		stopRequested( 0 )
+{
+}
+
+
+
+
+TelemetryRecorder:: ~TelemetryRecorder()
+{
+	stop();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Recording Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool TelemetryRecorder:: start( const data::UTF8String& filePath, Size newRingCapacity )
+{
+	stop();
+	
+	Pointer<rim::io::FileWriter> newWriter = Pointer<rim::io::FileWriter>::construct( filePath );
+	
+	if ( !newWriter->open() || !newWriter->erase() )
+		return false;
+	
+	TelemetryFormat::FileHeader header;
+	header.magic = TelemetryFormat::FILE_MAGIC;
+	header.version = TelemetryFormat::FILE_VERSION;
+	
+	if ( newWriter->write( (const UByte*)&header, sizeof(TelemetryFormat::FileHeader) ) != sizeof(TelemetryFormat::FileHeader) )
+	{
+		newWriter->close();
+		return false;
+	}
+	
+	// The capacity is a power of two so that positions can be wrapped with a mask.
+	Size ringCapacity = 1;
+	
+	while ( ringCapacity < newRingCapacity )
+		ringCapacity <<= 1;
+	
+	ring.setSize( ringCapacity );
+	writeIndex = 0;
+	readIndex = 0;
+	stopRequested = 0;
+	
+	writer = newWriter;
+	chunkData.clear();
+	chunkHeader.numFrames = 0;
+	writerPaths.clear();
+	previousRecords.clear();
+	recordedPaths.clear();
+	numFrames = 0;
+	numStalls = 0;
+	numDroppedFrames = 0;
+	
+	writerThread.start( FunctionCall<void ()>( bind( &TelemetryRecorder::runWriter, this ) ) );
+	recording = true;
+	
+	return true;
+}
+
+
+
+
+void TelemetryRecorder:: stop()
+{
+	if ( !recording )
+		return;
+	
+	threads::atomic::addAndRead( stopRequested, Size(1) );
+	writerThread.join();
+	
+	writer->close();
+	writer.release();
+	
+	ring.setSize( 0 );
+	pending.clear();
+	recording = false;
+}
+
+
+
+
+void TelemetryRecorder:: record( Double time, const Simulation& simulation )
+{
+	if ( !recording )
+		return;
+	
+	const Size numVehicles = simulation.getQuadcopterCount();
+	
+	TelemetryFormat::FrameHeader frameHeader;
+	frameHeader.time = time;
+	frameHeader.numVehicles = UInt32(numVehicles);
+	frameHeader.numPaths = 0;
+	
+	frameBuffer.clear();
+	frameBuffer.addAll( (const UByte*)&frameHeader, sizeof(TelemetryFormat::FrameHeader) );
+	
+	if ( recordedPaths.getSize() > numVehicles )
+		recordedPaths.removeLast( recordedPaths.getSize() - numVehicles );
+	
+	// Paths rarely change, so they are only stored in the frames where they do.
+	for ( Index i = 0; i < numVehicles; i++ )
+	{
+		const vertices& path = simulation.getQuadcopter(i)->path;
+		
+		if ( i == recordedPaths.getSize() )
+			recordedPaths.add( vertices() );
+		
+		if ( path == recordedPaths[i] )
+			continue;
+		
+		recordedPaths[i] = path;
+		
+		TelemetryFormat::PathHeader pathHeader;
+		pathHeader.vehicleIndex = UInt32(i);
+		pathHeader.numWaypoints = UInt32(path.size());
+		frameBuffer.addAll( (const UByte*)&pathHeader, sizeof(TelemetryFormat::PathHeader) );
+		
+		for ( Index w = 0; w < path.size(); w++ )
+		{
+			const Float32 waypoint[3] = { path[w].x, path[w].y, path[w].z };
+			frameBuffer.addAll( (const UByte*)waypoint, sizeof(waypoint) );
+		}
+		
+		frameHeader.numPaths++;
+	}
+	
+	rim::util::copy( frameBuffer.getPointer(), (const UByte*)&frameHeader, sizeof(TelemetryFormat::FrameHeader) );
+	
+	for ( Index i = 0; i < numVehicles; i++ )
+	{
+		TelemetryFormat::VehicleRecord record;
+		record.set( *simulation.getQuadcopter(i) );
+		frameBuffer.addAll( (const UByte*)&record, sizeof(TelemetryFormat::VehicleRecord) );
+	}
+	
+	pushFrame( frameBuffer.getPointer(), frameBuffer.getSize() );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void TelemetryRecorder:: pushFrame( const UByte* data, Size size )
+{
+	const Size capacity = ring.getSize();
+	
+	if ( size > capacity )
+	{
+		numDroppedFrames++;
+		return;
+	}
+	
+	// Only this thread changes the write position, so it can be read without synchronization.
+	if ( capacity - (writeIndex - threads::atomic::addAndRead( readIndex, Size(0) )) < size )
+	{
+		numStalls++;
+		
+		while ( capacity - (writeIndex - threads::atomic::addAndRead( readIndex, Size(0) )) < size )
+			threads::Thread::yield();
+	}
+	
+	const Index start = writeIndex & (capacity - 1);
+	const Size firstPart = math::min( size, capacity - start );
+	
+	rim::util::copy( ring.getPointer() + start, data, firstPart );
+	rim::util::copy( ring.getPointer(), data + firstPart, size - firstPart );
+	
+	// Publish the frame only after all of its bytes are in the ring.
+	threads::atomic::addAndRead( writeIndex, size );
+	numFrames++;
+}
+
+
+
+
+void TelemetryRecorder:: runWriter()
+{
+	while ( true )
+	{
+		// Read the stop flag first so that every frame pushed before stop() was called is seen below.
+		const Bool stopping = threads::atomic::addAndRead( stopRequested, Size(0) ) != 0;
+		const Size available = threads::atomic::addAndRead( writeIndex, Size(0) ) - readIndex;
+		
+		if ( available == 0 )
+		{
+			if ( stopping )
+				break;
+			
+			threads::Thread::sleep( 1 );
+			continue;
+		}
+		
+		const Size capacity = ring.getSize();
+		const Index start = readIndex & (capacity - 1);
+		const Size firstPart = math::min( available, capacity - start );
+		
+		pending.clear();
+		pending.addAll( ring.getPointer() + start, firstPart );
+		pending.addAll( ring.getPointer(), available - firstPart );
+		
+		// Free the space in the ring before encoding, so that the simulation thread isn't kept waiting.
+		threads::atomic::addAndRead( readIndex, available );
+		
+		// Frames are only published whole, so the pending bytes always end on a frame boundary.
+		const UByte* frame = pending.getPointer();
+		const UByte* const pendingEnd = frame + available;
+		
+		while ( frame < pendingEnd )
+			frame += encodeFrame( frame );
+	}
+	
+	writeChunk();
+}
+
+
+
+
+Size TelemetryRecorder:: encodeFrame( const UByte* frame )
+{
+	TelemetryFormat::FrameHeader frameHeader;
+	rim::util::copy( (UByte*)&frameHeader, frame, sizeof(TelemetryFormat::FrameHeader) );
+	
+	const UByte* input = frame + sizeof(TelemetryFormat::FrameHeader);
+	const UByte* const pathRecords = input;
+	
+	// Keep the latest path of each vehicle so that it can be repeated at the start of the next chunk.
+	for ( Index p = 0; p < frameHeader.numPaths; p++ )
+	{
+		TelemetryFormat::PathHeader pathHeader;
+		rim::util::copy( (UByte*)&pathHeader, input, sizeof(TelemetryFormat::PathHeader) );
+		
+		const Size recordSize = sizeof(TelemetryFormat::PathHeader) + 3*sizeof(Float32)*pathHeader.numWaypoints;
+		
+		while ( writerPaths.getSize() <= pathHeader.vehicleIndex )
+			writerPaths.add( ArrayList<UByte>() );
+		
+		ArrayList<UByte>& path = writerPaths[pathHeader.vehicleIndex];
+		path.clear();
+		path.addAll( input, recordSize );
+		
+		input += recordSize;
+	}
+	
+	// Don't repeat the paths of vehicles that were removed.
+	if ( writerPaths.getSize() > frameHeader.numVehicles )
+		writerPaths.removeLast( writerPaths.getSize() - frameHeader.numVehicles );
+	
+	if ( chunkHeader.numFrames == 0 )
+	{
+		// The first frame of a chunk has every path and no deltas, so that the chunk can be decoded on its own.
+		chunkHeader.startTime = frameHeader.time;
+		previousRecords.clear();
+		frameHeader.numPaths = 0;
+		
+		for ( Index i = 0; i < writerPaths.getSize(); i++ )
+		{
+			if ( writerPaths[i].getSize() > 0 )
+				frameHeader.numPaths++;
+		}
+		
+		chunkData.addAll( (const UByte*)&frameHeader, sizeof(TelemetryFormat::FrameHeader) );
+		
+		for ( Index i = 0; i < writerPaths.getSize(); i++ )
+			chunkData.addAll( writerPaths[i].getPointer(), writerPaths[i].getSize() );
+	}
+	else
+	{
+		chunkData.addAll( (const UByte*)&frameHeader, sizeof(TelemetryFormat::FrameHeader) );
+		chunkData.addAll( pathRecords, Size(input - pathRecords) );
+	}
+	
+	// Store each record as the XOR with the vehicle's previous record, or as is for a new vehicle.
+	for ( Index i = 0; i < frameHeader.numVehicles; i++ )
+	{
+		TelemetryFormat::VehicleRecord record;
+		rim::util::copy( (UByte*)&record, input, sizeof(TelemetryFormat::VehicleRecord) );
+		input += sizeof(TelemetryFormat::VehicleRecord);
+		
+		if ( i < previousRecords.getSize() )
+		{
+			TelemetryFormat::VehicleRecord delta = record;
+			TelemetryFormat::xorRecord( delta, previousRecords[i] );
+			previousRecords[i] = record;
+			chunkData.addAll( (const UByte*)&delta, sizeof(TelemetryFormat::VehicleRecord) );
+		}
+		else
+		{
+			previousRecords.add( record );
+			chunkData.addAll( (const UByte*)&record, sizeof(TelemetryFormat::VehicleRecord) );
+		}
+	}
+	
+	chunkHeader.endTime = frameHeader.time;
+	chunkHeader.numFrames++;
+	
+	if ( chunkData.getSize() >= CHUNK_SIZE )
+		writeChunk();
+	
+	return Size(input - frame);
+}
+
+
+
+
+void TelemetryRecorder:: writeChunk()
+{
+	if ( chunkHeader.numFrames == 0 )
+		return;
+	
+	compressedData.clear();
+	TelemetryFormat::compress( chunkData.getPointer(), chunkData.getSize(), compressedData );
+	
+	chunkHeader.magic = TelemetryFormat::CHUNK_MAGIC;
+	chunkHeader.rawSize = UInt32(chunkData.getSize());
+	chunkHeader.compressedSize = UInt32(compressedData.getSize());
+	
+	writer->write( (const UByte*)&chunkHeader, sizeof(TelemetryFormat::ChunkHeader) );
+	writer->write( compressedData.getPointer(), compressedData.getSize() );
+	
+	// Flush each chunk so that a log that is cut short still has every complete chunk.
+	writer->flush();
+	
+	chunkData.clear();
+	chunkHeader.numFrames = 0;
+}
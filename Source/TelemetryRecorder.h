@@ -0,0 +1,305 @@
+/*
+ *  TelemetryRecorder.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_TELEMETRY_RECORDER_H
+#define INCLUDE_TELEMETRY_RECORDER_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "Simulation.h"
+#include "TelemetryFormat.h"
+
+
+
+
+/// A class that records the state of every vehicle in a simulation to a telemetry log.
+/**
+  * The simulation thread serializes each frame into a ring buffer and returns. A
+  * background thread takes the frames out of the ring, delta-encodes them, and writes
+  * a compressed chunk to the log whenever enough frames have been collected, so
+  * recording never waits on the disk. The ring has a single producer and a single
+  * consumer, and the two only share the ring's read and write positions, which are
+  * updated atomically.
+  *
+  * If the writer falls so far behind that the ring is full, the simulation thread
+  * waits for space and the wait is counted as a stall.
+  *
+  * The log format is described by TelemetryFormat, and logs are read by TelemetryReplay.
+  */
+class TelemetryRecorder
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor / Destructor
+			
+			
+			
+			
+			/// Create a new telemetry recorder that isn't recording.
+			TelemetryRecorder();
+			
+			
+			
+			
+			/// Destroy the recorder, finishing the log if it is recording.
+			~TelemetryRecorder();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Recording Methods
+			
+			
+			
+			
+			/// Start a new log at the specified path, returning whether or not the file could be created.
+			/**
+			  * The ring capacity is rounded up to a power of two. If the recorder is
+			  * already recording, the previous log is finished first.
+			  */
+			Bool start( const data::UTF8String& filePath, Size newRingCapacity = DEFAULT_RING_CAPACITY );
+			
+			
+			
+			
+			/// Write the frames that are left in the ring to the log, then close the log.
+			/**
+			  * The method waits for the background thread to finish. It does nothing if
+			  * the recorder isn't recording.
+			  */
+			void stop();
+			
+			
+			
+			
+			/// Add a frame with the current state of every vehicle in the simulation at the specified time.
+			/**
+			  * This must only be called by one thread at a time, while the simulation
+			  * isn't being updated. A vehicle's path is only stored when it has changed
+			  * since the previous frame.
+			  */
+			void record( Double time, const Simulation& simulation );
+			
+			
+			
+			
+			/// Return whether or not the recorder is writing a log.
+			RIM_INLINE Bool isRecording() const
+			{
+				return recording;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Statistics Accessor Methods
+			
+			
+			
+			
+			/// Return the number of frames that have been added to the current log.
+			RIM_INLINE Size getFrameCount() const
+			{
+				return numFrames;
+			}
+			
+			
+			
+			
+			/// Return the number of frames for which the simulation thread had to wait for space in the ring.
+			RIM_INLINE Size getStallCount() const
+			{
+				return numStalls;
+			}
+			
+			
+			
+			
+			/// Return the number of frames that were dropped because they were larger than the ring.
+			RIM_INLINE Size getDroppedFrameCount() const
+			{
+				return numDroppedFrames;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Public Static Data Members
+			
+			
+			
+			
+			/// The default capacity of the ring buffer in bytes.
+			static const Size DEFAULT_RING_CAPACITY = Size(1) << 23;
+			
+			
+			/// The size in bytes of uncompressed frames at which a chunk is written to the log.
+			static const Size CHUNK_SIZE = Size(1) << 20;
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Copy a serialized frame into the ring, waiting until there is room for it.
+			void pushFrame( const UByte* data, Size size );
+			
+			
+			
+			
+			/// Move frames from the ring to the log until recording stops. This is run by the writer thread.
+			void runWriter();
+			
+			
+			
+			
+			/// Delta-encode one frame from the ring and add it to the current chunk, returning the frame's size.
+			Size encodeFrame( const UByte* frame );
+			
+			
+			
+			
+			/// Compress the current chunk and append it to the log.
+			void writeChunk();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Producer Data Members
+			
+			
+			
+			
+			/// Whether or not the recorder is writing a log.
+			Bool recording;
+			
+			
+			/// The buffer that the simulation thread serializes each frame into.
+			ArrayList<UByte> frameBuffer;
+			
+			
+			/// The path of each vehicle in the previous frame, used to detect when a path changes.
+			ArrayList<vertices> recordedPaths;
+			
+			
+			/// The number of frames that have been added to the current log.
+			Size numFrames;
+			
+			
+			/// The number of frames for which the simulation thread had to wait for space in the ring.
+			Size numStalls;
+			
+			
+			/// The number of frames that were dropped because they were larger than the ring.
+			Size numDroppedFrames;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Ring Data Members
+			
+			
+			
+			
+			/// The ring buffer of serialized frames, whose size is a power of two.
+			Array<UByte> ring;
+			
+			
+			/// The total number of bytes that have been added to the ring, only changed by the simulation thread.
+			Size writeIndex;
+			
+			
+			/// The total number of bytes that have been removed from the ring, only changed by the writer thread.
+			Size readIndex;
+			
+			
+			/// Nonzero when the writer thread should finish the log once the ring is empty.
+			Size stopRequested;
+			
+			
+			/// The thread that moves frames from the ring to the log.
+			threads::Thread writerThread;
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Writer Data Members
+			
+			
+			
+			
+			/// The log that chunks are appended to.
+			Pointer<rim::io::FileWriter> writer;
+			
+			
+			/// The frames that have been taken out of the ring but not yet encoded.
+			ArrayList<UByte> pending;
+			
+			
+			/// The encoded frames of the current chunk before compression.
+			ArrayList<UByte> chunkData;
+			
+			
+			/// The compressed frames of the current chunk.
+			ArrayList<UByte> compressedData;
+			
+			
+			/// The header of the current chunk, whose sizes are filled in when it is written.
+			TelemetryFormat::ChunkHeader chunkHeader;
+			
+			
+			/// The latest path record of each vehicle, which is repeated at the start of every chunk.
+			ArrayList< ArrayList<UByte> > writerPaths;
+			
+			
+			/// The previous record of each vehicle in the current chunk, which the next record is encoded against.
+			ArrayList<TelemetryFormat::VehicleRecord> previousRecords;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_TELEMETRY_RECORDER_H
@@ -0,0 +1,380 @@
+/*
+ *  TelemetryReplay.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "TelemetryReplay.h"
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+TelemetryReplay:: TelemetryReplay()
+	:	numFrames( 0 ),
+		loadedChunk( 0 ),
+		frameIndex( 0 ),
+		frameTime( 0 ),
+		pathFrame( -1 )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		File Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool TelemetryReplay:: open( const data::UTF8String& filePath )
+{
+	close();
+	
+	if ( !file.open( filePath ) || file.getSize() < sizeof(TelemetryFormat::FileHeader) )
+	{
+		file.close();
+		return false;
+	}
+	
+	const UByte* data = file.getData();
+	const Size fileSize = file.getSize();
+	
+	TelemetryFormat::FileHeader header;
+	rim::util::copy( (UByte*)&header, data, sizeof(TelemetryFormat::FileHeader) );
+	
+	if ( header.magic != TelemetryFormat::FILE_MAGIC || header.version != TelemetryFormat::FILE_VERSION )
+	{
+		file.close();
+		return false;
+	}
+	
+	// Index the chunks, stopping at the first one that is incomplete.
+	Size offset = sizeof(TelemetryFormat::FileHeader);
+	
+	while ( fileSize - offset >= sizeof(TelemetryFormat::ChunkHeader) )
+	{
+		Chunk chunk;
+		rim::util::copy( (UByte*)&chunk.header, data + offset, sizeof(TelemetryFormat::ChunkHeader) );
+		chunk.dataOffset = offset + sizeof(TelemetryFormat::ChunkHeader);
+		chunk.firstFrame = numFrames;
+		
+		if ( chunk.header.magic != TelemetryFormat::CHUNK_MAGIC || chunk.header.numFrames == 0 ||
+			chunk.header.compressedSize > fileSize - chunk.dataOffset )
+			break;
+		
+		chunks.add( chunk );
+		numFrames += chunk.header.numFrames;
+		offset = chunk.dataOffset + chunk.header.compressedSize;
+	}
+	
+	loadedChunk = chunks.getSize();
+	
+	if ( !seekFrame( 0 ) )
+	{
+		close();
+		return false;
+	}
+	
+	return true;
+}
+
+
+
+
+void TelemetryReplay:: close()
+{
+	file.close();
+	chunks.clear();
+	numFrames = 0;
+	loadedChunk = 0;
+	chunkData.setSize( 0 );
+	frameOffsets.clear();
+	recordOffsets.clear();
+	frameTimes.clear();
+	frameIndex = 0;
+	frameTime = 0;
+	pathFrame = -1;
+	vehicleRecords.clear();
+	paths.clear();
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Seek Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool TelemetryReplay:: seek( Double time )
+{
+	if ( chunks.getSize() == 0 )
+		return false;
+	
+	// Find the last chunk that starts at or before the time.
+	Index low = 0;
+	Index high = chunks.getSize();
+	
+	while ( high - low > 1 )
+	{
+		const Index middle = (low + high) / 2;
+		
+		if ( chunks[middle].header.startTime <= time )
+			low = middle;
+		else
+			high = middle;
+	}
+	
+	if ( !loadChunk( low ) )
+		return false;
+	
+	const Index chunkIndex = low;
+	
+	// Then find the last frame in that chunk at or before the time.
+	low = 0;
+	high = frameTimes.getSize();
+	
+	while ( high - low > 1 )
+	{
+		const Index middle = (low + high) / 2;
+		
+		if ( frameTimes[middle] <= time )
+			low = middle;
+		else
+			high = middle;
+	}
+	
+	readFrame( low );
+	frameIndex = chunks[chunkIndex].firstFrame + low;
+	
+	return true;
+}
+
+
+
+
+Bool TelemetryReplay:: seekFrame( Index newFrameIndex )
+{
+	if ( newFrameIndex >= numFrames )
+		return false;
+	
+	// Find the last chunk whose first frame is at or before the frame.
+	Index low = 0;
+	Index high = chunks.getSize();
+	
+	while ( high - low > 1 )
+	{
+		const Index middle = (low + high) / 2;
+		
+		if ( chunks[middle].firstFrame <= newFrameIndex )
+			low = middle;
+		else
+			high = middle;
+	}
+	
+	if ( !loadChunk( low ) )
+		return false;
+	
+	readFrame( newFrameIndex - chunks[low].firstFrame );
+	frameIndex = newFrameIndex;
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool TelemetryReplay:: loadChunk( Index chunkIndex )
+{
+	if ( chunkIndex == loadedChunk )
+		return true;
+	
+	const Chunk& chunk = chunks[chunkIndex];
+	const Size rawSize = chunk.header.rawSize;
+	
+	// Invalidate the loaded chunk until the new one has been decoded.
+	loadedChunk = chunks.getSize();
+	
+	if ( chunkData.getSize() < rawSize )
+		chunkData.setSize( rawSize );
+	
+	if ( !TelemetryFormat::decompress( file.getData() + chunk.dataOffset, chunk.header.compressedSize,
+										chunkData.getPointer(), rawSize ) )
+		return false;
+	
+	UByte* const data = chunkData.getPointer();
+	ArrayList<TelemetryFormat::VehicleRecord> previousRecords;
+	Size offset = 0;
+	
+	frameOffsets.clear();
+	recordOffsets.clear();
+	frameTimes.clear();
+	
+	// Check that every record is in bounds while undoing the deltas, so that readFrame() can trust the offsets.
+	for ( Index f = 0; f < chunk.header.numFrames; f++ )
+	{
+		if ( rawSize - offset < sizeof(TelemetryFormat::FrameHeader) )
+			return false;
+		
+		TelemetryFormat::FrameHeader frameHeader;
+		rim::util::copy( (UByte*)&frameHeader, data + offset, sizeof(TelemetryFormat::FrameHeader) );
+		
+		frameOffsets.add( offset );
+		frameTimes.add( frameHeader.time );
+		offset += sizeof(TelemetryFormat::FrameHeader);
+		
+		for ( Index p = 0; p < frameHeader.numPaths; p++ )
+		{
+			if ( rawSize - offset < sizeof(TelemetryFormat::PathHeader) )
+				return false;
+			
+			TelemetryFormat::PathHeader pathHeader;
+			rim::util::copy( (UByte*)&pathHeader, data + offset, sizeof(TelemetryFormat::PathHeader) );
+			offset += sizeof(TelemetryFormat::PathHeader);
+			
+			// A path must belong to a vehicle in its frame, and its waypoints must fit in the rest of the chunk.
+			if ( pathHeader.vehicleIndex >= frameHeader.numVehicles ||
+				(rawSize - offset) / (3*sizeof(Float32)) < pathHeader.numWaypoints )
+				return false;
+			
+			offset += 3*sizeof(Float32)*pathHeader.numWaypoints;
+		}
+		
+		if ( (rawSize - offset) / sizeof(TelemetryFormat::VehicleRecord) < frameHeader.numVehicles )
+			return false;
+		
+		recordOffsets.add( offset );
+		
+		for ( Index i = 0; i < frameHeader.numVehicles; i++ )
+		{
+			TelemetryFormat::VehicleRecord record;
+			rim::util::copy( (UByte*)&record, data + offset, sizeof(TelemetryFormat::VehicleRecord) );
+			
+			if ( i < previousRecords.getSize() )
+			{
+				TelemetryFormat::xorRecord( record, previousRecords[i] );
+				previousRecords[i] = record;
+				rim::util::copy( data + offset, (const UByte*)&record, sizeof(TelemetryFormat::VehicleRecord) );
+			}
+			else
+				previousRecords.add( record );
+			
+			offset += sizeof(TelemetryFormat::VehicleRecord);
+		}
+	}
+	
+	if ( offset != rawSize )
+		return false;
+	
+	loadedChunk = chunkIndex;
+	pathFrame = -1;
+	
+	return true;
+}
+
+
+
+
+void TelemetryReplay:: readFrame( Index chunkFrameIndex )
+{
+	const UByte* const data = chunkData.getPointer();
+	
+	// Paths are only stored when they change, so replay them from the chunk's first frame, which has every path.
+	Index firstPathFrame = Index(pathFrame + 1);
+	
+	if ( pathFrame < 0 || Int64(chunkFrameIndex) < pathFrame )
+	{
+		firstPathFrame = 0;
+		paths.clear();
+	}
+	
+	for ( Index f = firstPathFrame; f <= chunkFrameIndex; f++ )
+	{
+		TelemetryFormat::FrameHeader frameHeader;
+		rim::util::copy( (UByte*)&frameHeader, data + frameOffsets[f], sizeof(TelemetryFormat::FrameHeader) );
+		
+		Size offset = frameOffsets[f] + sizeof(TelemetryFormat::FrameHeader);
+		
+		for ( Index p = 0; p < frameHeader.numPaths; p++ )
+		{
+			TelemetryFormat::PathHeader pathHeader;
+			rim::util::copy( (UByte*)&pathHeader, data + offset, sizeof(TelemetryFormat::PathHeader) );
+			offset += sizeof(TelemetryFormat::PathHeader);
+			
+			while ( paths.getSize() <= pathHeader.vehicleIndex )
+				paths.add( vertices() );
+			
+			vertices& path = paths[pathHeader.vehicleIndex];
+			path.resize( pathHeader.numWaypoints );
+			
+			for ( Index w = 0; w < pathHeader.numWaypoints; w++ )
+			{
+				Float32 waypoint[3];
+				rim::util::copy( (UByte*)waypoint, data + offset, sizeof(waypoint) );
+				path[w] = Vector3f( waypoint[0], waypoint[1], waypoint[2] );
+				offset += sizeof(waypoint);
+			}
+		}
+		
+		// Forget the paths of vehicles that were removed, like the recorder does.
+		if ( paths.getSize() > frameHeader.numVehicles )
+			paths.removeLast( paths.getSize() - frameHeader.numVehicles );
+	}
+	
+	pathFrame = Int64(chunkFrameIndex);
+	
+	TelemetryFormat::FrameHeader frameHeader;
+	rim::util::copy( (UByte*)&frameHeader, data + frameOffsets[chunkFrameIndex], sizeof(TelemetryFormat::FrameHeader) );
+	
+	const UByte* records = data + recordOffsets[chunkFrameIndex];
+	vehicleRecords.clear();
+	
+	for ( Index i = 0; i < frameHeader.numVehicles; i++ )
+	{
+		TelemetryFormat::VehicleRecord record;
+		rim::util::copy( (UByte*)&record, records, sizeof(TelemetryFormat::VehicleRecord) );
+		vehicleRecords.add( record );
+		records += sizeof(TelemetryFormat::VehicleRecord);
+	}
+	
+	while ( paths.getSize() < vehicleRecords.getSize() )
+		paths.add( vertices() );
+	
+	frameTime = frameHeader.time;
+}
@@ -0,0 +1,338 @@
+/*
+ *  TelemetryReplay.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_TELEMETRY_REPLAY_H
+#define INCLUDE_TELEMETRY_REPLAY_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+
+
+#include "MappedFile.h"
+#include "TelemetryFormat.h"
+
+
+
+
+/// A class that reads the frames of a telemetry log in any order.
+/**
+  * When a log is opened, only the chunk headers are read, to build an index of the
+  * chunks' frames and time ranges. Seeking to a frame decodes the chunk that contains
+  * it, and frames in the same chunk are then read without decoding anything else, so
+  * playing the log forward at any speed only decodes each chunk once.
+  *
+  * If the log was cut short, the frames up to the last complete chunk are read.
+  */
+class TelemetryReplay
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new telemetry replay without an open log.
+			TelemetryReplay();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	File Methods
+			
+			
+			
+			
+			/// Open the log at the specified path and seek to its first frame.
+			/**
+			  * The method returns FALSE if the file can't be read, isn't a telemetry log,
+			  * or has no complete chunks.
+			  */
+			Bool open( const data::UTF8String& filePath );
+			
+			
+			
+			
+			/// Close the log that is open.
+			void close();
+			
+			
+			
+			
+			/// Return whether or not a log is open.
+			RIM_INLINE Bool isOpen() const
+			{
+				return chunks.getSize() > 0;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Seek Methods
+			
+			
+			
+			
+			/// Seek to the last frame at or before the specified simulation time, or the first frame if there is none.
+			Bool seek( Double time );
+			
+			
+			
+			
+			/// Seek to the frame with the specified index, returning whether or not it could be read.
+			Bool seekFrame( Index frameIndex );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Log Accessor Methods
+			
+			
+			
+			
+			/// Return the number of frames in the log.
+			RIM_INLINE Size getFrameCount() const
+			{
+				return numFrames;
+			}
+			
+			
+			
+			
+			/// Return the simulation time of the first frame in the log.
+			RIM_INLINE Double getStartTime() const
+			{
+				return chunks.getSize() > 0 ? chunks.getFirst().header.startTime : Double(0);
+			}
+			
+			
+			
+			
+			/// Return the simulation time of the last frame in the log.
+			RIM_INLINE Double getEndTime() const
+			{
+				return chunks.getSize() > 0 ? chunks.getLast().header.endTime : Double(0);
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Frame Accessor Methods
+			
+			
+			
+			
+			/// Return the index of the current frame.
+			RIM_INLINE Index getFrameIndex() const
+			{
+				return frameIndex;
+			}
+			
+			
+			
+			
+			/// Return the simulation time of the current frame.
+			RIM_INLINE Double getTime() const
+			{
+				return frameTime;
+			}
+			
+			
+			
+			
+			/// Return the number of vehicles in the current frame.
+			RIM_INLINE Size getVehicleCount() const
+			{
+				return vehicleRecords.getSize();
+			}
+			
+			
+			
+			
+			/// Return the transform state of the vehicle at the specified index in the current frame.
+			RIM_INLINE TransformState getState( Index vehicleIndex ) const
+			{
+				return vehicleRecords[vehicleIndex].getState();
+			}
+			
+			
+			
+			
+			/// Return the target waypoint of the vehicle at the specified index in the current frame.
+			RIM_INLINE Vector3f getNextWaypoint( Index vehicleIndex ) const
+			{
+				return vehicleRecords[vehicleIndex].getNextWaypoint();
+			}
+			
+			
+			
+			
+			/// Return the number of motor thrusts of the vehicle at the specified index in the current frame.
+			RIM_INLINE Size getThrustCount( Index vehicleIndex ) const
+			{
+				const Size numThrusts = vehicleRecords[vehicleIndex].numThrusts;
+				
+				return numThrusts < MotorAllocator::MAX_MOTORS ? numThrusts : MotorAllocator::MAX_MOTORS;
+			}
+			
+			
+			
+			
+			/// Return the thrust of a motor of the vehicle at the specified index in the current frame.
+			RIM_INLINE Float getThrust( Index vehicleIndex, Index motorIndex ) const
+			{
+				return vehicleRecords[vehicleIndex].thrusts[motorIndex];
+			}
+			
+			
+			
+			
+			/// Return the path of the vehicle at the specified index in the current frame.
+			RIM_INLINE const vertices& getPath( Index vehicleIndex ) const
+			{
+				return paths[vehicleIndex];
+			}
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Chunk Class Declaration
+			
+			
+			
+			
+			/// A class that stores where a chunk is in the log and which frames it has.
+			class Chunk
+			{
+				public:
+					
+					/// The chunk's header.
+					TelemetryFormat::ChunkHeader header;
+					
+					/// The offset in bytes of the chunk's compressed frames in the log.
+					Size dataOffset;
+					
+					/// The index in the log of the chunk's first frame.
+					Index firstFrame;
+			
+			};
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Decompress the chunk at the specified index and undo its deltas, returning whether or not it was valid.
+			Bool loadChunk( Index chunkIndex );
+			
+			
+			
+			
+			/// Read the paths and vehicle records of the frame at the specified index in the loaded chunk.
+			void readFrame( Index chunkFrameIndex );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The mapped log file.
+			MappedFile file;
+			
+			
+			/// The complete chunks of the log, in order.
+			ArrayList<Chunk> chunks;
+			
+			
+			/// The number of frames in the complete chunks.
+			Size numFrames;
+			
+			
+			/// The index of the chunk that is decoded, or chunks.getSize() if there is none.
+			Index loadedChunk;
+			
+			
+			/// The decoded frames of the loaded chunk, with the vehicle records stored as is.
+			Array<UByte> chunkData;
+			
+			
+			/// The offset in the decoded chunk of each of its frames.
+			ArrayList<Size> frameOffsets;
+			
+			
+			/// The offset in the decoded chunk of the first vehicle record of each of its frames.
+			ArrayList<Size> recordOffsets;
+			
+			
+			/// The simulation time of each frame in the loaded chunk.
+			ArrayList<Double> frameTimes;
+			
+			
+			/// The index in the log of the current frame.
+			Index frameIndex;
+			
+			
+			/// The simulation time of the current frame.
+			Double frameTime;
+			
+			
+			/// The index in the loaded chunk of the frame whose paths were last read, or -1 if none were.
+			Int64 pathFrame;
+			
+			
+			/// The vehicle records of the current frame.
+			ArrayList<TelemetryFormat::VehicleRecord> vehicleRecords;
+			
+			
+			/// The path of each vehicle as of the current frame.
+			ArrayList<vertices> paths;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_TELEMETRY_REPLAY_H
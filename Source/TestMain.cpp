@@ -0,0 +1,58 @@
+/*
+ *  TestMain.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "TestSuite.h"
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+
+
+static void printUsage( const char* programName )
+{
+	std::fprintf( stderr, "Usage: %s [--scene <obj path>] [--seed N]\n", programName );
+}
+
+
+
+
+int main (int argc, char * const argv[])
+{
+	TestSuite suite;
+	const char* scenePath = "Data/Port City/Port City.obj";
+	
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( i + 1 >= argc )
+		{
+			printUsage( argv[0] );
+			return 1;
+		}
+		
+		const char* option = argv[i];
+		const char* value = argv[++i];
+		
+		if ( std::strcmp( option, "--scene" ) == 0 )
+			scenePath = value;
+		else if ( std::strcmp( option, "--seed" ) == 0 )
+			suite.setRandomSeed( UInt32(std::strtoul( value, NULL, 10 )) );
+		else
+		{
+			printUsage( argv[0] );
+			return 1;
+		}
+	}
+	
+	if ( !suite.loadScene( scenePath ) )
+		return 1;
+	
+	return suite.run() ? 0 : 1;
+}
@@ -0,0 +1,534 @@
+/*
+ *  TestSuite.cpp
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#include "TestSuite.h"
+#include "TelemetryFormat.h"
+#include "MeshPrimitiveSet.h"
+
+
+#include <cstring>
+
+
+/// The number of random buffers that are compressed and decompressed.
+static const UInt32 NUM_COMPRESSION_BUFFERS = 256;
+
+
+/// The maximum size in bytes of each random buffer.
+static const UInt32 MAX_BUFFER_SIZE = 4096;
+
+
+/// The maximum length of the runs of zero and random bytes in each buffer, which is longer than one compressed run.
+static const UInt32 MAX_BUFFER_RUN = 300;
+
+
+/// The number of frames of a vehicle's records that are delta encoded and compressed.
+static const Size NUM_RECORD_FRAMES = 256;
+
+
+/// The number of ray packets that are traced through the scene.
+static const Size NUM_RAY_PACKETS = 1 << 14;
+
+
+/// The maximum distance of each ray.
+static const Float RAY_DISTANCE = 100.0f;
+
+
+/// The maximum offset along each axis of the rays in a packet of nearby rays from their shared direction.
+static const Float PACKET_SPREAD = 0.02f;
+
+
+/// The largest relative difference between a packet's distance and a single ray's, since their intersection tests round differently.
+static const Float PACKET_DISTANCE_TOLERANCE = 1.0e-4f;
+
+
+/// The number of vehicles in the fleet, which isn't a multiple of the fleet's group width so that the last group is partial.
+static const Size NUM_FLEET_VEHICLES = 37;
+
+
+/// The number of simulation steps that the two integration methods are compared for.
+static const Size NUM_FLEET_STEPS = 240;
+
+
+/// The fixed simulation time step in seconds.
+static const Float FLEET_TIME_STEP = 1.0f/120.0f;
+
+
+/// The relative error of each step that the FLEET_RK4 method is documented to be within of the RK4 method.
+static const Float FLEET_TOLERANCE = 1.0e-5f;
+
+
+/// The thread counts that the parallel collision trees are built with.
+static const Size TREE_THREAD_COUNTS[] = { 2, 3, 8 };
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Helper Functions
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+/// Return whether or not two vectors differ by at most the tolerance relative to the first's magnitude, or to 1 if it is smaller.
+static Bool vectorsMatch( const Vector3f& a, const Vector3f& b, Float tolerance )
+{
+	return (a - b).getMagnitude() <= tolerance*math::max( a.getMagnitude(), Float(1) );
+}
+
+
+
+
+/// Return whether or not each part of two transform states matches to within a relative tolerance.
+static Bool statesMatch( const TransformState& a, const TransformState& b, Float tolerance )
+{
+	const Quaternion<Float>& q1 = a.orientation;
+	const Quaternion<Float>& q2 = b.orientation;
+	
+	// The orientations are unit quaternions, so their components are compared to the tolerance directly.
+	return vectorsMatch( a.position, b.position, tolerance ) &&
+			vectorsMatch( a.velocity, b.velocity, tolerance ) &&
+			vectorsMatch( a.angularVelocity, b.angularVelocity, tolerance ) &&
+			math::abs( q1.a - q2.a ) <= tolerance && math::abs( q1.b - q2.b ) <= tolerance &&
+			math::abs( q1.c - q2.c ) <= tolerance && math::abs( q1.d - q2.d ) <= tolerance;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Constructor
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+TestSuite:: TestSuite()
+	:	sceneBounds( -300, 300, 0, 50, -500, 300 ),
+		randomSeed( 0 ),
+		numChecks( 0 ),
+		numFailures( 0 )
+{
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Setup Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool TestSuite:: loadScene( const char* newScenePath )
+{
+	graphics::io::OBJTranscoder objTranscoder;
+	mesh = objTranscoder.decode( ResourceID( newScenePath ) ).dynamicCast<GenericMeshShape>();
+	
+	if ( mesh.isNull() )
+	{
+		std::fprintf( stderr, "Unable to load the scene mesh %s\n", newScenePath );
+		return false;
+	}
+	
+	return true;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Run Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+Bool TestSuite:: run()
+{
+	numChecks = 0;
+	numFailures = 0;
+	
+	testTelemetryCompression();
+	testRayPackets();
+	testFleetIntegration();
+	testParallelTreeBuild();
+	
+	std::fprintf( stderr, "%lu of %lu checks passed\n", (unsigned long)(numChecks - numFailures),
+				(unsigned long)numChecks );
+	
+	return numFailures == 0;
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Test Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void TestSuite:: testTelemetryCompression()
+{
+	RandomVariable<UInt32> randomVariable( randomSeed );
+	ArrayList<UByte> data;
+	ArrayList<UByte> compressed;
+	Array<UByte> decompressed( MAX_BUFFER_SIZE + 1 );
+	Size numFailedCases = 0;
+	
+	for ( Index b = 0; b < NUM_COMPRESSION_BUFFERS; b++ )
+	{
+		// Alternate runs of zeros with runs of random bytes, which can have single zeros in them.
+		const Size size = randomVariable.sample( 0, MAX_BUFFER_SIZE );
+		data.clear();
+		
+		while ( data.getSize() < size )
+		{
+			const Size runLength = math::min( Size(randomVariable.sample( 1, MAX_BUFFER_RUN )), size - data.getSize() );
+			const Bool isZeroRun = randomVariable.sample( 0, 1 ) == 0;
+			
+			for ( Index i = 0; i < runLength; i++ )
+				data.add( isZeroRun ? UByte(0) : UByte(randomVariable.sample( 0, 255 )) );
+		}
+		
+		compressed.clear();
+		TelemetryFormat::compress( data.getPointer(), size, compressed );
+		
+		// The data must only decompress to exactly its own size, and not when the input is cut short.
+		const Bool decoded = TelemetryFormat::decompress( compressed.getPointer(), compressed.getSize(),
+															decompressed.getPointer(), size );
+		
+		if ( !decoded || std::memcmp( decompressed.getPointer(), data.getPointer(), size ) != 0 ||
+			TelemetryFormat::decompress( compressed.getPointer(), compressed.getSize(),
+										decompressed.getPointer(), size + 1 ) ||
+			(size > 0 && TelemetryFormat::decompress( compressed.getPointer(), compressed.getSize() - 1,
+													decompressed.getPointer(), size )) )
+			numFailedCases++;
+	}
+	
+	addResult( "TelemetryFormat::compress buffers", NUM_COMPRESSION_BUFFERS, numFailedCases );
+	
+	//********************************************************************************
+	// Delta encode a vehicle's records as the recorder does, changing some of the words each frame.
+	
+	RandomVariable<Float> floatVariable( randomSeed );
+	TelemetryFormat::VehicleRecord previous;
+	rim::util::zero( &previous, 1 );
+	previous.numThrusts = 4;
+	numFailedCases = 0;
+	
+	for ( Index f = 0; f < NUM_RECORD_FRAMES; f++ )
+	{
+		TelemetryFormat::VehicleRecord current = previous;
+		
+		for ( Index i = 0; i < 3; i++ )
+		{
+			current.position[i] += floatVariable.sample( -1.0f, 1.0f );
+			current.velocity[i] = floatVariable.sample( -5.0f, 5.0f );
+		}
+		
+		current.thrusts[f % current.numThrusts] = floatVariable.sample( 0.0f, 10.0f );
+		
+		TelemetryFormat::VehicleRecord delta = current;
+		TelemetryFormat::xorRecord( delta, previous );
+		
+		compressed.clear();
+		TelemetryFormat::compress( (const UByte*)&delta, sizeof(delta), compressed );
+		
+		TelemetryFormat::VehicleRecord decoded;
+		
+		if ( TelemetryFormat::decompress( compressed.getPointer(), compressed.getSize(), (UByte*)&decoded, sizeof(decoded) ) )
+		{
+			TelemetryFormat::xorRecord( decoded, previous );
+			
+			if ( std::memcmp( &decoded, &current, sizeof(current) ) != 0 )
+				numFailedCases++;
+		}
+		else
+			numFailedCases++;
+		
+		previous = current;
+	}
+	
+	addResult( "TelemetryFormat::compress records", NUM_RECORD_FRAMES, numFailedCases );
+}
+
+
+
+
+void TestSuite:: testRayPackets()
+{
+	MeshPrimitiveSet primitives( mesh );
+	Pointer<CollisionTree> tree = Pointer<CollisionTree>::construct();
+	tree->build( primitives );
+	
+	RandomVariable<Float> randomVariable( randomSeed );
+	Vector3f directions[4];
+	Float packetDistances[4];
+	Size numFailedCases = 0;
+	
+	for ( Index p = 0; p < NUM_RAY_PACKETS; p++ )
+	{
+		const Vector3f origin = getRandomPoint( randomVariable );
+		const Vector3f direction = getRandomDirection( randomVariable );
+		
+		// Alternate between packets of nearby rays, like neighboring pixels, and packets of unrelated rays.
+		for ( Index i = 0; i < 4; i++ )
+		{
+			if ( p % 2 == 0 )
+			{
+				const Vector3f offsetDirection = direction + Vector3f( randomVariable.sample( -PACKET_SPREAD, PACKET_SPREAD ),
+																		randomVariable.sample( -PACKET_SPREAD, PACKET_SPREAD ),
+																		randomVariable.sample( -PACKET_SPREAD, PACKET_SPREAD ) );
+				directions[i] = offsetDirection / offsetDirection.getMagnitude();
+			}
+			else
+				directions[i] = getRandomDirection( randomVariable );
+		}
+		
+		const int hitMask = tree->traceRayPacket( origin, directions, RAY_DISTANCE, packetDistances );
+		
+		for ( Index i = 0; i < 4; i++ )
+		{
+			Float distance = RAY_DISTANCE;
+			const Bool hit = tree->traceRay( origin, directions[i], RAY_DISTANCE, distance );
+			
+			if ( !hit )
+				distance = RAY_DISTANCE;
+			
+			if ( hit != ((hitMask & (1 << i)) != 0) ||
+				math::abs( packetDistances[i] - distance ) > PACKET_DISTANCE_TOLERANCE*math::max( distance, Float(1) ) )
+				numFailedCases++;
+		}
+	}
+	
+	addResult( "CollisionTree::traceRayPacket", 4*NUM_RAY_PACKETS, numFailedCases );
+}
+
+
+
+
+void TestSuite:: testFleetIntegration()
+{
+	RandomVariable<Float> randomVariable( randomSeed );
+	ArrayList< Pointer<Quadcopter> > rk4Quadcopters( NUM_FLEET_VEHICLES );
+	ArrayList< Pointer<Quadcopter> > fleetQuadcopters( NUM_FLEET_VEHICLES );
+	
+	Simulation rk4Simulation;
+	rk4Simulation.setIntegrationMethod( Simulation::RK4 );
+	
+	Simulation fleetSimulation;
+	fleetSimulation.setIntegrationMethod( Simulation::FLEET_RK4 );
+	
+	// Give each pair of vehicles the same start and a fixed waypoint, without a roadmap, so that only the integrators differ.
+	for ( Index i = 0; i < NUM_FLEET_VEHICLES; i++ )
+	{
+		const Vector3f start = getRandomPoint( randomVariable );
+		const Vector3f goal = getRandomPoint( randomVariable );
+		
+		for ( Index s = 0; s < 2; s++ )
+		{
+			Pointer<Quadcopter> quadcopter = Pointer<Quadcopter>::construct();
+			quadcopter->currentState.position = start;
+			quadcopter->setStandardAirframe();
+			quadcopter->goalpoint = goal;
+			quadcopter->nextWaypoint = goal;
+			
+			if ( s == 0 )
+			{
+				rk4Quadcopters.add( quadcopter );
+				rk4Simulation.addQuadcopter( quadcopter );
+			}
+			else
+			{
+				fleetQuadcopters.add( quadcopter );
+				fleetSimulation.addQuadcopter( quadcopter );
+			}
+		}
+	}
+	
+	rk4Simulation.setRandomSeed( randomSeed );
+	fleetSimulation.setRandomSeed( randomSeed );
+	
+	Size numFailedCases = 0;
+	
+	for ( Index step = 0; step < NUM_FLEET_STEPS; step++ )
+	{
+		rk4Simulation.update( FLEET_TIME_STEP );
+		fleetSimulation.update( FLEET_TIME_STEP );
+		
+		for ( Index i = 0; i < NUM_FLEET_VEHICLES; i++ )
+		{
+			Quadcopter& rk4Quadcopter = *rk4Quadcopters[i];
+			Quadcopter& fleetQuadcopter = *fleetQuadcopters[i];
+			
+			if ( !statesMatch( rk4Quadcopter.currentState, fleetQuadcopter.currentState, FLEET_TOLERANCE ) )
+				numFailedCases++;
+			
+			// Start the next step from the same state and thrusts, so that the error is measured per step and doesn't accumulate.
+			fleetQuadcopter.currentState = rk4Quadcopter.currentState;
+			
+			for ( Index m = 0; m < rk4Quadcopter.motors.getSize(); m++ )
+				fleetQuadcopter.motors[m].thrust = rk4Quadcopter.motors[m].thrust;
+		}
+	}
+	
+	addResult( "Simulation FLEET_RK4", NUM_FLEET_VEHICLES*NUM_FLEET_STEPS, numFailedCases );
+}
+
+
+
+
+void TestSuite:: testParallelTreeBuild()
+{
+	MeshPrimitiveSet primitives( mesh );
+	Pointer<CollisionTree> serialTree = Pointer<CollisionTree>::construct();
+	serialTree->build( primitives );
+	
+	const Size numThreadCounts = sizeof(TREE_THREAD_COUNTS) / sizeof(Size);
+	Size numFailedCases = 0;
+	
+	for ( Index c = 0; c < numThreadCounts; c++ )
+	{
+		threadPool.setThreadCount( TREE_THREAD_COUNTS[c] );
+		
+		Pointer<CollisionTree> parallelTree = Pointer<CollisionTree>::construct();
+		parallelTree->build( primitives, &threadPool );
+		
+		if ( parallelTree->getNodeCount() != serialTree->getNodeCount() ||
+			parallelTree->getTriangleCount() != serialTree->getTriangleCount() ||
+			(serialTree->getNodeCount() > 0 && !subtreesMatch( *serialTree, 0, *parallelTree, 0 )) )
+			numFailedCases++;
+	}
+	
+	addResult( "CollisionTree::build", numThreadCounts, numFailedCases );
+}
+
+
+
+
+//##########################################################################################
+//##########################################################################################
+//############
+//############		Private Helper Methods
+//############
+//##########################################################################################
+//##########################################################################################
+
+
+
+
+void TestSuite:: addResult( const char* name, Size numCases, Size numFailedCases )
+{
+	numChecks++;
+	
+	if ( numFailedCases == 0 )
+		std::fprintf( stderr, "PASS %s (%lu cases)\n", name, (unsigned long)numCases );
+	else
+	{
+		std::fprintf( stderr, "FAIL %s (%lu of %lu cases failed)\n", name, (unsigned long)numFailedCases,
+					(unsigned long)numCases );
+		numFailures++;
+	}
+}
+
+
+
+
+Bool TestSuite:: subtreesMatch( const CollisionTree& tree1, Index node1, const CollisionTree& tree2, Index node2 )
+{
+	const CollisionTree::Node& a = tree1.nodeData[node1];
+	const CollisionTree::Node& b = tree2.nodeData[node2];
+	
+	for ( Index c = 0; c < 4; c++ )
+	{
+		for ( Index i = 0; i < 6; i++ )
+		{
+			if ( a.bounds[i][c] != b.bounds[i][c] )
+				return false;
+		}
+		
+		if ( a.numTriangles[c] != b.numTriangles[c] )
+			return false;
+		
+		if ( a.numTriangles[c] > 0 )
+		{
+			// Compare the leaf's triangles themselves, since only the node order is allowed to differ.
+			for ( Index t = 0; t < a.numTriangles[c]; t++ )
+			{
+				const Triangle<Vector3f>& triangle1 = tree1.triangleData[a.children[c] + t];
+				const Triangle<Vector3f>& triangle2 = tree2.triangleData[b.children[c] + t];
+				
+				if ( triangle1.v1 != triangle2.v1 || triangle1.v2 != triangle2.v2 || triangle1.v3 != triangle2.v3 )
+					return false;
+			}
+		}
+		else
+		{
+			// Unused children have an invalid index, which is past the end of the nodes.
+			const Bool isNode1 = a.children[c] < tree1.numNodes;
+			const Bool isNode2 = b.children[c] < tree2.numNodes;
+			
+			if ( isNode1 != isNode2 || (isNode1 && !subtreesMatch( tree1, a.children[c], tree2, b.children[c] )) )
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+
+
+
+Vector3f TestSuite:: getRandomPoint( RandomVariable<Float>& randomVariable ) const
+{
+	return Vector3f( randomVariable.sample( sceneBounds.min.x, sceneBounds.max.x ),
+					randomVariable.sample( sceneBounds.min.y, sceneBounds.max.y ),
+					randomVariable.sample( sceneBounds.min.z, sceneBounds.max.z ) );
+}
+
+
+
+
+Vector3f TestSuite:: getRandomDirection( RandomVariable<Float>& randomVariable )
+{
+	// Reject points outside the unit sphere so that the directions are uniformly distributed.
+	while ( true )
+	{
+		const Vector3f v( randomVariable.sample( -1.0f, 1.0f ),
+						randomVariable.sample( -1.0f, 1.0f ),
+						randomVariable.sample( -1.0f, 1.0f ) );
+		const Float magnitudeSquared = v.getMagnitudeSquared();
+		
+		if ( magnitudeSquared > 0.0001f && magnitudeSquared <= 1.0f )
+			return v / math::sqrt( magnitudeSquared );
+	}
+}
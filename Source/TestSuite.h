@@ -0,0 +1,215 @@
+/*
+ *  TestSuite.h
+ *  Quadcopter
+ *
+ *  Copyright 2014 __MyCompanyName__. All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_TEST_SUITE_H
+#define INCLUDE_TEST_SUITE_H
+
+
+#include "rim/rimEngine.h"
+
+
+using namespace rim;
+using namespace rim::math;
+using namespace rim::graphics;
+
+
+#include "CollisionTree.h"
+#include "Simulation.h"
+
+
+#include <cstdio>
+
+
+
+
+/// A class that checks the optimized code paths against the simple versions that they replace.
+/**
+  * Every test draws its inputs from random streams with a fixed seed, so a run with
+  * the same seed always checks the same cases. A failed check prints what it compared
+  * to the standard error stream, and the run fails if any check did.
+  *
+  * The tests are:
+  *
+  *		TelemetryFormat::compress		Compressed buffers and record deltas decompress to the original bytes.
+  *		CollisionTree::traceRayPacket	Packets of rays through the scene match four calls to traceRay().
+  *		Simulation FLEET_RK4			Each step of a fleet matches the RK4 method to within 1e-5.
+  *		CollisionTree::build			Trees built on a thread pool have the same nodes as one built serially.
+  */
+class TestSuite
+{
+	public:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Constructor
+			
+			
+			
+			
+			/// Create a new test suite with the default seed.
+			TestSuite();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Setup Methods
+			
+			
+			
+			
+			/// Load the OBJ mesh of the scene that the tests are run in.
+			/**
+			  * The method prints a message and returns FALSE if the mesh can't be loaded.
+			  */
+			Bool loadScene( const char* newScenePath );
+			
+			
+			
+			
+			/// Set the seed of the random streams that the test inputs are drawn from.
+			RIM_INLINE void setRandomSeed( UInt32 newSeed )
+			{
+				randomSeed = newSeed;
+			}
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Run Methods
+			
+			
+			
+			
+			/// Run every test in order, printing the results to the standard error stream.
+			/**
+			  * The method returns whether or not every check passed.
+			  */
+			Bool run();
+	
+	
+	
+	
+	private:
+		
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Test Methods
+			
+			
+			
+			
+			/// Check that random buffers and vehicle record deltas survive a compression round trip.
+			void testTelemetryCompression();
+			
+			
+			
+			
+			/// Check that ray packets through the scene hit the same triangles at the same distances as single rays.
+			void testRayPackets();
+			
+			
+			
+			
+			/// Check that each step of the FLEET_RK4 method matches the per-vehicle RK4 method within its stated error.
+			void testFleetIntegration();
+			
+			
+			
+			
+			/// Check that collision trees built with several thread counts are the same as one built on one thread.
+			void testParallelTreeBuild();
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Helper Methods
+			
+			
+			
+			
+			/// Count a check of a number of cases and print its result to the standard error stream.
+			/**
+			  * The check fails if any of its cases did.
+			  */
+			void addResult( const char* name, Size numCases, Size numFailedCases );
+			
+			
+			
+			
+			/// Return a random point in the scene bounds.
+			Vector3f getRandomPoint( RandomVariable<Float>& randomVariable ) const;
+			
+			
+			
+			
+			/// Return a random unit-length direction.
+			static Vector3f getRandomDirection( RandomVariable<Float>& randomVariable );
+			
+			
+			
+			
+			/// Return whether or not the subtrees at a node of each tree have the same bounds and triangles.
+			/**
+			  * The nodes of a parallel build are stored in a different order, so the trees
+			  * are compared by walking them together rather than by comparing their arrays.
+			  */
+			static Bool subtreesMatch( const CollisionTree& tree1, Index node1, const CollisionTree& tree2, Index node2 );
+			
+			
+			
+			
+		//********************************************************************************
+		//********************************************************************************
+		//********************************************************************************
+		//******	Private Data Members
+			
+			
+			
+			
+			/// The mesh of the scene.
+			Pointer<GenericMeshShape> mesh;
+			
+			
+			/// The bounds that random queries are sampled in.
+			AABB3f sceneBounds;
+			
+			
+			/// The seed of the random streams that the test inputs are drawn from.
+			UInt32 randomSeed;
+			
+			
+			/// A pool of worker threads used to build collision trees in parallel.
+			threads::ThreadPool threadPool;
+			
+			
+			/// The number of checks that have been run.
+			Size numChecks;
+			
+			
+			/// The number of checks that have failed.
+			Size numFailures;
+
+
+
+};
+
+
+
+
+#endif // INCLUDE_TEST_SUITE_H
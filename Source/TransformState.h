@@ -48,8 +48,12 @@ public:
      */
     //Orientation orientation;
 	
-	/// A 3x3 orthonormal rotation matrix indicating the rotation from body to world space.
-	Matrix3f rotation;
+	/// A unit quaternion indicating the rotation from body to world space.
+	/**
+	  * The rotation matrix isn't stored. It is computed from the quaternion with
+	  * getRotation() only where it is needed, such as for graphics.
+	  */
+	Quaternion<Float> orientation;
 	
     /**
      * A <code>Vector3f</code> object containing the velocity of the object.
@@ -73,7 +77,7 @@ public:
      */
     TransformState()
 		:	position(),
-			rotation( Matrix3f::IDENTITY ),
+			orientation(),
 			velocity(),
 			angularVelocity()
 	{
@@ -94,20 +98,75 @@ public:
      *            A <code>Vector3f</code> object containing the velocity of the
      *            object.
      */
-    TransformState( const Vector3f& pos, const Matrix3f& rot, const Vector3f& vel, const Vector3f& angularVel )
+    TransformState( const Vector3f& pos, const Quaternion<Float>& orient, const Vector3f& vel, const Vector3f& angularVel )
 		:	position( pos ),
-			rotation( rot ),
+			orientation( orient ),
 			velocity( vel ),
 			angularVelocity( angularVel )
 	{
     }
 	
 	
+	/// Create a new transform state with the orientation of the specified orthonormal rotation matrix.
+	TransformState( const Vector3f& pos, const Matrix3f& rot, const Vector3f& vel, const Vector3f& angularVel )
+		:	position( pos ),
+			orientation( Quaternion<Float>( rot ).normalize() ),
+			velocity( vel ),
+			angularVelocity( angularVel )
+	{
+    }
+	
+	
+	
+	/// Return the orthonormal rotation matrix from body to world space.
+	Matrix3f getRotation() const
+	{
+		return orientation.toMatrixNormalized();
+	}
+	
+	
+	/// Set the orientation from an orthonormal rotation matrix from body to world space.
+	void setRotation( const Matrix3f& rotation )
+	{
+		orientation = Quaternion<Float>( rotation ).normalize();
+	}
+	
+	
+	
+	/// Return the unit quaternion for a rotation by the magnitude of a vector in radians around its direction.
+	/**
+	  * This is the exponential map from a rotation vector to a quaternion. For small
+	  * angles, a Taylor series is used to avoid dividing by the angle.
+	  */
+	static Quaternion<Float> getRotationQuaternion( const Vector3f& rotationVector )
+	{
+		const Float angle = rotationVector.getMagnitude();
+		const Float halfAngle = Float(0.5)*angle;
+		const Float scale = angle > Float(1.0e-4) ? math::sin( halfAngle ) / angle :
+												Float(0.5) - angle*angle / Float(48);
+		
+		return Quaternion<Float>( math::cos( halfAngle ), rotationVector.x*scale,
+								rotationVector.y*scale, rotationVector.z*scale );
+	}
+	
+	
+	/// Return a unit quaternion orientation rotated by the specified world-space rotation vector.
+	/**
+	  * This integrates a constant angular velocity w over a time step h when the
+	  * rotation vector is w*h. The product of unit quaternions only drifts from unit
+	  * length by rounding error, so a cheap renormalization keeps it valid.
+	  */
+	static Quaternion<Float> rotateOrientation( const Quaternion<Float>& orientation, const Vector3f& rotationVector )
+	{
+		return (getRotationQuaternion( rotationVector )*orientation).normalize();
+	}
+	
+	
 	
 	/// Transform a point in body space into world space.
 	Vector3f transformToWorld( const Vector3f& point ) const
 	{
-		return position + rotation*point;
+		return position + rotateVectorToWorld( point );
 	}
 	
 	
@@ -115,23 +174,34 @@ public:
 	/// Transform a point in world space into body space.
 	Vector3f transformToBody( const Vector3f& point ) const
 	{
-		// Reverse multiply is the same as multiply by the transpose.
-		return (point - position)*rotation;
+		return rotateVectorToBody( point - position );
 	}
 	
 	
 	/// Rotate a vector in body space into world space.
 	Vector3f rotateVectorToWorld( const Vector3f& point ) const
 	{
-		return rotation*point;
+		return rotateVector( orientation.a, Vector3f( orientation.b, orientation.c, orientation.d ), point );
 	}
 	
 	
 	/// Rotate a vector in world space into body space.
 	Vector3f rotateVectorToBody( const Vector3f& point ) const
 	{
-		// Reverse multiply is the same as multiply by the transpose.
-		return point*rotation;
+		// Rotating by the conjugate quaternion is the same as rotating by the inverse.
+		return rotateVector( orientation.a, -Vector3f( orientation.b, orientation.c, orientation.d ), point );
+	}
+
+
+private:
+	
+	/// Rotate a vector by the unit quaternion with the specified scalar and vector parts.
+	static Vector3f rotateVector( Float w, const Vector3f& u, const Vector3f& v )
+	{
+		// Expand q*v*q^-1 without building the rotation matrix.
+		const Vector3f t = math::cross( u, v )*Float(2);
+		
+		return v + t*w + math::cross( u, t );
 	}
 };
 